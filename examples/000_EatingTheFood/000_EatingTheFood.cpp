@@ -51,8 +51,7 @@ const unsigned long FOODTREAT_DURATIONS[MAX_LEVEL] = {192000, 96000, 48000,
 const unsigned long SOUND_FOODTREAT_DELAY = 1200;  // (ms) delay for reward
                                                    // sound
 
-int performance[HISTORY_LENGTH] = {0};  // store the progress in this challenge
-int perfPos = 0;                        // position in the performance array
+PerformanceStats performance(HISTORY_LENGTH);  // store the progress in this challenge
 bool foodtreatWasEaten = false;  // store if foodtreat was eaten in last interaction
 bool challengeComplete = false; // do not re-initialize
 
@@ -196,8 +195,6 @@ void setup() {
  * ------------------
  */
 void loop() {
-  unsigned int perf_total = 0;  // sum of performance of the
-                                // HISTORY_LENGTH last interactions
   bool gameIsComplete = false;
 
   // Advance the device layer state machine, but with 20 ms max time
@@ -207,25 +204,15 @@ void loop() {
   // Play 1 level of the Eating The Food challenge
   gameIsComplete = playEatingTheFood();  // Will return true if level is done
 
-  // Store level result in performance array
+  // Store level result in performance history
   if (gameIsComplete) {
-    performance[perfPos] = foodtreatWasEaten;  // store the interaction result
-                                               // in the performance array
-    perfPos++;
-    if (perfPos > (HISTORY_LENGTH - 1)) {  // make our performance array circular
-      perfPos = 0;
-    }
+    performance.AddResult(foodtreatWasEaten);  // store the interaction result
   }
 
-  // Check performance array if we're ready to pass to next challenge
-  for (int i = 0; i < HISTORY_LENGTH; ++i) {
-    perf_total += performance[i];
-    if (perf_total >= ENOUGH_SUCCESSES) {
-      Log.info("Challenge completed!");
-      challengeComplete = true;
-      // reset performance
-      perf_total = 0;
-      for (unsigned char i = 0; i < HISTORY_LENGTH; ++i) performance[i] = 0;
-    }
+  // Check performance history if we're ready to pass to next challenge
+  if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
+    Log.info("Challenge completed!");
+    challengeComplete = true;
+    performance.ResetHistory();
   }
 }
@@ -67,10 +67,7 @@ const int FLASHING_DUTY_CYCLE = 99; // ignored since no FLASHING
 const unsigned long SOUND_FOODTREAT_DELAY = 1200; // (ms) delay for reward sound
 const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0;   // to keep our position in the performance array
-unsigned char perfDepth = 0; // to keep the size of the number of perf numbers
-                              // to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
 // timer values to check if challenge should continue
 unsigned long challenge_timer_before, challenge_timer_length = 0;
 bool reset_challenge_timer = true; // bool to check if timer time should be
@@ -94,53 +91,11 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-//// return the number of positive interactions in performance history for current level
-unsigned int countSuccesses() {
-  unsigned int total = 0;
-  for (unsigned char i = 0; i <= perfDepth - 1; i++)
-    if (performance[i] == 1)
-      total++;
-  return total;
-}
-
-/// return the number of negative interactions in performance history for current level
-unsigned int countMisses() {
-  unsigned int total = 0;
-  for (unsigned char i = 0; i <= perfDepth - 1; i++)
-    if (performance[i] == 0)
-      total++;
-  return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory() {
-  for (unsigned char i = 0; i < HISTORY_LENGTH; i++)
-    performance[i] = 0;
-  perfPos = 0;
-  perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry) {
-  // Log.info("Adding %u", entry);
-  performance[perfPos] = entry;
-  perfPos++;
-  if (perfDepth < HISTORY_LENGTH)
-    perfDepth++;
-  if (perfPos > (HISTORY_LENGTH - 1)) { // make our performance array circular
-    perfPos = 0;
-  }
-  // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-  Log.info("New successes: %u, misses: %u", countSuccesses(),
-           countMisses());
-}
-
-/// print the performance history for debugging
-void printPerformanceArray() {
-  Serial.printf("performance: ");
-  for (unsigned char i = 0; i < HISTORY_LENGTH; i++)
-    Serial.printf("%u", performance[i]);
-  Serial.printf("\n");
+  performance.AddResult(entry);
+  Log.info("New successes: %u, misses: %u", performance.CountSuccesses(),
+           performance.CountMisses());
 }
 
 /// The actual EngagingConsistently challenge. This function needs to be called in a loop.
@@ -171,7 +126,7 @@ bool playEngagingConsistently() {
   Log.info("-------------------------------------------");
   // Log.info("Starting new \"Engaging Consistently\" challenge");
   Log.info("Current level: %u, successes: %u, number of misses: %u", currentLevel,
-           countSuccesses(), countMisses());
+           performance.CountSuccesses(), performance.CountMisses());
 
   gameStartTime = Time.now();
 
@@ -245,26 +200,26 @@ bool playEngagingConsistently() {
   // Check if we're ready for next challenge
   if (currentLevel == MAX_LEVEL) {
     addResultToPerformanceHistory(foodtreatWasEaten);
-    if (countSuccesses() >= ENOUGH_SUCCESSES) {
+    if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
       Log.info("At MAX level! %u", currentLevel);
       challengeComplete = true;
-      resetPerformanceHistory();
+      performance.ResetHistory();
     }
   } else {
     // Increase level if foodtreat eaten and good performance in this level
     addResultToPerformanceHistory(foodtreatWasEaten);
-    if (countSuccesses() >= ENOUGH_SUCCESSES) {
+    if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
       if (currentLevel < MAX_LEVEL) {
         currentLevel++;
         Log.info("Leveling UP %u", currentLevel);
-        resetPerformanceHistory();
+        performance.ResetHistory();
       }
     }
   }
 
   // Decrease level if bad performance in this level
   // BAD_PERFORMACE is really high, so will never come here
-  if (countMisses() >= TOO_MANY_MISSES) {
+  if (performance.CountMisses() >= TOO_MANY_MISSES) {
     if (currentLevel > 1) {
       currentLevel--;
       Log.info("Leveling DOWN %u", currentLevel);
@@ -275,7 +230,7 @@ bool playEngagingConsistently() {
   // Send report
   Log.info("Sending report");
   String extra = String::format(
-      "{\"pos_tries\":%u,\"neg_tries\":%u", countSuccesses(), countMisses());
+      "{\"pos_tries\":%u,\"neg_tries\":%u", performance.CountSuccesses(), performance.CountMisses());
   if (challengeComplete) {extra += ",\"challengeComplete\":1";}
   extra += "}";
 
@@ -290,7 +245,9 @@ bool playEngagingConsistently() {
       extra                // extra field
   );
 
-  // printPerformanceArray();
+  // remember the level, and now and then the history, in case the hub loses power
+  performance.SetLevel(currentLevel);
+  performance.SaveIfDue(0, "EngagingConsistently");
 
   hub.SetDIResetLock(false); // allow DI board to reset if needed between interactions
   yield_finish();
@@ -304,6 +261,13 @@ bool playEngagingConsistently() {
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "EngagingConsistently")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = 1; // saved by another game or version
+    }
+  }
 }
 
 /**
@@ -320,7 +284,7 @@ void loop() {
   // if the challenge timer expired we need to reset it
   if (reset_challenge_timer) {
     // Log.info("Timer reset");
-    resetPerformanceHistory();
+    performance.ResetHistory();
     challenge_timer_before = millis();
     challenge_timer_length = CHALLENGE_TIMER_DURATIONS[currentLevel - 1];
     reset_challenge_timer = false;
@@ -33,7 +33,6 @@
 */
 
 #include <hackerpet.h>
-#include <algorithm>
 
 // Set this to the name of your player (dog, cat, etc.)
 const char PlayerName[] = "Pet, Clever";
@@ -67,11 +66,12 @@ const unsigned long INTER_GAME_DELAY = 6000;
 const unsigned long SOUND_FOODTREAT_DELAY = 1200; // (ms) delay for reward sound
 const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 const unsigned long VIEW_WINDOW = 500; // time delay for viewing the touchpad
+const unsigned long REACTION_GRACE = 250; // (ms) wait this much longer than the
+                                         // reaction time allows, so touches
+                                         // reach us even if the button poll
+                                         // reported them a moment late
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-int perfPos = 0;   // to keep our position in the performance array
-int perfDepth = 0; // to keep the size of the number of perf numbers to
-                    // consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
 
 // Use primary serial over USB interface for logging output (9600)
 // Choose logging level here (ERROR, WARN, INFO)
@@ -91,56 +91,11 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successful interactions in performance history for current level
-unsigned int countSuccesses() {
-  unsigned int total = 0;
-  for (unsigned char i = 0; i <= perfDepth - 1; i++)
-    if (performance[i] == 1)
-      total++;
-  return total;
-}
-
-/// return the number of misses in performance history for current level
-unsigned int countMisses() {
-  unsigned int total = 0;
-  for (unsigned char i = 0; i <= perfDepth - 1; i++)
-    if (performance[i] == 0)
-      total++;
-  return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory() {
-  for (unsigned char i = 0; i < HISTORY_LENGTH; i++)
-    performance[i] = 0;
-  perfPos = 0;
-  perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry) {
-  // Log.info("Adding %u", entry);
-  performance[perfPos] = entry;
-  perfPos++;
-  if (perfDepth < HISTORY_LENGTH)
-    perfDepth++;
-  if (perfPos > (HISTORY_LENGTH - 1)) { // make our performance array circular
-    perfPos = 0;
-  }
-  // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-  Log.info("New successful interactions: %u, misses: %u", countSuccesses(),
-           countMisses());
-}
-
-/// print the performance history for debugging
-void printPerformanceArray() {
-  Serial.printf("performance: {");
-  for (unsigned char i = 0; i < perfDepth; i++) {
-    Serial.printf("%u", performance[i]);
-    if ((i + 1) == perfPos)
-      Serial.printf("|");
-  }
-  Serial.printf("}\n");
+  performance.AddResult(entry);
+  Log.info("New successful interactions: %u, misses: %u", performance.CountSuccesses(),
+           performance.CountMisses());
 }
 
 /// converts a bitfield of pressed touchpads to letters
@@ -197,6 +152,7 @@ bool playRespondingQuickly() {
   yield_begin();
 
   static unsigned long gameStartTime, timestampTouchpad, timestampBefore, activityDuration = 0;
+  static unsigned long reactionTime, reactionError = 0;
   static unsigned char foodtreatState = 99;
   static unsigned char touchpads[3] = { hub.BUTTON_LEFT,  // should not be re-initialized
                                         hub.BUTTON_MIDDLE,
@@ -214,6 +170,8 @@ bool playRespondingQuickly() {
    timestampTouchpad = 0;
    timestampBefore = 0;
    activityDuration = 0;
+   reactionTime = 0;
+   reactionError = 0;
    foodtreatState = 99;
    accurate = false;
    timeout = false;
@@ -224,7 +182,7 @@ bool playRespondingQuickly() {
   Log.info("-------------------------------------------");
   // Log.info("Starting new \"Responding Quickly\" challenge");
   Log.info("Current level: %u, successes: %u, num misses: %u", currentLevel,
-           countSuccesses(), countMisses());
+           performance.CountSuccesses(), performance.CountMisses());
 
   gameStartTime = Time.now();
 
@@ -249,7 +207,7 @@ bool playRespondingQuickly() {
     Log.info("We're doing a retry interaction");
   } else {
     // randomly shuffle our 3 touchpads in an array
-    random_shuffle(&touchpads[0], &touchpads[3]);
+    hub.Random().Shuffle(touchpads, 3);
   }
 
   hub.SetLights(touchpads[0], YELLOW, BLUE, SLEW);
@@ -284,6 +242,9 @@ bool playRespondingQuickly() {
 
     // progress to next state
     timestampTouchpad = millis();
+    // time the reaction from when the response window opens, like the loop
+    // below does: touches during the view window do not count
+    hub.StartReactionTimer(touchpads[1] | touchpads[2]);
 
     do {
       // detect any touchpads currently pressed
@@ -293,10 +254,21 @@ bool playRespondingQuickly() {
     } while (       // 0 if any touchpad except interaction1 pad is touched
         !(pressed[1] & (touchpads[1] | touchpads[2])) &&
         // 0 if timed out
-        millis() < timestampTouchpad + MAX_REACTION_TIME[currentLevel - 1]);
+        millis() < timestampTouchpad + MAX_REACTION_TIME[currentLevel - 1] + REACTION_GRACE);
 
     hub.SetLights(hub.LIGHT_BTNS, 0, 0, 0); // turn off lights
 
+    if (pressed[1] != 0 && hub.GetReactionTime(&reactionTime, &reactionError)) {
+      Log.info("Reaction time: %lu +- %lu ms", reactionTime, reactionError);
+      performance.AddReactionTime(reactionTime);
+      // grade the measured time, the loop above waits a little longer for
+      // touches to reach us
+      if (reactionTime > MAX_REACTION_TIME[currentLevel - 1]) {
+        pressed[1] = 0;
+      }
+    }
+    hub.StopReactionTimer();
+
     if (pressed[1] == 0) {
       Log.info("No touchpad pressed, second interaction timeout");
       timeout = true;
@@ -350,27 +322,27 @@ bool playRespondingQuickly() {
 
   // Check if we're ready for next challenge
   if (currentLevel == MAX_LEVEL) {
-    if (countSuccesses() >= ENOUGH_SUCCESSES) {
+    if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
       Log.info("At MAX level! %u", currentLevel);
       challengeComplete = true;
-      resetPerformanceHistory();
+      performance.ResetHistory();
     }
   } else {
     // Increase level if foodtreat eaten and good performance in this level
-    if (countSuccesses() >= ENOUGH_SUCCESSES) {
+    if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
       if (currentLevel < MAX_LEVEL) {
         currentLevel++;
         Log.info("Leveling UP %u", currentLevel);
-        resetPerformanceHistory();
+        performance.ResetHistory();
       }
     }
   }
   // Decrease level if bad performance in this level
-  if (countMisses() >= TOO_MANY_MISSES) {
+  if (performance.CountMisses() >= TOO_MANY_MISSES) {
     if (currentLevel > 1) {
       currentLevel--;
       Log.info("Leveling DOWN %u", currentLevel);
-      resetPerformanceHistory();
+      performance.ResetHistory();
     }
   }
 
@@ -410,14 +382,16 @@ bool playRespondingQuickly() {
     retryTarget = true;
   }
 
-  // printPerformanceArray();
-
   if (retryTarget) {
     // Log.info("in the doghouose");
     // between interaction wait time if a miss
     yield_sleep_ms(INTER_GAME_DELAY, false);
   }
 
+  // remember the level, and now and then the history, in case the hub loses power
+  performance.SetLevel(currentLevel);
+  performance.SaveIfDue(0, "RespondingQuickly");
+
   hub.SetDIResetLock(false); // allow DI board to reset if needed between interactions
   yield_finish();
   return true;
@@ -430,6 +404,13 @@ bool playRespondingQuickly() {
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "RespondingQuickly")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = 1; // saved by another game or version
+    }
+  }
 }
 
 /**
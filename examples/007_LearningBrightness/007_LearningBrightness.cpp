@@ -42,7 +42,6 @@
 */
 
 #include <hackerpet.h>
-#include <algorithm>
 
 // Set this to the name of your player (dog, cat, etc.)
 const char PlayerName[] = "Pet, Clever";
@@ -64,6 +63,11 @@ const unsigned long MAX_REACTION_TIME = 20000; // (ms) timeout time for second i
 const unsigned long INTER_GAME_DELAY = 6000;
 const unsigned char TARGET_INTENSITY = 80; // touchpad target intensity
 const unsigned char SLEW = 20; // touchpad lights fade time
+// true: intensities are perceived brightness, so equal steps look equally
+// different. The distractor intensities below were chosen for false (the
+// light output grows in a straight line with the intensity), with true the
+// distractors look dimmer and the levels get easier
+const bool PERCEPTUAL_BRIGHTNESS = false;
 
 /**
  * Global variables and constants
@@ -78,10 +82,7 @@ const unsigned char DISTRACTOR_INTENSITY_MAX[MAX_LEVEL] = {5,10,15,18};
 const unsigned char DISTRACTOR_INTENSITY_TRESHOLD_MIN[MAX_LEVEL] = {0,5,10,10};
 const unsigned char DISTRACTOR_INTENSITY_TRESHOLD_MAX[MAX_LEVEL] = {255,255,255,16};
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0; // to keep our position in the performance array
-unsigned char perfDepth = 0;  // to keep the size of the number of perf numbers
-                              // to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
 
 // Use primary serial over USB interface for logging output (9600)
 // Choose logging level here (ERROR, WARN, INFO)
@@ -101,57 +102,10 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successful interactions in performance history for
-/// current level
-unsigned int countSuccesses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==1)
-            total++;
-    return total;
-}
-
-/// return the number of misses in performance history for current level
-unsigned int countMisses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==0)
-            total++;
-    return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory(){
-    for (unsigned char i = 0; i < HISTORY_LENGTH ; i++)
-        performance[i] = 0;
-    perfPos = 0;
-    perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry){
-        // Log.info("Adding %u", entry);
-    performance[perfPos] = entry;
-    perfPos++;
-    if (perfDepth < HISTORY_LENGTH)
-        perfDepth++;
-    if (perfPos > (HISTORY_LENGTH - 1)){ // make our performance array circular
-        perfPos = 0;
-    }
-    // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-    Log.info("New successes: %u, misses: %u", countSuccesses(), countMisses());
-
-}
-
-/// print the performance history for debugging
-void printPerformanceArray(){
-    Serial.printf("performance: {");
-    for (unsigned char i = 0; i < perfDepth ; i++){
-        Serial.printf("%u",performance[i]);
-        if ((i+1) == perfPos)
-            Serial.printf("|");
-    }
-    Serial.printf("}\n");
+    performance.AddResult(entry);
+    Log.info("New successes: %u, misses: %u", performance.CountSuccesses(), performance.CountMisses());
 }
 
 /// converts a bitfield of pressed touchpads to letters
@@ -241,7 +195,7 @@ bool playLearningBrightness(){
     Log.info("-------------------------------------------");
     // Log.info("Starting new \"Learning Brightness\" challenge");
     Log.info("Current level: %u, successes: %u, number of misses: %u",
-        currentLevel, countSuccesses(), countMisses());
+        currentLevel, performance.CountSuccesses(), performance.CountMisses());
 
     gameStartTime = Time.now();
 
@@ -264,9 +218,9 @@ bool playLearningBrightness(){
         Log.info("We're doing a retry interaction");
     } else {
         // randomly shuffle our 3 touchpads in an array
-        random_shuffle(&touchpads[0], &touchpads[3]);
+        hub.Random().Shuffle(touchpads, 3);
         // randomly choose distractor intensity
-        distractor_intensity = random(DISTRACTOR_INTENSITY_MIN[currentLevel-1],
+        distractor_intensity = hub.Random().Between(DISTRACTOR_INTENSITY_MIN[currentLevel-1],
                                     DISTRACTOR_INTENSITY_MAX[currentLevel-1]);
         // In level 4 we add random probes of higher distractor intensities
         if ((currentLevel > 3)
@@ -274,7 +228,7 @@ bool playLearningBrightness(){
             Log.info("We're doing a probe interaction");
             probe_game = true;
             // randomly shuffle our probe list
-            random_shuffle(&distractor_intensity_probes[0], &distractor_intensity_probes[8]);
+            hub.Random().Shuffle(distractor_intensity_probes, 8);
             // pick first probe in list
             distractor_intensity = distractor_intensity_probes[0];
         }
@@ -395,18 +349,18 @@ discarding performance.");
 
     // Check if we're ready for next challenge
     if (currentLevel == MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             Log.info("At MAX level! %u", currentLevel);
             challengeComplete = true;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     } else {
         // Increase level if foodtreat eaten and good performance in this level
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             if (currentLevel < MAX_LEVEL){
                 currentLevel++;
                 Log.info("Leveling UP %u", currentLevel);
-                resetPerformanceHistory();
+                performance.ResetHistory();
             }
         }
     }
@@ -450,13 +404,15 @@ discarding performance.");
         retryTarget = true;
     }
 
-    // printPerformanceArray();
-
     if(retryTarget){
         // between interaction wait time if a miss
         yield_sleep_ms(INTER_GAME_DELAY, false);
     }
 
+    // remember the level, and now and then the history, in case the hub loses power
+    performance.SetLevel(currentLevel);
+    performance.SaveIfDue(0, "LearningBrightness");
+
     hub.SetDIResetLock(false);  // allow DI board to reset if needed between interactions
     yield_finish();
     return true;
@@ -470,6 +426,15 @@ discarding performance.");
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  if (PERCEPTUAL_BRIGHTNESS)
+    hub.SetLightCurve(AMPLITUDE_CURVE_PERCEPTUAL);
+  // continue where we left off before a restart
+  if (performance.Load(0, "LearningBrightness")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = 1; // saved by another game or version
+    }
+  }
 }
 
 /**
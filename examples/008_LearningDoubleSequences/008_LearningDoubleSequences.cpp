@@ -65,9 +65,7 @@ const unsigned long INTER_GAME_DELAY = 10000;
 const unsigned long SOUND_FOODTREAT_DELAY = 1200; // (ms) delay for reward sound
 const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0; // to keep our position in the performance array
-unsigned char perfDepth = 0; // to keep the size of the number of perf numbers to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
 
 // Use primary serial over USB interface for logging output (9600)
 // Choose logging level here (ERROR, WARN, INFO)
@@ -87,57 +85,12 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successful interactions in performance history for current level
-unsigned int countSuccesses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==1)
-            total++;
-    return total;
-}
-
-/// return the number of misses in performance history for current level
-unsigned int countMisses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==0)
-            total++;
-    return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory(){
-    for (unsigned char i = 0; i < HISTORY_LENGTH ; i++)
-        performance[i] = 0;
-    perfPos = 0;
-    perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry){
-        // Log.info("Adding %u", entry);
-    performance[perfPos] = entry;
-    perfPos++;
-    if (perfDepth < HISTORY_LENGTH)
-        perfDepth++;
-    if (perfPos > (HISTORY_LENGTH - 1)){ // make our performance array circular
-        perfPos = 0;
-    }
-    // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-    Log.info("New successful interactions: %u, misses: %u", countSuccesses(), countMisses());
-
+    performance.AddResult(entry);
+    Log.info("New successful interactions: %u, misses: %u", performance.CountSuccesses(), performance.CountMisses());
 }
 
-/// print the performance history for debugging
-void printPerformanceArray(){
-    Serial.printf("performance: {");
-    for (unsigned char i = 0; i < perfDepth ; i++){
-        Serial.printf("%u",performance[i]);
-        if ((i+1) == perfPos)
-            Serial.printf("|");
-    }
-    Serial.printf("}\n");
-}
 /// converts a bitfield of pressed touchpads to letters
 /// multiple consecutive touches are possible and will be reported L -> M - > R
 /// @returns String
@@ -224,7 +177,7 @@ bool playLearningDoubleSequences(){
     Log.info("-------------------------------------------");
     // Log.info("Starting new \"Learning Double Sequences\" challenge");
     // Log.info("Current level: %u, successes: %u, number of misses: %u",
-        // currentLevel, countSuccesses(), countMisses());
+        // currentLevel, performance.CountSuccesses(), performance.CountMisses());
 
     gameStartTime = Time.now();
 
@@ -243,7 +196,7 @@ bool playLearningDoubleSequences(){
     // fill touchpad_sequence
     for (int i = 0; i < SEQUENCE_LENGTH; ++i)
     {
-        random_shuffle(&touchpads[0], &touchpads[3]);
+        hub.Random().Shuffle(touchpads, 3);
         touchpad_sequence[i] = touchpads[0];
     }
 
@@ -378,10 +331,10 @@ bool playLearningDoubleSequences(){
 
     // Check if we're ready for next challenge
     if (currentLevel == MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             Log.info("At MAX level! %u", currentLevel);
             challengeComplete = true;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
@@ -416,13 +369,15 @@ bool playLearningDoubleSequences(){
         );
         // }
 
-        // printPerformanceArray();
-
         if (!accurate) {
           // between interaction wait time if a miss
           yield_sleep_ms(INTER_GAME_DELAY, false);
     }
 
+    // remember the level, and now and then the history, in case the hub loses power
+    performance.SetLevel(currentLevel);
+    performance.SaveIfDue(0, "LearningDoubleSequences");
+
     hub.SetDIResetLock(false);  // allow DI board to reset if needed between interactions
     yield_finish();
     return true;
@@ -436,6 +391,13 @@ bool playLearningDoubleSequences(){
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "LearningDoubleSequences")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = 1; // saved by another game or version
+    }
+  }
 }
 
 /**
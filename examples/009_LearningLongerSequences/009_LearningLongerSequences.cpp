@@ -69,9 +69,7 @@ const unsigned long INTER_GAME_DELAY = 10000;
 const unsigned long SOUND_FOODTREAT_DELAY = 1200; // (ms) delay for reward sound
 const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0; // to keep our position in the performance array
-unsigned char perfDepth = 0; // to keep the size of the number of perf numbers to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
 
 // Use primary serial over USB interface for logging output (9600)
 // Choose logging level here (ERROR, WARN, INFO)
@@ -91,58 +89,13 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successes in performance history for current level
-unsigned int countSuccesses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==1)
-            total++;
-    return total;
-}
-
-/// return the number of misss in performance history for current level
-unsigned int countMisses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==0)
-            total++;
-    return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory(){
-    for (unsigned char i = 0; i < HISTORY_LENGTH ; i++)
-        performance[i] = 0;
-    perfPos = 0;
-    perfDepth = 0;
-}
-
 /// add a interaction result to the performance history
 void addResultToPerformanceHistory(bool entry){
-        // Log.info("Adding %u", entry);
-    performance[perfPos] = entry;
-    perfPos++;
-    if (perfDepth < HISTORY_LENGTH)
-        perfDepth++;
-    if (perfPos > (HISTORY_LENGTH - 1)){ // make our performance array circular
-        perfPos = 0;
-    }
-    // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-    Log.info("New successes: %u, misss: %u", countSuccesses(),
-             countMisses());
-
+    performance.AddResult(entry);
+    Log.info("New successes: %u, misss: %u", performance.CountSuccesses(),
+             performance.CountMisses());
 }
 
-/// print the performance history for debugging
-void printPerformanceArray(){
-    Serial.printf("performance: {");
-    for (unsigned char i = 0; i < perfDepth ; i++){
-        Serial.printf("%u",performance[i]);
-        if ((i+1) == perfPos)
-            Serial.printf("|");
-    }
-    Serial.printf("}\n");
-}
 /// converts a bitfield of pressed touchpads to letters
 /// multiple consecutive touches are possible and will be reported L -> M - > R
 /// @returns String
@@ -232,7 +185,7 @@ bool playLearningLongerSequences(){
     Log.info("-------------------------------------------");
     // Log.info("Starting new \"Learning Longer Sequences\" challenge");
     // Log.info("Current length: %u, successes: %u, num misses: %u",
-        // sequenceLength, countSuccesses(), countMisses());
+        // sequenceLength, performance.CountSuccesses(), performance.CountMisses());
 
     // before starting interaction, wait until:
     //  1. device layer is ready (in a good state)
@@ -251,7 +204,7 @@ bool playLearningLongerSequences(){
     // fill touchpad_sequence
     for (int i = 0; i < sequenceLength; ++i)
     {
-        random_shuffle(&touchpads[0], &touchpads[3]);
+        hub.Random().Shuffle(touchpads, 3);
         touchpad_sequence[i] = touchpads[0];
     }
 
@@ -395,7 +348,7 @@ bool playLearningLongerSequences(){
 
     if (sequenceLength == 9)
     {
-        resetPerformanceHistory();
+        performance.ResetHistory();
         Log.info("At MAX length! %u", sequenceLength);
         challengeComplete = true;
     }
@@ -406,20 +359,20 @@ bool playLearningLongerSequences(){
     }
 
     // adjust sequence length according to performance
-    if (countSuccesses() >= ENOUGH_SUCCESSES) {
+    if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) {
         if (sequenceLength < SEQUENCE_LENGTHMax)
         {
             Log.info("Increasing sequence length! %u", sequenceLength);
             sequenceLength++;
         }
-        resetPerformanceHistory();
-    } else if (countMisses() >= TOO_MANY_MISSES) {
+        performance.ResetHistory();
+    } else if (performance.CountMisses() >= TOO_MANY_MISSES) {
         if (sequenceLength > 3)
         {
             Log.info("Decreasing sequence length! %u", sequenceLength);
             sequenceLength--;
         }
-        resetPerformanceHistory();
+        performance.ResetHistory();
     }
 
     // Send report
@@ -455,13 +408,15 @@ bool playLearningLongerSequences(){
         );
     }
 
-    // printPerformanceArray();
-
     if(!accurate){
         // between interaction time if wrong
         yield_sleep_ms(INTER_GAME_DELAY, false);
     }
 
+    // remember the level, and now and then the history, in case the hub loses power
+    performance.SetLevel(sequenceLength);
+    performance.SaveIfDue(0, "LearningLongerSequences");
+
     hub.SetDIResetLock(false);  // allow DI board to reset if needed between interactions
     yield_finish();
     return true;
@@ -475,6 +430,13 @@ bool playLearningLongerSequences(){
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "LearningLongerSequences")) {
+    sequenceLength = performance.GetLevel();
+    if ((sequenceLength < 3) || (sequenceLength > SEQUENCE_LENGTHMax)) {
+      sequenceLength = 3; // saved by another game or version
+    }
+  }
 }
 
 /**
@@ -74,9 +74,8 @@ const unsigned long SOUND_DO_DELAY = 600; // (ms) delay between reward sound and
 const unsigned long SOUND_FOODTREAT_DELAY = 600; // (ms) delay for reward sound
 const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0; // to keep our position in the performance array
-unsigned char perfDepth = 0; // to keep the size of the number of perf numbers to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
+int currentLevel = STARTING_LEVEL; // starting and current level
 unsigned char touchpadsColor[3] = {};
 
 // Use primary serial over USB interface for logging output (9600)
@@ -97,56 +96,10 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successful interactions in performance history for current level
-unsigned int countSuccesses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==1)
-            total++;
-    return total;
-}
-
-/// return the number of misses in performance history for current level
-unsigned int countMisses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==0)
-            total++;
-    return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory(){
-    for (unsigned char i = 0; i < HISTORY_LENGTH ; i++)
-        performance[i] = 0;
-    perfPos = 0;
-    perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry){
-        // Log.info("Adding %u", entry);
-    performance[perfPos] = entry;
-    perfPos++;
-    if (perfDepth < HISTORY_LENGTH)
-        perfDepth++;
-    if (perfPos > (HISTORY_LENGTH - 1)){ // make our performance array circular
-        perfPos = 0;
-    }
-    // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-    Log.info("New successes: %u, misses: %u", countSuccesses(), countMisses());
-
-}
-
-/// print the performance history for debugging
-void printPerformanceArray(){
-    Serial.printf("performance: {");
-    for (unsigned char i = 0; i < perfDepth ; i++){
-        Serial.printf("%u",performance[i]);
-        if ((i+1) == perfPos)
-            Serial.printf("|");
-    }
-    Serial.printf("}\n");
+    performance.AddResult(entry);
+    Log.info("New successes: %u, misses: %u", performance.CountSuccesses(), performance.CountMisses());
 }
 
 /// advance a touchpad to the next color
@@ -198,7 +151,6 @@ bool playMatchingTwoColors(){
     static unsigned char foodtreatState = 99;
     static unsigned char touchpadsColorStart[3] = {};
     static unsigned char pressed = 0;
-    static int currentLevel = STARTING_LEVEL;
     static int pads_pressed = 0;
     static bool match = false;
     static bool retryGame = false;  // should not be re-initialized
@@ -227,7 +179,7 @@ bool playMatchingTwoColors(){
     Log.info("-------------------------------------------");
     // Log.info("Starting new \"Matching Two Colors\" challenge");
     // Log.info("Current level: %u, successes: %u, number of misses: %u",
-        // currentLevel, countSuccesses(), countMisses());
+        // currentLevel, performance.CountSuccesses(), performance.CountMisses());
 
     gameStartTime = Time.now();
 
@@ -246,9 +198,9 @@ bool playMatchingTwoColors(){
     // Rndomly pick start state, except on retry interaction
     if (!retryGame){
         do{
-            touchpadsColor[0] = random(0,2);
-            touchpadsColor[1] = random(0,2);
-            touchpadsColor[2] = random(0,2);
+            touchpadsColor[0] = hub.Random().Between(0,2);
+            touchpadsColor[1] = hub.Random().Between(0,2);
+            touchpadsColor[2] = hub.Random().Between(0,2);
         } while (checkMatch());
     } else {
         Log.info("Doing a retry interaction");
@@ -388,28 +340,28 @@ bool playMatchingTwoColors(){
 
     // Check if we're ready for next challenge
     if (currentLevel == MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             Log.info("At MAX level! %u", currentLevel);
             challengeComplete = true;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
     if (currentLevel < MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             currentLevel++;
             Log.info("Leveling UP %u", currentLevel);
             retryGame = false;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
-    if (countMisses() >= TOO_MANY_MISSES){
+    if (performance.CountMisses() >= TOO_MANY_MISSES){
         if (currentLevel > 1){
             currentLevel--;
             Log.info("Leveling DOWN %u", currentLevel);
             retryGame = false;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
@@ -442,7 +394,9 @@ bool playMatchingTwoColors(){
         );
     }
 
-    // printPerformanceArray();
+    // remember the level, and now and then the history, in case the hub loses power
+    performance.SetLevel(currentLevel);
+    performance.SaveIfDue(0, "MatchingTwoColors");
 
     hub.SetDIResetLock(false);  // allow DI board to reset if needed between interactions
     yield_finish();
@@ -456,6 +410,13 @@ bool playMatchingTwoColors(){
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "MatchingTwoColors")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = STARTING_LEVEL; // saved by another game or version
+    }
+  }
 }
 
 /**
@@ -74,10 +74,8 @@ const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) delay for touchpad sound
 // make sure you understand the challenge logic before changing
 const unsigned char PADS_PRESSED_MAX[MAX_LEVEL] = {3,35,10,6};
 
-bool performance[HISTORY_LENGTH] = {0}; // store the progress in this challenge
-unsigned char perfPos = 0; // to keep our position in the performance array
-unsigned char perfDepth = 0;  // to keep the size of the number of perf numbers
-                              // to consider
+PerformanceStats performance(HISTORY_LENGTH); // store the progress in this challenge
+int currentLevel = STARTING_LEVEL; // starting and current level
 int numberOfColors = 2; // this is chosen at random between 2 or 3
 unsigned char touchpadsColor[3] = {};
 
@@ -100,56 +98,10 @@ SYSTEM_THREAD(ENABLED);
  * ----------------
  */
 
-/// return the number of successful interactions in performance history for current level
-unsigned int countSuccesses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==1)
-            total++;
-    return total;
-}
-
-/// return the number of misses in performance history for current level
-unsigned int countMisses(){
-    unsigned int total = 0;
-    for (unsigned char i = 0; i <= perfDepth-1 ; i++)
-        if(performance[i]==0)
-            total++;
-    return total;
-}
-
-/// reset performance history to 0
-void resetPerformanceHistory(){
-    for (unsigned char i = 0; i < HISTORY_LENGTH ; i++)
-        performance[i] = 0;
-    perfPos = 0;
-    perfDepth = 0;
-}
-
 /// add an interaction result to the performance history
 void addResultToPerformanceHistory(bool entry){
-        // Log.info("Adding %u", entry);
-    performance[perfPos] = entry;
-    perfPos++;
-    if (perfDepth < HISTORY_LENGTH)
-        perfDepth++;
-    if (perfPos > (HISTORY_LENGTH - 1)){ // make our performance array circular
-        perfPos = 0;
-    }
-    // Log.info("perfPos %u, perfDepth %u", perfPos, perfDepth);
-    Log.info("New successes: %u, misses: %u", countSuccesses(), countMisses());
-
-}
-
-/// print the performance history for debugging
-void printPerformanceArray(){
-    Serial.printf("performance: {");
-    for (unsigned char i = 0; i < perfDepth ; i++){
-        Serial.printf("%u",performance[i]);
-        if ((i+1) == perfPos)
-            Serial.printf("|");
-    }
-    Serial.printf("}\n");
+    performance.AddResult(entry);
+    Log.info("New successes: %u, misses: %u", performance.CountSuccesses(), performance.CountMisses());
 }
 
 /// advance a touchpad to the next color
@@ -201,7 +153,6 @@ bool playMatchingMoreColors(){
     static unsigned char foodtreatState = 99;
     static unsigned char touchpadsColorStart[3] = {};
     static unsigned char pressed = 0;
-    static int currentLevel = STARTING_LEVEL; // starting level
     static int PADS_PRESSED_MAX_override = 0;
     static int padsPressed = 0;
     static bool match = false;
@@ -233,7 +184,7 @@ bool playMatchingMoreColors(){
     Log.info("-------------------------------------------");
     // Log.info("Starting new \"Matching More Colors\" challenge");
     // Log.info("Current level: %u, successes: %u, number of misses: %u",
-        // currentLevel, countSuccesses(), countMisses());
+        // currentLevel, performance.CountSuccesses(), performance.CountMisses());
 
     // before starting interaction, wait until:
     //  1. device layer is ready (in a good state)
@@ -251,7 +202,7 @@ bool playMatchingMoreColors(){
 
     // establish number of colors for interaction
     if(!retryGame){
-        numberOfColors = random(2,4); // 2 or 3 colors
+        numberOfColors = hub.Random().Between(2,4); // 2 or 3 colors
     }
 
     // overrides like the original interactions
@@ -271,9 +222,9 @@ bool playMatchingMoreColors(){
     // Rndomly pick start state, except on retry interaction
     if (!retryGame){
         do{
-            touchpadsColor[0] = random(0,numberOfColors);
-            touchpadsColor[1] = random(0,numberOfColors);
-            touchpadsColor[2] = random(0,numberOfColors);
+            touchpadsColor[0] = hub.Random().Between(0,numberOfColors);
+            touchpadsColor[1] = hub.Random().Between(0,numberOfColors);
+            touchpadsColor[2] = hub.Random().Between(0,numberOfColors);
         } while (checkMatch());
     } else {
         Log.info("Doing a retry interaction");
@@ -414,29 +365,29 @@ bool playMatchingMoreColors(){
 
     // Check if we're ready for next challenge
     if (currentLevel == MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             Log.info("At MAX level! %u", currentLevel);
             challengeComplete = true;
             retryGame = false;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
     if (currentLevel < MAX_LEVEL){
-        if (countSuccesses() >= ENOUGH_SUCCESSES){
+        if (performance.CountSuccesses() >= ENOUGH_SUCCESSES){
             currentLevel++;
             Log.info("Leveling UP %u", currentLevel);
             retryGame = false;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
-    if (countMisses() >= TOO_MANY_MISSES){
+    if (performance.CountMisses() >= TOO_MANY_MISSES){
         if (currentLevel > 1){
             currentLevel--;
             Log.info("Leveling DOWN %u", currentLevel);
             retryGame = false;
-            resetPerformanceHistory();
+            performance.ResetHistory();
         }
     }
 
@@ -469,7 +420,9 @@ bool playMatchingMoreColors(){
 
     }
 
-    // printPerformanceArray();
+    // remember the level, and now and then the history, in case the hub loses power
+    performance.SetLevel(currentLevel);
+    performance.SaveIfDue(0, "MatchingMoreColors");
 
     hub.SetDIResetLock(false);  // allow DI board to reset if needed between interactions
     yield_finish();
@@ -483,6 +436,13 @@ bool playMatchingMoreColors(){
 void setup() {
   // Initializes the hub and passes the current filename as ID for reporting
   hub.Initialize(__FILE__);
+  // continue where we left off before a restart
+  if (performance.Load(0, "MatchingMoreColors")) {
+    currentLevel = performance.GetLevel();
+    if ((currentLevel < 1) || (currentLevel > MAX_LEVEL)) {
+      currentLevel = STARTING_LEVEL; // saved by another game or version
+    }
+  }
 }
 
 /**
@@ -4,11 +4,17 @@
  *
  * This is an example how to send debug messages over a TCP connection
  *
+ * The log lines are handed to a NetworkLogHandler, which sends them from a
+ * thread of its own, so a slow or lost connection never holds up loop() or
+ * hub.Run(). Lines that cannot be buffered are dropped and counted.
+ *
  * For the receiver run a program that prints the output of incoming tcp
  * connections. For exmample on linux you can use nc  (netcat) netcat usage:
- * nc -ln 4888
+ * nc -lk 4888
+ * or tools/netlog_listen.py, which also counts missing lines
  *
- * NOTE: The receiver must be started before the hub is started
+ * The receiver may be started after the hub, the handler keeps trying to
+ * connect.
  */
 
 #include <hackerpet.h>
@@ -19,19 +25,9 @@ unsigned long last_timestamp;
 
 SYSTEM_THREAD(ENABLED);
 
-TCPClient client;
-byte server[] = { 192, 168, 0, 227 };  //Change to the IP that listens for debug connection
-int port = 4888;                       //Port where the receiver listens
-String logString;
-
-//Write the message over the TCP connection if it is connected
-void remotePrintLn(char *message)
-{
-    if (client.connected())
-    {
-        client.println(message);
-    }
-}
+// Change to the IP that listens for debug connection, and the port where the
+// receiver listens
+NetworkLogHandler netLog("192.168.0.227", 4888, NETWORK_LOG_TCP, LOG_LEVEL_INFO);
 
 // initialize hub interface (from CleverpetLibrary)
 HubInterface hub;
@@ -39,24 +35,13 @@ HubInterface hub;
 // to avoid quirks define setup() nearly last, and right before loop()
 void setup()
 {
-    Particle.variable("logString", logString);
     Particle.publish("start-game");
 
-    Serial.begin(9600);  // for debug text output
-
     // Initializes the hub and passes the current filename as ID for reporting
     hub.Initialize(__FILE__);
 
-    if (client.connect(server, port))
-    {
-        logString = "connected ";
-        logString += millis();
-        client.println("Connected ...");
-    } else
-    {
-        logString = "did not connect ";
-        logString += millis();
-    }
+    // start sending the log
+    netLog.Initialize();
 
     last_timestamp = millis();
 }
@@ -69,7 +54,7 @@ void loop()
   hub.Run(20);
 
   if (millis() - last_timestamp > 1000) {
-    remotePrintLn("Next message");
+    Log.info("Next message, sent: %lu, dropped: %lu", netLog.Sent(), netLog.Dropped());
     last_timestamp = millis();
     }
 
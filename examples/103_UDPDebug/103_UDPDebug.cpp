@@ -3,17 +3,16 @@
  * ========
  *
  * This is an example how to send debug messages over a UDP connection
- * using the Papertrail loghandler.
+ * using a NetworkLogHandler. Every log line is one datagram, sent from a
+ * thread of its own, so logging never waits for the network.
  *
- * For the receiver run a program that prints the output of incoming tcp
- * connections.
+ * For the receiver run a program that prints the output of incoming udp
+ * datagrams.
  * For exmample on linux you can use nc  (netcat)
- * netcat usage:   nc -lnu 4888
- *
- * NOTE: You must add the papertrail library to your project
+ * netcat usage:   nc -lku 4888
+ * or tools/netlog_listen.py --udp, which also counts missing lines
  */
 
-#include <papertrail.h>
 #include <hackerpet.h>
 
 using namespace std;
@@ -26,17 +25,18 @@ SYSTEM_THREAD(ENABLED);
 HubInterface hub;
 
 // Use the IP address and port where the receiver is listening
-PapertrailLogHandler papertrailHandler("192.168.1.191", 4888, "UDPDebug_Demo");
+NetworkLogHandler netLog("192.168.1.191", 4888, NETWORK_LOG_UDP, LOG_LEVEL_INFO);
 
 
 // to avoid quirks define setup() nearly last, and right before loop()
 void setup()
 {
-    Serial.begin(9600);  // for debug text output
-
     // Initializes the hub and passes the current filename as ID for reporting
     hub.Initialize(__FILE__);
 
+    // start sending the log
+    netLog.Initialize();
+
     last_timestamp = millis();
 }
 
@@ -48,7 +48,7 @@ void loop()
   hub.Run(20);
 
   if (millis() - last_timestamp > 1000) {
-    Log.info("Elapsed:  %d\n", millis() - last_timestamp);
+    Log.info("Elapsed:  %lu", millis() - last_timestamp);
     last_timestamp = millis();
     }
 
@@ -0,0 +1,104 @@
+/**
+  Curriculum
+  ==========
+
+    Plays the challenges of the original CleverPet learning curriculum that
+    are part of the library from one firmware, from Exploring The Touchpads to
+    Mastering The Lights. When your player completes a challenge the next one
+    starts.
+
+    You can also switch challenges without reflashing: call the "challenge"
+    cloud function of your hub with the name of a challenge, e.g. with the
+    Particle CLI:
+
+        particle call <your hub> challenge LearningTheLights
+
+    The new challenge starts after the current interaction. The progress of
+    every challenge is kept separately and survives restarts. The reports
+    carry the name of the challenge played as their challenge_id.
+
+  Authors: CleverPet Inc.
+
+  Copyright 2019
+  Licensed under the AGPL 3.0
+*/
+
+#include <hackerpet.h>
+
+// Set this to the name of your player (dog, cat, etc.)
+const char PlayerName[] = "Pet, Clever";
+
+/**
+ * Challenge settings
+ * -------------
+ *
+ * The challenges in the order they are played, see src/curriculum.cpp for
+ * their levels and logic.
+ */
+ExploringTheTouchpads exploringTheTouchpads;
+AvoidingUnlitTouchpads avoidingUnlitTouchpads;
+LearningTheLights learningTheLights;
+MasteringTheLights masteringTheLights;
+
+/**
+ * Global variables and constants
+ * ------------------------------
+ */
+
+// Use primary serial over USB interface for logging output (9600)
+// Choose logging level here (ERROR, WARN, INFO)
+SerialLogHandler logHandler(LOG_LEVEL_INFO, { // Logging level for all messages
+    { "app.hackerpet", LOG_LEVEL_ERROR }, // Logging level for library messages
+    { "app", LOG_LEVEL_INFO } // Logging level for application messages
+});
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+// plays the interactions of the selected challenge
+ChallengeEngine engine(hub, PlayerName);
+
+// enables simultaneous execution of application and system thread
+SYSTEM_THREAD(ENABLED);
+
+/**
+ * Setup function
+ * --------------
+ */
+void setup() {
+  // Initializes the hub and passes the current filename as ID for reporting
+  hub.Initialize(__FILE__);
+
+  engine.Add(exploringTheTouchpads);
+  engine.Add(avoidingUnlitTouchpads);
+  engine.Add(learningTheLights);
+  engine.Add(masteringTheLights);
+
+  // allow switching challenges from the cloud
+  engine.EnableCloudSelect();
+
+  // report every interaction under the name of the challenge played
+  engine.ReportNamesAsChallengeId(true);
+}
+
+/**
+ * Main loop function
+ * ------------------
+ */
+void loop() {
+  // Advance the device layer state machine, but with 20 ms max time
+  // spent per loop cycle.
+  hub.Run(20);
+
+  // Play one interaction of the current challenge at a time
+  if (engine.Run() && engine.Current()->Completed()) {
+    // move on to the next challenge, the last one keeps going
+    for (unsigned char i = 0; i + 1 < engine.NumChallenges(); i++) {
+      if (engine.GetChallenge(i) == engine.Current()) {
+        Log.info("%s completed, starting %s", engine.Current()->Name(), engine.GetChallenge(i + 1)->Name());
+        engine.SelectIndex(i + 1);
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ *  LightAnimation
+ *  ==============
+ *
+ *  Shows how to let the library animate the lights. While waiting for the
+ *  player, a light runs from left to right ("attract mode"). The animation is
+ *  a table of keyframes that is handed to the hub once; hub.Run() sends the
+ *  light changes when they are due, so the game itself only waits for a
+ *  touch. When a touchpad is touched, all touchpads flash blue twice.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <hackerpet.h>
+
+// enables simultaneous execution of application and system thread, per
+// https://docs.particle.io/reference/device-os/firmware/photon/#system-thread
+SYSTEM_THREAD(ENABLED);
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+// a yellow light running from left to right, fading in and out by itself
+// (slew), the whole animation starts over after 1500 ms
+const LightKeyframe ATTRACT[] = {
+    // at_ms, lights, mode, {yellow, blue, -}, slew, period, on
+    {0,    HubInterface::LIGHT_BTNS,   LIGHT_KEYFRAME_YB, {0, 0, 0},  0, 0, 0},
+    {0,    HubInterface::LIGHT_LEFT,   LIGHT_KEYFRAME_YB, {80, 0, 0}, 30, 0, 0},
+    {500,  HubInterface::LIGHT_LEFT,   LIGHT_KEYFRAME_YB, {0, 0, 0},  30, 0, 0},
+    {500,  HubInterface::LIGHT_MIDDLE, LIGHT_KEYFRAME_YB, {80, 0, 0}, 30, 0, 0},
+    {1000, HubInterface::LIGHT_MIDDLE, LIGHT_KEYFRAME_YB, {0, 0, 0},  30, 0, 0},
+    {1000, HubInterface::LIGHT_RIGHT,  LIGHT_KEYFRAME_YB, {80, 0, 0}, 30, 0, 0},
+};
+const unsigned long ATTRACT_LOOP_MS = 1500;
+
+// all touchpads flash blue (period 40 x 10 ms, on 20 x 10 ms), then turn off
+const LightKeyframe TOUCHED[] = {
+    {0,   HubInterface::LIGHT_BTNS, LIGHT_KEYFRAME_YB, {0, 80, 0}, 0, 40, 20},
+    {800, HubInterface::LIGHT_BTNS, LIGHT_KEYFRAME_YB, {0, 0, 0},  0, 0, 0},
+};
+
+bool LightAnimation()
+{
+    yield_begin();
+
+    // wait until the device layer is ready and no touchpad is pressed
+    yield_wait_for(hub.IsReady() && not hub.AnyButtonPressed(), false);
+
+    hub.SetDIResetLock(true);
+
+    // start attract mode, hub.Run() plays it from here on
+    hub.PlayLightAnimation(ATTRACT, sizeof(ATTRACT) / sizeof(ATTRACT[0]), ATTRACT_LOOP_MS);
+
+    // Wait until a touchpad has been pressed on the Hub
+    yield_wait_for(hub.AnyButtonPressed(), false);
+
+    // replaces attract mode, plays once
+    hub.PlayLightAnimation(TOUCHED, sizeof(TOUCHED) / sizeof(TOUCHED[0]));
+
+    yield_wait_for(!hub.LightAnimationPlaying(), false);
+
+    // keep the lights off for a moment
+    yield_sleep_ms(1000, false);
+
+    hub.SetDIResetLock(false);
+
+    yield_finish();
+    return true;
+}
+
+void setup()
+{
+  // Initializes the hub and passes the current filename as ID for reporting
+  hub.Initialize(__FILE__);
+}
+
+void loop()
+{
+    // advance the device layer state machine (and the light animation), but
+    // with 20 millisecond max time spent per loop cycle
+    hub.Run(20);
+
+    LightAnimation();
+}
@@ -0,0 +1,109 @@
+/*
+ *  Gestures
+ *  ========
+ *
+ *  Shows how to read touchpad gestures instead of raw touches. hub.Run()
+ *  recognizes taps, double taps, holds, chords (several touchpads at once)
+ *  and slides (from one touchpad to another); the game takes them one by
+ *  one with hub.NextGesture(). Every gesture is logged and answered with
+ *  lights on the touchpads involved: yellow for a tap, blue for a double
+ *  tap, both for a hold, a flash for a chord and a light on the touchpad a
+ *  slide ended on.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <hackerpet.h>
+
+// enables simultaneous execution of application and system thread, per
+// https://docs.particle.io/reference/device-os/firmware/photon/#system-thread
+SYSTEM_THREAD(ENABLED);
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+SerialLogHandler logHandler;
+
+// touchpad BUTTON_... bits to light LIGHT_... bits
+unsigned char LightsFor(unsigned char pads)
+{
+    unsigned char lights = 0;
+    if (pads & hub.BUTTON_LEFT) {
+        lights |= hub.LIGHT_LEFT;
+    }
+    if (pads & hub.BUTTON_MIDDLE) {
+        lights |= hub.LIGHT_MIDDLE;
+    }
+    if (pads & hub.BUTTON_RIGHT) {
+        lights |= hub.LIGHT_RIGHT;
+    }
+    return lights;
+}
+
+bool Gestures()
+{
+    static TouchGesture gesture;
+
+    yield_begin();
+
+    // wait until the device layer is ready and no touchpad is pressed
+    yield_wait_for(hub.IsReady() && not hub.AnyButtonPressed(), false);
+
+    hub.SetDIResetLock(true);
+
+    // forget anything touched before
+    hub.ClearGestures();
+
+    yield_wait_for(hub.NextGesture(&gesture), false);
+
+    hub.SetLights(hub.LIGHT_BTNS, 0, 0, 0);
+    switch (gesture.type) {
+    case GESTURE_TAP:
+        Log.info("Tap on %u after %lu ms", gesture.pads, gesture.duration_ms);
+        hub.SetLights(LightsFor(gesture.pads), 80, 0, 0);
+        break;
+    case GESTURE_DOUBLE_TAP:
+        Log.info("Double tap on %u", gesture.pads);
+        hub.SetLights(LightsFor(gesture.pads), 0, 80, 0);
+        break;
+    case GESTURE_HOLD:
+        Log.info("Hold on %u", gesture.pads);
+        hub.SetLights(LightsFor(gesture.pads), 80, 80, 0);
+        break;
+    case GESTURE_CHORD:
+        Log.info("Chord on %u", gesture.pads);
+        hub.SetLights(LightsFor(gesture.pads), 80, 80, 20, 10);
+        break;
+    case GESTURE_SLIDE:
+        Log.info("Slide from %u to %u in %lu ms", gesture.from, gesture.to, gesture.duration_ms);
+        hub.SetLights(LightsFor(gesture.to), 0, 80, 0);
+        break;
+    }
+
+    // show it for a moment
+    yield_sleep_ms(600, false);
+    hub.SetLights(hub.LIGHT_BTNS, 0, 0, 0);
+
+    hub.SetDIResetLock(false);
+
+    yield_finish();
+    return true;
+}
+
+void setup()
+{
+  // Initializes the hub and passes the current filename as ID for reporting
+  hub.Initialize(__FILE__);
+}
+
+void loop()
+{
+    // advance the device layer state machine, which also recognizes the
+    // gestures, but with 20 millisecond max time spent per loop cycle
+    hub.Run(20);
+
+    Gestures();
+}
@@ -0,0 +1,60 @@
+/*
+ *  SizeReport
+ *  ==========
+ *
+ *  Prints how much RAM the library takes: the size of a HubInterface and of
+ *  its parts, and the free memory left to a game once the hub runs. Flash it
+ *  after changing the library and compare with the last release, together
+ *  with tools/size_report.py, which reads the same numbers (and the flash
+ *  use) from the firmware file without running it.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <hackerpet.h>
+
+// enables simultaneous execution of application and system thread, per
+// https://docs.particle.io/reference/device-os/firmware/photon/#system-thread
+SYSTEM_THREAD(ENABLED);
+
+SerialLogHandler logHandler;
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+void PrintSizes()
+{
+    Log.info("sizeof(HubInterface)           %u", sizeof(HubInterface));
+    Log.info("  dlimsg_t (per queued message) %u", sizeof(dlimsg_t));
+    Log.info("  LightAnimator                %u", sizeof(LightAnimator));
+    Log.info("  LightShadow                  %u", sizeof(LightShadow));
+    Log.info("  AudioSequencer               %u", sizeof(AudioSequencer));
+    Log.info("  AmplitudeTable (x2)          %u", sizeof(AmplitudeTable));
+    Log.info("  TouchGestureRecognizer       %u", sizeof(TouchGestureRecognizer));
+    Log.info("  BaselineDriftTracker (x3)    %u", sizeof(BaselineDriftTracker));
+    Log.info("  RandomSource                 %u", sizeof(RandomSource));
+    Log.info("shared report buffer           %u", MAX_LEN_REPORT);
+    Log.info("free memory                    %lu", (unsigned long)System.freeMemory());
+}
+
+void setup()
+{
+    // Initializes the hub and passes the current filename as ID for reporting
+    hub.Initialize(__FILE__);
+}
+
+void loop()
+{
+    static bool printed = false;
+
+    hub.Run(20);
+
+    // once the device layer is up, so the queues have been used
+    if (!printed && hub.IsReady() && (millis() > 10000)) {
+        PrintSizes();
+        printed = true;
+    }
+}
@@ -0,0 +1,83 @@
+/*
+ *  Benchmark
+ *  =========
+ *
+ *  Times the library's hot paths (see src/benchmark.h) on a hub and prints
+ *  one JSON line per case over USB serial, once the device layer is ready
+ *  and then every time a key is sent. Allocations are counted by the
+ *  operator new below.
+ *
+ *  The hub talks to a simulated device layer (see
+ *  src/simulated_device_layer.h) instead of the real one, so the benchmark
+ *  moves no platter and lights no touchpad.
+ *
+ *  To catch regressions, capture a run before and after a change:
+ *      particle serial monitor > after.txt
+ *      tools/benchmark_compare.py after.txt --baseline before.txt
+ *
+ *  The cloud stays off while the benchmark runs, so it does not take turns
+ *  with the cases.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <hackerpet.h>
+
+// enables simultaneous execution of application and system thread, per
+// https://docs.particle.io/reference/device-os/firmware/photon/#system-thread
+SYSTEM_THREAD(ENABLED);
+SYSTEM_MODE(SEMI_AUTOMATIC);
+
+// only problems, the JSON lines go straight to Serial
+SerialLogHandler logHandler(LOG_LEVEL_WARN);
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+HubBenchmark benchmark(hub);
+
+// answers the commands of the Run cases in place of the device layer
+SimulatedDeviceLayer simulatedDL;
+
+void * operator new(size_t size)
+{
+    HubBenchmark::NoteAllocation();
+    return malloc(size);
+}
+
+void operator delete(void * p)
+{
+    free(p);
+}
+
+void operator delete(void * p, size_t size)
+{
+    free(p);
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    simulatedDL.Begin();
+    hub.SetDeviceLayerLink(&simulatedDL);
+    // Initializes the hub and passes the current filename as ID for reporting
+    hub.Initialize(__FILE__);
+}
+
+void loop()
+{
+    static bool ran = false;
+
+    hub.Run(20);
+
+    if ((!ran && hub.IsReady() && (millis() > 10000)) || (Serial.available() > 0)) {
+        while (Serial.available() > 0) {
+            Serial.read();
+        }
+        benchmark.RunAll(Serial);
+        ran = true;
+    }
+}
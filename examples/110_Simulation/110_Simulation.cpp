@@ -0,0 +1,103 @@
+/*
+ *  Simulation
+ *  ==========
+ *
+ *  Soak test without a pet: runs ExploringTheTouchpads for a week of hub
+ *  time against a simulated device layer (see src/hub_simulation.h) and
+ *  prints what happened over USB serial. A week takes a few minutes on a
+ *  Photon. The virtual clock starts a minute before millis() wraps around:
+ *  first a touch that ends right before the wrap checks that the touchpad
+ *  is let go of after it, then the week starts.
+ *
+ *  The simulated pet touches a random touchpad every 2 to 10 seconds and
+ *  eats 4 out of 5 foodtreats. Send a key to run another week.
+ *
+ *  Nothing is published, the cloud stays off.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <hackerpet.h>
+
+SYSTEM_MODE(MANUAL);
+
+// only problems, the statistics go straight to Serial
+SerialLogHandler logHandler(LOG_LEVEL_WARN);
+
+#define SIMULATION_HOURS 168
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+// must be set up before hub.Initialize, it replaces Serial1
+HubSimulation simulation(hub, 0xFFFFFFFF - 60000);
+
+ExploringTheTouchpads exploring;
+ChallengeEngine engine(hub, "Pet, Clever");
+
+// one loop() of the game, in virtual time
+void gameLoop()
+{
+    static unsigned long nextTouch = 0;
+
+    if ((int32_t)(HubClock::Millis() - nextTouch) >= 0) {
+        simulation.DeviceLayer().Touch(1 << hub.Random().Below(3), 300);
+        nextTouch = HubClock::Millis() + hub.Random().Between(2000, 10000);
+    }
+
+    engine.Run();
+    hub.Run(20);
+}
+
+// only the hub, no game
+void idleLoop()
+{
+    hub.Run(20);
+}
+
+// a touch seen in the last moments before millis() wraps must end like any other
+void checkLiftoffAcrossWrap()
+{
+    uint32_t untilWrap = 0 - (uint32_t)HubClock::Millis();
+    if (untilWrap < 10000) {
+        return; // too late to check
+    }
+    simulation.RunFor(untilWrap - 350, idleLoop);
+    simulation.DeviceLayer().Touch(hub.BUTTON_LEFT, 300);
+    simulation.RunFor(1000, idleLoop);
+    Serial.printlnf("touch ending right before the millis() wrap: %s",
+                    hub.AnyButtonPressed() ? "touchpad STUCK pressed" : "let go");
+}
+
+void runWeek()
+{
+    Serial.printlnf("simulating %d hours...", SIMULATION_HOURS);
+    simulation.RunFor(SIMULATION_HOURS * 3600000ULL, gameLoop);
+    simulation.PrintStats(Serial);
+    Serial.printlnf("ExploringTheTouchpads at level %d", exploring.Level());
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    delay(3000); // time to open the serial monitor
+    // Initializes the hub and passes the current filename as ID for reporting
+    hub.Initialize(__FILE__);
+    engine.Add(exploring);
+    simulation.DeviceLayer().SetEatChance(800);
+    checkLiftoffAcrossWrap();
+    runWeek();
+}
+
+void loop()
+{
+    if (Serial.available() > 0) {
+        while (Serial.available() > 0) {
+            Serial.read();
+        }
+        runWeek();
+    }
+}
@@ -0,0 +1,275 @@
+/*
+ *  Fleet
+ *  =====
+ *
+ *  Load test for the report pipeline: runs many simulated hubs (see
+ *  src/hub_simulation.h), each playing the curriculum with a scripted pet,
+ *  on a pool of worker threads, and posts every report to a local HTTP
+ *  endpoint as the webhook in docs/particle_webhook.json would.
+ *
+ *  Runs on the host, build it for the gcc platform (PLATFORM=gcc). Start
+ *  the stand-in endpoint first:
+ *      tools/webhook_standin.py --port 8090
+ *
+ *  Settings come from the environment:
+ *      FLEET_HUBS      simulated hubs (default 200)
+ *      FLEET_THREADS   worker threads (default one per core)
+ *      FLEET_HOURS     hub time every hub plays (default 24)
+ *      FLEET_SPEED     hub time per real time, 1 is realistic, 0 as fast as
+ *                      possible (default 0)
+ *      FLEET_ENDPOINT  host:port of the endpoint (default 127.0.0.1:8090)
+ *
+ *  Every hub has its own clock, logger and report publisher, so the hubs
+ *  of one thread take turns, a second of hub time each.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+// before hackerpet.h, its yield macro would break std::this_thread::yield
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <hackerpet.h>
+
+#if !defined(PLATFORM_GCC) || (PLATFORM_ID != PLATFORM_GCC)
+#error "111_Fleet runs on the host, build it for the gcc platform"
+#endif
+
+SYSTEM_MODE(MANUAL);
+
+// only problems, the hubs would drown the summary otherwise
+SerialLogHandler logHandler(LOG_LEVEL_WARN);
+
+#define FLEET_SLICE_MS 1000
+// hub time a hub plays before the next hub of its thread gets a turn
+
+#define FLEET_RUN_MS 20
+// hub.Run(FLEET_RUN_MS) per loop, like the examples
+
+#define MAX_LEN_WEBHOOK_BODY (2 * MAX_LEN_REPORT + 200)
+// the report escaped into the webhook JSON
+
+struct FleetSettings {
+    unsigned int hubs;
+    unsigned int threads;
+    unsigned long hours;
+    double speed;
+    char host[64];
+    uint16_t port;
+};
+
+struct FleetTotals {
+    std::atomic<unsigned long> reports{0};
+    std::atomic<unsigned long> failed{0};
+    std::atomic<unsigned long long> post_us{0};
+    std::atomic<unsigned long> max_post_us{0};
+};
+
+FleetSettings settings;
+FleetTotals totals;
+
+// one simulated hub with its pet
+struct FleetHub {
+    FleetHub(unsigned int index)
+        : simulation(hub), engine(hub, player, -1), log(logName), index(index)
+    {
+        snprintf(player, sizeof(player), "Pet %u", index);
+        snprintf(logName, sizeof(logName), "app.fleet.%u", index);
+        snprintf(deviceId, sizeof(deviceId), "f1ee7%019u", index);
+    }
+
+    HubInterface hub;
+    HubSimulation simulation;
+    ExploringTheTouchpads exploringTheTouchpads;
+    AvoidingUnlitTouchpads avoidingUnlitTouchpads;
+    LearningTheLights learningTheLights;
+    MasteringTheLights masteringTheLights;
+    ChallengeEngine engine;
+    char player[16];
+    char logName[24];
+    Logger log;
+    char deviceId[25]; // coreid in the webhook, 24 hex digits like a real device id
+    unsigned int index;
+    unsigned long nextTouch = 0;
+};
+
+// one HTTP/1.1 POST per event, like the webhook
+bool postWebhook(const char * body, size_t length)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(settings.port);
+    inet_pton(AF_INET, settings.host, &address.sin_addr);
+    bool ok = false;
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+        char header[256];
+        int headerLength = snprintf(header, sizeof(header),
+                                    "POST /v1/webhook HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\n"
+                                    "Content-Length: %u\r\nConnection: close\r\n\r\n",
+                                    settings.host, settings.port, (unsigned int)length);
+        if ((send(fd, header, headerLength, 0) == headerLength) && (send(fd, body, length, 0) == (ssize_t)length)) {
+            char status[16] = "";
+            ssize_t got = recv(fd, status, sizeof(status) - 1, 0);
+            ok = (got >= 12) && (status[9] == '2'); // "HTTP/1.1 2xx"
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+// ReportPublisher of every hub
+bool publishReport(const char * event, const char * data, void * context)
+{
+    FleetHub * fleetHub = (FleetHub *)context;
+
+    time_t now = HubClock::Now();
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    char publishedAt[32];
+    strftime(publishedAt, sizeof(publishedAt), "%Y-%m-%dT%H:%M:%S.000Z", &utc);
+
+    char body[MAX_LEN_WEBHOOK_BODY];
+    JsonWriter json(body, sizeof(body));
+    json.BeginObject();
+    json.StringField("event", event);
+    json.StringField("data", data);
+    json.StringField("coreid", fleetHub->deviceId);
+    json.StringField("published_at", publishedAt);
+    json.EndObject();
+    if (json.Overflowed()) {
+        totals.failed++;
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = postWebhook(json.c_str(), json.Length());
+    unsigned long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    totals.post_us += us;
+    unsigned long max = totals.max_post_us;
+    while ((us > max) && !totals.max_post_us.compare_exchange_weak(max, us)) {
+    }
+    if (ok) {
+        totals.reports++;
+    }
+    else {
+        totals.failed++;
+    }
+    return ok;
+}
+
+void startHub(FleetHub & fleetHub)
+{
+    fleetHub.simulation.Select();
+    fleetHub.hub.SetLogger(fleetHub.log);
+    fleetHub.hub.SetReportPublisher(publishReport, &fleetHub);
+    fleetHub.hub.Initialize((char *)__FILE__);
+    fleetHub.hub.SeedRandom(fleetHub.index);
+    fleetHub.simulation.DeviceLayer().Seed(fleetHub.index);
+    // pets differ in how often they finish their foodtreat
+    fleetHub.simulation.DeviceLayer().SetEatChance(fleetHub.hub.Random().Between(500, 950));
+    fleetHub.engine.Add(fleetHub.exploringTheTouchpads);
+    fleetHub.engine.Add(fleetHub.avoidingUnlitTouchpads);
+    fleetHub.engine.Add(fleetHub.learningTheLights);
+    fleetHub.engine.Add(fleetHub.masteringTheLights);
+}
+
+// plays a hub until its hub time reaches untilMs
+void playHub(FleetHub & fleetHub, uint64_t untilMs)
+{
+    fleetHub.simulation.Select();
+    while (fleetHub.simulation.Elapsed() < untilMs) {
+        // the scripted pet touches a random touchpad every 2 to 10 seconds
+        if ((int32_t)(HubClock::Millis() - fleetHub.nextTouch) >= 0) {
+            fleetHub.simulation.DeviceLayer().Touch(1 << fleetHub.hub.Random().Below(3), 300);
+            fleetHub.nextTouch = HubClock::Millis() + fleetHub.hub.Random().Between(2000, 10000);
+        }
+        fleetHub.engine.Run();
+        fleetHub.simulation.Step(FLEET_RUN_MS);
+    }
+}
+
+void worker(unsigned int thread)
+{
+    std::vector<FleetHub *> hubs;
+    for (unsigned int index = thread; index < settings.hubs; index += settings.threads) {
+        hubs.push_back(new FleetHub(index));
+        startHub(*hubs.back());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t endMs = settings.hours * 3600000ULL;
+    for (uint64_t untilMs = FLEET_SLICE_MS; untilMs <= endMs; untilMs += FLEET_SLICE_MS) {
+        for (FleetHub * fleetHub : hubs) {
+            playHub(*fleetHub, untilMs);
+        }
+        if (settings.speed > 0) {
+            // keep hub time at speed times real time
+            std::this_thread::sleep_until(start + std::chrono::microseconds((uint64_t)(untilMs * 1000 / settings.speed)));
+        }
+    }
+
+    for (FleetHub * fleetHub : hubs) {
+        delete fleetHub;
+    }
+}
+
+unsigned long settingFromEnvironment(const char * name, unsigned long otherwise)
+{
+    const char * value = getenv(name);
+    return (value != nullptr) ? strtoul(value, nullptr, 10) : otherwise;
+}
+
+void setup()
+{
+    settings.hubs = settingFromEnvironment("FLEET_HUBS", 200);
+    settings.threads = settingFromEnvironment("FLEET_THREADS", std::thread::hardware_concurrency());
+    if ((settings.threads == 0) || (settings.threads > settings.hubs)) {
+        settings.threads = (settings.hubs > 0) ? settings.hubs : 1;
+    }
+    settings.hours = settingFromEnvironment("FLEET_HOURS", 24);
+    settings.speed = getenv("FLEET_SPEED") ? atof(getenv("FLEET_SPEED")) : 0;
+    const char * endpoint = getenv("FLEET_ENDPOINT") ? getenv("FLEET_ENDPOINT") : "127.0.0.1:8090";
+    unsigned int port = 8090;
+    if (sscanf(endpoint, "%63[^:]:%u", settings.host, &port) < 1) {
+        strcpy(settings.host, "127.0.0.1");
+    }
+    settings.port = port;
+
+    Serial.printlnf("fleet: %u hubs on %u threads, %lu h of hub time each, posting to %s:%u",
+                    settings.hubs, settings.threads, settings.hours, settings.host, settings.port);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned int thread = 0; thread < settings.threads; thread++) {
+        threads.emplace_back(worker, thread);
+    }
+    for (std::thread & thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long posts = totals.reports + totals.failed;
+    Serial.printlnf("fleet: %.0f h of hub time in %.1f s", (double)settings.hubs * settings.hours, seconds);
+    Serial.printlnf("reports: %lu posted, %lu failed, %.1f per second", (unsigned long)totals.reports,
+                    (unsigned long)totals.failed, posts / (seconds > 0 ? seconds : 1));
+    Serial.printlnf("post latency: %.2f ms mean, %.2f ms max",
+                    posts ? totals.post_us / 1000.0 / posts : 0.0, totals.max_post_us / 1000.0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,146 @@
+/*
+ *  Pet Simulation
+ *  ==============
+ *
+ *  Runs one of the challenge examples (000 to 011) against a simulated pet
+ *  (LearningPet, see src/simulated_pet.h) in virtual time, to see how many
+ *  hours a kind of pet needs to get through the levels and how much it
+ *  eats on the way. The challenge's own source is compiled in unchanged:
+ *  its setup() and loop() are renamed and its millis() and Time.now() run
+ *  on the simulated hub's clock.
+ *
+ *  Runs on the host, build it for the gcc platform (PLATFORM=gcc), once
+ *  per challenge, choosing it with PET_CHALLENGE, e.g.
+ *      -DPET_CHALLENGE='"../007_LearningBrightness/007_LearningBrightness.cpp"'
+ *  The default is 009_LearningLongerSequences.
+ *
+ *  Settings come from the environment:
+ *      PET_HOURS       hub time to play (default 168)
+ *      PET_SEED        for the pet and the hub's random numbers (default 1)
+ *      PET_<TRAIT>     a PetTraits field in capitals, e.g. PET_REACTION_MS
+ *                      or PET_LEARNING_RATE; the defaults of PetTraits
+ *                      otherwise
+ *
+ *  Besides the challenge's own log it prints a line for every report
+ *      pet report <hub hours> <level> <result>
+ *  and one for every hour of hub time
+ *      pet hour <hour> <foodtreats presented> <eaten> <accuracy> <satiety> <boredom>
+ *  then exits. tools/pet_sweep.py runs many of these in parallel over a
+ *  grid of traits and sums them up.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+// before hackerpet.h and the macros below, which would break them
+#include <algorithm>
+#include <stdlib.h>
+
+#include <hackerpet.h>
+
+#if !defined(PLATFORM_GCC) || (PLATFORM_ID != PLATFORM_GCC)
+#error "112_PetSimulation runs on the host, build it for the gcc platform"
+#endif
+
+#ifndef PET_CHALLENGE
+#define PET_CHALLENGE "../009_LearningLongerSequences/009_LearningLongerSequences.cpp"
+#endif
+
+// Time.now() of the challenge, on the simulated hub's clock
+class PetTime
+{
+public:
+    time_t now() { return HubClock::Now(); }
+    bool isValid() { return HubClock::TimeValid(); }
+    String format(time_t t, const char * format) { return Time.format(t, format); }
+};
+
+PetTime petTime;
+
+#define setup challengeSetup
+#define loop challengeLoop
+#define millis() HubClock::Millis()
+#define Time petTime
+#include PET_CHALLENGE
+#undef setup
+#undef loop
+#undef Time
+#undef millis
+
+// the challenge's hub, before it is initialized in challengeSetup
+HubSimulation simulation(hub);
+
+LearningPet pet;
+
+unsigned long settingFromEnvironment(const char * name, unsigned long otherwise)
+{
+    const char * value = getenv(name);
+    return (value != nullptr) ? strtoul(value, nullptr, 10) : otherwise;
+}
+
+#define PET_TRAIT(field, NAME) traits.field = settingFromEnvironment("PET_" NAME, traits.field)
+
+// the "level" and "result" of every report the challenge sends
+bool printReport(const char * event, const char * data, void * context)
+{
+    const char * level = strstr(data, "\"level\":\"");
+    const char * result = strstr(data, "\"result\":\"");
+    if ((level == nullptr) || (result == nullptr)) {
+        return true; // not a report
+    }
+    result += strlen("\"result\":\"");
+    Serial.printlnf("pet report %.4f %lu %.*s", simulation.Elapsed() / 3600000.0,
+                    strtoul(level + strlen("\"level\":\""), nullptr, 10), (int)strcspn(result, "\""), result);
+    return true;
+}
+
+void setup()
+{
+    unsigned long hours = settingFromEnvironment("PET_HOURS", 168);
+    uint32_t seed = settingFromEnvironment("PET_SEED", 1);
+
+    PetTraits traits;
+    PET_TRAIT(reaction_ms, "REACTION_MS");
+    PET_TRAIT(reaction_spread_ms, "REACTION_SPREAD_MS");
+    PET_TRAIT(accuracy, "ACCURACY");
+    PET_TRAIT(max_accuracy, "MAX_ACCURACY");
+    PET_TRAIT(learning_rate, "LEARNING_RATE");
+    PET_TRAIT(satiety_per_foodtreat, "SATIETY_PER_FOODTREAT");
+    PET_TRAIT(satiety_half_life_min, "SATIETY_HALF_LIFE_MIN");
+    PET_TRAIT(boredom_per_miss, "BOREDOM_PER_MISS");
+    PET_TRAIT(boredom_half_life_min, "BOREDOM_HALF_LIFE_MIN");
+    PET_TRAIT(rest_ms, "REST_MS");
+    PET_TRAIT(explore_ms, "EXPLORE_MS");
+    PET_TRAIT(touch_ms, "TOUCH_MS");
+    pet.SetTraits(traits);
+    pet.Seed(seed);
+    simulation.DeviceLayer().Seed(seed);
+    simulation.SetPet(&pet);
+    hub.SetReportPublisher(printReport, nullptr);
+
+    challengeSetup();
+    hub.SeedRandom(seed);
+
+    unsigned long presented = 0;
+    unsigned long eaten = 0;
+    for (unsigned long hour = 1; hour <= hours; hour++) {
+        simulation.RunFor(3600000, challengeLoop);
+        unsigned long now = HubClock::Millis();
+        Serial.printlnf("pet hour %lu %lu %lu %u %u %u", hour,
+                        simulation.DeviceLayer().FoodtreatsPresented() - presented,
+                        simulation.DeviceLayer().FoodtreatsEaten() - eaten,
+                        pet.Accuracy(), pet.Satiety(now), pet.Boredom(now));
+        presented = simulation.DeviceLayer().FoodtreatsPresented();
+        eaten = simulation.DeviceLayer().FoodtreatsEaten();
+    }
+    simulation.PrintStats(Serial);
+
+    // a sweep runs many of these, this one is done
+    exit(0);
+}
+
+void loop()
+{
+}
@@ -0,0 +1,188 @@
+/*
+ *  Transport Thread
+ *  ================
+ *
+ *  A game that blocks: it waits for a touch, thinks hard after every
+ *  interaction and sends its report with a publish that takes a while.
+ *  With hub.Run() in loop() the device layer would not be served during
+ *  any of that; here a HubTransport (see src/hub_transport.h) runs the hub
+ *  on a thread of its own. The game puts commands into the transport's
+ *  queue and reads the hub through its snapshot, State().
+ *
+ *  The game: one touchpad lights up yellow, touching it within 10 seconds
+ *  earns a foodtreat.
+ *
+ *  On a hub it plays the pet in front of it. Built for the gcc platform
+ *  (PLATFORM=gcc) it runs on the host against a SimulatedDeviceLayer and a
+ *  LearningPet (see src/simulated_pet.h) in real time, the transport on a
+ *  std::thread; the pet acts on the transport thread, before every pass.
+ *  Settings come from the environment there:
+ *      TRANSPORT_SECONDS   how long to play (default 60)
+ *      TRANSPORT_THINK_MS  computation after every interaction (default 300)
+ *      TRANSPORT_PUBLISH_MS how long a report publish blocks (default 1500)
+ *  At the end it prints the interactions, the longest the game thread was
+ *  busy and the longest gap between two passes of the transport thread,
+ *  which stays near HUB_TRANSPORT_RUN_MS however long the game blocks.
+ *
+ *  Author: CleverPet
+ *
+ *  Copyright 2019
+ *  Licensed under the AGPL 3.0
+ */
+
+#include <stdlib.h>
+
+#include <hackerpet.h>
+
+// enables simultaneous execution of application and system thread, per
+// https://docs.particle.io/reference/device-os/firmware/photon/#system-thread
+SYSTEM_THREAD(ENABLED);
+
+#define TOUCH_TIMEOUT_MS 10000
+#define FOODTREAT_DURATION_MS 4000
+
+// access to hub functionality (lights, foodtreats, etc.)
+HubInterface hub;
+
+// runs hub, the game below only talks to this
+HubTransport transport(hub);
+
+SerialLogHandler logHandler(LOG_LEVEL_WARN);
+
+RandomSource gameRandom;
+
+unsigned long thinkMs = 300;
+unsigned long publishMs = 1500; // host only
+unsigned long playMs = 60000; // host only
+unsigned long playStartMs = 0;
+
+unsigned long interactions = 0;
+unsigned long successes = 0;
+unsigned long longestBusyMs = 0; // longest the game thread did not look at the hub
+
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+SimulatedDeviceLayer simulatedDL;
+LearningPet pet;
+
+// on the transport thread, before every pass
+void PetActs(void * context)
+{
+    pet.Act(simulatedDL, HubClock::Millis());
+}
+
+unsigned long SettingFromEnvironment(const char * name, unsigned long otherwise)
+{
+    const char * value = getenv(name);
+    return (value != nullptr) ? strtoul(value, nullptr, 10) : otherwise;
+}
+
+// stands in for the cloud: a slow publish, as Particle.publish can be
+bool SlowPublish(const char * event, const char * data, void * context)
+{
+    delay(publishMs);
+    return true;
+}
+#endif
+
+// stands in for game logic that takes a while
+void Think()
+{
+    unsigned long start = millis();
+    volatile uint32_t x = 1;
+    while (millis() - start < thinkMs) {
+        x = x * 1664525 + 1013904223;
+    }
+}
+
+// waits for a touch, the gesture's pads or 0 after the timeout
+unsigned char WaitForTouch(unsigned long timeoutMs)
+{
+    unsigned long start = millis();
+    TouchGesture gesture;
+    while (millis() - start < timeoutMs) {
+        if (transport.NextGesture(&gesture) && (gesture.type == GESTURE_TAP)) {
+            return gesture.pads;
+        }
+        delay(10);
+    }
+    return 0;
+}
+
+void Interaction()
+{
+    unsigned char target = 1 << gameRandom.Below(NUM_PADS);
+
+    transport.ClearGestures();
+    transport.SetLights(hub.LIGHT_BTNS & ~target, 0, 0, 0);
+    transport.SetLights(target, 99, 0, 0);
+
+    unsigned long start = millis();
+    unsigned char touched = WaitForTouch(TOUCH_TIMEOUT_MS);
+    transport.SetLights(hub.LIGHT_BTNS, 0, 0, 0);
+
+    const char * result = "timeout";
+    bool eaten = false;
+    if (touched == target) {
+        result = "success";
+        successes++;
+        unsigned char pact;
+        do {
+            delay(20);
+            pact = transport.PresentAndCheckFoodtreat(FOODTREAT_DURATION_MS);
+        } while ((pact != hub.PACT_RESPONSE_FOODTREAT_TAKEN) && (pact != hub.PACT_RESPONSE_FOODTREAT_NOT_TAKEN));
+        eaten = (pact == hub.PACT_RESPONSE_FOODTREAT_TAKEN);
+    }
+    else if (touched != 0) {
+        result = "fail";
+    }
+    interactions++;
+
+    // the blocking part: none of it holds up the device layer
+    unsigned long busy = millis();
+    Think();
+    hub.Report(String(start), "Pet, Clever", 1, result, millis() - start, touched == target, eaten);
+    longestBusyMs = max(longestBusyMs, millis() - busy);
+}
+
+void PrintSummary()
+{
+    const HubSnapshot & state = transport.State();
+    Serial.printlnf("transport: %lu interactions, %lu successes", interactions, successes);
+    Serial.printlnf("transport: game thread busy up to %lu ms, passes %lu, longest gap between passes %lu ms",
+                    longestBusyMs, (unsigned long)state.passes, state.max_pass_gap_ms);
+    Serial.printlnf("transport: %lu commands dropped, %lu gestures dropped",
+                    (unsigned long)transport.CommandsDropped(), (unsigned long)transport.GesturesDropped());
+}
+
+void setup()
+{
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+    playMs = 1000 * SettingFromEnvironment("TRANSPORT_SECONDS", playMs / 1000);
+    thinkMs = SettingFromEnvironment("TRANSPORT_THINK_MS", thinkMs);
+    publishMs = SettingFromEnvironment("TRANSPORT_PUBLISH_MS", publishMs);
+    simulatedDL.Begin();
+    hub.SetDeviceLayerLink(&simulatedDL);
+    transport.SetPassHook(PetActs, nullptr);
+    hub.SetReportPublisher(SlowPublish, nullptr); // a hub publishes to the cloud
+    playStartMs = millis();
+#endif
+    hub.Initialize(__FILE__);
+    transport.Start();
+}
+
+void loop()
+{
+    if (!transport.State().ready) {
+        delay(20);
+        return;
+    }
+    Interaction();
+
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+    if (millis() - playStartMs > playMs) {
+        transport.Stop();
+        PrintSummary();
+        exit(0);
+    }
+#endif
+}
@@ -0,0 +1,65 @@
+#include "amplitude_table.h"
+
+#include <math.h>
+
+AmplitudeTable::AmplitudeTable()
+{
+    Build(AMPLITUDE_LEVELS - 1);
+}
+
+void AmplitudeTable::Build(unsigned char maxAmplitude, unsigned char curve)
+{
+    const int top = AMPLITUDE_LEVELS - 1;
+    if (maxAmplitude > top) {
+        maxAmplitude = top;
+    }
+    _max_amplitude = maxAmplitude;
+    _curve = curve;
+
+    for (int value = 0; value <= top; value++) {
+        if (curve == AMPLITUDE_CURVE_LINEAR) {
+            // exactly what map(value, 0, 99, 0, maxAmplitude) gave
+            _levels[value] = value * maxAmplitude / top;
+            continue;
+        }
+        float x = (float)value / top;
+        float y;
+        if (curve == AMPLITUDE_CURVE_GAMMA) {
+            y = powf(x, 2.2f);
+        }
+        else {
+            // CIE 1976 lightness L* = 100 x to relative luminance
+            float lightness = 100.0f * x;
+            if (lightness <= 8.0f) {
+                y = lightness / 903.3f;
+            }
+            else {
+                float t = (lightness + 16.0f) / 116.0f;
+                y = t * t * t;
+            }
+        }
+        int level = (int)(y * maxAmplitude + 0.5f);
+        if ((level == 0) && (value > 0) && (maxAmplitude > 0)) {
+            level = 1;
+        }
+        _levels[value] = level;
+    }
+}
+
+unsigned char AmplitudeTable::Scale(unsigned char value) const
+{
+    if (value >= AMPLITUDE_LEVELS) {
+        value = AMPLITUDE_LEVELS - 1;
+    }
+    return _levels[value];
+}
+
+unsigned char AmplitudeTable::MaxAmplitude() const
+{
+    return _max_amplitude;
+}
+
+unsigned char AmplitudeTable::Curve() const
+{
+    return _curve;
+}
@@ -0,0 +1,53 @@
+#ifndef AMPLITUDE_TABLE_H
+#define AMPLITUDE_TABLE_H
+
+#include "application.h"
+
+#define AMPLITUDE_CURVE_LINEAR 0      // output proportional to the value, like map(value, 0, 99, 0, max)
+#define AMPLITUDE_CURVE_GAMMA 1       // value^2.2, the usual display gamma
+#define AMPLITUDE_CURVE_PERCEPTUAL 2  // value is CIE lightness, equal steps look equally bright
+
+#define AMPLITUDE_LEVELS 100
+// values the device layer takes, 0-99
+
+/*
+                            <<<     Amplitude table         >>>
+                            <<<                             >>>
+
+    Scales 0-99 color and volume values to the hub's maximum amplitude.
+    The 100 results are computed when the maximum or the curve changes, so
+    building a light or audio command only looks them up.
+
+    The curves are for lights: the LEDs are pulse width modulated, so
+    their light output follows the value in a straight line while the eye
+    sees steps between dim values as much larger than between bright ones.
+    With AMPLITUDE_CURVE_PERCEPTUAL a value of 50 looks half as bright as
+    99. A value above 0 never becomes 0, so a light that should be on
+    stays on.
+*/
+
+class AmplitudeTable
+{
+
+public:
+    AmplitudeTable();
+    // linear, maximum 99
+
+    void Build(unsigned char maxAmplitude, unsigned char curve = AMPLITUDE_CURVE_LINEAR);
+    // maxAmplitude: [0, 99]
+    // curve: AMPLITUDE_CURVE_...
+
+    unsigned char Scale(unsigned char value) const;
+    // value: [0, 99], larger values count as 99
+
+    unsigned char MaxAmplitude() const;
+
+    unsigned char Curve() const;
+
+private:
+    unsigned char _max_amplitude;
+    unsigned char _curve;
+    unsigned char _levels[AMPLITUDE_LEVELS];
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "hackerpet.h"
+
+AudioSequencer::AudioSequencer()
+{
+}
+
+void AudioSequencer::Play(const AudioStep * steps, unsigned char numSteps)
+{
+    _steps = steps;
+    _num_steps = numSteps;
+    _step = 0;
+    _step_started = false;
+    _step_start_ms = HubClock::Millis();
+    _playing = (numSteps > 0);
+    // a tone still sounding from before is kept if the first step is the same tone
+}
+
+void AudioSequencer::Stop(HubInterface & hub)
+{
+    _playing = false;
+    _stop_tone(hub);
+}
+
+bool AudioSequencer::Playing() const
+{
+    return _playing;
+}
+
+bool AudioSequencer::WaitingForSample() const
+{
+    return _playing && _step_started && (_steps[_step].sample != 0) && _sample_sent && (_sample_end_ms == 0);
+}
+
+/*
+                            <<<     AudioSequencer::Run     >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    start the current step if that did not happen yet, and move on through
+    the steps that are done
+
+    <<<PARAMS>>>
+    hub: to send the commands with and to ask whether the sample still plays
+*/
+void AudioSequencer::Run(HubInterface & hub)
+{
+    if (!_playing) {
+        return;
+    }
+
+    unsigned long now = HubClock::Millis();
+    for (;;) {
+        if (!_step_started) {
+            _start_step(hub);
+            _step_started = true;
+        }
+        if (!_step_done(hub, now)) {
+            break;
+        }
+        _step++;
+        _step_started = false;
+        if (_step >= _num_steps) {
+            _stop_tone(hub);
+            _playing = false;
+            break;
+        }
+    }
+}
+
+void AudioSequencer::_start_step(HubInterface & hub)
+{
+    const AudioStep & step = _steps[_step];
+    if (step.sample != 0) {
+        _stop_tone(hub);
+        _sample_sent = hub._play_sequence_sample(step.sample, step.volume);
+        _sample_end_ms = 0;
+    }
+    else if (step.frequency == 0) {
+        _stop_tone(hub);
+    }
+    else if (!_tone_on || (step.frequency != _tone_frequency) || (step.volume != _tone_volume)) {
+        // when audio is disabled the step still takes its time
+        _tone_on = hub.PlayTone(step.frequency, step.volume, 0);
+        _tone_frequency = step.frequency;
+        _tone_volume = step.volume;
+    }
+}
+
+bool AudioSequencer::_step_done(HubInterface & hub, unsigned long now)
+{
+    const AudioStep & step = _steps[_step];
+    if (step.sample == 0) {
+        if (now - _step_start_ms < step.duration_ms) {
+            return false;
+        }
+        _step_start_ms += step.duration_ms; // on schedule, also if Run was late
+        return true;
+    }
+
+    if (_sample_end_ms == 0) {
+        // the reply to our own 'P' tells that it started or was given up, not the counters
+        // of all samples: touchpad sounds and other samples start and drop in between
+        bool ended = !_sample_sent
+                     || ((hub._sequence_sample == HubInterface::SEQUENCE_SAMPLE_STARTED) && !hub.AudioPlaying())
+                     || (hub._sequence_sample == HubInterface::SEQUENCE_SAMPLE_DROPPED)
+                     || (now - _step_start_ms >= AUDIO_SEQUENCE_SAMPLE_TIMEOUT_MS);
+        if (!ended) {
+            return false;
+        }
+        _sample_end_ms = now;
+    }
+    if (now - _sample_end_ms < step.duration_ms) {
+        return false;
+    }
+    _step_start_ms = _sample_end_ms + step.duration_ms;
+    return true;
+}
+
+void AudioSequencer::_stop_tone(HubInterface & hub)
+{
+    if (_tone_on) {
+        hub.PlayTone(0, 0, 0);
+        _tone_on = false;
+    }
+}
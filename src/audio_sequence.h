@@ -0,0 +1,81 @@
+#ifndef AUDIO_SEQUENCE_H
+#define AUDIO_SEQUENCE_H
+
+#include "application.h"
+
+class HubInterface;
+
+struct AudioStep {
+    // one step of a melody or a chain of samples
+    unsigned char sample;       // AUDIO_... sample to play, 0 = a tone or a rest
+    unsigned int frequency;     // tone in Hz, 0 (with sample 0) = a rest, silence
+    unsigned char volume;       // [0, 99]
+    unsigned long duration_ms;  // tone or rest: how long it lasts; sample: pause after the sample ended
+};
+
+#define AUDIO_SEQUENCE_SAMPLE_TIMEOUT_MS 10000
+// a sample counts as ended after this long, also if the device layer never said so
+
+#define AUDIO_SEQUENCE_DIAG_MS 100
+// how often the device layer is asked whether the sample still plays, while waiting for that
+
+/*
+                            <<<     Audio sequencer         >>>
+                            <<<                             >>>
+
+    Plays a list of AudioSteps from HubInterface::Run, so a game hands over
+    a melody or a chain of samples once instead of timing PlayTone and
+    PlayAudio calls from its own loop. A tone keeps sounding into the next
+    tone step without a new command if frequency and volume stay the same,
+    and is stopped once, at a rest, before a sample or at the end. Tones
+    and rests follow each other on a fixed schedule, the length of one
+    step does not depend on how late Run got to it. A sample step waits
+    until the device layer accepted its own 'P' command and then reports
+    (in its diagnostics) that nothing plays any more, or until the hub gave
+    the sample up, then for duration_ms.
+*/
+
+class AudioSequencer
+{
+
+public:
+    AudioSequencer();
+
+    void Play(const AudioStep * steps, unsigned char numSteps);
+    // start playing, the array is not copied and must stay valid while playing
+
+    void Stop(HubInterface & hub);
+    // stops a sounding tone too, a sample plays to its end
+
+    bool Playing() const;
+
+    bool WaitingForSample() const;
+    // a sample step is waiting for its sample to end, poll the diagnostics more often
+
+    void Run(HubInterface & hub);
+    // emits the commands that are due
+
+private:
+    void _start_step(HubInterface & hub);
+    bool _step_done(HubInterface & hub, unsigned long now);
+    void _stop_tone(HubInterface & hub);
+
+private:
+    const AudioStep * _steps = nullptr;
+    unsigned char _num_steps = 0;
+    unsigned char _step = 0;
+    bool _playing = false;
+    bool _step_started = false;
+    unsigned long _step_start_ms = 0; // when the current step is due
+
+    // the tone that is sounding
+    bool _tone_on = false;
+    unsigned int _tone_frequency = 0;
+    unsigned char _tone_volume = 0;
+
+    // the sample of the current step
+    bool _sample_sent = false;
+    unsigned long _sample_end_ms = 0; // 0 while it plays
+};
+
+#endif
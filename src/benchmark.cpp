@@ -0,0 +1,283 @@
+#include "hackerpet.h"
+
+volatile uint32_t HubBenchmark::_allocations = 0;
+
+const HubBenchmark::BenchCase HubBenchmark::_cases[] = {
+    {"create_dl_cmd", &HubBenchmark::_create_dl_cmd, 1000, false},
+    {"encode_light", &HubBenchmark::_encode_light, 1000, false},
+    {"constant_frame", &HubBenchmark::_constant_frame, 1000, false},
+    {"parse_B", &HubBenchmark::_parse_B, 1000, false},
+    {"parse_G", &HubBenchmark::_parse_G, 1000, false},
+    {"parse_Z", &HubBenchmark::_parse_Z, 1000, false},
+    {"parse_U", &HubBenchmark::_parse_U, 1000, false},
+    {"queue_push_pop", &HubBenchmark::_queue_push_pop, 1000, false},
+    {"update_buttons", &HubBenchmark::_update_buttons, 1000, false},
+    {"update_cap_reset", &HubBenchmark::_update_cap_reset, 1000, false},
+    {"report_json", &HubBenchmark::_report_json, 200, false},
+    {"run_idle", &HubBenchmark::_run_idle, 1000, true},
+    {"run_saturated", &HubBenchmark::_run_saturated, 1000, true},
+};
+
+HubBenchmark::HubBenchmark(HubInterface & hub)
+    : _hub(hub)
+{
+}
+
+void HubBenchmark::NoteAllocation()
+{
+    _allocations++;
+}
+
+void HubBenchmark::RunAll(Print & out)
+{
+    for (const BenchCase & bench : _cases) {
+        if (_can_run(bench)) {
+            _measure(out, bench);
+        }
+    }
+}
+
+bool HubBenchmark::RunCase(Print & out, const char * name)
+{
+    for (const BenchCase & bench : _cases) {
+        if ((strcmp(bench.name, name) == 0) && _can_run(bench)) {
+            _measure(out, bench);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HubBenchmark::_can_run(const BenchCase & bench)
+{
+    // the Run cases send commands: never to the real device layer, it would act on them
+    return !bench.needs_dl || (_hub.IsReady() && (_hub._dl_link != &Serial1));
+}
+
+/*
+                            <<<     HubBenchmark::_measure  >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    time one case: a warm up round (queues grow to their working size),
+    then BENCHMARK_ROUNDS rounds, and print the median of the rounds
+
+    <<<PARAMS>>>
+    out: where the JSON line goes
+    bench: the case
+*/
+void HubBenchmark::_measure(Print & out, const BenchCase & bench)
+{
+    uint32_t ticks[BENCHMARK_ROUNDS];
+    uint32_t allocations[BENCHMARK_ROUNDS];
+
+    (this->*bench.body)(bench.ops);
+    _drain_queues();
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+        uint32_t allocated_before = _allocations;
+        ticks[round] = (this->*bench.body)(bench.ops);
+        allocations[round] = _allocations - allocated_before;
+        _drain_queues();
+    }
+
+    // the median, robust against a round interrupted by the system thread
+    for (int i = 1; i < BENCHMARK_ROUNDS; i++) {
+        for (int j = i; (j > 0) && (ticks[j] < ticks[j - 1]); j--) {
+            uint32_t t = ticks[j];
+            ticks[j] = ticks[j - 1];
+            ticks[j - 1] = t;
+        }
+        for (int j = i; (j > 0) && (allocations[j] < allocations[j - 1]); j--) {
+            uint32_t a = allocations[j];
+            allocations[j] = allocations[j - 1];
+            allocations[j - 1] = a;
+        }
+    }
+    uint64_t ns = (uint64_t)ticks[BENCHMARK_ROUNDS / 2] * 1000 / System.ticksPerMicrosecond();
+
+    char line[MAX_LEN_BENCHMARK_LINE];
+    JsonWriter json(line, sizeof(line));
+    json.BeginObject();
+    json.StringField("bench", bench.name);
+    json.NumberField("ops", bench.ops);
+    json.NumberField("rounds", BENCHMARK_ROUNDS);
+    json.NumberField("ns_per_op", (uint32_t)(ns / bench.ops));
+    json.NumberField("allocs_per_1000_ops", (uint32_t)((uint64_t)allocations[BENCHMARK_ROUNDS / 2] * 1000 / bench.ops));
+    json.EndObject();
+    out.println(json.c_str());
+}
+
+void HubBenchmark::_drain_queues()
+{
+    // let a command in flight get its reply or time out first, popping it
+    // under the link state machine would leave it processing a command that is gone
+    unsigned long start = millis(); // real time, a virtual clock does not move here
+    while ((_hub._run_loop_state != HubInterface::STATE_BEFORE_SEND)
+            && (millis() - start <= BENCHMARK_DRAIN_MS)) {
+        _hub._process_DL();
+    }
+
+    while (!_hub._cmd_queue.empty()) {
+        _hub._cmd_queue.pop();
+    }
+    while (!_hub._dl_reply_queue.empty()) {
+        _hub._dl_reply_queue.pop();
+    }
+
+    // a reply that did not come in time is given up on
+    _hub._run_loop_state = HubInterface::STATE_BEFORE_SEND;
+    _hub._num_send_retries = 0;
+    _hub._len_reply_buffer = 0;
+}
+
+uint32_t HubBenchmark::_create_dl_cmd(uint32_t ops)
+{
+    dlimsg_t cmd;
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._create_dl_cmd_with('N', "2100500", &cmd);
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_encode_light(uint32_t ops)
+{
+    dlimsg_t cmd;
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        DlFrameEncoder(cmd.buf, 'H').Letter('G').Digits<2>(i % 100).Digits<2>(50).Digits<2>(0).Digits<2>(20).Digits<2>(10).Finish();
+        _hub._stamp_dl_cmd(&cmd);
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_constant_frame(uint32_t ops)
+{
+    static constexpr ConstantDlFrame frame = MakeDlFrame('Z', "00");
+    dlimsg_t cmd;
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._create_dl_cmd_from(frame, &cmd);
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_parse(uint32_t ops, unsigned char token, const char * payload)
+{
+    char buf[MAX_LEN_REPLY_BUFFER];
+    strncpy(buf, payload, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = 0;
+    unsigned short len = strlen(buf);
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._parse_msg(token, '1', buf, len);
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_parse_B(uint32_t ops)
+{
+    // nothing touched, readings at the baselines
+    return _parse(ops, 'B', "000500500500500500500.");
+}
+
+uint32_t HubBenchmark::_parse_G(uint32_t ops)
+{
+    return _parse(ops, 'G', "000.");
+}
+
+uint32_t HubBenchmark::_parse_Z(uint32_t ops)
+{
+    // food machine idle, dome on
+    return _parse(ops, 'Z', "00000000000.");
+}
+
+uint32_t HubBenchmark::_parse_U(uint32_t ops)
+{
+    return _parse(ops, 'U', "2100500.");
+}
+
+uint32_t HubBenchmark::_queue_push_pop(uint32_t ops)
+{
+    dlimsg_t cmd;
+    _hub._create_dl_cmd_with('N', "2100500", &cmd);
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._cmd_queue.push(cmd);
+        if (_hub._cmd_queue.size() > 8) {
+            _hub._cmd_queue.pop();
+        }
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_run_idle(uint32_t ops)
+{
+    // nothing queued and nothing polled, only the checks of every pass
+    bool poll_diag = _hub._do_poll_diag;
+    bool poll_buttons = _hub._do_poll_buttons;
+    bool poll_indlight = _hub._do_poll_indlight;
+    _hub._do_poll_diag = false;
+    _hub._do_poll_buttons = false;
+    _hub._do_poll_indlight = false;
+
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._run_pass();
+    }
+    uint32_t ticks = System.ticks() - start;
+
+    _hub._do_poll_diag = poll_diag;
+    _hub._do_poll_buttons = poll_buttons;
+    _hub._do_poll_indlight = poll_indlight;
+    return ticks;
+}
+
+uint32_t HubBenchmark::_run_saturated(uint32_t ops)
+{
+    // the device layer always has a command to answer
+    uint32_t ticks = 0;
+    for (uint32_t i = 0; i < ops; i++) {
+        while (_hub._cmd_queue.size() < 4) {
+            _hub._poll_buttons();
+        }
+        uint32_t start = System.ticks();
+        _hub._run_pass();
+        ticks += System.ticks() - start;
+    }
+    return ticks;
+}
+
+uint32_t HubBenchmark::_update_buttons(uint32_t ops)
+{
+    // a touch every other poll, without the button sounds
+    bool button_audio = _hub._button_audio_enabled;
+    _hub._button_audio_enabled = false;
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._update_button_pressed_state((i & 1) ? HubInterface::BUTTON_LEFT : 0);
+    }
+    uint32_t ticks = System.ticks() - start;
+    _hub._button_audio_enabled = button_audio;
+    _hub.ClearGestures();
+    return ticks;
+}
+
+uint32_t HubBenchmark::_update_cap_reset(uint32_t ops)
+{
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        _hub._update_cap_reset();
+    }
+    return System.ticks() - start;
+}
+
+uint32_t HubBenchmark::_report_json(uint32_t ops)
+{
+    uint32_t start = System.ticks();
+    for (uint32_t i = 0; i < ops; i++) {
+        JsonWriter json(HubInterface::_report_buffer, MAX_LEN_REPORT);
+        _hub._write_report_json(json, "1571320000000", "Pet, Clever", i, "success", 2300, true, true, "{\"reaction_ms\":\"512\"}");
+    }
+    return System.ticks() - start;
+}
@@ -0,0 +1,93 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "application.h"
+
+class HubInterface;
+
+#define BENCHMARK_ROUNDS 5
+// every case is timed this often after one warm up round, the median round is reported
+
+#define MAX_LEN_BENCHMARK_LINE 160
+
+#define BENCHMARK_DRAIN_MS 100
+// longest wait for the reply of a command in flight before the queues are emptied
+
+/*
+                            <<<     Hot path benchmarks     >>>
+                            <<<                             >>>
+
+    Times the parts of HubInterface that run on every loop: encoding
+    command frames, parsing the 'B', 'G', 'Z' and 'U' replies, the command
+    queue, Run with nothing to send and with a full command queue, the
+    touchpad state updates and building a report.
+
+    Every case prints one JSON line:
+        {"bench":"parse_B","ops":1000,"rounds":5,"ns_per_op":2113,"allocs_per_1000_ops":0}
+
+    Allocations are only counted if the program calls NoteAllocation from
+    its operator new, see examples/109_Benchmark. Capture the lines and
+    compare them with a stored baseline with tools/benchmark_compare.py.
+
+    The cases change the state of the hub (touchpad readings, queues,
+    polling), so give the benchmark a hub that runs nothing else. The Run
+    cases send commands, they only run against a SimulatedDeviceLayer
+    (see HubInterface::SetDeviceLayerLink), whose handling of the frames
+    is part of their time; on the real device layer they are skipped.
+*/
+
+class HubBenchmark
+{
+
+public:
+    HubBenchmark(HubInterface & hub);
+
+    void RunAll(Print & out);
+    // runs every case, the Run cases only once a simulated device layer is ready
+
+    bool RunCase(Print & out, const char * name);
+    // runs the case of that name, false if there is none or it cannot run on this hub
+
+    static void NoteAllocation();
+    // counts one allocation, call it from operator new
+
+private:
+    typedef uint32_t (HubBenchmark::*BenchBody)(uint32_t ops);
+    // runs the case ops times, returns the ticks spent in the timed part
+
+    struct BenchCase {
+        const char * name;
+        BenchBody body;
+        uint32_t ops;
+        bool needs_dl; // sends to the device layer, a simulated one
+    };
+
+    static const BenchCase _cases[];
+
+    bool _can_run(const BenchCase & bench);
+
+    void _measure(Print & out, const BenchCase & bench);
+
+    void _drain_queues();
+
+    uint32_t _create_dl_cmd(uint32_t ops);
+    uint32_t _encode_light(uint32_t ops);
+    uint32_t _constant_frame(uint32_t ops);
+    uint32_t _parse(uint32_t ops, unsigned char token, const char * payload);
+    uint32_t _parse_B(uint32_t ops);
+    uint32_t _parse_G(uint32_t ops);
+    uint32_t _parse_Z(uint32_t ops);
+    uint32_t _parse_U(uint32_t ops);
+    uint32_t _queue_push_pop(uint32_t ops);
+    uint32_t _run_idle(uint32_t ops);
+    uint32_t _run_saturated(uint32_t ops);
+    uint32_t _update_buttons(uint32_t ops);
+    uint32_t _update_cap_reset(uint32_t ops);
+    uint32_t _report_json(uint32_t ops);
+
+private:
+    HubInterface & _hub;
+    static volatile uint32_t _allocations;
+};
+
+#endif
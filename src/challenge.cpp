@@ -0,0 +1,416 @@
+#include "hackerpet.h"
+
+Challenge::Challenge(const char * name, const ChallengeLevel * levels, unsigned char numLevels, unsigned char historyLength, int startingLevel)
+    : _name(name), _levels(levels), _num_levels(numLevels), _starting_level(startingLevel), _performance(historyLength)
+{
+    SetLevel(startingLevel);
+}
+
+const char * Challenge::Name() const
+{
+    return _name;
+}
+
+int Challenge::Level() const
+{
+    return _performance.GetLevel();
+}
+
+void Challenge::SetLevel(int level)
+{
+    if (level < 1) {
+        level = 1;
+    }
+    if (level > _num_levels) {
+        level = _num_levels;
+    }
+    _performance.SetLevel(level);
+    _performance.ResetHistory();
+}
+
+unsigned char Challenge::NumLevels() const
+{
+    return _num_levels;
+}
+
+const ChallengeLevel & Challenge::LevelSettings() const
+{
+    return _levels[Level() - 1];
+}
+
+bool Challenge::Completed() const
+{
+    return _completed;
+}
+
+PerformanceStats & Challenge::Performance()
+{
+    return _performance;
+}
+
+bool Challenge::Reward(unsigned char response)
+{
+    return response == RESPONSE_HIT;
+}
+
+bool Challenge::Success(unsigned char response, bool foodtreatEaten)
+{
+    return response == RESPONSE_HIT;
+}
+
+void Challenge::ReportExtra(JsonWriter & extra)
+{
+}
+
+void Challenge::Finish(unsigned char response)
+{
+}
+
+// give the hub a moment to finish playing the touchpad sound, then the feedback
+const AudioStep ChallengeEngine::REWARD_SOUND[] = {
+    {0, 0, 0, SOUND_TOUCHPAD_DELAY},
+    {HubInterface::AUDIO_POSITIVE, 0, 20, 0},
+};
+
+// a miss: negative feedback at low volume
+const AudioStep ChallengeEngine::MISS_SOUND[] = {
+    {0, 0, 0, SOUND_TOUCHPAD_DELAY},
+    {HubInterface::AUDIO_NEGATIVE, 0, 5, 0},
+};
+
+ChallengeEngine::ChallengeEngine(HubInterface & hub, const char * player, int eepromAddress)
+    : _hub(hub), _player(player), _eeprom_address(eepromAddress)
+{
+}
+
+bool ChallengeEngine::Add(Challenge & challenge)
+{
+    if (_num_challenges >= MAX_CHALLENGES) {
+        _hub.Log().error("ChallengeEngine::Add no room for challenge %s", challenge.Name());
+        return false;
+    }
+    if (challenge._performance.Load(_address(_num_challenges), challenge.Name())) {
+        // the level table may have changed since it was saved
+        int level = challenge.Level();
+        if ((level < 1) || (level > challenge.NumLevels())) {
+            challenge.SetLevel(challenge._starting_level);
+        }
+        _hub.Log().info("ChallengeEngine::Add %s continues at level %d", challenge.Name(), challenge.Level());
+    }
+    _challenges[_num_challenges++] = &challenge;
+    return true;
+}
+
+void ChallengeEngine::ReportNamesAsChallengeId(bool enable)
+{
+    _names_as_challenge_id = enable;
+}
+
+bool ChallengeEngine::Select(const char * name)
+{
+    for (unsigned char i = 0; i < _num_challenges; i++) {
+        if (strcmp(_challenges[i]->Name(), name) == 0) {
+            return SelectIndex(i);
+        }
+    }
+    _hub.Log().warn("ChallengeEngine::Select no challenge %s", name);
+    return false;
+}
+
+bool ChallengeEngine::SelectIndex(unsigned char index)
+{
+    if (index >= _num_challenges) {
+        return false;
+    }
+    _selected = index;
+    return true;
+}
+
+Challenge * ChallengeEngine::Current()
+{
+    return (_num_challenges > 0) ? _challenges[_current] : nullptr;
+}
+
+unsigned char ChallengeEngine::NumChallenges() const
+{
+    return _num_challenges;
+}
+
+Challenge * ChallengeEngine::GetChallenge(unsigned char index)
+{
+    return (index < _num_challenges) ? _challenges[index] : nullptr;
+}
+
+bool ChallengeEngine::EnableCloudSelect()
+{
+    return Particle.function("challenge", &ChallengeEngine::_cloud_select, this);
+}
+
+int ChallengeEngine::_cloud_select(String name)
+{
+    return Select(name.c_str()) ? 0 : -1;
+}
+
+bool ChallengeEngine::_wait(unsigned long since, unsigned long duration)
+{
+    return (HubClock::Millis() - since) < duration;
+}
+
+/*
+                            <<<     ChallengeEngine::Run     >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    play the interactions of the current challenge, one state per call so
+    loop() (and hub.Run()) keep running in between
+
+    <<<PARAMS>>>
+    none
+
+    returns true at the end of an interaction
+*/
+bool ChallengeEngine::Run()
+{
+    if (_num_challenges == 0) {
+        return false;
+    }
+    Challenge * challenge = _challenges[_current];
+
+    switch (_state) {
+    case CHALLENGE_WAIT_READY:
+        // between interactions, the place to switch challenges
+        if (_selected >= 0) {
+            if (_selected != _current) {
+                _current = _selected;
+                challenge = _challenges[_current];
+                _hub.Log().info("ChallengeEngine::Run switched to %s", challenge->Name());
+            }
+            _selected = -1;
+        }
+        // wait until the device layer is ready, the foodmachine idle and no touchpad pressed
+        if (_hub.IsReady() && (_hub.FoodmachineState() == _hub.FOODMACHINE_IDLE) && !_hub.AnyButtonPressed()) {
+            _start_interaction();
+        }
+        break;
+
+    case CHALLENGE_RESPONSE: {
+        unsigned long elapsed = HubClock::Millis() - _start_time;
+        unsigned char response = challenge->Respond(_hub, _hub.AnyButtonPressed(), elapsed);
+        unsigned long timeout = challenge->LevelSettings().response_timeout_ms;
+        if ((response == Challenge::RESPONSE_PENDING) && (timeout > 0) && (elapsed >= timeout)) {
+            response = Challenge::RESPONSE_TIMEOUT;
+        }
+        if (response != Challenge::RESPONSE_PENDING) {
+            _finish_response(response);
+        }
+        break;
+    }
+
+    case CHALLENGE_BEFORE_FEEDBACK:
+        if (_rewarded) {
+            _hub.PlayAudioSequence(REWARD_SOUND, sizeof(REWARD_SOUND) / sizeof(REWARD_SOUND[0]));
+        }
+        else {
+            _hub.PlayAudioSequence(MISS_SOUND, sizeof(MISS_SOUND) / sizeof(MISS_SOUND[0]));
+        }
+        _state = CHALLENGE_AFTER_FEEDBACK;
+        _state_time = HubClock::Millis();
+        break;
+
+    case CHALLENGE_AFTER_FEEDBACK:
+        // the hub tells when the sample ended
+        if (!_hub.AudioSequencePlaying()) {
+            if (_rewarded) {
+                _state = CHALLENGE_FOODTREAT;
+            }
+            else {
+                _state = CHALLENGE_DELAY;
+                _report();
+            }
+            _state_time = HubClock::Millis();
+        }
+        break;
+
+    case CHALLENGE_FOODTREAT: {
+        unsigned char pact = _hub.PresentAndCheckFoodtreat(challenge->LevelSettings().foodtreat_duration_ms);
+        if ((pact == _hub.PACT_RESPONSE_FOODTREAT_TAKEN) || (pact == _hub.PACT_RESPONSE_FOODTREAT_NOT_TAKEN)) {
+            _foodtreat_eaten = (pact == _hub.PACT_RESPONSE_FOODTREAT_TAKEN);
+            _hub.Log().info("ChallengeEngine::Run foodtreat %s", _foodtreat_eaten ? "eaten" : "not eaten");
+            _report();
+            _state = CHALLENGE_DELAY;
+            _state_time = HubClock::Millis();
+        }
+        break;
+    }
+
+    case CHALLENGE_DELAY:
+        if (!_wait(_state_time, _delay)) {
+            _hub.SetDIResetLock(false); // allow DI board to reset if needed between interactions
+            _state = CHALLENGE_WAIT_READY;
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+void ChallengeEngine::_start_interaction()
+{
+    Challenge * challenge = _challenges[_current];
+
+    _hub.Log().info("ChallengeEngine: new %s interaction, level %d", challenge->Name(), challenge->Level());
+
+    if (_names_as_challenge_id) {
+        // every challenge reports under its own name, also the first one played
+        _hub.SetChallengeId(challenge->Name());
+    }
+
+    // DI reset occurs if, for example, device layer detects that touchpads need re-calibration
+    _hub.SetDIResetLock(true);
+
+    challenge->_completed = false;
+    _response = Challenge::RESPONSE_PENDING;
+    _rewarded = false;
+    _foodtreat_eaten = false;
+    _game_start_time = HubClock::Now();
+    _start_time = HubClock::Millis();
+    challenge->Cue(_hub);
+    // times the reaction from the cue lights, if Cue set any
+    _hub.StartReactionTimer(_hub.BUTTON_LEFT | _hub.BUTTON_MIDDLE | _hub.BUTTON_RIGHT);
+    _state = CHALLENGE_RESPONSE;
+}
+
+void ChallengeEngine::_finish_response(unsigned char response)
+{
+    Challenge * challenge = _challenges[_current];
+    const ChallengeLevel & level = challenge->LevelSettings();
+
+    _response = response;
+    _duration = HubClock::Millis() - _start_time;
+    _hub.SetLights(_hub.LIGHT_BTNS, 0, 0, 0);
+
+    if (response != Challenge::RESPONSE_TIMEOUT) {
+        unsigned long reaction, error;
+        if (!_hub.GetReactionTime(&reaction, &error)) {
+            reaction = _duration;
+        }
+        challenge->_performance.AddReactionTime(reaction);
+    }
+    _hub.StopReactionTimer();
+    _rewarded = challenge->Reward(response);
+
+    // pick the wait after this interaction now, with the settings of the level it was played at
+    _delay = level.min_delay_ms;
+    if (level.max_delay_ms > level.min_delay_ms) {
+        _delay = _hub.Random().Between(level.min_delay_ms, level.max_delay_ms);
+    }
+
+    _state_time = HubClock::Millis();
+    if (_rewarded || (response == Challenge::RESPONSE_MISS)) {
+        _state = CHALLENGE_BEFORE_FEEDBACK;
+    }
+    else {
+        // no response, no consequence
+        _report();
+        _state = CHALLENGE_DELAY;
+    }
+}
+
+void ChallengeEngine::_add_result(bool success)
+{
+    PerformanceStats & performance = _challenges[_current]->_performance;
+
+    performance.AddResult(success);
+    _hub.Log().info("ChallengeEngine: successes: %u, misses: %u", performance.CountSuccesses(), performance.CountMisses());
+}
+
+bool ChallengeEngine::_completing()
+{
+    Challenge * challenge = _challenges[_current];
+    return (challenge->Level() == challenge->NumLevels())
+           && (challenge->_performance.CountSuccesses() >= challenge->LevelSettings().enough_successes);
+}
+
+void ChallengeEngine::_progress()
+{
+    Challenge * challenge = _challenges[_current];
+    const ChallengeLevel & level = challenge->LevelSettings();
+    PerformanceStats & performance = challenge->_performance;
+
+    if (performance.CountSuccesses() >= level.enough_successes) {
+        if (_completing()) {
+            _hub.Log().info("ChallengeEngine: %s completed", challenge->Name());
+            challenge->_completed = true;
+            performance.ResetHistory();
+        }
+        else {
+            challenge->SetLevel(challenge->Level() + 1);
+            _hub.Log().info("ChallengeEngine: leveling UP %d", challenge->Level());
+        }
+    }
+    else if ((level.too_many_misses > 0) && (performance.CountMisses() >= level.too_many_misses) && (challenge->Level() > 1)) {
+        challenge->SetLevel(challenge->Level() - 1);
+        _hub.Log().info("ChallengeEngine: leveling DOWN %d", challenge->Level());
+    }
+}
+
+void ChallengeEngine::_report()
+{
+    Challenge * challenge = _challenges[_current];
+    bool timeout = (_response == Challenge::RESPONSE_TIMEOUT);
+    bool success = challenge->Success(_response, _foodtreat_eaten);
+    bool counted = !timeout || challenge->_count_timeouts;
+
+    if (counted) {
+        _add_result(success);
+    }
+
+    if (!timeout || challenge->_report_timeouts) {
+        JsonWriter extra(_extra_buffer, sizeof(_extra_buffer));
+        extra.BeginObject();
+        challenge->ReportExtra(extra);
+        if (counted && _completing()) {
+            extra.NumberField("challengeComplete", 1);
+        }
+        extra.EndObject();
+        const char * extra_text = extra.c_str();
+        if (extra.Overflowed()) {
+            _hub.Log().error("ChallengeEngine: extra field of %s does not fit, reporting without it", challenge->Name());
+            extra_text = "";
+        }
+        else if (extra.Length() <= 2) { // nothing in {}
+            extra_text = "";
+        }
+
+        _hub.Report(Time.format(_game_start_time, TIME_FORMAT_ISO8601_FULL), // play_start_time
+                    _player,                    // player
+                    challenge->Level(),         // level
+                    success ? "1" : "0",        // result
+                    _duration,                  // duration
+                    _rewarded,                  // foodtreat_presented
+                    _foodtreat_eaten,           // foodtreat_eaten
+                    extra_text                  // extra
+        );
+    }
+
+    // after the report, which carries the level the interaction was played at
+    if (counted) {
+        _progress();
+    }
+
+    challenge->Finish(_response);
+    _save(_current);
+}
+
+void ChallengeEngine::_save(unsigned char index)
+{
+    _challenges[index]->_performance.SaveIfDue(_address(index), _challenges[index]->Name());
+}
+
+int ChallengeEngine::_address(unsigned char index) const
+{
+    if (_eeprom_address < 0) {
+        return -1; // for every challenge, not only the first
+    }
+    return _eeprom_address + index * PerformanceStats::SaveSize();
+}
@@ -0,0 +1,248 @@
+#ifndef CHALLENGE_H
+#define CHALLENGE_H
+
+#include "application.h"
+#include "json_writer.h"
+#include "audio_sequence.h"
+#include "performance_stats.h"
+
+class HubInterface;
+
+#define MAX_CHALLENGES 8
+// the maximum number of challenges one ChallengeEngine can switch between
+
+#define MAX_LEN_CHALLENGE_EXTRA 256
+// the maximum length of the extra field of a challenge report
+
+struct ChallengeLevel {
+    // settings of one level of a challenge, a challenge is a table of these
+    unsigned long response_timeout_ms;  // how long to wait for a response, 0 = forever
+    unsigned long foodtreat_duration_ms; // how long to present a foodtreat
+    unsigned char enough_successes;     // level up (or complete the challenge at the last level) at this many successes
+    unsigned char too_many_misses;      // level down at this many misses, 0 = never level down
+    unsigned long min_delay_ms;         // shortest wait between interactions
+    unsigned long max_delay_ms;         // longest wait between interactions, picked at random between min and max
+};
+
+/*
+                            <<<     Challenge               >>>
+                            <<<                             >>>
+
+    Base class for challenges run by a ChallengeEngine. A challenge only
+    holds what is unique to it: its level table and the hooks below. Waiting
+    for the hub, timing, rewards, progression, reporting and saving the
+    performance are done by the engine, the same way for every challenge.
+
+    One interaction goes:
+        1. engine waits until the hub is ready, the foodmachine idle and no touchpad pressed
+        2. Cue()                    e.g. light the targets
+        3. Respond()                every Run() until it decides, or the level's timeout passes
+        4. Reward()                 engine plays the feedback sound and presents the foodtreat if so
+        5. Success()                engine adds the result to the history and levels up/down
+        6. ReportExtra()            engine sends the report
+        7. Finish()                 e.g. remember the targets for a retry
+        8. engine waits min_delay_ms..max_delay_ms
+
+    Hooks are called from ChallengeEngine::Run() and must not block.
+*/
+
+class Challenge
+{
+
+public:
+    Challenge(const char * name, const ChallengeLevel * levels, unsigned char numLevels, unsigned char historyLength, int startingLevel = 1);
+    // name: identifies the challenge, also used to save its performance
+    // levels: table of numLevels levels, level 1 is levels[0], must outlive the challenge
+    // historyLength: number of interactions to look back for leveling up and down
+
+    virtual ~Challenge() {}
+
+    const char * Name() const;
+
+    int Level() const;
+    // current level, [1, NumLevels()]
+
+    void SetLevel(int level);
+    // change the level, the history is reset
+
+    unsigned char NumLevels() const;
+
+    const ChallengeLevel & LevelSettings() const;
+    // settings of the current level
+
+    bool Completed() const;
+    // whether the last interaction completed the challenge (enough successes at the last level)
+
+    PerformanceStats & Performance();
+
+    //HOOKS
+
+    virtual void Cue(HubInterface & hub) = 0;
+    // start of an interaction, present the cue (e.g. light the targets)
+
+    virtual unsigned char Respond(HubInterface & hub, unsigned char pressed, unsigned long elapsed_ms) = 0;
+    // called while waiting for a response with the touchpads currently pressed (BUTTON_... bits)
+    // and the time since Cue, returns RESPONSE_PENDING to keep waiting or RESPONSE_HIT/RESPONSE_MISS
+
+    virtual bool Reward(unsigned char response);
+    // whether to present a foodtreat for a response (RESPONSE_...), default: only for a hit
+
+    virtual bool Success(unsigned char response, bool foodtreatEaten);
+    // whether an interaction counts as a success in the history, default: a hit
+
+    virtual void ReportExtra(JsonWriter & extra);
+    // add fields to the extra object of the report, default: none
+
+    virtual void Finish(unsigned char response);
+    // end of an interaction, after it was reported
+
+    //RESPONSES
+    static const unsigned char RESPONSE_PENDING = 0;
+    static const unsigned char RESPONSE_HIT = 1;
+    static const unsigned char RESPONSE_MISS = 2;
+    static const unsigned char RESPONSE_TIMEOUT = 3; // set by the engine, never returned by Respond
+
+protected:
+    bool _count_timeouts = false; // add timeouts to the history as misses
+    bool _report_timeouts = false; // send reports of interactions that timed out
+
+private:
+    friend class ChallengeEngine;
+
+    const char * _name;
+    const ChallengeLevel * _levels;
+    unsigned char _num_levels;
+    int _starting_level;
+    bool _completed = false;
+    PerformanceStats _performance;
+};
+
+/*
+                            <<<     Challenge engine        >>>
+                            <<<                             >>>
+
+    Runs the interactions of one of up to MAX_CHALLENGES challenges. Another
+    challenge can be selected at any time, also from the cloud with the
+    "challenge" function (see EnableCloudSelect), it takes over at the start
+    of the next interaction. The performance of every challenge is saved in
+    EEPROM when its level changes and otherwise now and then (see
+    PerformanceStats::SaveIfDue), one PerformanceStats::SaveSize() slot per
+    challenge in the order they were added.
+
+    The reports keep the challenge_id Initialize gave them, the name of the
+    source file. With ReportNamesAsChallengeId they carry the name of the
+    challenge played instead (see HubInterface::SetChallengeId), so the
+    reports of a hub that switches challenges can be told apart.
+
+ * example:
+ *      AvoidingUnlitTouchpads avoiding;
+ *      LearningTheLights learning;
+ *      ChallengeEngine engine(hub, "Pet, Clever");
+ *      // setup()
+ *      hub.Initialize(__FILE__);
+ *      engine.Add(avoiding);
+ *      engine.Add(learning);
+ *      engine.EnableCloudSelect();
+ *      // loop()
+ *      hub.Run(20);
+ *      engine.Run();
+*/
+
+class ChallengeEngine
+{
+
+public:
+    ChallengeEngine(HubInterface & hub, const char * player, int eepromAddress = 0);
+    // player: name of the player in the reports, must outlive the engine
+    // eepromAddress: where the saved performance of the first challenge starts,
+    //               negative to neither load nor save any of them (e.g. hubs of a fleet simulation)
+
+    bool Add(Challenge & challenge);
+    // adds a challenge and loads its saved performance, the first one added is played first
+    // returns false if MAX_CHALLENGES are added already
+
+    void ReportNamesAsChallengeId(bool enable);
+    // true: every report has the name of the challenge played as its challenge_id
+    // false (default): the reports keep the challenge_id of the source file
+
+    bool Select(const char * name);
+    // play the challenge with this name from the next interaction on
+
+    bool SelectIndex(unsigned char index);
+    // same, by the order the challenges were added
+
+    Challenge * Current();
+    // the challenge being played, nullptr if none was added
+
+    unsigned char NumChallenges() const;
+
+    Challenge * GetChallenge(unsigned char index);
+
+    bool EnableCloudSelect();
+    // registers the "challenge" cloud function, call it with the name of a challenge to select it
+
+    bool Run();
+    // advances the interaction of the current challenge, call every loop() after hub.Run()
+    // returns true when an interaction finished
+
+private:
+    void _start_interaction();
+
+    void _finish_response(unsigned char response);
+
+    void _add_result(bool success);
+    // adds a result to the history of the current challenge
+
+    bool _completing();
+    // the history completes the last level of the current challenge
+
+    void _progress();
+    // levels the current challenge up or down by its history, or completes it
+
+    void _report();
+
+    void _save(unsigned char index);
+
+    int _address(unsigned char index) const;
+    // EEPROM address of the saved performance of a challenge, -1 if the engine does not save
+
+    int _cloud_select(String name);
+
+    static bool _wait(unsigned long since, unsigned long duration);
+
+private:
+    //INTERACTION STATES
+    static const unsigned char CHALLENGE_WAIT_READY = 0;
+    static const unsigned char CHALLENGE_RESPONSE = 1;
+    static const unsigned char CHALLENGE_BEFORE_FEEDBACK = 2;
+    static const unsigned char CHALLENGE_AFTER_FEEDBACK = 3;
+    static const unsigned char CHALLENGE_FOODTREAT = 4;
+    static const unsigned char CHALLENGE_DELAY = 5;
+
+    static const unsigned long SOUND_TOUCHPAD_DELAY = 300; // (ms) let the touchpad sound finish
+    static const AudioStep REWARD_SOUND[];
+    static const AudioStep MISS_SOUND[];
+
+    HubInterface & _hub;
+    const char * _player;
+    int _eeprom_address;
+    bool _names_as_challenge_id = false;
+    Challenge * _challenges[MAX_CHALLENGES];
+    unsigned char _num_challenges = 0;
+    unsigned char _current = 0;
+    int _selected = -1; // challenge to switch to at the next interaction, -1 = none
+
+    unsigned char _state = CHALLENGE_WAIT_READY;
+    unsigned long _state_time = 0; // millis() when the current state started
+    unsigned long _start_time = 0; // millis() when the cue was presented
+    unsigned long _game_start_time = 0; // Time.now() when the cue was presented
+    unsigned long _duration = 0;
+    unsigned long _delay = 0;
+    unsigned char _response = Challenge::RESPONSE_PENDING;
+    bool _rewarded = false;
+    bool _foodtreat_eaten = false;
+
+    char _extra_buffer[MAX_LEN_CHALLENGE_EXTRA];
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "compact_report.h"
+
+CompactReportBatch::CompactReportBatch()
+{
+    Begin(0, 0);
+}
+
+void CompactReportBatch::Begin(uint32_t dict_id, uint32_t base_timestamp)
+{
+    _dict_id = dict_id;
+    _base_timestamp = base_timestamp;
+    _len = 0;
+    _put_byte(COMPACT_REPORT_VERSION);
+    _put_u32(dict_id);
+    _put_u32(base_timestamp);
+    _put_byte(0); // number of records, updated by Add()
+}
+
+bool CompactReportBatch::Add(uint32_t timestamp, const char * play_start_time, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra)
+{
+    const size_t count_offset = 9;
+
+    if (_buffer[count_offset] == 255) {
+        return false;
+    }
+    if (timestamp < _base_timestamp) { // clock went backwards, needs a new batch
+        return false;
+    }
+
+    unsigned char flags = 0;
+    if (foodtreat_presented) {
+        flags |= COMPACT_FLAG_FOODTREAT_PRESENTED;
+    }
+    if (foodtreat_eaten) {
+        flags |= COMPACT_FLAG_FOODTREAT_EATEN;
+    }
+
+    uint32_t start_utc = 0;
+    int offset_minutes = 0;
+    bool is_z = false;
+    if (_parse_iso8601(play_start_time, &start_utc, &offset_minutes, &is_z) && (start_utc <= timestamp)) {
+        flags |= COMPACT_FLAG_START_PACKED;
+        if (is_z) {
+            flags |= COMPACT_FLAG_START_UTC_Z;
+        }
+    }
+
+    if (((result[0] == '0') || (result[0] == '1')) && (result[1] == 0)) {
+        flags |= COMPACT_FLAG_RESULT_PACKED;
+        if (result[0] == '1') {
+            flags |= COMPACT_FLAG_RESULT_VALUE;
+        }
+    }
+
+    if ((extra != nullptr) && (extra[0] != 0)) {
+        flags |= COMPACT_FLAG_HAS_EXTRA;
+    }
+
+    size_t len_before = _len;
+    bool ok = _put_varint(timestamp - _base_timestamp);
+    ok = ok && _put_byte(flags);
+    ok = ok && _put_varint(level);
+    ok = ok && _put_varint(duration);
+    if (flags & COMPACT_FLAG_START_PACKED) {
+        // zigzag so small negative offsets stay small
+        uint32_t zigzag = (offset_minutes < 0) ? ((uint32_t)(-offset_minutes) * 2 - 1) : ((uint32_t)offset_minutes * 2);
+        ok = ok && _put_varint(timestamp - start_utc);
+        ok = ok && _put_varint(zigzag);
+    }
+    else {
+        ok = ok && _put_text(play_start_time);
+    }
+    if (!(flags & COMPACT_FLAG_RESULT_PACKED)) {
+        ok = ok && _put_text(result);
+    }
+    if (flags & COMPACT_FLAG_HAS_EXTRA) {
+        ok = ok && _put_text(extra);
+    }
+
+    if (!ok) {
+        _len = len_before; // drop the partial record
+        return false;
+    }
+    _buffer[count_offset]++;
+    return true;
+}
+
+unsigned char CompactReportBatch::Count() const
+{
+    return _buffer[9];
+}
+
+uint32_t CompactReportBatch::DictId() const
+{
+    return _dict_id;
+}
+
+size_t CompactReportBatch::EncodeBase64(char * out, size_t size) const
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    size_t out_len = 4 * ((_len + 2) / 3);
+    if (out_len + 1 > size) {
+        return 0;
+    }
+
+    size_t o = 0;
+    for (size_t i = 0; i < _len; i += 3) {
+        uint32_t triple = (uint32_t)_buffer[i] << 16;
+        if (i + 1 < _len) {
+            triple |= (uint32_t)_buffer[i + 1] << 8;
+        }
+        if (i + 2 < _len) {
+            triple |= _buffer[i + 2];
+        }
+        out[o++] = alphabet[(triple >> 18) & 0x3f];
+        out[o++] = alphabet[(triple >> 12) & 0x3f];
+        out[o++] = (i + 1 < _len) ? alphabet[(triple >> 6) & 0x3f] : '=';
+        out[o++] = (i + 2 < _len) ? alphabet[triple & 0x3f] : '=';
+    }
+    out[o] = 0;
+    return o;
+}
+
+uint32_t CompactReportBatch::DictIdFor(const char * challenge_id, const char * player)
+{
+    uint32_t hash = 2166136261UL;
+    for (const char * c = challenge_id; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619UL;
+    }
+    hash = (hash ^ 0) * 16777619UL; // separator, so "ab"+"c" differs from "a"+"bc"
+    for (const char * c = player; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619UL;
+    }
+    return hash;
+}
+
+bool CompactReportBatch::_put_byte(unsigned char value)
+{
+    if (_len >= MAX_LEN_COMPACT_BATCH) {
+        return false;
+    }
+    _buffer[_len++] = value;
+    return true;
+}
+
+bool CompactReportBatch::_put_u32(uint32_t value)
+{
+    return _put_byte(value & 0xff) && _put_byte((value >> 8) & 0xff)
+           && _put_byte((value >> 16) & 0xff) && _put_byte((value >> 24) & 0xff);
+}
+
+bool CompactReportBatch::_put_varint(uint32_t value)
+{
+    while (value >= 0x80) {
+        if (!_put_byte((value & 0x7f) | 0x80)) {
+            return false;
+        }
+        value >>= 7;
+    }
+    return _put_byte(value);
+}
+
+bool CompactReportBatch::_put_text(const char * text)
+{
+    size_t len = strlen(text);
+    if (!_put_varint(len)) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!_put_byte(text[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompactReportBatch::_parse_iso8601(const char * text, uint32_t * utc, int * offset_minutes, bool * is_z)
+{
+    static const unsigned char days_in_month[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    int year, month, day, hour, minute, second, consumed = 0;
+    if (sscanf(text, "%4d-%2d-%2dT%2d:%2d:%2d%n", &year, &month, &day, &hour, &minute, &second, &consumed) != 6) {
+        return false;
+    }
+    if ((year < 1970) || (month < 1) || (month > 12) || (day < 1) || (day > days_in_month[month - 1])
+            || (hour > 23) || (minute > 59) || (second > 59)) {
+        return false;
+    }
+    if ((month == 2) && (day == 29) && !(((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0)))) {
+        return false;
+    }
+
+    const char * zone = text + consumed;
+    int offset = 0;
+    *is_z = false;
+    if ((zone[0] == 'Z') && (zone[1] == 0)) {
+        *is_z = true;
+    }
+    else {
+        int zone_hour, zone_minute;
+        char sign;
+        if (sscanf(zone, "%c%2d:%2d", &sign, &zone_hour, &zone_minute) != 3 || ((sign != '+') && (sign != '-'))) {
+            return false;
+        }
+        offset = zone_hour * 60 + zone_minute;
+        if (sign == '-') {
+            offset = -offset;
+        }
+    }
+
+    // only pack what the decoder can reproduce character for character
+    char check[32];
+    int len = snprintf(check, sizeof(check), "%04d-%02d-%02dT%02d:%02d:%02d", year, month, day, hour, minute, second);
+    if (*is_z) {
+        snprintf(check + len, sizeof(check) - len, "Z");
+    }
+    else {
+        snprintf(check + len, sizeof(check) - len, "%c%02d:%02d", offset < 0 ? '-' : '+', abs(offset) / 60, abs(offset) % 60);
+    }
+    if (strcmp(check, text) != 0) {
+        return false;
+    }
+
+    // days since 1970-01-01 of the local date (civil calendar, valid for years >= 1970)
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = y / 400;
+    int year_of_era = y - era * 400;
+    int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int64_t days = (int64_t)era * 146097 + day_of_era - 719468;
+
+    int64_t local_seconds = days * 86400 + hour * 3600 + minute * 60 + second;
+    int64_t utc_seconds = local_seconds - offset * 60;
+    if ((utc_seconds < 0) || (utc_seconds > 0xffffffffLL)) {
+        return false;
+    }
+    *utc = (uint32_t)utc_seconds;
+    *offset_minutes = offset;
+    return true;
+}
@@ -0,0 +1,99 @@
+#ifndef COMPACT_REPORT_H
+#define COMPACT_REPORT_H
+
+#include "application.h"
+
+#define MAX_LEN_COMPACT_BATCH 465
+// the maximum length of a binary batch, base64 of it must fit in one particle publish (620 characters)
+
+#define COMPACT_REPORT_VERSION 1
+
+/*
+                            <<<     Compact report batch    >>>
+                            <<<                             >>>
+
+    Packs many reports into one binary batch that is published base64
+    encoded as a "hckrpt/creport" event. The strings that are the same for
+    every report of a challenge (challenge_id and player) are not part of the
+    records: they are published once as a "hckrpt/dict" event and the batch
+    only carries the dictionary id. tools/decode_compact_reports.py turns
+    the events back into the regular "hckrpt/report" JSON.
+
+    Batch layout, integers are little endian, varints are LEB128:
+        u8      version (COMPACT_REPORT_VERSION)
+        u32     dictionary id
+        u32     base timestamp (unix time of the first record)
+        u8      number of records
+        records...
+
+    Record layout:
+        varint  timestamp - base timestamp
+        u8      flags (COMPACT_FLAG_...)
+        varint  level
+        varint  duration
+        play_start_time:
+            COMPACT_FLAG_START_PACKED:  varint  timestamp - start time (unix)
+                                        varint  zigzag utc offset in minutes
+            otherwise:                  varint length, characters
+        result:
+            COMPACT_FLAG_RESULT_PACKED: nothing, value in COMPACT_FLAG_RESULT_VALUE
+            otherwise:                  varint length, characters
+        extra (only if COMPACT_FLAG_HAS_EXTRA): varint length, characters
+*/
+
+class CompactReportBatch
+{
+
+public:
+    CompactReportBatch();
+
+    void Begin(uint32_t dict_id, uint32_t base_timestamp);
+    // start a new, empty batch
+
+    bool Add(uint32_t timestamp, const char * play_start_time, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra);
+    // append one record, returns false (and leaves the batch untouched) if it does not fit
+    // extra may be nullptr
+
+    unsigned char Count() const;
+    // number of records in the batch
+
+    uint32_t DictId() const;
+    // dictionary id the batch was started with
+
+    size_t EncodeBase64(char * out, size_t size) const;
+    // writes the 0 terminated base64 text of the batch to out, returns its length or 0 if it does not fit
+
+    static uint32_t DictIdFor(const char * challenge_id, const char * player);
+    // FNV-1a hash identifying a challenge_id/player dictionary
+
+    //RECORD FLAGS
+    static const unsigned char COMPACT_FLAG_FOODTREAT_PRESENTED = 0b00000001;
+    static const unsigned char COMPACT_FLAG_FOODTREAT_EATEN     = 0b00000010;
+    static const unsigned char COMPACT_FLAG_START_PACKED        = 0b00000100; // play_start_time is ISO8601 and stored as numbers
+    static const unsigned char COMPACT_FLAG_START_UTC_Z         = 0b00001000; // packed play_start_time ended in 'Z'
+    static const unsigned char COMPACT_FLAG_RESULT_PACKED       = 0b00010000; // result is "0" or "1"
+    static const unsigned char COMPACT_FLAG_RESULT_VALUE        = 0b00100000; // packed result was "1"
+    static const unsigned char COMPACT_FLAG_HAS_EXTRA           = 0b01000000;
+
+private:
+    bool _put_byte(unsigned char value);
+
+    bool _put_u32(uint32_t value);
+
+    bool _put_varint(uint32_t value);
+
+    bool _put_text(const char * text);
+    // varint length followed by the characters
+
+    static bool _parse_iso8601(const char * text, uint32_t * utc, int * offset_minutes, bool * is_z);
+    // parses YYYY-MM-DDTHH:MM:SS followed by Z or +HH:MM / -HH:MM
+    // only succeeds if formatting the result again gives back exactly the same text
+
+private:
+    unsigned char _buffer[MAX_LEN_COMPACT_BATCH];
+    size_t _len;
+    uint32_t _dict_id;
+    uint32_t _base_timestamp;
+};
+
+#endif
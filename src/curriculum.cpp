@@ -0,0 +1,136 @@
+#include "hackerpet.h"
+
+// response timeout, foodtreat duration, enough successes, too many misses, min delay, max delay
+static const ChallengeLevel EXPLORING_THE_TOUCHPADS_LEVELS[] = {
+    {60000, 12000, 3, 4, 0, 0},
+    {180000, 10000, 3, 4, 0, 0},
+    {600000, 8000, 3, 4, 0, 0},
+    {99999999, 6000, 3, 4, 0, 0},
+};
+
+static const ChallengeLevel AVOIDING_UNLIT_TOUCHPADS_LEVELS[] = {
+    {60000, 5000, 18, 0, 1000, 8000},
+    {60000, 5000, 18, 0, 1000, 8000},
+};
+
+static const ChallengeLevel LEARNING_THE_LIGHTS_LEVELS[] = {
+    {60000, 5000, 30, 0, 1000, 8000},
+};
+
+static const ChallengeLevel MASTERING_THE_LIGHTS_LEVELS[] = {
+    {60000, 5000, 40, 0, 1000, 8000},
+};
+
+#define NUM_LEVELS(levels) (sizeof(levels) / sizeof(levels[0]))
+
+static bool single_pad(unsigned char pressed)
+{
+    return (pressed == HubInterface::BUTTON_LEFT) || (pressed == HubInterface::BUTTON_MIDDLE) || (pressed == HubInterface::BUTTON_RIGHT);
+}
+
+ExploringTheTouchpads::ExploringTheTouchpads()
+    : Challenge("ExploringTheTouchpads", EXPLORING_THE_TOUCHPADS_LEVELS, NUM_LEVELS(EXPLORING_THE_TOUCHPADS_LEVELS), 6)
+{
+    _count_timeouts = true; // an uneaten foodtreat is a miss, touched or not
+}
+
+void ExploringTheTouchpads::Cue(HubInterface & hub)
+{
+    hub.SetRandomButtonLights(3, 60, 60, 0, 99);
+}
+
+unsigned char ExploringTheTouchpads::Respond(HubInterface & hub, unsigned char pressed, unsigned long elapsed_ms)
+{
+    return single_pad(pressed) ? RESPONSE_HIT : RESPONSE_PENDING;
+}
+
+bool ExploringTheTouchpads::Reward(unsigned char response)
+{
+    return true; // also after a timeout
+}
+
+bool ExploringTheTouchpads::Success(unsigned char response, bool foodtreatEaten)
+{
+    return foodtreatEaten;
+}
+
+LitTouchpadChallenge::LitTouchpadChallenge(const char * name, const ChallengeLevel * levels, unsigned char numLevels, unsigned char historyLength, unsigned char numPads, int retryLevel)
+    : Challenge(name, levels, numLevels, historyLength), _num_pads(numPads), _retry_level(retryLevel)
+{
+}
+
+void LitTouchpadChallenge::Cue(HubInterface & hub)
+{
+    unsigned char yellow = hub.Random().Between(20, 90);
+    unsigned char blue = hub.Random().Between(20, 90);
+
+    _pressed = 0;
+    if (_retry_target != 0) {
+        _target = _retry_target;
+        hub.SetLights(_target, yellow, blue, 0, 99);
+    }
+    else {
+        _target = hub.SetRandomButtonLights(_num_pads, yellow, blue, 0, 99);
+    }
+}
+
+unsigned char LitTouchpadChallenge::Respond(HubInterface & hub, unsigned char pressed, unsigned long elapsed_ms)
+{
+    if (!single_pad(pressed)) {
+        return RESPONSE_PENDING;
+    }
+    _pressed = pressed;
+    return (pressed & _target) ? RESPONSE_HIT : RESPONSE_MISS;
+}
+
+void LitTouchpadChallenge::ReportExtra(JsonWriter & extra)
+{
+    char letters[4];
+    PadLetters(_target, letters);
+    extra.StringField("targets", letters);
+    PadLetters(_pressed, letters);
+    extra.StringField("pressed", letters);
+    extra.StringField("retryGame", _retry_target ? "1" : "0");
+}
+
+void LitTouchpadChallenge::Finish(unsigned char response)
+{
+    if (response == RESPONSE_HIT) {
+        _retry_target = 0;
+    }
+    else if ((response == RESPONSE_MISS) && (Level() >= _retry_level)) {
+        _retry_target = _target;
+    }
+}
+
+void LitTouchpadChallenge::PadLetters(unsigned char pads, char * letters)
+{
+    unsigned char i = 0;
+    if (pads & HubInterface::BUTTON_LEFT) {
+        letters[i++] = 'L';
+    }
+    if (pads & HubInterface::BUTTON_MIDDLE) {
+        letters[i++] = 'M';
+    }
+    if (pads & HubInterface::BUTTON_RIGHT) {
+        letters[i++] = 'R';
+    }
+    letters[i] = 0;
+}
+
+AvoidingUnlitTouchpads::AvoidingUnlitTouchpads()
+    : LitTouchpadChallenge("AvoidingUnlitTouchpads", AVOIDING_UNLIT_TOUCHPADS_LEVELS, NUM_LEVELS(AVOIDING_UNLIT_TOUCHPADS_LEVELS), 20, 2, 2)
+{
+    _count_timeouts = true;
+}
+
+LearningTheLights::LearningTheLights()
+    : LitTouchpadChallenge("LearningTheLights", LEARNING_THE_LIGHTS_LEVELS, NUM_LEVELS(LEARNING_THE_LIGHTS_LEVELS), 50, 1, 1)
+{
+    _count_timeouts = true;
+}
+
+MasteringTheLights::MasteringTheLights()
+    : LitTouchpadChallenge("MasteringTheLights", MASTERING_THE_LIGHTS_LEVELS, NUM_LEVELS(MASTERING_THE_LIGHTS_LEVELS), 50, 1, 1)
+{
+}
@@ -0,0 +1,78 @@
+#ifndef CURRICULUM_H
+#define CURRICULUM_H
+
+#include "challenge.h"
+
+/*
+                            <<<     Curriculum challenges   >>>
+                            <<<                             >>>
+
+    Challenges of the original CleverPet learning curriculum written for the
+    ChallengeEngine, so they can be played from one firmware and switched
+    without reflashing. See the examples with the same names for what each
+    challenge teaches.
+*/
+
+class ExploringTheTouchpads : public Challenge
+{
+    // all touchpads are lit, touching any of them or waiting long enough
+    // gives a foodtreat, success is eating it
+
+public:
+    ExploringTheTouchpads();
+
+    void Cue(HubInterface & hub);
+    unsigned char Respond(HubInterface & hub, unsigned char pressed, unsigned long elapsed_ms);
+    bool Reward(unsigned char response);
+    bool Success(unsigned char response, bool foodtreatEaten);
+};
+
+class LitTouchpadChallenge : public Challenge
+{
+    // numPads random touchpads are lit, touching a lit one is a hit
+    // after a miss the same touchpads are lit again (from retryLevel on)
+
+public:
+    LitTouchpadChallenge(const char * name, const ChallengeLevel * levels, unsigned char numLevels, unsigned char historyLength, unsigned char numPads, int retryLevel);
+
+    void Cue(HubInterface & hub);
+    unsigned char Respond(HubInterface & hub, unsigned char pressed, unsigned long elapsed_ms);
+    void ReportExtra(JsonWriter & extra);
+    void Finish(unsigned char response);
+
+    static void PadLetters(unsigned char pads, char * letters);
+    // writes the touchpads of a BUTTON_... bitfield as "L", "M" and "R" to letters (at least 4 chars)
+
+private:
+    unsigned char _num_pads;
+    int _retry_level;
+    unsigned char _target = 0; // bitfield, lit touchpads
+    unsigned char _pressed = 0; // bitfield, touchpad that was pressed
+    unsigned char _retry_target = 0; // touchpads to light again, 0 = pick new ones
+};
+
+class AvoidingUnlitTouchpads : public LitTouchpadChallenge
+{
+    // two touchpads are lit, level 2 retries after a miss
+
+public:
+    AvoidingUnlitTouchpads();
+};
+
+class LearningTheLights : public LitTouchpadChallenge
+{
+    // one touchpad is lit, 30 hits in 50 interactions completes it
+
+public:
+    LearningTheLights();
+};
+
+class MasteringTheLights : public LitTouchpadChallenge
+{
+    // one touchpad is lit, 40 hits in 50 interactions completes it, timeouts don't count
+
+public:
+    MasteringTheLights();
+};
+
+#endif
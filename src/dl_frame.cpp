@@ -0,0 +1,27 @@
+#include "dl_frame.h"
+
+DlFrameEncoder::DlFrameEncoder(char * buf, char token)
+    : _buf(buf), _at(buf + DL_FRAME_PAYLOAD_AT)
+{
+    _buf[0] = '$';
+    _buf[DL_FRAME_PACKET_NUMBER_AT] = '0';
+    _buf[5] = token;
+    _buf[6] = '1';
+}
+
+DlFrameEncoder & DlFrameEncoder::Letter(char letter)
+{
+    *_at++ = letter;
+    return *this;
+}
+
+size_t DlFrameEncoder::Finish()
+{
+    size_t len = _at - _buf - DL_FRAME_PAYLOAD_AT;
+    _buf[1] = '0' + len / 100;
+    _buf[2] = '0' + len / 10 % 10;
+    _buf[3] = '0' + len % 10;
+    *_at++ = '.';
+    *_at = 0;
+    return _at - _buf;
+}
@@ -0,0 +1,136 @@
+#ifndef DL_FRAME_H
+#define DL_FRAME_H
+
+#include "application.h"
+
+#define LEN_DL_CMD_FRAMING 9
+// bytes a command takes on the serial link besides its payload: $, length, packet number, token, 1, . and the end
+
+#define DL_FRAME_PACKET_NUMBER_AT 4
+// the packet number is the only byte that differs between two sends of the same command
+
+#define DL_FRAME_PAYLOAD_AT 7
+
+#define MAX_LEN_CONSTANT_DL_FRAME 12
+// room of a ConstantDlFrame, for payloads of up to 3 bytes
+
+/*
+                            <<<     Device layer frames     >>>
+                            <<<                             >>>
+
+    A command to the device layer is "$LLLNT1<payload>." with LLL the
+    payload length, N the packet number and T the token.
+
+    The polls and resets send the same payload every time, so their frames
+    are made at compile time (MakeDlFrame) and sending one costs a copy and
+    the packet number. The setters with fixed width fields (lights, audio,
+    tones) write their fields straight into the frame with DlFrameEncoder,
+    each field width a template argument, instead of formatting a payload
+    with sprintf and copying it into a frame with sprintf again.
+*/
+
+struct ConstantDlFrame {
+    char buf[MAX_LEN_CONSTANT_DL_FRAME]; // the frame with packet number 0
+    unsigned char len; // bytes before the terminating 0
+};
+
+// MakeDlFrame builds the frame one byte per index, in a single return, so
+// it stays a constant expression under C++11 as well
+template <size_t... I>
+struct DlFrameIndices {
+};
+
+template <size_t N, size_t... I>
+struct MakeDlFrameIndices : MakeDlFrameIndices<N - 1, N - 1, I...> {
+};
+
+template <size_t... I>
+struct MakeDlFrameIndices<0, I...> : DlFrameIndices<I...> {
+};
+
+template <size_t N>
+constexpr char DlFrameByte(size_t i, char token, const char (&payload)[N])
+// byte i of the frame of payload, 0 after the end
+{
+    return (i == 0) ? '$'
+           : (i == 1) ? (char)('0' + (N - 1) / 100)
+           : (i == 2) ? (char)('0' + (N - 1) / 10 % 10)
+           : (i == 3) ? (char)('0' + (N - 1) % 10)
+           : (i == DL_FRAME_PACKET_NUMBER_AT) ? '0'
+           : (i == 5) ? token
+           : (i == 6) ? '1'
+           : (i < DL_FRAME_PAYLOAD_AT + N - 1) ? payload[i - DL_FRAME_PAYLOAD_AT]
+           : (i == DL_FRAME_PAYLOAD_AT + N - 1) ? '.'
+           : '\0';
+}
+
+template <size_t N, size_t... I>
+constexpr ConstantDlFrame MakeDlFrame(char token, const char (&payload)[N], DlFrameIndices<I...>)
+{
+    return {{DlFrameByte(I, token, payload)...}, (unsigned char)(DL_FRAME_PAYLOAD_AT + N)};
+}
+
+template <size_t N>
+constexpr ConstantDlFrame MakeDlFrame(char token, const char (&payload)[N])
+// payload: a string literal
+{
+    static_assert(N - 1 + LEN_DL_CMD_FRAMING <= MAX_LEN_CONSTANT_DL_FRAME, "payload too long for a ConstantDlFrame");
+    return MakeDlFrame(token, payload, MakeDlFrameIndices<MAX_LEN_CONSTANT_DL_FRAME>());
+}
+
+class DlFrameEncoder
+{
+
+public:
+    DlFrameEncoder(char * buf, char token);
+    // starts a frame in buf, which must hold LEN_DL_CMD_FRAMING + the payload
+    // the packet number is left 0, see HubInterface::_stamp_dl_cmd
+
+    DlFrameEncoder & Letter(char letter);
+
+    template <unsigned int WIDTH> DlFrameEncoder & Digits(unsigned int value)
+    // value as exactly WIDTH decimal digits with leading zeros, like "%0<WIDTH>d"
+    // clipped to the largest WIDTH digit number, so the fields never shift
+    {
+        static_assert((WIDTH > 0) && (WIDTH < 10), "WIDTH out of range");
+        unsigned int max = 9;
+        for (unsigned int i = 1; i < WIDTH; i++) {
+            max = 10 * max + 9;
+        }
+        if (value > max) {
+            value = max;
+        }
+        for (unsigned int i = WIDTH; i > 0; i--) {
+            _at[i - 1] = '0' + value % 10;
+            value /= 10;
+        }
+        _at += WIDTH;
+        return *this;
+    }
+
+    size_t Finish();
+    // writes the payload length and the end, returns the bytes of the frame before the terminating 0
+
+private:
+    char * _buf;
+    char * _at;
+};
+
+template <> inline DlFrameEncoder & DlFrameEncoder::Digits<1>(unsigned int value)
+{
+    *_at++ = '0' + ((value > 9) ? 9 : value);
+    return *this;
+}
+
+template <> inline DlFrameEncoder & DlFrameEncoder::Digits<2>(unsigned int value)
+{
+    if (value > 99) {
+        value = 99;
+    }
+    _at[0] = '0' + value / 10;
+    _at[1] = '0' + value % 10;
+    _at += 2;
+    return *this;
+}
+
+#endif
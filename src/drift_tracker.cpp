@@ -0,0 +1,55 @@
+#include "drift_tracker.h"
+#include <math.h>
+
+BaselineDriftTracker::BaselineDriftTracker()
+{
+    Reset();
+}
+
+void BaselineDriftTracker::Reset()
+{
+    _mean = 0;
+    _variance = 0;
+    _samples = 0;
+}
+
+void BaselineDriftTracker::Add(int value)
+{
+    if (_samples == 0) {
+        _mean = value;
+    }
+    else {
+        // West's incremental EWMA of mean and variance
+        float diff = value - _mean;
+        float increment = _alpha * diff;
+        _mean += increment;
+        _variance = (1 - _alpha) * (_variance + diff * increment);
+    }
+    if (_samples < DRIFT_WARMUP_SAMPLES) {
+        _samples++;
+    }
+}
+
+bool BaselineDriftTracker::Ready() const
+{
+    return _samples >= DRIFT_WARMUP_SAMPLES;
+}
+
+float BaselineDriftTracker::Mean() const
+{
+    return _mean;
+}
+
+float BaselineDriftTracker::StdDev() const
+{
+    return sqrtf(_variance);
+}
+
+bool BaselineDriftTracker::AtRisk(int threshold) const
+{
+    if (!Ready()) {
+        return false;
+    }
+    float limit = _risk_fraction * threshold;
+    return (_mean + _sigmas * StdDev() > limit) || (-_mean > limit);
+}
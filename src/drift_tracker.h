@@ -0,0 +1,58 @@
+#ifndef DRIFT_TRACKER_H
+#define DRIFT_TRACKER_H
+
+#include "application.h"
+
+#define DRIFT_WARMUP_SAMPLES 40
+// samples (2 s of button polls) before a tracker judges the drift
+
+/*
+                            <<<     Baseline drift tracker  >>>
+                            <<<                             >>>
+
+    Follows baseline - reading of one untouched touchpad (the value that is
+    compared against the touch threshold) with an exponentially weighted
+    mean and variance. Humidity, temperature and a dirty dome make this
+    value creep away from 0 over time; once the mean plus a few standard
+    deviations gets close to the threshold, noise alone will soon look like
+    a touch, and once the mean sinks far below 0 real touches stop reaching
+    the threshold. Only then is a DI reset (which recalibrates the
+    baselines) worth the interruption.
+
+    Costs two multiply-adds per sample, no history is kept.
+*/
+
+class BaselineDriftTracker
+{
+
+public:
+    BaselineDriftTracker();
+
+    void Reset();
+    // forget everything, e.g. after the DI board recalibrated
+
+    void Add(int value);
+    // value: baseline - reading of the pad while it is not touched
+
+    bool Ready() const;
+    // enough samples to judge the drift
+
+    float Mean() const;
+
+    float StdDev() const;
+
+    bool AtRisk(int threshold) const;
+    // true if the pad is drifting towards false touches or lost sensitivity
+    // threshold: the touch threshold of the pad
+
+private:
+    float _mean;
+    float _variance;
+    unsigned short _samples;
+
+    float _alpha = 1.0 / 64; // weight of a new sample, about 3 s at 20 polls per second
+    float _sigmas = 3; // noise margin in standard deviations
+    float _risk_fraction = 0.6; // at risk once mean + noise margin (or -mean) passes this part of the threshold
+};
+
+#endif
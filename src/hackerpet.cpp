@@ -1,12 +1,18 @@
 #include "hackerpet.h"
-#include "timezone.h"
 
 using namespace std;
 
-#include <algorithm>  // random_shuffle
-
 Logger libLog("app.hackerpet");
-Timezone timezone;
+
+const char HubInterface::LightsNum2Token[16] = "ABCDEFGHIJKLMNO";
+HUB_THREAD_LOCAL char HubInterface::_report_buffer[MAX_LEN_REPORT];
+
+// the commands that never change, see MakeDlFrame
+static constexpr ConstantDlFrame DL_FRAME_POLL_DIAG = MakeDlFrame('Z', "00");
+static constexpr ConstantDlFrame DL_FRAME_POLL_BUTTONS = MakeDlFrame('B', "");
+static constexpr ConstantDlFrame DL_FRAME_RETRACT_TRAY = MakeDlFrame('X', "00");
+static constexpr ConstantDlFrame DL_FRAME_RESET_DI = MakeDlFrame('K', "");
+static constexpr ConstantDlFrame DL_FRAME_RESET_FOOD_MACHINE = MakeDlFrame('F', "");
 
 /*
                             <<<                             >>>
@@ -24,49 +30,78 @@ HubInterface::HubInterface()
 {
     _error_code                 = 0         ;// no error at start
     _len_reply_buffer           = 0         ;// indicates the filled length of _reply_buffer
-    _diag_check_rest_ms         = 500       ;// do the diag check every _diag_check_rest_ms MS
     _last_diag_request_ms       = 0         ;// when was the last time diag check was called
     _last_diag_update_ms        = 0         ;// when was the last time diag was updated
-    _time_left_button_pressed   = 0         ;// the last time when a button was pressed
-    _time_middle_button_pressed = 0         ;
-    _time_right_button_pressed  = 0         ;
     _last_timezone_request      = 0         ;// when was the last time we made a timezone request
     _packet_number              = 0         ;// packet sequence number
-    _diag_btn_poll_rest_ms      = 50        ;// rest in MS between button polls
-    _diag_indlight_rest_ms      = 1000      ;// rest in MS between ind light polls
     _last_btn_poll_ms           = 0         ;// last time that buttons were polled
     _run_loop_state             = STATE_BEFORE_SEND ;//before sending command to DL
     _num_send_retries           = 0         ;// retries in sending command to DL
-    _max_num_send_retries       = 3         ;// max number of retries for sending a command
-    sprintf(LightsNum2Token, "%s", "ABCDEFGHIJKLMNO");
-    _max_listen_time            = 20        ;// 5 ms to listen to DL when expecting a reply
     _start_listen               = 0         ;
     _platter_error_count        = 0         ;
-    _platter_stuck              = false     ;
-    _bootup_time                = millis()  ;
-    libLog("HubInterface::HubInterface Constructor finished");
+    _bootup_time                = HubClock::Millis()  ;
+    _reaction_cue_shown         = false    ;
+    _reaction_pressed           = false    ;
+    _get_config_done            = false    ;
+    _platter_stuck              = false    ;
+    _dl_is_ready                = false    ;
+    _do_poll_diag               = false    ;
+    _do_poll_buttons            = false    ;
+    _do_poll_indlight           = false    ;
+    _dome_open                  = false    ;
+    _previous_foodtreat_taken   = false    ;
+    _hub_out_of_food            = false    ;
+    _platter_error              = false    ;
+    _singulator_error           = false    ;
+    _need_foodtreat_reset       = false    ;
+    _indefinite_tray_presentation = false    ;
+    _want_tray_closed           = false    ;
+    _audio_enabled              = true     ;
+    _button_audio_mute          = false    ;
+    _audio_replay_pending       = false    ;
+    _audio_playing              = false    ;
+    _light_enabled              = true     ;
+    _button_audio_enabled       = true     ;
+    _csf_DI_reset_locked        = false    ;
+    _csf_needs_DI_reset         = false    ;
+    _csf_DI_reset_sent          = false    ;
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        _pad_liftoff_end[pad] = _button_liftoff_ms;
+        _set_pad_threshold(pad, _pad_threshold[pad]);
+    }
+    _log->info("HubInterface::HubInterface Constructor finished");
     //REGISTER THE EXPORTED FUNCTIONS
 //    Interface::AddInterfaceFunction("SetLightsFlash",&HubInterface::SetLightsFlash);
 //    Interface::AddInterfaceFunction("SetLightsSlew",&HubInterface::SetLightsSlew);
 }
 
 bool HubInterface::Initialize(char * longFileName){
-    Serial1.begin(38400);  // needed for device layer (hub) communication
+    if (_dl_link == &Serial1) {
+        Serial1.begin(38400);  // needed for device layer (hub) communication
+    }
     ResetDI(); // Reset DI board, just to be sure
     SetDoPollDiagnostics(true); //start polling the diagnostics
     SetDoPollButtons(true); //start polling the touchpads/buttons
     SetDoPollIndLight(true); //start polling the indicator light
     PlayTone(0, 5, 10); // turn off sound
     SetLights(LIGHT_BTNS, 0, 0, 0);  // turn off lights
+    _random.SeedFromHardware(); // different picks on every start
 
-    timezone.withEventName("hckrpt/timezone").begin(); // start timezone library
+    if (!HubClock::IsVirtual()) {
+        _timezone.withEventName("hckrpt/timezone").begin(); // start timezone library
+    }
 
     // set challenge id for report
     const char * fileName = (strrchr(longFileName, SLASH) + 1); // remove path
     if (fileName[0] == 0) // if our new filename is empty
         fileName = longFileName; // use long version
-    sprintf(challenge_id, "%s#%sT%s", fileName , __NICEDATE__, __TIME__ );
+    SetChallengeId(fileName);
+
+    return true;
+}
 
+bool HubInterface::SetChallengeId(const char * name){
+    snprintf(challenge_id, sizeof(challenge_id), "%s#%sT%s", name, __NICEDATE__, __TIME__ );
     return true;
 }
 
@@ -110,22 +145,22 @@ bool HubInterface::SetLights(unsigned char whichLights, unsigned char yellow, un
         // Serial.println("HubInterface::SetLights lights Disabled");
         return false;
     }
+    _light_animator.Forget(whichLights); // the game takes over these lights
+
 
     //create a command to set the lights with slew, then put the command into queue
-    char    slew_cmd_payload[8];
-    sprintf(slew_cmd_payload, "%c%02d%02d%02d", LightsNum2Token[whichLights - 1],
-            map(yellow, 0, 99, 0, _light_amplitude_max), map(blue, 0, 99, 0, _light_amplitude_max), slew);
-    // Serial.println("HubInterface::SetLights");
-    // Serial.println(slew_cmd_payload);
+    LightShadowState state = {LIGHT_KEYFRAME_YB, {_light_levels.Scale(yellow), _light_levels.Scale(blue), 0}, 0, 0};
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('M', slew_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        // Serial.println("HubInterface::SetLightsslew enqueue cmd");
-        _cmd_queue.push(cmd);
-        return true;
+    size_t len = DlFrameEncoder(cmd.buf, 'M').Letter(LightsNum2Token[whichLights - 1])
+                 .Digits<2>(state.color[0]).Digits<2>(state.color[1]).Digits<2>(slew).Finish();
+    if (!_lights_change(whichLights, state, len)) {
+        return true; // they already show that
     }
-    // Serial.println("HubInterface::SetLights w/ slew finished");
-    return false;
+    // Serial.println("HubInterface::SetLights");
+    // Serial.println(cmd.buf);
+    _stamp_dl_cmd(&cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 bool HubInterface::SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char slew)
@@ -135,22 +170,22 @@ bool HubInterface::SetLightsRGB(unsigned char whichLights, unsigned char red, un
         // Serial.println("HubInterface::SetLightsRGB lights Disabled");
         return false;
     }
+    _light_animator.Forget(whichLights); // the game takes over these lights
+
 
     //create a command to set the lights with slew, then put the command into queue
-    char    slew_cmd_payload[10];
-    sprintf(slew_cmd_payload, "%c%02d%02d%02d%02d", LightsNum2Token[whichLights - 1],
-            map(red, 0, 99, 0, _light_amplitude_max), map(green, 0, 99, 0, _light_amplitude_max), map(blue, 0, 99, 0, _light_amplitude_max), slew);
-    // Serial.println("HubInterface::SetLightsRGB");
-    // Serial.println(slew_cmd_payload);
+    LightShadowState state = {LIGHT_KEYFRAME_RGB, {_light_levels.Scale(red), _light_levels.Scale(green), _light_levels.Scale(blue)}, 0, 0};
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('I', slew_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        // libLog("HubInterface::SetLightsRGB enqueue cmd");
-        _cmd_queue.push(cmd);
-        return true;
+    size_t len = DlFrameEncoder(cmd.buf, 'I').Letter(LightsNum2Token[whichLights - 1])
+                 .Digits<2>(state.color[0]).Digits<2>(state.color[1]).Digits<2>(state.color[2]).Digits<2>(slew).Finish();
+    if (!_lights_change(whichLights, state, len)) {
+        return true; // they already show that
     }
-    // Serial.println("HubInterface::SetLightsRGB w/ slew finished");
-    return false;
+    // Serial.println("HubInterface::SetLightsRGB");
+    // Serial.println(cmd.buf);
+    _stamp_dl_cmd(&cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 
@@ -188,21 +223,22 @@ bool HubInterface::SetLights(unsigned char whichLights, unsigned char yellow, un
         // Serial.println("HubInterface::SetLights lights Disabled");
         return false;
     }
+    _light_animator.Forget(whichLights); // the game takes over these lights
+
 
     // Serial.println("HubInterface::SetLights:: Set lights w/ flash");
     //create a command to set the lights with flash, then put the command into queue
-    char    flash_cmd_payload[10];
-    sprintf(flash_cmd_payload, "%c%02d%02d%02d%02d", LightsNum2Token[whichLights - 1],
-            map(yellow, 0, 99, 0, _light_amplitude_max), map(blue, 0, 99, 0, _light_amplitude_max), period, on);
+    LightShadowState state = {LIGHT_KEYFRAME_YB, {_light_levels.Scale(yellow), _light_levels.Scale(blue), 0}, period, on};
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('L', flash_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        libLog("HubInterface::SetLights w/ flash enqueuing command");
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog("HubInterface::SetLights w/ flash finished");
-    return false;
+    size_t len = DlFrameEncoder(cmd.buf, 'L').Letter(LightsNum2Token[whichLights - 1])
+                 .Digits<2>(state.color[0]).Digits<2>(state.color[1]).Digits<2>(period).Digits<2>(on).Finish();
+    if (!_lights_change(whichLights, state, len)) {
+        return true; // they already show that
+    }
+    _log->info("HubInterface::SetLights w/ flash enqueuing command");
+    _stamp_dl_cmd(&cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 bool HubInterface::SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char period, unsigned char on)
 {
@@ -211,21 +247,76 @@ bool HubInterface::SetLightsRGB(unsigned char whichLights, unsigned char red, un
         // Serial.println("HubInterface::SetLightsRGB lights Disabled");
         return false;
     }
+    _light_animator.Forget(whichLights); // the game takes over these lights
+
 
     // Serial.println("HubInterface::SetLights:: Set SetLightsRGB w/ flash");
     //create a command to set the lights with flash, then put the command into queue
-    char    flash_cmd_payload[12];
-    sprintf(flash_cmd_payload, "%c%02d%02d%02d%02d%02d", LightsNum2Token[whichLights - 1],
-            map(red, 0, 99, 0, _light_amplitude_max), map(green, 0, 99, 0, _light_amplitude_max), map(blue, 0, 99, 0, _light_amplitude_max), period, on);
+    LightShadowState state = {LIGHT_KEYFRAME_RGB, {_light_levels.Scale(red), _light_levels.Scale(green), _light_levels.Scale(blue)}, period, on};
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('H', flash_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        libLog("HubInterface::SetLightsRGB w/ flash enqueuing command");
-        _cmd_queue.push(cmd);
-        return true;
+    size_t len = DlFrameEncoder(cmd.buf, 'H').Letter(LightsNum2Token[whichLights - 1])
+                 .Digits<2>(state.color[0]).Digits<2>(state.color[1]).Digits<2>(state.color[2]).Digits<2>(period).Digits<2>(on).Finish();
+    if (!_lights_change(whichLights, state, len)) {
+        return true; // they already show that
+    }
+    _log->info("HubInterface::SetLightsRGB w/ flash enqueuing command");
+    _stamp_dl_cmd(&cmd);
+    _cmd_queue.push(cmd);
+    return true;
+}
+
+bool HubInterface::_lights_change(unsigned char whichLights, const LightShadowState & state, size_t frameBytes)
+{
+    return _light_shadow.Changes(whichLights, state, frameBytes);
+}
+
+void HubInterface::_forget_lights_of(const dlimsg_t & cmd)
+{
+    char token = cmd.buf[5];
+    if ((token == 'M') || (token == 'I') || (token == 'L') || (token == 'H')) {
+        // the payload starts with the token of the lights, A = 1 ...
+        _light_shadow.Forget(cmd.buf[7] - 'A' + 1);
     }
-    libLog("HubInterface::SetLightsRGB w/ flash finished");
-    return false;
+}
+
+void HubInterface::_lost_cmd(const dlimsg_t & cmd)
+{
+    _forget_lights_of(cmd);
+    if (cmd.flags & DLIMSG_SEQUENCE_SAMPLE) {
+        _sequence_sample = SEQUENCE_SAMPLE_DROPPED; // the audio sequencer moves on
+    }
+}
+
+void HubInterface::ForceLights(unsigned char whichLights)
+{
+    _light_shadow.Forget(whichLights);
+}
+
+void HubInterface::GetLightCommandStats(uint32_t * sent, uint32_t * suppressed, uint32_t * bytesSaved)
+{
+    *sent = _light_shadow.Sent();
+    *suppressed = _light_shadow.Suppressed();
+    *bytesSaved = _light_shadow.BytesSaved();
+}
+
+bool HubInterface::PlayLightAnimation(const LightKeyframe * keyframes, unsigned char numKeyframes, unsigned long loopAfterMs)
+{
+    if ((keyframes == nullptr) || (numKeyframes == 0)) {
+        return false;
+    }
+    _light_animator.Play(keyframes, numKeyframes, loopAfterMs);
+    return true;
+}
+
+bool HubInterface::StopLightAnimation()
+{
+    _light_animator.Stop();
+    return true;
+}
+
+bool HubInterface::LightAnimationPlaying()
+{
+    return _light_animator.Playing();
 }
 /*
                             <<<                             >>>
@@ -257,18 +348,7 @@ bool HubInterface::SetLightsRGB(unsigned char whichLights, unsigned char red, un
 
 unsigned char HubInterface::SetRandomButtonLights(unsigned char numLights, unsigned char yellow, unsigned char blue, unsigned char period, unsigned char on)
 {
-    unsigned char        tgt_light = 0;
-    //add the random lights to tgtLight
-    vector<unsigned char> myvector;
-    myvector.push_back(1);//left
-    myvector.push_back(2);//middle
-    myvector.push_back(4);//right
-
-    random_shuffle ( myvector.begin(), myvector.end() );
-    for (unsigned char cntr = 0; cntr < numLights; cntr++)
-    {
-        tgt_light = tgt_light | myvector[cntr];
-    }
+    unsigned char        tgt_light = _random.Bits(LIGHT_BTNS, numLights);
 
     if (SetLights(tgt_light, yellow, blue, period, on))
         return tgt_light;
@@ -290,7 +370,7 @@ bool HubInterface::SetButtonAudioEnabled(bool buttonAudioEnabled)
 
 bool HubInterface::SetMaxAudioAmplitude(unsigned char max_audio_amplitude)
 {
-    _audio_amplitude_max = max_audio_amplitude;
+    _audio_levels.Build(max_audio_amplitude);
     return true;
 }
 
@@ -302,7 +382,13 @@ bool HubInterface::SetLightEnabled(bool lightEnabled)
 
 bool HubInterface::SetMaxLightAmplitude(unsigned char max_light_amplitude)
 {
-    _light_amplitude_max = max_light_amplitude;
+    _light_levels.Build(max_light_amplitude, _light_levels.Curve());
+    return true;
+}
+
+bool HubInterface::SetLightCurve(unsigned char curve)
+{
+    _light_levels.Build(_light_levels.MaxAmplitude(), curve);
     return true;
 }
 
@@ -338,17 +424,81 @@ bool HubInterface::PlayAudio(unsigned char whichAudio, unsigned char volume)
         return false;
     }
 
+    if (_audio_replay_pending) {
+        // the new sound replaces an old one waiting to be played again
+        _audio_replay_pending = false;
+        _drop_audio(_audio_replay_flags);
+    }
+    return _queue_audio(whichAudio, volume, HubClock::Millis(), 0, 0);
+}
+
+bool HubInterface::_play_sequence_sample(unsigned char whichAudio, unsigned char volume)
+{
+    if (!PlayAudio(whichAudio, volume)) {
+        return false;
+    }
+    _cmd_queue.back().flags |= DLIMSG_SEQUENCE_SAMPLE;
+    _sequence_sample = SEQUENCE_SAMPLE_QUEUED;
+    return true;
+}
+
+void HubInterface::_drop_audio(unsigned char flags)
+{
+    _audio_samples_dropped ++;
+    if (flags & DLIMSG_SEQUENCE_SAMPLE) {
+        _sequence_sample = SEQUENCE_SAMPLE_DROPPED;
+    }
+}
+
+bool HubInterface::_queue_audio(unsigned char whichAudio, unsigned char volume, unsigned long requestedMs, unsigned char replays, unsigned char flags)
+{
     //create a command to play audio, then put the command into queue
-    char    audio_cmd_payload[4];
-    sprintf(audio_cmd_payload, "%d%02d", whichAudio, map(volume, 0, 99, 0, _audio_amplitude_max));
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('P', audio_cmd_payload, &cmd)) //if command creation was successful, add the command to the queue to be sent on later
-    {
-        _cmd_queue.push(cmd);
-        return true;
+    DlFrameEncoder(cmd.buf, 'P').Digits<1>(whichAudio).Digits<2>(_audio_levels.Scale(volume)).Finish();
+    _stamp_dl_cmd(&cmd);
+    cmd.audio_sample = whichAudio;
+    cmd.audio_volume = volume;
+    cmd.audio_replays = replays;
+    cmd.audio_requested_ms = requestedMs;
+    cmd.flags = flags;
+    _cmd_queue.push(cmd);
+    return true;
+}
+
+void HubInterface::_schedule_audio_replay(const dlimsg_t & cmd)
+{
+    unsigned long backoff = (unsigned long)AUDIO_REPLAY_BACKOFF_MS << cmd.audio_replays;
+    if ((cmd.audio_replays >= MAX_AUDIO_REPLAYS)
+            || (HubClock::Millis() - cmd.audio_requested_ms + backoff > _audio_replay_window)) {
+        _log->error("HubInterface::_schedule_audio_replay audio %u dropped after %u replays", cmd.audio_sample, cmd.audio_replays);
+        _drop_audio(cmd.flags);
+        return;
+    }
+    if (_audio_replay_pending) {
+        _drop_audio(_audio_replay_flags); // keep the newer one
+    }
+    _audio_replay_sample = cmd.audio_sample;
+    _audio_replay_volume = cmd.audio_volume;
+    _audio_replay_count = cmd.audio_replays + 1;
+    _audio_replay_requested_ms = cmd.audio_requested_ms;
+    _audio_replay_rejected_ms = HubClock::Millis();
+    _audio_replay_backoff_ms = backoff;
+    _audio_replay_flags = cmd.flags;
+    _audio_replay_pending = true;
+}
+
+void HubInterface::_run_audio_replay()
+{
+    if (!_audio_replay_pending || (HubClock::Millis() - _audio_replay_rejected_ms < _audio_replay_backoff_ms)) {
+        return;
     }
-    libLog.error("HubInterface::PlayAudio ERROR: could not push command");
-    return false;
+    _audio_replay_pending = false;
+    if (!_audio_enabled) {
+        _drop_audio(_audio_replay_flags);
+        return;
+    }
+    _audio_replays ++;
+    _queue_audio(_audio_replay_sample, _audio_replay_volume, _audio_replay_requested_ms, _audio_replay_count, _audio_replay_flags);
 }
 
 /*
@@ -382,20 +532,51 @@ bool HubInterface::PlayTone(unsigned int frequecy, unsigned char volume, unsigne
         return false;
     }
 
-    //create a command to set the lights with flash, then put the command into queue
-    char    tone_cmd_payload[9];
-    sprintf(tone_cmd_payload, "%02d%05d%1d", map(volume, 0, 99, 0, _audio_amplitude_max), frequecy, slew);
+    //create a command to play the tone, then put the command into queue
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('Q', tone_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        //char msg[64];
-        //sprintf(msg,"HubInterface::PlayTone Length of Queue %d",_cmd_queue.size());
-        //Serial.println(msg);
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog.error("HubInterface::PlayTone ERROR: could not push command");
-    return false;
+    DlFrameEncoder(cmd.buf, 'Q').Digits<2>(_audio_levels.Scale(volume)).Digits<5>(frequecy).Digits<1>(slew).Finish();
+    _stamp_dl_cmd(&cmd);
+    //char msg[64];
+    //sprintf(msg,"HubInterface::PlayTone Length of Queue %d",_cmd_queue.size());
+    //Serial.println(msg);
+    _cmd_queue.push(cmd);
+    return true;
+}
+
+bool HubInterface::PlayAudioSequence(const AudioStep * steps, unsigned char numSteps)
+{
+    _audio_sequencer.Play(steps, numSteps);
+    return true;
+}
+
+void HubInterface::StopAudioSequence()
+{
+    _audio_sequencer.Stop(*this);
+}
+
+bool HubInterface::AudioSequencePlaying()
+{
+    return _audio_sequencer.Playing();
+}
+
+bool HubInterface::AudioPlaying()
+{
+    return _audio_playing;
+}
+
+uint32_t HubInterface::AudioSamplesStarted()
+{
+    return _audio_samples_started;
+}
+
+uint32_t HubInterface::AudioReplays()
+{
+    return _audio_replays;
+}
+
+uint32_t HubInterface::AudioSamplesDropped()
+{
+    return _audio_samples_dropped;
 }
 
 
@@ -422,29 +603,20 @@ bool HubInterface::PlayTone(unsigned int frequecy, unsigned char volume, unsigne
 bool HubInterface::PresentFoodtreat(unsigned char duration_decisec)
 {
     //create a command to present a foodtreat (duration in deciseconds 00-99), then put the command into queue
-    char    foodtreat_cmd_payload[2];
-    sprintf(foodtreat_cmd_payload, "%02d", duration_decisec);
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('T', foodtreat_cmd_payload, &cmd)) //if command creation was successfull, add the command to the queue to be sent on later
-    {
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog("HubInterface::PresenFoodtreat finished");
-    return false;
+    DlFrameEncoder(cmd.buf, 'T').Digits<2>(duration_decisec).Finish();
+    _stamp_dl_cmd(&cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 bool HubInterface::RetractTray()
 {
     //create a command to retract the tray
     dlimsg_t cmd;
-    if (_create_dl_cmd_with('X', "00", &cmd))
-    {
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog("HubInterface::RetractTray finished");
-    return false;
+    _create_dl_cmd_from(DL_FRAME_RETRACT_TRAY, &cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
@@ -455,10 +627,10 @@ unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
 
     if ((_foodmachine_state == FOODMACHINE_LID_OPEN) || //lid open
             (_foodmachine_state > FOODMACHINE_WAIT) ) { //some sort of error
-        libLog("HubInterface::PresentAndCheckFoodtreat failed. lid open OR _foodmachine_state > FOODMACHINE_WAIT");
+        _log->info("HubInterface::PresentAndCheckFoodtreat failed. lid open OR _foodmachine_state > FOODMACHINE_WAIT");
 
         if (_need_foodtreat_reset == true) {
-            libLog("resetting foodmachine from HubInterface::PresentAndCheckFoodtreat");
+            _log->info("resetting foodmachine from HubInterface::PresentAndCheckFoodtreat");
             ResetFoodMachine();
             _need_foodtreat_reset = false;
         }
@@ -471,26 +643,26 @@ unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
 
         if (_foodmachine_state == FOODMACHINE_IDLE) {
             unsigned char duration_decisec = _milliseconds_to_deciseconds_for_DL_T(duration_ms);
-            libLog("HubInterface::PresentAndCheckFoodtreat: PACT_BEFORE_PRESENT duration_decisec: %u", duration_decisec);
+            _log->info("HubInterface::PresentAndCheckFoodtreat: PACT_BEFORE_PRESENT duration_decisec: %u", duration_decisec);
 
             if (duration_decisec >= 99){
                 if (PresentFoodtreat(0)) { //this will present tray indefinitely
-                    libLog("HubInterface::PresentAndCheckFoodtreat: PACT_BEFORE_PRESENT presenting foodtreat INDEFINITELY ");
+                    _log->info("HubInterface::PresentAndCheckFoodtreat: PACT_BEFORE_PRESENT presenting foodtreat INDEFINITELY ");
                     _indefinite_tray_presentation = true;
-                    _foodtreat_presented_time = millis();
+                    _foodtreat_presented_time = HubClock::Millis();
                     _pact_foodtreat_state = PACT_PLATTER_OUT;
                 }
                 else {
-                    libLog("HubInterface::PresentAndCheckFoodtreat PresentFoodtreat(0) returned false");
+                    _log->info("HubInterface::PresentAndCheckFoodtreat PresentFoodtreat(0) returned false");
                 }
             }
             else{
                 if (PresentFoodtreat(duration_decisec)) {
-                    _foodtreat_presented_time = millis();
+                    _foodtreat_presented_time = HubClock::Millis();
                     _pact_foodtreat_state = PACT_PLATTER_OUT;
                 }
                 else {
-                    libLog("HubInterface::PresentAndCheckFoodtreat PresentFoodtreat(duration_decisec) returned false");
+                    _log->info("HubInterface::PresentAndCheckFoodtreat PresentFoodtreat(duration_decisec) returned false");
                 }
             }
         }
@@ -520,20 +692,20 @@ unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
             //in a foodmachine state after the foodtreat has been checked for and updated by DL
             _foodtreat_retracted_time = 0;
             _want_tray_closed = false;
-            _pact_platter_return_time = millis();
+            _pact_platter_return_time = HubClock::Millis();
             _pact_foodtreat_state = PACT_WAIT_DIAG;
             return _pact_foodtreat_state;
         }
 
         if (_indefinite_tray_presentation == true){
-            if ((_want_tray_closed) || ((millis()-_foodtreat_presented_time) > duration_ms)){
+            if ((_want_tray_closed) || ((HubClock::Millis()-_foodtreat_presented_time) > duration_ms)){
                 if (RetractTray()){
-                    _foodtreat_retracted_time = millis();
+                    _foodtreat_retracted_time = HubClock::Millis();
                     _indefinite_tray_presentation = false;
-                    libLog("HubInterface::PresentAndCheckFoodtreat retracting tray");
+                    _log->info("HubInterface::PresentAndCheckFoodtreat retracting tray");
                 }
                 else{
-                    libLog.error("HubInterface::PresentAndCheckFoodtreat ERROR retracting tray");
+                    _log->error("HubInterface::PresentAndCheckFoodtreat ERROR retracting tray");
                 }
             }
         }
@@ -548,8 +720,8 @@ unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
                 return _pact_foodtreat_state;
             }
             else{
-                if ((_foodtreat_retracted_time != 0)&&((millis()-_foodtreat_retracted_time) > 500)) { // 500 allows some slop in DL communication before raising error
-                    libLog.error("HubInterface::PresentAndCheckFoodtreat ERROR - Tray should be on its way back by now!!");
+                if ((_foodtreat_retracted_time != 0)&&((HubClock::Millis()-_foodtreat_retracted_time) > 500)) { // 500 allows some slop in DL communication before raising error
+                    _log->error("HubInterface::PresentAndCheckFoodtreat ERROR - Tray should be on its way back by now!!");
                 }
             }
         }
@@ -572,7 +744,7 @@ unsigned char HubInterface::PresentAndCheckFoodtreat(unsigned long duration_ms)
         }
         break;
     default:
-        libLog("HubInterface::PresentAndCheckFoodtreat got to default: VERY BAD");
+        _log->info("HubInterface::PresentAndCheckFoodtreat got to default: VERY BAD");
         return _pact_foodtreat_state;
         break;
     }
@@ -667,29 +839,48 @@ bool HubInterface::SetDoPollButtons(bool buttonPollingEnable) {
 bool HubInterface::_poll_buttons()
 {
     dlimsg_t cmd;
-    //if command creation was successfull, add the command to the queue to be sent on later
-    if (_create_dl_cmd_with('B', "", &cmd))
-    {
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog("HubInterface::_poll_buttons finished");
-    return false;
+    _create_dl_cmd_from(DL_FRAME_POLL_BUTTONS, &cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 int HubInterface::GetButtonVal(unsigned char whichButton){
-    if (whichButton == BUTTON_LEFT){
-        return ((int)_left_baseline) - ((int)_left_read);
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if (whichButton == (1 << pad)) {
+            return ((int)_pad_baseline[pad]) - ((int)_pad_read[pad]);
+        }
     }
-    if (whichButton == BUTTON_MIDDLE){
-        return ((int)_midd_baseline) - ((int)_midd_read);
+    return -1;
+}
+
+bool HubInterface::GetBaselineDrift(unsigned char whichButton, float * mean, float * stddev)
+{
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if ((whichButton == (1 << pad)) && _drift[pad].Ready()) {
+            *mean = _drift[pad].Mean();
+            *stddev = _drift[pad].StdDev();
+            return true;
+        }
     }
-    if (whichButton == BUTTON_RIGHT){
-        return ((int)_right_baseline) - ((int)_right_read);
+    return false;
+}
+
+int HubInterface::GetButtonThreshold(unsigned char whichButton)
+{
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if (whichButton == (1 << pad)) {
+            return _pad_threshold[pad];
+        }
     }
     return -1;
 }
 
+void HubInterface::_set_pad_threshold(unsigned char pad, int threshold)
+{
+    _pad_threshold[pad] = threshold;
+    _pad_release_threshold[pad] = (int)(threshold * _csf_hysteresis);
+}
+
 /*
                             <<<                             >>>
                             <<<       Check Any Buttons     >>>
@@ -710,94 +901,78 @@ int HubInterface::GetButtonVal(unsigned char whichButton){
                 |           True if button pressed, False otherwise     |
             <<</PARAMS>>>
 */
-bool HubInterface::_update_button_pressed_state(unsigned char left, unsigned char middle, unsigned char right)
-{
-    // Serial.println("HubInterface::_update_button_pressed_state::entering");
-    // Serial.println("L M R incoming");
-    // Serial.println(left);
-    // Serial.println(middle);
-    // Serial.println(right);
-
-    // Serial.println("L M R button_state");
-    // Serial.println(_l_button_state);
-    // Serial.println(_m_button_state);
-    // Serial.println(_r_button_state);
-
-    if (left) {
-        _l_button_timeout = millis() + _button_liftoff_ms;
-        if (_l_button_state == false) {
-            _l_button_state = true;
-            if (_button_audio_enabled == true) {
-                PlayAudio(AUDIO_L, _button_audio_amplitude);
-            }
-        }
-    }
-    else {
-        if (millis() > _l_button_timeout) {
-            _l_button_state = false;
-        }
-    }
+bool HubInterface::_update_button_pressed_state(unsigned char pressed)
+{
+    static const unsigned char pad_audio[NUM_PADS] = {AUDIO_L, AUDIO_M, AUDIO_R};
+    unsigned long now = HubClock::Millis();
+    unsigned char lifted = 0; // pads not touched for longer than the liftoff window
 
-    if (middle) {
-        _m_button_timeout = millis() + _button_liftoff_ms;
-        if (_m_button_state == false) {
-            _m_button_state = true;
-            if (_button_audio_enabled == true) {
-                PlayAudio(AUDIO_M, _button_audio_amplitude);
-            }
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if (pressed & (1 << pad)) {
+            _pad_liftoff_end[pad] = now + _button_liftoff_ms;
         }
-    }
-    else {
-        if (millis() > _m_button_timeout) {
-            _m_button_state = false;
+        else if ((int32_t)(now - _pad_liftoff_end[pad]) > 0) { // also across the millis() wrap
+            lifted |= (1 << pad);
         }
     }
 
-    if (right) {
-        _r_button_timeout = millis() + _button_liftoff_ms;
-        if (_r_button_state == false) {
-            _r_button_state = true;
-            if (_button_audio_enabled == true) {
-                PlayAudio(AUDIO_R, _button_audio_amplitude);
+    unsigned char new_touches = pressed & ~_pads_pressed;
+    _pads_pressed = (_pads_pressed | pressed) & ~lifted;
+    _gestures.Update(_pads_pressed, now);
+
+    if (new_touches && _button_audio_enabled) {
+        for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+            if (new_touches & (1 << pad)) {
+                PlayAudio(pad_audio[pad], _button_audio_amplitude);
             }
         }
     }
-    else {
-        if (millis() > _r_button_timeout) {
-            _r_button_state = false;
-        }
-    }
     return true;
 }
 
 
 unsigned char HubInterface::AnyButtonPressed()
 {
-    unsigned char pressed            = 0;
+    return _pads_pressed;
+}
+
+RandomSource & HubInterface::Random()
+{
+    return _random;
+}
 
-    pressed = _l_button_state ? pressed | BUTTON_LEFT   : pressed;
-    pressed = _m_button_state ? pressed | BUTTON_MIDDLE : pressed;
-    pressed = _r_button_state ? pressed | BUTTON_RIGHT  : pressed;
+void HubInterface::SeedRandom(uint32_t seed)
+{
+    _random.Seed(seed);
+}
 
-    // Serial.println("dli::AnyButtonPressed finished");
-    // Serial.println(pressed);
-    return pressed;
+bool HubInterface::NextGesture(TouchGesture * gesture)
+{
+    return _gestures.Next(gesture);
+}
+
+void HubInterface::ClearGestures()
+{
+    _gestures.Clear();
+}
+
+void HubInterface::SetGestureTimings(unsigned long holdMs, unsigned long doubleTapMs, unsigned long chordMs, unsigned long slideMs)
+{
+    _gestures.SetTimings(holdMs, doubleTapMs, chordMs, slideMs);
 }
 
 unsigned char HubInterface::AnyButtonSupraThresholdInWindow(unsigned long sinceWhen)
 {
     unsigned char pressed            = 0;
-    unsigned long   now             = millis();
+    unsigned long   now             = HubClock::Millis();
     unsigned long   window_start    = now > sinceWhen ? now - sinceWhen : 0;
     //for each button if it was suprathreshold within time window
     if (window_start > 0)
     {
-        pressed = window_start <= _time_left_button_pressed    ? pressed | BUTTON_LEFT   : pressed;
-        pressed = window_start <= _time_middle_button_pressed  ? pressed | BUTTON_MIDDLE : pressed;
-        pressed = window_start <= _time_right_button_pressed   ? pressed | BUTTON_RIGHT  : pressed;
+        for (unsigned char pad = 0; pad < NUM_PADS; pad++)
+            if (window_start <= _time_pad_pressed[pad])
+                pressed |= (1 << pad);
     }
-    // Serial.println("dli::AnyButtonSupraThresholdInWindow finished");
-    // Serial.println(pressed);
     return pressed;
 }
 
@@ -826,131 +1001,161 @@ unsigned char HubInterface::AnyButtonSupraThresholdInWindow(unsigned long sinceW
 */
 bool HubInterface::IsButtonPressed(unsigned char whichButton)
 {
-    unsigned char pressed            = false;
-
-    //for each button if it was pressed within time window
-    if ( (whichButton & BUTTON_LEFT) == BUTTON_LEFT)
-        pressed = pressed || _l_button_state;
-    if ( (whichButton & BUTTON_MIDDLE) == BUTTON_MIDDLE)
-        pressed = pressed || _m_button_state;
-    if ( (whichButton & BUTTON_RIGHT) == BUTTON_RIGHT)
-        pressed = pressed || _r_button_state;
-
-    libLog("HubInterface::IsButtonPressed finished");
-
-    // char    buff[8];
-    // sprintf(buff, "prsd?%d", pressed);
-    // Serial.println(buff);
-    return pressed;
+    _log->info("HubInterface::IsButtonPressed finished");
+    return (_pads_pressed & whichButton) != 0;
 }
 
 bool HubInterface::WasButtonSupraThresholdInWindow(unsigned char whichButton, unsigned long sinceWhen)
 {
     unsigned char pressed            = false;
-    unsigned long   now             = millis();
+    unsigned long   now             = HubClock::Millis();
     unsigned long   window_start    = now > sinceWhen ? now - sinceWhen : 0;
     //for each button if it was suprathreshold within time window
-    if ( (whichButton & BUTTON_LEFT) == BUTTON_LEFT)
-        pressed = pressed || (window_start <= _time_left_button_pressed) ;
-    if ( (whichButton & BUTTON_MIDDLE) == BUTTON_MIDDLE)
-        pressed = pressed || (window_start <= _time_middle_button_pressed) ;
-    if ( (whichButton & BUTTON_RIGHT) == BUTTON_RIGHT)
-        pressed = pressed || (window_start <= _time_right_button_pressed) ;
-    libLog("HubInterface::WasButtonSupraThresholdInWindow finished");
-    // char    buff[8];
-    // sprintf(buff, "prsd?%d", pressed);
-    // Serial.println(buff);
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++)
+        if (whichButton & (1 << pad))
+            pressed = pressed || (window_start <= _time_pad_pressed[pad]);
+    _log->info("HubInterface::WasButtonSupraThresholdInWindow finished");
     return pressed;
 }
 
-void HubInterface::_update_cap_reset(int left, int middle, int right) {
+/*
+                            <<<                             >>>
+                            <<<       Reaction timer        >>>
+                            <<<                             >>>
+
 
-    if (_csf_needs_DI_reset == true) {
-        libLog("dli::_update_cap_reset: DI NEEDS RESET");
-        return; //wait until DI gets reset
+            <<<GOAL>>>
+                |   Times a reaction from the DL acknowledging the cue  |
+                |   lights to the first button poll that saw a touch.   |
+                |   The cue was shown between transmitting its command  |
+                |   and receiving the reply, the touch happened between |
+                |   the last poll that did not see it and the reply of  |
+                |   the poll that did, so the reaction time is known    |
+                |   to be in a range instead of depending on when the   |
+                |   game called SetLights and checked the buttons.      |
+            <<</GOAL>>>
+
+
+            <<<PARAMS>>>
+                |   INPUT:                                              |
+                |    whichButtons : touchpads to wait for               |
+                |   RETURN:                                             |
+                |           True                                        |
+            <<</PARAMS>>>
+*/
+bool HubInterface::StartReactionTimer(unsigned char whichButtons)
+{
+    _reaction_buttons = whichButtons;
+    _reaction_cue_shown = false;
+    _reaction_pressed = false;
+
+    unsigned char token = _cmd_queue.empty() ? 0 : _cmd_queue.back().buf[5];
+    if ((token == 'M') || (token == 'I') || (token == 'L') || (token == 'H')) {
+        _cmd_queue.back().flags |= DLIMSG_REACTION_CUE;
     }
+    else {
+        _reaction_cue_earliest_ms = HubClock::Millis();
+        _reaction_cue_latest_ms = _reaction_cue_earliest_ms;
+        _reaction_cue_shown = true;
+    }
+    _reaction_press_earliest_ms = _reaction_cue_earliest_ms;
+    return true;
+}
 
-    // Serial.printlnf("LEFT:\tV: %d\tD: %d\tT: %lu\t\tMIDDLE:\tV: %d\tD: %d\tT: %lu\t\tRIGHT:\tV: %d\tD: %d\tT: %lu",
-    //     left,_csf_detect_integration_left,millis()-_csf_timer_max_left,
-    //     middle,_csf_detect_integration_middle,millis()-_csf_timer_max_middle,
-    //     right,_csf_detect_integration_right,millis()-_csf_timer_max_right
-    //     );
+bool HubInterface::GetReactionTime(unsigned long * reactionMs, unsigned long * errorMs)
+{
+    if (!_reaction_pressed) {
+        return false;
+    }
+    // signed differences, so it works across the millis() wrap
+    int32_t shortest = (int32_t)(_reaction_press_earliest_ms - _reaction_cue_latest_ms);
+    int32_t longest = (int32_t)(_reaction_press_latest_ms - _reaction_cue_earliest_ms);
+    if (shortest < 0) {
+        shortest = 0; // a touch that was already there before the cue counts as 0 ms
+    }
+    *reactionMs = shortest + (longest - shortest) / 2;
+    *errorMs = longest - *reactionMs;
+    return true;
+}
 
+void HubInterface::StopReactionTimer()
+{
+    _reaction_buttons = 0;
+}
 
-//DO LEFT
-    if (_csf_detect_integration_left >= _csf_integration_thresh) {
-        if (left >  (int)(LEFT_THRESHOLD * _csf_hysteresis)) {
-            // Serial.printlnf("Tval: %d  bool: %d",(int)(LEFT_THRESHOLD * _csf_hysteresis),(left >  (int)(LEFT_THRESHOLD * _csf_hysteresis)));
-            if ((millis() - _csf_timer_max_left) > _csf_max_on_duration) {
-                libLog("dli::_update_cap_reset: DI RESET NEEDED: LEFT");
-                _csf_needs_DI_reset = true;
-                _csf_detect_integration_left = 0;
-                _csf_timer_max_left = millis();
-                return;
-            }
-        }
-        else {
-            _csf_detect_integration_left = 0;
-            _csf_timer_max_left = millis();
-        }
+void HubInterface::_update_reaction_timer(unsigned char pressed)
+{
+    if ((_reaction_buttons == 0) || !_reaction_cue_shown || _reaction_pressed) {
+        return;
     }
-    else if (left > LEFT_THRESHOLD) {
-        _csf_detect_integration_left++;
+    if (pressed & _reaction_buttons) {
+        _reaction_press_latest_ms = _reply_received_ms;
+        _reaction_pressed = true;
     }
     else {
-        _csf_detect_integration_left = 0;
-        _csf_timer_max_left = millis();
-    }
-//DO MIDDLE
-    if (_csf_detect_integration_middle >= _csf_integration_thresh) {
-        if (middle >  (int)(MIDDLE_THRESHOLD * _csf_hysteresis)) {
-            if ((millis() - _csf_timer_max_middle) > _csf_max_on_duration) {
-                libLog("dli::_update_cap_reset: DI RESET NEEDED: MIDDLE");
-                _csf_needs_DI_reset = true;
-                _csf_detect_integration_middle = 0;
-                _csf_timer_max_middle = millis();
-                return;
-            }
-        }
-        else {
-            _csf_detect_integration_middle = 0;
-            _csf_timer_max_middle = millis();
+        // not touched yet when this poll was sampled, after it was sent
+        _reaction_press_earliest_ms = _cmd_sent_ms;
+    }
+}
+
+void HubInterface::_update_pad_touches(unsigned char pressed)
+{
+    //update the time of button press if any detected
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if (pressed & (1 << pad)) {
+            _time_pad_pressed[pad] = HubClock::Millis();
         }
     }
-    else if (middle > MIDDLE_THRESHOLD) {
-        _csf_detect_integration_middle++;
+    _update_reaction_timer(pressed);
+    _update_button_pressed_state(pressed);
+}
+
+void HubInterface::_update_cap_reset() {
+
+    if (_csf_needs_DI_reset == true) {
+        _log->info("dli::_update_cap_reset: DI NEEDS RESET");
+        return; //wait until DI gets reset
     }
-    else {
-        _csf_detect_integration_middle = 0;
-        _csf_timer_max_middle = millis();
-    }
-//DO RIGHT
-    if (_csf_detect_integration_right >= _csf_integration_thresh) {
-        if (right >  (int)(RIGHT_THRESHOLD * _csf_hysteresis)) {
-            if ((millis() - _csf_timer_max_right) > _csf_max_on_duration) {
-                libLog("dli::_update_cap_reset: DI RESET NEEDED: RIGHT");
-                _csf_needs_DI_reset = true;
-                _csf_detect_integration_right = 0;
-                _csf_timer_max_right = millis();
-                return;
-            }
-        }
-        else {
-            _csf_detect_integration_right = 0;
-            _csf_timer_max_right = millis();
+
+    // one bit per pad for each condition, then all pads are handled by the same mask operations
+    unsigned long now = HubClock::Millis();
+    unsigned char above = 0; // above the touch threshold
+    unsigned char above_release = 0; // above the release threshold (hysteresis)
+    unsigned char latched = 0; // was above the touch threshold for _csf_integration_thresh polls
+    unsigned char held_too_long = 0; // above threshold for longer than _csf_max_on_duration
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        unsigned char bit = 1 << pad;
+        int value = ((int)_pad_baseline[pad]) - ((int)_pad_read[pad]);
+        above |= (value > _pad_threshold[pad]) ? bit : 0;
+        above_release |= (value > _pad_release_threshold[pad]) ? bit : 0;
+        latched |= (_csf_detect_integration[pad] >= _csf_integration_thresh) ? bit : 0;
+        held_too_long |= ((now - _csf_timer_max[pad]) > _csf_max_on_duration) ? bit : 0;
+        if ((value <= _pad_threshold[pad]) && !(_pads_pressed & bit)) {
+            _drift[pad].Add(value); // touches are not drift
         }
     }
-    else if (right > RIGHT_THRESHOLD) {
-        _csf_detect_integration_right++;
-    }
-    else {
-        _csf_detect_integration_right = 0;
-        _csf_timer_max_right = millis();
+
+    unsigned char stuck = latched & above_release & held_too_long;
+    unsigned char counting = ~latched & above;
+    unsigned char restart = (latched & ~above_release) | (~latched & ~above) | stuck;
+
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        if (counting & (1 << pad)) {
+            _csf_detect_integration[pad]++;
+        }
+        else if (restart & (1 << pad)) {
+            _csf_detect_integration[pad] = 0;
+            _csf_timer_max[pad] = now;
+        }
     }
 
-    return;
+    if (stuck) {
+        _log->info("dli::_update_cap_reset: DI RESET NEEDED: pads %u", stuck);
+        _csf_needs_DI_reset = true;
+    }
 }
 
+
 bool HubInterface::SetFoodTreatDetectThresh(int foodtreat_detect_threshold)
 {
     // this function optionally overrides the default value of foodtreat_detect_threshold
@@ -968,7 +1173,7 @@ bool HubInterface::SetFoodTreatDetectThresh(int foodtreat_detect_threshold)
         SetConfigValue(20, foodtreat_detect_threshold);   
         ResetDI();
     }
-    libLog("HubInterface::SetFoodTreatDetectThresh finished");
+    _log->info("HubInterface::SetFoodTreatDetectThresh finished");
 
     return true;
 }
@@ -986,18 +1191,21 @@ bool HubInterface::SetDLInitValues(int left, int middle, int right, int tray_spe
 
     //WARNING: THIS WILL RESET THE DI BOARD - make sure you're not using it! Button Lights, etc.
     if ((left > 255) || (middle > 255) || (right > 255)) {
-        libLog("HubInterface::SetDLInitValues threshold values must be between 0-255");
+        _log->info("HubInterface::SetDLInitValues threshold values must be between 0-255");
         return false;
     }
 
     if (tray_speed > 16) {
-        libLog("HubInterface::SetDLInitValues tray_speed must be between 0-16");
+        _log->info("HubInterface::SetDLInitValues tray_speed must be between 0-16");
         return false;
     }
 
     SetConfigValue(21, left);
     SetConfigValue(22, middle);
     SetConfigValue(23, right);
+    _set_pad_threshold(0, left);
+    _set_pad_threshold(1, middle);
+    _set_pad_threshold(2, right);
     SetConfigValue(11, tray_speed * PLATTER_MOTOR_MAX_DUTY_CYCLE / PLATTER_MOTOR_MAX_PWM_COUNTER);
     SetConfigValue(8, tray_current_threshold);
     SetConfigValue(18, foodtreat_tx_power_level);
@@ -1006,7 +1214,7 @@ bool HubInterface::SetDLInitValues(int left, int middle, int right, int tray_spe
 
     ResetDI();
 
-    libLog("HubInterface::SetDLInitValues finished");
+    _log->info("HubInterface::SetDLInitValues finished");
 
     return true;
 }
@@ -1033,7 +1241,7 @@ bool HubInterface::GetConfigValue(unsigned char configID)
         _cmd_queue.push(cmd);
         return true;
     }
-    libLog.error("HubInterface::GetConfigValue ERROR: could not push command");
+    _log->error("HubInterface::GetConfigValue ERROR: could not push command");
     return false;
 }
 
@@ -1048,7 +1256,7 @@ bool HubInterface::SetConfigValue(unsigned char configID, int value)
         _cmd_queue.push(cmd);
         return true;
     }
-    libLog.error("HubInterface::SetConfigValue ERROR: could not push command");
+    _log->error("HubInterface::SetConfigValue ERROR: could not push command");
     return false;
 }
 //
@@ -1066,37 +1274,28 @@ bool HubInterface::ResetDI()
 {
     bool reset_was_sent = false;
     if (_csf_DI_reset_locked == false) {
-        libLog("HubInterface::ResetDI Resetting DI");
+        _log->info("HubInterface::ResetDI Resetting DI");
         dlimsg_t cmd;
-        //if command creation was successfull, add the command to the queue to be sent on later
-        if (_create_dl_cmd_with('K', "", &cmd))
-        {
-            _cmd_queue.push(cmd);
-            reset_was_sent = true;
-            _dl_is_ready = false;
-        }
+        _create_dl_cmd_from(DL_FRAME_RESET_DI, &cmd);
+        _cmd_queue.push(cmd);
+        reset_was_sent = true;
+        _dl_is_ready = false;
     }
     else {
         // Serial.println("HubInterface::ResetDI - NOT resetting DI - LOCKED");
     }
-    libLog("HubInterface::ResetDI finished");
+    _log->info("HubInterface::ResetDI finished");
     return reset_was_sent;
 }
 
 bool HubInterface::ResetFoodMachine()
 {
     dlimsg_t cmd;
-
-    //if command creation was successfull, add the command to the queue to be sent on later
-    if (_create_dl_cmd_with('F', "", &cmd))
-    {
-        _cmd_queue.push(cmd);
-        libLog("HubInterface::ResetFoodMachine sent command to DL");
-        _need_foodtreat_reset = false;
-        return true;
-    }
-    libLog("HubInterface::ResetFoodMachine was unable to send command");
-    return false;
+    _create_dl_cmd_from(DL_FRAME_RESET_FOOD_MACHINE, &cmd);
+    _cmd_queue.push(cmd);
+    _log->info("HubInterface::ResetFoodMachine sent command to DL");
+    _need_foodtreat_reset = false;
+    return true;
 }
 
 unsigned char HubInterface::FoodmachineState()
@@ -1132,10 +1331,25 @@ int HubInterface::GetDomeOpen()
 
 bool HubInterface::IsDomeRemoved()
 {
-    libLog("HubInterface::IsDomeRemoved finished");
+    _log->info("HubInterface::IsDomeRemoved finished");
     return _dome_open;
 }
 
+void HubInterface::SetDeviceLayerLink(Stream * link)
+{
+    _dl_link = link;
+}
+
+void HubInterface::SetLogger(const Logger & log)
+{
+    _log = &log;
+}
+
+const Logger & HubInterface::Log() const
+{
+    return *_log;
+}
+
 /*
                             <<<                             >>>
                             <<<         poll DL state       >>>
@@ -1167,14 +1381,9 @@ bool HubInterface::SetDoPollDiagnostics(bool diagPollingEnable) {
 bool HubInterface::_poll_diag()
 {
     dlimsg_t cmd;
-    //if command creation was successfull, add the command to the queue to be sent on later
-    if (_create_dl_cmd_with('Z', "00", &cmd))
-    {
-        _cmd_queue.push(cmd);
-        return true;
-    }
-    libLog("HubInterface::_poll_diag finished");
-    return false;
+    _create_dl_cmd_from(DL_FRAME_POLL_DIAG, &cmd);
+    _cmd_queue.push(cmd);
+    return true;
 }
 
 
@@ -1208,8 +1417,8 @@ bool HubInterface::_transmit_cmd(dlimsg_t *cmd)
     //len_sent    =   Serial1.write(cmd,strlen(cmd));
     // Serial.println("HubInterface::_transmit_cmd:: sending message:");
     //Serial.println(cmd);
-    len_sent    =   Serial1.write((*cmd).buf);
-    Serial1.flush();
+    len_sent    =   _dl_link->write((*cmd).buf);
+    _dl_link->flush();
     // Serial.printlnf("Sent DL %d unsigned chars of cmd: %s",len_sent,(*cmd).buf);
     // Serial.println("HubInterface::_send_cmd finished");
     // Serial.println("dli _send_cmd sent unsigned chars:");
@@ -1248,17 +1457,17 @@ bool HubInterface::_receive_cmd(dlimsg_t *cmd)
     // Serial.println(_len_reply_buffer);
     // Serial.println("send message queue length is");
     // Serial.println(_cmd_queue.size());
-    while (Serial1.available() > 0)
+    while (_dl_link->available() > 0)
     {
         if (_len_reply_buffer >= MAX_LEN_REPLY_BUFFER - 1)
         {
             _error_code     = ERROR_CMD_RECEIVED_TOO_LONG;
-            libLog("dli::_receive_cmd received msg exceeds buffer length");
+            _log->info("dli::_receive_cmd received msg exceeds buffer length");
             return false;
         }
         // Serial.println("In receive cmd: data available, current buff size:");
         // Serial.println(_len_reply_buffer);
-        _reply_buffer[_len_reply_buffer] = Serial1.read();
+        _reply_buffer[_len_reply_buffer] = _dl_link->read();
         // Serial.println(_reply_buffer[_len_reply_buffer]);
         _len_reply_buffer ++;
         if ( _reply_buffer[_len_reply_buffer - 1] == '.')
@@ -1308,14 +1517,21 @@ bool HubInterface::_send_top_cmd()
         cmd = _cmd_queue.front();
         // Serial.println("dli sending cmd");
         // Serial.println(cmd);
+        if (_num_send_retries == 0) //the DL may act on any transmission, keep the first one
+        {
+            _cmd_sent_ms = HubClock::Millis();
+        }
         if (_transmit_cmd(&cmd)) //if successfully transmitted the command, remove it from the queue
         {
             //Serial.println("sending cmd, going to before rcv");
             rslt = true;
+            _link_cmds_sent ++;
+            if (_num_send_retries > 0)
+                _link_retries ++;
         }
         else
         {
-            libLog.error("dli error sending top cmd failed");
+            _log->error("dli error sending top cmd failed");
             rslt = false;
             _num_send_retries ++;
         }
@@ -1336,23 +1552,26 @@ bool HubInterface::_initialize() {
     case DLINIT_WAIT_BOOT:
     {
         _dl_is_ready = false;
-        if (millis() > _wait_dl_boot_ms) {
+        if (HubClock::Millis() > _wait_dl_boot_ms) {
             _init_dl_state = DLINIT_SEND;
         }
         break;
     }
     case DLINIT_SEND:
     {
+        // the shadow follows what was queued, not what the device layer did: after a
+        // (re)boot it may still hold the lights as off and drop this first command
+        _light_shadow.Forget(LIGHT_ALL);
         SetLights(LIGHT_ALL, 0, 0, 0);
         PlayTone(1000, 0, 2);
         RetractTray();
-        _init_dl_start = millis();
+        _init_dl_start = HubClock::Millis();
         _init_dl_state = DLINIT_PROCESS;
         break;
     }
     case DLINIT_PROCESS:
     {
-        if (millis() > (_init_dl_start + _init_dl_process_ms)) {
+        if (HubClock::Millis() > (_init_dl_start + _init_dl_process_ms)) {
             _init_dl_state = DLINIT_WAIT_BOOT;
             _dl_is_ready = true;
         }
@@ -1371,7 +1590,7 @@ bool HubInterface::_process_DL() {
         if (_send_top_cmd())
         {
             _run_loop_state     = STATE_AFTER_SEND_BEFORE_RCV; // change state to before rcv reply from DL
-            _start_listen       = millis();
+            _start_listen       = HubClock::Millis();
             _len_reply_buffer   = 0;
         }
     }
@@ -1381,15 +1600,17 @@ bool HubInterface::_process_DL() {
         //_receive_cmd returns true only if memory allocated to reply
         if (_receive_cmd(&reply)) //if a full reply received from DL, enqueue it for further processing
         {
+            _reply_received_ms = HubClock::Millis();
             _dl_reply_queue.push(reply);
             _run_loop_state = STATE_AFTER_RCV_BEFORE_PROCESS;
             // Serial.println("dli response received");
             // Serial.println(reply);
         }
-        else if ((millis() - _start_listen) > _max_listen_time) // if listen timed out, go back to sending
+        else if ((HubClock::Millis() - _start_listen) > _max_listen_time) // if listen timed out, go back to sending
         {
-            libLog("listening for response from DL failed: %u", _reply_buffer);
+            _log->info("listening for response from DL failed: %u", _reply_buffer);
             _num_send_retries ++;
+            _link_listen_timeouts ++;
             _run_loop_state = STATE_BEFORE_SEND;
             _len_reply_buffer = 0;//reset the incoming buffer length
         }
@@ -1401,7 +1622,16 @@ bool HubInterface::_process_DL() {
     {
         if (!_process_next_msg()) //if msg parsed successfully, delete the send command too
         {
-            libLog("dli Processing next resp failed, moving on...");
+            _log->info("dli Processing next resp failed, moving on...");
+            _lost_cmd(_cmd_queue.front());
+        }
+        else if ((_cmd_queue.front().flags & DLIMSG_REACTION_CUE) && !_reaction_cue_shown)
+        {
+            //the cue of the reaction timer is lit now
+            _reaction_cue_earliest_ms = _cmd_sent_ms;
+            _reaction_cue_latest_ms = _reply_received_ms;
+            _reaction_press_earliest_ms = _cmd_sent_ms;
+            _reaction_cue_shown = true;
         }
         _cmd_queue.pop(); // remove the cmd from queue, move to the next command
         _num_send_retries   = 0;
@@ -1409,7 +1639,9 @@ bool HubInterface::_process_DL() {
     }
     if (_num_send_retries >= _max_num_send_retries)
     {
-        libLog("max num retries reached, deleting command");
+        _log->info("max num retries reached, deleting command");
+        _link_cmds_dropped ++;
+        _lost_cmd(_cmd_queue.front());
         _cmd_queue.pop(); // remove the cmd from queue, move to the next command
         _num_send_retries   = 0;
     }
@@ -1444,7 +1676,7 @@ bool HubInterface::_process_config_init()
 {
     switch (_config_init_state) {
         case CONFIG_INIT_BOOTUP:
-            if (millis() > _bootup_time + _config_init_delay)
+            if (HubClock::Millis() > _bootup_time + _config_init_delay)
             {
                 _config_init_state = CONFIG_INIT_GET;
             }
@@ -1456,9 +1688,9 @@ bool HubInterface::_process_config_init()
         case CONFIG_INIT_WAIT_GET:
             if (_get_config_done)
             {
-                bool match = (_left_from_dl == LEFT_THRESHOLD);
-                match = match && (_right_from_dl == RIGHT_THRESHOLD);
-                match = match && (_middle_from_dl == MIDDLE_THRESHOLD);
+                bool match = (_left_from_dl == _pad_threshold[0]);
+                match = match && (_right_from_dl == _pad_threshold[2]);
+                match = match && (_middle_from_dl == _pad_threshold[1]);
                 match = match && (_tray_speed_pwm_from_dl == TRAY_SPEED * PLATTER_MOTOR_MAX_DUTY_CYCLE / PLATTER_MOTOR_MAX_PWM_COUNTER);
                 match = match && (_tray_current_threshold_from_dl == TRAY_CURRENT_THRESHOLD);
                 match = match && (_foodtreat_tx_power_level_from_dl == FOODTREAT_TX_POWER_LEVEL);
@@ -1476,14 +1708,14 @@ bool HubInterface::_process_config_init()
             }
             break;
         case CONFIG_INIT_SET:
-            SetDLInitValues(LEFT_THRESHOLD, MIDDLE_THRESHOLD, RIGHT_THRESHOLD, TRAY_SPEED, TRAY_CURRENT_THRESHOLD, FOODTREAT_TX_POWER_LEVEL, FOODTREAT_DETECT_THRESHOLD);
+            SetDLInitValues(_pad_threshold[0], _pad_threshold[1], _pad_threshold[2], TRAY_SPEED, TRAY_CURRENT_THRESHOLD, FOODTREAT_TX_POWER_LEVEL, FOODTREAT_DETECT_THRESHOLD);
             _config_init_state = CONFIG_INIT_DONE;
             break;
         case CONFIG_INIT_DONE:
-            libLog("HubInterface::_process_config_init: Done.");
+            _log->info("HubInterface::_process_config_init: Done.");
             break;
         default:
-            libLog.error("dli::_process_config_init Error! Invalid state!");
+            _log->error("dli::_process_config_init Error! Invalid state!");
             break;
     }
     return true;
@@ -1509,69 +1741,183 @@ bool HubInterface::UpdateButtonAudioEnabled()
 }
 
 
+void HubInterface::_check_DI_reset()
+{
+    if (_csf_needs_DI_reset) {
+        if (_csf_DI_reset_sent == false) {
+            if (ResetDI()) {
+                _csf_DI_reset_sent = true;
+            }
+        }
+    }
+    else if (!_csf_DI_reset_locked) {
+        // only reset when drift makes the touchpads unreliable, or as a last resort after a long time
+        // (32 bit difference: across the millis() wrap also where unsigned long is wider, like the gcc platform)
+        unsigned long since_reset = (uint32_t)(HubClock::Millis() - _csf_last_DI_reset_millis);
+        if (since_reset > _csf_DI_reset_interval) {
+            _csf_needs_DI_reset = true;
+        }
+        else if (since_reset > _csf_min_drift_reset_interval) {
+            for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+                if (_drift[pad].AtRisk(_pad_threshold[pad])) {
+                    _log->info("dli::Run: DI RESET NEEDED: pad %u drifted to %d +- %d", pad, (int)_drift[pad].Mean(), (int)_drift[pad].StdDev());
+                    _csf_needs_DI_reset = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 bool HubInterface::Run(unsigned long forHowLong)
 {
 
-    unsigned long start = millis();
-    while (millis() - start < forHowLong)
+    unsigned long start = HubClock::Millis();
+    while (HubClock::Millis() - start < forHowLong)
     {
-        if (!_dl_is_ready) {
-            _initialize();
+        _run_pass();
+        if (HubClock::IsVirtual()) {
+            // skip to the next thing to do, but not past the end of this Run
+            unsigned long left = forHowLong - (HubClock::Millis() - start);
+            HubClock::AdvanceMicros(HUB_CLOCK_PASS_US + 1000UL * _ms_until_next_event(left));
         }
-        else {
+    }
 
-            if (_csf_needs_DI_reset) {
-                if (_csf_DI_reset_sent == false) {
-                    if (ResetDI()) {
-                        _csf_DI_reset_sent = true;
-                    }
-                }
-            }
-            else if ((millis() - _csf_last_DI_reset_millis) > _csf_DI_reset_interval) {
-                _csf_needs_DI_reset = true;
-            }
+    // check if we have a valid timezone
+    _check_timezone();
 
-            if(_config_init_state < CONFIG_INIT_DONE)
-            {
-                _process_config_init();
-            }
+    // publish compact reports that have been waiting too long
+    if ((_compact_batch != nullptr) && (_compact_batch->Count() > 0)
+            && (HubClock::Millis() - _compact_batch_start_ms > _compact_batch_max_age_ms)
+            && (HubClock::Millis() - _last_compact_flush_ms > _compact_flush_retry_ms)) {
+        _last_compact_flush_ms = HubClock::Millis();
+        FlushReports();
+    }
 
-            _process_DL();
+    // send telemetry if enabled
+    if (_telemetry != nullptr) {
+        _telemetry->Run(*this);
+    }
 
-            //maybe do some polling about the device layer, with a pre-specified frequency
-            if (millis() - _last_diag_request_ms > _diag_check_rest_ms)
-            {
-                if (_do_poll_diag == true) {
-                    _poll_diag();
-                    _last_diag_request_ms = millis();
-                }
+    return true;
+}
+
+void HubInterface::_run_pass()
+{
+    if (!_dl_is_ready) {
+        _initialize();
+    }
+    else {
+
+        _check_DI_reset();
+
+        if(_config_init_state < CONFIG_INIT_DONE)
+        {
+            _process_config_init();
+        }
+
+        _process_DL();
+
+        //maybe do some polling about the device layer, with a pre-specified frequency
+        //(more often while a sequence waits for its sample to end)
+        if (HubClock::Millis() - _last_diag_request_ms > (_audio_sequencer.WaitingForSample() ? AUDIO_SEQUENCE_DIAG_MS : _diag_check_rest_ms))
+        {
+            if (_do_poll_diag == true) {
+                _poll_diag();
+                _last_diag_request_ms = HubClock::Millis();
             }
-            //poll the state of buttons with some specified frequency
-            if (millis() - _last_btn_poll_ms > _diag_btn_poll_rest_ms)
-            {
-                if (_do_poll_buttons == true) {
-                    _poll_buttons();
-                    _last_btn_poll_ms = millis();
-                }
+        }
+        //poll the state of buttons with some specified frequency
+        if (HubClock::Millis() - _last_btn_poll_ms > _diag_btn_poll_rest_ms)
+        {
+            if (_do_poll_buttons == true) {
+                _poll_buttons();
+                _last_btn_poll_ms = HubClock::Millis();
             }
-            //update the indicator light
-            if (millis() - _last_indlight_poll_ms > _diag_indlight_rest_ms)
-            {
-                if (_do_poll_indlight == true) {
-                    _poll_indlight();
-                    _last_indlight_poll_ms = millis();
-                }
+        }
+        //update the indicator light
+        if (HubClock::Millis() - _last_indlight_poll_ms > _diag_indlight_rest_ms)
+        {
+            if (_do_poll_indlight == true) {
+                _poll_indlight();
+                _last_indlight_poll_ms = HubClock::Millis();
             }
-
-            //do the error processing here
-            _handle_dl_errors();
         }
+
+        //send the light changes of a playing animation
+        _light_animator.Run(*this, _cmd_queue.size());
+
+        //play rejected samples again after their backoff
+        _run_audio_replay();
+
+        //and the tones and samples of a playing sequence
+        _audio_sequencer.Run(*this);
+
+        //do the error processing here
+        _handle_dl_errors();
     }
+}
 
-    // check if we have a valid timezone
-    _check_timezone();
+/*
+                            <<<                             >>>
+                            <<<   time to the next event    >>>
+                            <<<                             >>>
 
-    return true;
+
+            <<<GOAL>>>
+                |   How long a pass of Run would find nothing to do,    |
+                |   so virtual time can jump ahead (see HubClock).      |
+            <<</GOAL>>>
+
+
+            <<<PARAMS>>>
+                |   INPUT:                                              |
+                |       limit : longest jump wanted                     |
+                |   RETURN:                                             |
+                |           ms until the next timer, at most limit      |
+            <<</PARAMS>>>
+*/
+unsigned long HubInterface::_ms_until_next_event(unsigned long limit)
+{
+    if (!_dl_is_ready || (_config_init_state < CONFIG_INIT_DONE)) {
+        return (limit < 1) ? limit : 1; // starting up, in small steps
+    }
+    if ((_run_loop_state == STATE_AFTER_RCV_BEFORE_PROCESS) ||
+            ((_run_loop_state == STATE_BEFORE_SEND) && !_cmd_queue.empty())) {
+        return 0; // work to do now
+    }
+    unsigned long next = limit;
+    if (_run_loop_state == STATE_AFTER_SEND_BEFORE_RCV) {
+        next = _ms_until(_start_listen + _max_listen_time + 1, next);
+    }
+    if (_do_poll_diag) {
+        next = _ms_until(_last_diag_request_ms + (_audio_sequencer.WaitingForSample() ? AUDIO_SEQUENCE_DIAG_MS : _diag_check_rest_ms) + 1, next);
+    }
+    if (_do_poll_buttons) {
+        next = _ms_until(_last_btn_poll_ms + _diag_btn_poll_rest_ms + 1, next);
+    }
+    if (_do_poll_indlight) {
+        next = _ms_until(_last_indlight_poll_ms + _diag_indlight_rest_ms + 1, next);
+    }
+    if (_audio_replay_pending) {
+        next = _ms_until(_audio_replay_rejected_ms + _audio_replay_backoff_ms, next);
+    }
+    if (!_csf_DI_reset_locked && !_csf_needs_DI_reset) {
+        next = _ms_until(_csf_last_DI_reset_millis + _csf_DI_reset_interval + 1, next);
+    }
+    if ((_light_animator.Playing() || _audio_sequencer.Playing()) && (next > HUB_CLOCK_PLAYING_STEP_MS)) {
+        next = HUB_CLOCK_PLAYING_STEP_MS; // their frames and steps are not timers of their own
+    }
+    return HubClock::MillisUntilWake(next);
+}
+
+unsigned long HubInterface::_ms_until(unsigned long when, unsigned long limit)
+{
+    int32_t until = (int32_t)(when - HubClock::Millis());
+    if (until <= 0) {
+        return 0;
+    }
+    return ((unsigned long)until < limit) ? until : limit;
 }
 
 bool HubInterface::_process_next_msg()
@@ -1592,8 +1938,9 @@ bool HubInterface::_process_next_msg()
         else
         {
             rslt = false;
-            libLog.error("dli Error! process next msg failed");
+            _log->error("dli Error! process next msg failed");
             _num_send_retries++;
+            _link_bad_replies++;
         }
         _dl_reply_queue.pop();
     }
@@ -1671,7 +2018,11 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
 
     rplystatus -= 48; //convert to number
     if (rplystatus != 1) {
-        libLog.error("HubInterface::_parse_msg message:: ERROR - received non-success reply token: %u", rplystatus);
+        _log->error("HubInterface::_parse_msg message:: ERROR - received non-success reply token: %u", rplystatus);
+        _link_bad_replies++;
+        if (!_cmd_queue.empty()) {
+            _forget_lights_of(_cmd_queue.front()); // a rejected light command did not change the lights
+        }
     }
 
     switch (token) {
@@ -1690,8 +2041,8 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
 
         num_parsed = sscanf(payload, "%1c%1c%1c%3hu%3hu%3hu%3hu%3hu%3hu.",
                             &left, &middle, &right,
-                            &_left_baseline, &_midd_baseline, &_right_baseline,
-                            &_left_read, &_midd_read, &_right_read);
+                            &_pad_baseline[0], &_pad_baseline[1], &_pad_baseline[2],
+                            &_pad_read[0], &_pad_read[1], &_pad_read[2]);
         if (num_parsed != 9) //check number of arguments in the payload
         {
             _error_code = ERROR_CMD_RECEIVED_BAD_NUM_ARGS;
@@ -1703,16 +2054,10 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         middle  -= 48;
         // char    msg[32];
         // sprintf(msg, "%1d%1d%1d", left, middle, right);
-        // sprintf(msg, "%1d %3d %3d\t%1d %3d %3d\t%1d %3d %3d", left, _left_baseline, _left_read, middle, _midd_baseline, _midd_read, right, _right_baseline, _right_read);
         // Serial.println(msg);
 
-        //update the time of button press if any detected
-        _time_left_button_pressed   = left  ? millis()  : _time_left_button_pressed;
-        _time_middle_button_pressed = middle ? millis()  : _time_middle_button_pressed;
-        _time_right_button_pressed  = right ? millis()  : _time_right_button_pressed;
-
-        _update_button_pressed_state(left, middle, right);
-        _update_cap_reset(GetButtonVal(BUTTON_LEFT), GetButtonVal(BUTTON_MIDDLE), GetButtonVal(BUTTON_RIGHT));
+        _update_pad_touches((left * BUTTON_LEFT) | (middle * BUTTON_MIDDLE) | (right * BUTTON_RIGHT));
+        _update_cap_reset();
 
         break;
     case 'G'://get button summary: 0/1 if touched or not
@@ -1732,12 +2077,7 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         // sprintf(msg, "%1d%1d%1d", left, middle, right);
 //                        Serial.println(msg);
 
-        //update the time of button press if any detected
-        _time_left_button_pressed   = left  ? millis()  : _time_left_button_pressed;
-        _time_middle_button_pressed = middle ? millis()  : _time_middle_button_pressed;
-        _time_right_button_pressed  = right ? millis()  : _time_right_button_pressed;
-
-        _update_button_pressed_state(left, middle, right);
+        _update_pad_touches((left * BUTTON_LEFT) | (middle * BUTTON_MIDDLE) | (right * BUTTON_RIGHT));
 
         break;
     case 'Z'://diag message parsing
@@ -1762,11 +2102,12 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         foodtreat_still_in_bowl         -= 48;
         foodtreat_statemachine_state    -= 48;
         cap_open                    -= 48;
-        _last_diag_update_ms    = millis();
+        _last_diag_update_ms    = HubClock::Millis();
         _dome_open              = cap_open == 1; //if the cap is on or not
         _dome_open_int          = cap_open == 1 ? 1 : 0; // -1=dunno 0=closed 1=open
         _previous_foodtreat_taken   = foodtreat_still_in_bowl == 0; //this is the value of the foodtreat detection on platter return after previous dispense
         _foodmachine_state      = foodtreat_statemachine_state; //state of foodtreat state machine
+        _audio_playing          = sound_playing == '1';
 
         // Serial.println("HubInterface::_parse_msg message:: Z :: foodtreat_statemachine_state = ");
         // Serial.println(foodtreat_statemachine_state);
@@ -1777,7 +2118,7 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         if (_foodmachine_state == FOODMACHINE_FOODTREAT_ERROR_CODE){
             // Serial.println("HubInterface::_parse_msg message:: Z :: _foodmachine_state == FOODMACHINE_FOODTREAT_ERROR_CODE");
             if (_hub_out_of_food == false){
-                libLog.info("HubInterface::_parse_msg message:: Z :: HUB OUT OF FOOD");
+                _log->info("HubInterface::_parse_msg message:: Z :: HUB OUT OF FOOD");
                 _hub_out_of_food = true;
                 UpdateButtonAudioEnabled();
                 IndicatorState = IL_DLI_OOF;
@@ -1788,7 +2129,7 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         else{
             if (_hub_out_of_food == true){
                if (_foodmachine_state == FOODMACHINE_IDLE){
-                    libLog.info("HubInterface::_parse_msg message:: Z :: HUB HAS FOOD AGAIN");
+                    _log->info("HubInterface::_parse_msg message:: Z :: HUB HAS FOOD AGAIN");
                     _hub_out_of_food = false;
                     UpdateButtonAudioEnabled();
                     IndicatorState = IL_DLI_NULL;
@@ -1801,12 +2142,12 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
         if (_foodmachine_state == FOODMACHINE_PLATTER_ERROR_CODE){
             if (_platter_error == false){
                 _platter_error = true;
-                _platter_error_start_ms = millis();
+                _platter_error_start_ms = HubClock::Millis();
                 IndicatorState = IL_DLI_JAM;
             }
             else{
             //still in error
-                if (!_platter_stuck  && millis()>(_platter_error_start_ms+_platter_error_reset_wait)){
+                if (!_platter_stuck  && HubClock::Millis()>(_platter_error_start_ms+_platter_error_reset_wait)){
                     _platter_error_count += 1;
 
                     if (_platter_error_count > (_max_platter_error_count - 1))
@@ -1874,73 +2215,50 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
 
         break;
     case 'L'://OK packet for setting BY lights flash
-        libLog.trace("HubInterface::_parse_msg message:: L");
+        _log->trace("HubInterface::_parse_msg message:: L");
         break;
     case 'H'://OK packet for setting RGB lights flash
-        libLog.trace("HubInterface::_parse_msg message:: H");
+        _log->trace("HubInterface::_parse_msg message:: H");
         break;
     case 'Q':
         break;
     case 'P':
         if (rplystatus == 0) {
-            libLog.error("HubInterface::_parse_msg message:: P :: ERROR audio did not play - attempting REPLAY");
-
-            switch (_ars_state) {
-            case ARS_BEFORE_REPLAY:
-                // Serial.println("dli::_parse_msg::P::ARS_BEFORE_REPLAY");
-                _audio_replay_window_start = millis();
-                if ((millis() - _audio_replay_window_start) <= _audio_replay_window) {
-                    unsigned char    whichaudioagain;
-                    unsigned char    volumeagain;
-                    sscanf(_cmd_queue.front().buf, "%*c%*c%*c%*c%*c%*c%*c%1d%2d.", &whichaudioagain, &volumeagain);
-                    // Serial.print("whichaudioagain: ");
-                    // Serial.println(whichaudioagain);
-                    // Serial.print("volumeagain: ");
-                    // Serial.println(volumeagain);
-                    PlayAudio(whichaudioagain, volumeagain);
-                }
-                else {
-                    // Serial.println("dli::_parse_msg::P::REPLAY TIMED OUT");
-                    _ars_state = ARS_BEFORE_REPLAY;
-                }
-                _ars_state = ARS_DURING_REPLAY;
-                break;
-            case ARS_DURING_REPLAY:
-                // Serial.println("dli::_parse_msg::P::ARS_DURING_REPLAY");
-                if ((millis() - _audio_replay_window_start) <= _audio_replay_window) {
-                    unsigned char    whichaudioagain;
-                    unsigned char    volumeagain;
-                    sscanf(_cmd_queue.front().buf, "%*c%*c%*c%*c%*c%*c%*c%1d%2d.", &whichaudioagain, &volumeagain);
-                    PlayAudio(whichaudioagain, volumeagain);
-                }
-                else {
-                    // Serial.println("dli::_parse_msg::P::REPLAY TIMED OUT");
-                    _ars_state = ARS_BEFORE_REPLAY;
-                }
-                break;
-            }
+            _log->error("HubInterface::_parse_msg message:: P :: ERROR audio did not play");
+            _schedule_audio_replay(_cmd_queue.front());
         }
         else {
-            _ars_state = ARS_BEFORE_REPLAY;
+            _audio_samples_started ++;
+            _audio_playing = true; // until the diagnostics say otherwise
+            if (!_cmd_queue.empty() && (_cmd_queue.front().flags & DLIMSG_SEQUENCE_SAMPLE)) {
+                _sequence_sample = SEQUENCE_SAMPLE_STARTED;
+            }
         }
         break;
     case 'T':
-        libLog.trace("HubInterface::_parse_msg message:: T :: Presenting Tray");
+        _log->trace("HubInterface::_parse_msg message:: T :: Presenting Tray");
         break;
     case 'X':
-        libLog.trace("HubInterface::_parse_msg message:: X :: Retracting Tray");
+        _log->trace("HubInterface::_parse_msg message:: X :: Retracting Tray");
         break;
     case 'N':
-        libLog.trace("HubInterface::_parse_msg message:: N :: config item set");
+        _log->trace("HubInterface::_parse_msg message:: N :: config item set");
         break;
     case 'K':
         _csf_needs_DI_reset = false;
         _csf_DI_reset_sent = false;
-        _csf_last_DI_reset_millis = millis();
-        libLog.trace("HubInterface::_parse_msg message:: K :: DI rebooted");
+        _csf_last_DI_reset_millis = HubClock::Millis();
+        for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+            _drift[pad].Reset(); // baselines are recalibrated
+        }
+        // the lights do not show what they were told any more
+        _light_shadow.Forget(LIGHT_ALL);
+        _light_animator.Resend();
+        _current_ilstate = IL_DLI_NULL; // an error indicator is set again at the next poll
+        _log->trace("HubInterface::_parse_msg message:: K :: DI rebooted");
         break;
     case 'U':
-        libLog.trace("HubInterface::_parse_msg message:: U: %s", payload);
+        _log->trace("HubInterface::_parse_msg message:: U: %s", payload);
         unsigned long config_id;
         unsigned long config_value;
         num_parsed = sscanf(payload, "%02d%05d", &config_id, &config_value);
@@ -1978,7 +2296,7 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
                 _foodtreat_detect_threshold_from_dl = config_value;
                 break;
             default:
-                libLog.error("dli::_parse_msg Error! get config message parse not implemented. Token %u, Payload %s", token, payload);
+                _log->error("dli::_parse_msg Error! get config message parse not implemented. Token %u, Payload %s", token, payload);
                 break;
         }
 
@@ -1990,7 +2308,7 @@ bool HubInterface::_parse_msg(unsigned char token, unsigned char rplystatus, cha
 
         break;
     default:
-        libLog.error("dli::_parse_msg Error! message parse not implemented, Token %u, Payload %s", token, payload);
+        _log->error("dli::_parse_msg Error! message parse not implemented, Token %u, Payload %s", token, payload);
         break;
     }
     //Serial.println("HubInterface::_parse_msg finished");
@@ -2026,16 +2344,16 @@ bool HubInterface::_handle_dl_errors()
     //for now only send a message through _logger
     switch (_error_code) {
     case ERROR_CMD_QUEUE_FULL:
-        libLog.error("HubInterface::_handle_dl_errors cmd queue full");
+        _log->error("HubInterface::_handle_dl_errors cmd queue full");
         break;
     case ERROR_CMD_RECEIVED_BAD_START:
-        libLog.error("HubInterface::_handle_dl_errors cmd received has a bad start char");
+        _log->error("HubInterface::_handle_dl_errors cmd received has a bad start char");
         break;
     case ERROR_CMD_RECEIVED_TOO_SHORT:
-        libLog.error("HubInterface::_handle_dl_errors cmd received is too short");
+        _log->error("HubInterface::_handle_dl_errors cmd received is too short");
         break;
     case ERROR_CMD_RECEIVED_BAD_NUM_ARGS:
-        libLog.error("HubInterface::_handle_dl_errors cmd received has bad number of arguments");
+        _log->error("HubInterface::_handle_dl_errors cmd received has bad number of arguments");
         break;
     default:
         break;
@@ -2071,34 +2389,49 @@ bool HubInterface::_handle_dl_errors()
 
 bool HubInterface::_create_dl_cmd_with(unsigned char token, const char* payload, dlimsg_t *cmd)
 {
-    if (strlen(payload) >= 999) //for now allow only payload size for single packet communication
+    if (strlen(payload) + LEN_DL_CMD_FRAMING > MAX_LEN_REPLY_BUFFER) //for now allow only payload size for single packet communication
     {
-        libLog.error("HubInterface::_create_dl_cmd_with payload too large for one packet");
+        _log->error("HubInterface::_create_dl_cmd_with payload too large for one packet");
         return false;
     }
     (*cmd).buf[7 + strlen(payload)] = STR_CARRIAGE_RETURN;//always mark the end of strings with CR
     //print the token, lengh of payload and payload into the packet
 
-    sprintf((*cmd).buf, "$%03d%d%c1%s.", strlen(payload), _packet_number, token, payload);
-    _packet_number              = (_packet_number + 1) % 9; //packet sequence number, always in [0-9]
+    sprintf((*cmd).buf, "$%03d0%c1%s.", strlen(payload), token, payload);
+    _stamp_dl_cmd(cmd);
     // libLog.trace("HubInterface::_create_dl_cmd_with message created");
     // Serial.println((*cmd).buf);
     // libLog.trace("HubInterface::_create_dl_cmd_with finished");
     return true;
 }
 
+void HubInterface::_create_dl_cmd_from(const ConstantDlFrame & frame, dlimsg_t *cmd)
+{
+    memcpy((*cmd).buf, frame.buf, frame.len + 1);
+    _stamp_dl_cmd(cmd);
+}
+
+void HubInterface::_stamp_dl_cmd(dlimsg_t *cmd)
+{
+    (*cmd).buf[DL_FRAME_PACKET_NUMBER_AT] = '0' + _packet_number;
+    _packet_number              = (_packet_number + 1) % 9; //packet sequence number, always in [0-9]
+}
+
 // check if there's a valid timezone and request one if missing
 bool HubInterface::_check_timezone()
 {
+    if (HubClock::IsVirtual()) {
+        return true; // simulated hubs keep UTC
+    }
     // check if we recently made a timezone request
     if (_last_timezone_request == 0 || // first request doesnt need timeout
-        (_last_timezone_request + _timezone_request_interval) < millis()){
+        (_last_timezone_request + _timezone_request_interval) < HubClock::Millis()){
         // check if timezone is valid
-        if (!timezone.isValid() && !timezone.requestPending() &&
+        if (!_timezone.isValid() && !_timezone.requestPending() &&
             Particle.connected()){
-            _last_timezone_request = millis();
+            _last_timezone_request = HubClock::Millis();
                 // make timezone request
-                timezone.request();
+                _timezone.request();
         }
     }
     return true;
@@ -2159,41 +2492,8 @@ bool HubInterface::IsPlatterStuck()
 */
 
 
-bool HubInterface::Report(String play_start_time, String player, uint32_t level, String result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten){
-
-    char report[621]; // max particle publish length
-
-    //build report
-    unsigned int string_length = snprintf(report, sizeof(report),
-            "{\"challenge_id\":\"%s\",\"play_start_time\":\"%s\",\"player\":\"%s\",\"timestamp\":\"%lu\",\"result\":\"%s\",\"level\":\"%lu\",\"duration\":\"%lu\",\"foodtreat_presented\":\"%d\",\"foodtreat_eaten\":\"%d\"}",
-            challenge_id,
-            play_start_time.c_str(),
-            player.c_str(),
-            Time.now(),
-            result.c_str(),
-            level,
-            duration,
-            foodtreat_presented,
-            foodtreat_eaten
-            );
-
-    if ((string_length >= 0) and (string_length < sizeof(report))){
-        // succesfully constructed report string
-        if (Particle.connected() && Time.isValid()) {
-            // connected to particle cloud, send report
-            return Particle.publish("hckrpt/report", report, 60, PRIVATE);
-        }
-        else {
-            // not connected to particle cloud or time not synced
-            // Try to sync time
-            Particle.syncTime();
-            return false;
-        };
-    }
-    else {
-        // something went wrong in constructing report string
-        return false;
-    }
+bool HubInterface::Report(ReportText play_start_time, ReportText player, uint32_t level, ReportText result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten){
+    return _report(play_start_time.str, player.str, level, result.str, duration, foodtreat_presented, foodtreat_eaten, nullptr);
 }
 
 /*
@@ -2228,40 +2528,253 @@ bool HubInterface::Report(String play_start_time, String player, uint32_t level,
             <<</PARAMS>>>
 */
 
-bool HubInterface::Report(String play_start_time, String player, uint32_t level, String result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, String extra){
-
-    char report[621]; // max particle publish length
-
-    //build report
-    unsigned int string_length = snprintf(report, sizeof(report),
-            "{\"challenge_id\":\"%s\",\"play_start_time\":\"%s\",\"player\":\"%s\",\"timestamp\":\"%lu\",\"result\":\"%s\",\"level\":\"%lu\",\"duration\":\"%lu\",\"foodtreat_presented\":\"%d\",\"foodtreat_eaten\":\"%d\",\"extra\":%s}",
-            challenge_id,
-            play_start_time.c_str(),
-            player.c_str(),
-            Time.now(),
-            result.c_str(),
-            level,
-            duration,
-            foodtreat_presented,
-            foodtreat_eaten,
-            extra.c_str()
-            );
+bool HubInterface::Report(ReportText play_start_time, ReportText player, uint32_t level, ReportText result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, ReportText extra){
+    return _report(play_start_time.str, player.str, level, result.str, duration, foodtreat_presented, foodtreat_eaten, extra.str);
+}
+
+bool HubInterface::_report(const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra){
+
+    if (_report_encoding == REPORT_ENCODING_COMPACT) {
+        return _report_compact(play_start_time, player, level, result, duration, foodtreat_presented, foodtreat_eaten, extra);
+    }
+
+    //build report straight into the reusable report buffer
+    JsonWriter json(_report_buffer, sizeof(_report_buffer));
+    if (!_write_report_json(json, play_start_time, player, level, result, duration, foodtreat_presented, foodtreat_eaten, extra)) {
+        // report does not fit in one publish, don't send a truncated one
+        _log->error("HubInterface::Report ERROR: report longer than %u characters, not sent", MAX_LEN_REPORT - 1);
+        return false;
+    }
+
+    if (_can_publish() && HubClock::TimeValid()) {
+        // connected to particle cloud, send report
+        return _publish("hckrpt/report", json.c_str());
+    }
+    else {
+        // not connected to particle cloud or time not synced
+        // Try to sync time
+        Particle.syncTime();
+        return false;
+    }
+}
+
+bool HubInterface::_write_report_json(JsonWriter & json, const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra)
+{
+    json.BeginObject();
+    json.StringField("challenge_id", challenge_id);
+    json.StringField("play_start_time", play_start_time);
+    json.StringField("player", player);
+    json.NumberAsStringField("timestamp", HubClock::Now());
+    json.StringField("result", result);
+    json.NumberAsStringField("level", level);
+    json.NumberAsStringField("duration", duration);
+    json.NumberAsStringField("foodtreat_presented", foodtreat_presented);
+    json.NumberAsStringField("foodtreat_eaten", foodtreat_eaten);
+    if ((extra != nullptr) && (extra[0] != 0)) {
+        json.RawField("extra", extra);
+    }
+    json.EndObject();
+    return !json.Overflowed();
+}
+
+/*
+                            <<<                             >>>
+                            <<<    compact report batches   >>>
+                            <<<                             >>>
+
 
-    if ((string_length >= 0) and (string_length < sizeof(report))){
-        // succesfully constructed report string
-        if (Particle.connected() && Time.isValid()) {
-            // connected to particle cloud, send report
-            return Particle.publish("hckrpt/report", report, 60, PRIVATE);
+            <<<GOAL>>>
+                |   Instead of one JSON publish per report, collect     |
+                |   reports in a binary batch (see compact_report.h)    |
+                |   and publish the batch once it is full, once it is   |
+                |   old, or when the challenge_id/player dictionary     |
+                |   changes. The dictionary is published only when it   |
+                |   changed since the last batch.                       |
+            <<</GOAL>>>
+*/
+
+bool HubInterface::SetReportEncoding(unsigned char encoding)
+{
+    if (encoding == REPORT_ENCODING_COMPACT) {
+        if (_compact_batch == nullptr) {
+            _compact_batch = new CompactReportBatch();
         }
-        else {
-            // not connected to particle cloud or time not synced
-            // Try to sync time
-            Particle.syncTime();
-            return false;
-        };
+    }
+    else if (encoding == REPORT_ENCODING_JSON) {
+        FlushReports(); // don't strand reports collected so far
     }
     else {
-        // something went wrong in constructing report string
+        _log->error("HubInterface::SetReportEncoding unknown encoding %u", encoding);
+        return false;
+    }
+    _report_encoding = encoding;
+    return true;
+}
+
+bool HubInterface::FlushReports()
+{
+    if ((_compact_batch == nullptr) || (_compact_batch->Count() == 0)) {
+        return true;
+    }
+    if (!(_can_publish() && HubClock::TimeValid())) {
+        return false;
+    }
+    if (_compact_dict_sent_id != _compact_batch->DictId()) {
+        if (!_publish_report_dict()) {
+            return false;
+        }
+        _compact_dict_sent_id = _compact_batch->DictId();
+    }
+    if (_compact_batch->EncodeBase64(_report_buffer, sizeof(_report_buffer)) == 0) {
+        _log->error("HubInterface::FlushReports ERROR: batch does not fit in one publish");
+        return false;
+    }
+    if (!_publish("hckrpt/creport", _report_buffer)) {
+        return false;
+    }
+    _log->info("HubInterface::FlushReports published %u reports", _compact_batch->Count());
+    _compact_batch->Begin(_compact_batch->DictId(), 0); // empty, restarted by the next report
+    return true;
+}
+
+bool HubInterface::_report_compact(const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra)
+{
+    if (!HubClock::TimeValid()) {
+        // timestamps are relative to the batch, they need a synced clock
+        Particle.syncTime();
+        return false;
+    }
+    if (strlen(player) >= sizeof(_compact_player)) {
+        _log->error("HubInterface::Report ERROR: player name too long for compact reports");
+        return false;
+    }
+
+    uint32_t now = HubClock::Now();
+    uint32_t dict_id = CompactReportBatch::DictIdFor(challenge_id, player);
+
+    if ((_compact_batch->Count() > 0) && (dict_id != _compact_batch->DictId())) {
+        // every record of a batch shares its dictionary
+        if (!FlushReports()) {
+            return false;
+        }
+    }
+
+    for (unsigned char attempt = 0; attempt < 2; attempt++) {
+        if (_compact_batch->Count() == 0) {
+            _compact_batch->Begin(dict_id, now);
+            strcpy(_compact_player, player);
+            _compact_batch_start_ms = HubClock::Millis();
+        }
+        if (_compact_batch->Add(now, play_start_time, level, result, duration, foodtreat_presented, foodtreat_eaten, extra)) {
+            return true;
+        }
+        if (_compact_batch->Count() == 0) {
+            _log->error("HubInterface::Report ERROR: report too large for a compact batch, not sent");
+            return false;
+        }
+        // batch is full, publish it and start a new one
+        if (!FlushReports()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool HubInterface::_publish_report_dict()
+{
+    JsonWriter json(_report_buffer, sizeof(_report_buffer));
+    json.BeginObject();
+    json.NumberAsStringField("dict_id", _compact_batch->DictId());
+    json.StringField("challenge_id", challenge_id);
+    json.StringField("player", _compact_player);
+    json.EndObject();
+
+    if (json.Overflowed()) {
+        _log->error("HubInterface::_publish_report_dict ERROR: dictionary does not fit in one publish");
         return false;
     }
+    return _publish("hckrpt/dict", json.c_str());
+}
+
+void HubInterface::SetReportPublisher(ReportPublisher publisher, void * context)
+{
+    _report_publisher = publisher;
+    _report_publisher_context = context;
+}
+
+bool HubInterface::_can_publish()
+{
+    return (_report_publisher != nullptr) || Particle.connected();
+}
+
+bool HubInterface::_publish(const char * event, const char * data)
+{
+    if (_report_publisher != nullptr) {
+        return _report_publisher(event, data, _report_publisher_context);
+    }
+    return Particle.publish(event, data, 60, PRIVATE);
+}
+
+/*
+                            <<<                             >>>
+                            <<<          Telemetry          >>>
+                            <<<                             >>>
+
+
+            <<<GOAL>>>
+                |   Sends a snapshot of the touchpads, the capsense     |
+                |   integrators, the food machine and the DL link as    |
+                |   a fixed layout UDP datagram (see telemetry.h) from  |
+                |   Run, so drift and link health can be watched live   |
+                |   without text logs.                                  |
+            <<</GOAL>>>
+*/
+
+bool HubInterface::EnableTelemetry(const char * host, uint16_t port, unsigned long intervalMs)
+{
+    if (_telemetry != nullptr) {
+        delete _telemetry;
+    }
+    _telemetry = new TelemetrySender(host, port, intervalMs);
+    return _telemetry != nullptr;
+}
+
+bool HubInterface::GetTelemetry(TelemetrySample * sample)
+{
+    sample->uptime_ms = HubClock::Millis();
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        sample->read[pad] = _pad_read[pad];
+        sample->baseline[pad] = _pad_baseline[pad];
+        sample->integration[pad] = _csf_detect_integration[pad];
+    }
+    sample->buttons = AnyButtonPressed();
+    sample->foodmachine_state = _foodmachine_state;
+
+    sample->flags = 0;
+    if (_dl_is_ready)
+        sample->flags |= TELEMETRY_FLAG_DL_READY;
+    if (_csf_needs_DI_reset)
+        sample->flags |= TELEMETRY_FLAG_DI_RESET_NEEDED;
+    if (_csf_DI_reset_locked)
+        sample->flags |= TELEMETRY_FLAG_DI_RESET_LOCKED;
+    if (_dome_open)
+        sample->flags |= TELEMETRY_FLAG_DOME_OPEN;
+    if (_hub_out_of_food)
+        sample->flags |= TELEMETRY_FLAG_OUT_OF_FOOD;
+    if (_platter_error)
+        sample->flags |= TELEMETRY_FLAG_PLATTER_ERROR;
+    if (_singulator_error)
+        sample->flags |= TELEMETRY_FLAG_SINGULATOR_ERROR;
+    if (_platter_stuck)
+        sample->flags |= TELEMETRY_FLAG_PLATTER_STUCK;
+
+    sample->cmd_queue = _cmd_queue.size();
+    sample->reply_queue = _dl_reply_queue.size();
+    sample->last_error = _error_code;
+    sample->cmds_sent = _link_cmds_sent;
+    sample->retries = _link_retries;
+    sample->listen_timeouts = _link_listen_timeouts;
+    sample->cmds_dropped = _link_cmds_dropped;
+    sample->bad_replies = _link_bad_replies;
+    return true;
 }
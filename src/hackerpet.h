@@ -2,16 +2,51 @@
 #define HACKERPET_H
 
 #include "application.h"
+#include "timezone.h"
 #include <queue>
 #include <string>
+#include "json_writer.h"
+#include "compact_report.h"
+#include "performance_stats.h"
+#include "challenge.h"
+#include "curriculum.h"
+#include "light_animation.h"
+#include "network_log.h"
+#include "telemetry.h"
+#include "drift_tracker.h"
+#include "touch_gestures.h"
+#include "random_source.h"
+#include "amplitude_table.h"
+#include "light_shadow.h"
+#include "audio_sequence.h"
+#include "dl_frame.h"
+#include "benchmark.h"
+#include "hub_clock.h"
+#include "simulated_device_layer.h"
+#include "simulated_pet.h"
+#include "hub_simulation.h"
+#include "hub_transport.h"
 
 using namespace std;
 
-#define MAX_LEN_REPLY_BUFFER 64
+#define MAX_LEN_REPLY_BUFFER 40
 // the maximum length of message buffer, which is used to receive a command from DL
+// the longest message of the protocol, a 'B' reply, takes 30 bytes
 
 #define STR_CARRIAGE_RETURN 0
 
+#define MAX_LEN_REPORT 621
+// the maximum length of a report, limited by the particle publish data size
+
+#define MAX_LEN_CHALLENGE_ID 64
+// file name, build date and time, see SetChallengeId
+
+#define NUM_PADS 3
+// touchpads of the hub, pad i has BUTTON_... bit (1 << i): 0 left, 1 middle, 2 right
+
+#define PADS_ALL ((1 << NUM_PADS) - 1)
+// BUTTON_... bits of all pads
+
 // Gets us compilation date as yyyy-Mmm-dd instead of Mmm dd yyyy
 #define __NICEDATE__ (char const[]){ \
 __DATE__[7], __DATE__[8], __DATE__[9], __DATE__[10], '-', \
@@ -98,8 +133,8 @@ __DATE__[4], __DATE__[5], '\0' }
 #define yield_wait_for_with_timeout(condition, timeout_time_in_milliseconds, ret)\
   do {                                                                         \
     static unsigned long t1 = 0;                                               \
-    t1 = millis();                                                             \
-    while (!(condition) && (millis() - t1)                                     \
+    t1 = HubClock::Millis();                                                   \
+    while (!(condition) && (HubClock::Millis() - t1)                           \
            < timeout_time_in_milliseconds) {                                   \
       yield(ret);                                                              \
     }                                                                          \
@@ -108,14 +143,14 @@ __DATE__[4], __DATE__[5], '\0' }
 /* Yield Sleep
  *
  * Waits for the specified number of microseconds, yielding while waiting.
- * Uses particle micros() function, which overflows when it reaches 2^32
+ * Uses HubClock::Micros(), which overflows when it reaches 2^32
  * (i.e., every ~71.6 minutes)
  */
 #define yield_sleep(wait_time_in_microseconds, ret)                           \
   do {                                                                        \
     static unsigned long t1 = 0;                                              \
-    t1 = micros();                                                            \
-    while ((micros() - t1)                                                    \
+    t1 = HubClock::Micros();                                                  \
+    while ((HubClock::Micros() - t1)                                          \
            < wait_time_in_microseconds) {                                     \
       yield(ret);                                                             \
     }                                                                         \
@@ -124,13 +159,13 @@ __DATE__[4], __DATE__[5], '\0' }
 /* Yield Sleep milliseconds
  *
  * Waits for the specified number of milliseconds, yielding while waiting.
- * Uses millis() function, which overflows and returns to zero every ~49 days
+ * Uses HubClock::Millis(), which overflows and returns to zero every ~49 days
  */
 #define yield_sleep_ms(wait_time_in_milliseconds, ret)                         \
   do {                                                                         \
     static unsigned long t1 = 0;                                               \
-    t1 = millis();                                                             \
-    while ((millis() - t1)                                                     \
+    t1 = HubClock::Millis();                                                   \
+    while ((HubClock::Millis() - t1)                                           \
            < wait_time_in_milliseconds) {                                      \
       yield(ret);                                                              \
     }                                                                          \
@@ -149,12 +184,48 @@ __DATE__[4], __DATE__[5], '\0' }
 
 
 
+#define DLIMSG_REACTION_CUE 0x01
+// the command shows the cue of the running reaction timer
+
+#define DLIMSG_SEQUENCE_SAMPLE 0x02
+// the command plays the sample of a step of the audio sequencer, also when played again
+
+#define MAX_AUDIO_REPLAYS 3
+// how often a sample the device layer rejected is played again
+
+#define AUDIO_REPLAY_BACKOFF_MS 30
+// wait before the first replay, doubled for every further one
+
 struct dlimsg_t {
     char buf[MAX_LEN_REPLY_BUFFER];
+    unsigned char flags = 0; // DLIMSG_... bits, not sent
+    // 'P': the request as PlayAudio got it, to play it again if the device layer rejects it
+    unsigned char audio_sample = 0;
+    unsigned char audio_volume = 0; // before scaling to the max audio amplitude
+    unsigned char audio_replays = 0; // replays before this one
+    unsigned long audio_requested_ms = 0; // millis() of the PlayAudio call
+};
+
+typedef bool (*ReportPublisher)(const char * event, const char * data, void * context);
+// publishes a report event instead of Particle.publish, see SetReportPublisher
+
+extern Logger libLog;
+// the default logger of every hub, category "app.hackerpet"
+
+struct ReportText {
+    // non-owning view of the text of a report field
+    // accepts both c strings and Strings without copying them
+    ReportText(const char * text) : str(text ? text : "") {}
+    ReportText(const String & text) : str(text.c_str()) {}
+
+    const char * str;
 };
 
 class HubInterface
 {
+    friend class HubBenchmark; // times the private hot paths
+    friend class HubTransport; // snapshots the pad press times
+    friend class AudioSequencer; // follows the fate of its own samples
 
 public:
     HubInterface();
@@ -163,6 +234,10 @@ public:
     //
     //
 
+    bool SetChallengeId(const char * name);
+    // changes the challenge_id of the reports to name followed by the build date and time
+    // Initialize sets it to the name of the challenge source file
+
     bool Run(unsigned long forHowLong);
     // advance the device layer state machine, but with forHowLong millisecond max time spent
     // meant to be run every cycle of a loop() function
@@ -198,6 +273,18 @@ public:
     // on is duty cycle, 10 ms increments, must be < period
     // colors, period, on: can be [0, 99] each
 
+    bool PlayLightAnimation(const LightKeyframe * keyframes, unsigned char numKeyframes, unsigned long loopAfterMs = 0);
+    // plays a timeline of keyframes from Run(), see LightAnimator
+    // keyframes are not copied and must stay valid while playing (e.g. a global const array)
+    // loopAfterMs: start over this many ms after the start, 0 = play once
+    // lights set with SetLights... while playing keep their color until a keyframe sets them again
+
+    bool StopLightAnimation();
+    // stops the animation, the lights keep their current color
+
+    bool LightAnimationPlaying();
+    // whether an animation is playing
+
     bool PlayAudio(unsigned char whichAudio, unsigned char volume);
     // play audio according to specified audio file ID
     // whichAudio: see AUDIO_... constants in this class
@@ -209,6 +296,29 @@ public:
     //  volume: [0, 99]
     //  slew: [0, 99]
 
+    bool PlayAudioSequence(const AudioStep * steps, unsigned char numSteps);
+    // plays a melody or a chain of samples from Run(), see AudioSequencer
+    // the steps are not copied and must stay valid while playing
+    // replaces a sequence that is still playing, avoid PlayAudio/PlayTone meanwhile
+
+    void StopAudioSequence();
+    // stops the sequence and a tone it plays
+
+    bool AudioSequencePlaying();
+    // whether a sequence is playing
+
+    bool AudioPlaying();
+    // whether the device layer plays a sound, as of its last diagnostics
+
+    uint32_t AudioSamplesStarted();
+    // number of samples the device layer started playing since Initialize
+
+    uint32_t AudioReplays();
+    // number of times a sample was played again because the device layer rejected it
+
+    uint32_t AudioSamplesDropped();
+    // number of samples given up: rejected too often, too late to still play, or replaced by a newer one
+
     bool PresentFoodtreat(unsigned char duration_decisec);
     // presents foodtreat for specified duration, then close tray
     // duration_decisec: specified amount of time (duration x 0.1 secs)
@@ -248,6 +358,11 @@ public:
     // sets dl init values for tray speed, button threshold, tray current threshold and RESETS DI BOARD
     // WARNING: THIS WILL RESET THE DI BOARD - make sure you're not using it when this function is run! Button Lights, etc.
     // (see Run function implementation for use)
+    // the touchpad thresholds are also used by the library's own touch processing from now on
+
+    int GetButtonThreshold(unsigned char whichButton);
+    // returns the touch threshold of a touchpad, -1 if whichButton is not a single touchpad
+    // whichButton: see BUTTON_... constants
 
     bool GetNeedsDIReset();
     // return value of _csf_needs_DI_reset
@@ -256,6 +371,17 @@ public:
     bool SetDIResetLock(bool);
     // pass 1 to prevent DI reset, set to 0 to allow it - allows a game to control when dli may reset DI board
 
+    bool GetBaselineDrift(unsigned char whichButton, float * mean, float * stddev);
+    // how far baseline - reading of an untouched touchpad has drifted from 0, and its noise
+    // the DI board is reset when this threatens false or missed touches
+    // returns false if whichButton is not a single touchpad or there are not enough readings yet
+
+    RandomSource & Random();
+    // the hub's random numbers, for shuffles and picks in games, see random_source.h
+
+    void SeedRandom(uint32_t seed);
+    // fixed seed for reproducible runs, call after Initialize (which seeds from the hardware)
+
     bool ResetDI();
     // WARNING: THIS WILL RESET THE DI BOARD - make sure you're not using it when this function is called! Button Lights, etc.
     // (see Run function implementation for use)
@@ -283,6 +409,31 @@ public:
     // whichButton: see BUTTON_... constants
     // since: millis() at a particular time in the past
 
+    bool NextGesture(TouchGesture * gesture);
+    // takes the oldest touchpad gesture (tap, double tap, hold, chord, slide) recognized by Run
+    // returns false if there is none, see touch_gestures.h
+
+    void ClearGestures();
+    // forget recognized gestures, e.g. at the start of an interaction
+
+    void SetGestureTimings(unsigned long holdMs, unsigned long doubleTapMs, unsigned long chordMs, unsigned long slideMs);
+    // see TouchGestureRecognizer::SetTimings
+
+    bool StartReactionTimer(unsigned char whichButtons);
+    // starts timing a reaction to the light command queued last (call it
+    // right after SetLights...), from when the device layer acknowledged the
+    // lights until the first touch of one of whichButtons
+    // without a queued light command the cue counts as shown now
+    // whichButtons: see BUTTON_... constants
+
+    bool GetReactionTime(unsigned long * reactionMs, unsigned long * errorMs);
+    // returns true once the reaction timer saw the cue shown and a touch
+    // reactionMs: middle of the range the reaction time must be in
+    // errorMs: the reaction time is within reactionMs +- errorMs, about the
+    //          time between two button polls plus one device layer round trip
+
+    void StopReactionTimer();
+
     unsigned char FoodmachineState();
     // returns state of food machine: any FOODMACHINE_... values defined in this class
 
@@ -314,6 +465,19 @@ public:
     // set max light amplitude
     // max_light_amplitude: [0, 99]
 
+    void ForceLights(unsigned char whichLights);
+    // send the next SetLights... for these lights even if they already show that
+    // (commands that would not change a light are dropped otherwise)
+
+    void GetLightCommandStats(uint32_t * sent, uint32_t * suppressed, uint32_t * bytesSaved);
+    // light commands sent and dropped because they would not change anything,
+    // and the serial bytes that saved
+
+    bool SetLightCurve(unsigned char curve);
+    // how colors 0-99 map to light output, AMPLITUDE_CURVE_LINEAR (default),
+    // AMPLITUDE_CURVE_GAMMA or AMPLITUDE_CURVE_PERCEPTUAL (equal brightness steps)
+    // see amplitude_table.h
+
     bool SetDoPollButtons(bool buttonPollingEnable);
     // turn button polling on and off
 
@@ -323,6 +487,16 @@ public:
     bool SetDoPollIndLight(bool indLightPollingEnable);
     // turn indicator light updating on or off
 
+    void SetDeviceLayerLink(Stream * link);
+    // talk to the device layer through link instead of Serial1, e.g. a
+    // SimulatedDeviceLayer; call it before Initialize
+
+    void SetLogger(const Logger & log);
+    // log through log instead of libLog, e.g. one category per simulated hub; log is not copied
+
+    const Logger & Log() const;
+    // the logger of this hub, also used by its ChallengeEngine
+
     bool IsHubOutOfFood();
     // returns true if hub is out of food
 
@@ -335,16 +509,46 @@ public:
     bool IsPlatterStuck();
     // returns true if platter is stuck (IsPlatterError was true and retried N times)
 
-    bool Report(String play_start_time, String player, uint32_t level, String result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten);
+    bool Report(ReportText play_start_time, ReportText player, uint32_t level, ReportText result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten);
     // sends a report message with standard fields to the particle cloud. Returns true if successful.
+    // text fields can be c strings or Strings, they are not copied
 
-    bool Report(String play_start_time, String player, uint32_t level, String result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, String extra);
+    bool Report(ReportText play_start_time, ReportText player, uint32_t level, ReportText result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, ReportText extra);
     // sends a report message with standard fields and extra field to the particle cloud. Returns true if successful.
+    // extra must be valid JSON (usually an object), it is inserted verbatim; an empty extra is left out
+
+    bool SetReportEncoding(unsigned char encoding);
+    // choose how reports are sent, see REPORT_ENCODING_... constants
+    // REPORT_ENCODING_COMPACT batches reports, decode them with tools/decode_compact_reports.py
+
+    bool FlushReports();
+    // publish the pending compact report batch now instead of waiting for it to fill up
+    // returns true if nothing is left pending
+
+    void SetReportPublisher(ReportPublisher publisher, void * context);
+    // reports (and compact batches) go to publisher instead of the particle cloud,
+    // e.g. a local endpoint of a fleet simulation; nullptr publishes to the cloud again
+
+    bool EnableTelemetry(const char * host, uint16_t port, unsigned long intervalMs = 1000);
+    // from now on Run sends a binary telemetry datagram to host:port every intervalMs
+    // receive them with tools/telemetry_collector.py, host is not copied
+
+    bool GetTelemetry(TelemetrySample * sample);
+    // fills sample with the current touchpad, food machine and link state
 
 //PRIVATE FUNCTIONS
 private:
     bool _initialize();
 
+    void _run_pass();
+    // one pass of the loop in Run
+
+    unsigned long _ms_until_next_event(unsigned long limit);
+    // how far virtual time may jump after a pass, see HubClock
+
+    static unsigned long _ms_until(unsigned long when, unsigned long limit);
+    // ms from now until when, 0 if it passed, at most limit
+
     bool _process_DL();
 
     bool _process_config_init();
@@ -358,6 +562,30 @@ private:
     bool _apply_desired_indicator_light(unsigned char ilstate);
     // set indicator light according to ilstate
 
+    bool _lights_change(unsigned char whichLights, const LightShadowState & state, size_t frameBytes);
+    // whether a light command with this state has to be sent, see LightShadow
+
+    void _forget_lights_of(const dlimsg_t & cmd);
+    // a light command was lost or failed, its lights show something unknown now
+
+    void _lost_cmd(const dlimsg_t & cmd);
+    // cmd was given up without a reply, or its reply could not be read
+
+    bool _queue_audio(unsigned char whichAudio, unsigned char volume, unsigned long requestedMs, unsigned char replays, unsigned char flags);
+    // queues a 'P' command with its request and DLIMSG_... flags
+
+    void _drop_audio(unsigned char flags);
+    // a sample is given up, flags: of its command
+
+    bool _play_sequence_sample(unsigned char whichAudio, unsigned char volume);
+    // PlayAudio for the audio sequencer, _sequence_sample follows what becomes of it
+
+    void _schedule_audio_replay(const dlimsg_t & cmd);
+    // the device layer rejected cmd, play it again after a backoff, or drop it
+
+    void _run_audio_replay();
+    // queues the replay when its backoff passed
+
     bool _poll_diag();
     // poll the state of the DL including (importantly) food state machine state, dispense motor active, LEDs active, sound playing, dispense detected
 
@@ -376,6 +604,12 @@ private:
     bool _handle_dl_errors();
     //looks at _error_code and calls the appropriate procedures for handling the error
 
+    void _create_dl_cmd_from(const ConstantDlFrame & frame, dlimsg_t *cmd);
+    // copies a frame made by MakeDlFrame into cmd and gives it the next packet number
+
+    void _stamp_dl_cmd(dlimsg_t *cmd);
+    // gives a frame written with DlFrameEncoder the next packet number
+
     bool _create_dl_cmd_with(unsigned char token, const char* payload, dlimsg_t *cmd);
     //given a token and payload, creates a dl command in cmd using new
 
@@ -385,10 +619,20 @@ private:
     bool _process_next_msg();
     // grab the next received msg and process it
 
-    bool _update_button_pressed_state(unsigned char left, unsigned char middle, unsigned char right);
+    void _update_pad_touches(unsigned char pressed);
+    // pressed: BUTTON_... bits of the pads the DL reports as touched
+
+    void _update_reaction_timer(unsigned char pressed);
+
+    void _set_pad_threshold(unsigned char pad, int threshold);
+
+    bool _update_button_pressed_state(unsigned char pressed);
     // keep track of buttons' states across time, only gets 'unpressed' if not above threshold for some amount of debounce time
 
-    void    _update_cap_reset(int left, int middle, int right);
+    void    _update_cap_reset();
+
+    void    _check_DI_reset();
+    // requests a DI reset when a touchpad is stuck or drifting, while not locked
 
     unsigned char _milliseconds_to_deciseconds_for_DL_T(unsigned long);
     // convert milliseconds unsigned long to deciseconds unsigned char for use with DL API
@@ -396,6 +640,24 @@ private:
     bool _check_timezone();
     // check if there's a valid timezone and request one if missing
 
+    bool _report(const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra);
+    // builds the report JSON in _report_buffer and publishes it, extra may be nullptr
+
+    bool _write_report_json(JsonWriter & json, const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra);
+    // writes the report object, false if it did not fit
+
+    bool _report_compact(const char * play_start_time, const char * player, uint32_t level, const char * result, uint32_t duration, bool foodtreat_presented, bool foodtreat_eaten, const char * extra);
+    // adds the report to the compact batch, publishing the batch first if it is full or the dictionary changed
+
+    bool _publish_report_dict();
+    // publishes the challenge_id/player dictionary the current batch refers to
+
+    bool _can_publish();
+    // connected to the cloud, or a report publisher is set
+
+    bool _publish(const char * event, const char * data);
+    // Particle.publish, or the report publisher
+
 //PRIVATE STATIC CONSTANTS
 private:
     //Initialize DL state machine
@@ -403,10 +665,6 @@ private:
     static const unsigned char DLINIT_SEND = 2;
     static const unsigned char DLINIT_PROCESS = 3;
 
-    //Audio replay state machine
-    static const unsigned char ARS_BEFORE_REPLAY = 1;
-    static const unsigned char ARS_DURING_REPLAY = 2;
-
     // STATES FOR CONFIG OF INIT VALUES
     static const unsigned char CONFIG_INIT_BOOTUP = 0;
     static const unsigned char CONFIG_INIT_GET = 1;
@@ -415,23 +673,48 @@ private:
     static const unsigned char CONFIG_INIT_DONE = 4;
 
     unsigned long _bootup_time;
-    unsigned long _config_init_delay = 20000;
+    static const unsigned long _config_init_delay = 20000;
     unsigned char _config_init_state = CONFIG_INIT_BOOTUP;
 
     // Variables related to reporting
-    char challenge_id[125] = ""; // Will store a combination of __FILE__, __DATE__, and __TIME__ here
+    char challenge_id[MAX_LEN_CHALLENGE_ID] = ""; // Will store a combination of __FILE__, __DATE__, and __TIME__ here
+    static HUB_THREAD_LOCAL char _report_buffer[MAX_LEN_REPORT]; // reused for every report of every hub (they are built one at a time, one buffer per thread on the gcc platform), keeps it off the stack
+    ReportPublisher _report_publisher = nullptr; // nullptr: Particle.publish
+    void * _report_publisher_context = nullptr;
+    unsigned char _report_encoding = REPORT_ENCODING_JSON; // how reports are sent
+    CompactReportBatch * _compact_batch = nullptr; // only allocated when compact encoding is used
+    char _compact_player[64] = ""; // player of the dictionary of the current batch
+    uint32_t _compact_dict_sent_id = 0; // id of the last dictionary published
+    unsigned long _compact_batch_start_ms = 0; // when the first record of the current batch was added
+    static const unsigned long _compact_batch_max_age_ms = 300000; // publish a batch at least every 5 mins
+    unsigned long _last_compact_flush_ms = 0; // last time Run tried to publish an old batch
+    static const unsigned long _compact_flush_retry_ms = 10000; // rest between attempts to publish an old batch
+
+    // telemetry
+    TelemetrySender * _telemetry = nullptr; // only allocated when telemetry is enabled
+    uint32_t _link_cmds_sent = 0; // commands transmitted to DL
+    uint32_t _link_retries = 0; // commands transmitted again
+    uint32_t _link_listen_timeouts = 0; // replies that did not arrive in time
+    uint32_t _link_cmds_dropped = 0; // commands given up after _max_num_send_retries
+    uint32_t _link_bad_replies = 0; // replies with a failure status or that did not parse
 
 //PRIVATE VARIABLES
 private:
     /*THESE VARIABLES ARE TIME IN MILLISECONDS, FOR KEEPING LOG OF WHAT TIME AND EVENT HAPPENED*/
-    unsigned long _time_left_button_pressed = 0; // the last time in milliseconds that button press was detected for LEFT:0, middle:1 and right:2.
-    unsigned long _time_middle_button_pressed = 0; // the last time in milliseconds that button press was detected for LEFT:0, middle:1 and right:2.
-    unsigned long _time_right_button_pressed = 0; // the last time in milliseconds that button press was detected for LEFT:0, middle:1 and right:2.
+    unsigned long _time_pad_pressed[NUM_PADS] = {0}; // the last time in milliseconds that button press was detected for LEFT:0, middle:1 and right:2.
+    unsigned long _cmd_sent_ms = 0; // when the command at the front of the queue was first transmitted
+    unsigned long _reply_received_ms = 0; // when the last reply from DL was complete
+
+    // reaction timer: each time is known to be within [..._earliest_ms, ..._latest_ms]
+    unsigned char _reaction_buttons = 0; // touchpads the reaction timer waits for, 0 if not running
+    unsigned long _reaction_cue_earliest_ms = 0;
+    unsigned long _reaction_cue_latest_ms = 0;
+    unsigned long _reaction_press_earliest_ms = 0;
+    unsigned long _reaction_press_latest_ms = 0;
 
 // PRIVATE VARIABLES RELATED TO INTERNAL FUNCTIONALITY SUCH AS QUEUES etc
 private:
     // config init
-    bool   _get_config_done                   =    false                       ; // get values complete during init
     int    _num_config_values_recvd           = 0                              ;
     int    _left_from_dl                                                       ;
     int    _middle_from_dl                                                     ;
@@ -442,117 +725,138 @@ private:
     int    _foodtreat_detect_threshold_from_dl                                     ;
 
     // general
-    bool _platter_stuck; // max retries of platter error exceeded. red light.
-    int _platter_error_count; // number of platter errors encountered in a row
+    unsigned char _platter_error_count; // number of platter errors encountered in a row
     unsigned char _current_ilstate = IL_DLI_NULL; // curent indicator lght state
-    int _max_platter_error_count = 5;
+    static const unsigned char _max_platter_error_count = 5;
     queue <dlimsg_t>   _cmd_queue; // this is the command queue to be sent to the DL, the last element in the queue is defined by this pointer
     queue <dlimsg_t>   _dl_reply_queue; // all the message received from DL are stored for future processing
     unsigned short _error_code; // last error code
     char _reply_buffer[MAX_LEN_REPLY_BUFFER]; // temp buffer to receive data from DL
+    Stream * _dl_link = &Serial1; // the device layer, or a simulated one
+    const Logger * _log = &libLog; // or the one set with SetLogger
     unsigned short _len_reply_buffer; // size of the reply buffer
     unsigned char _packet_number; // packet sequence number
     unsigned char _run_loop_state; // state in the Run loop
     unsigned char _num_send_retries; // number of retries when sending cmd to DL
-    unsigned char _max_num_send_retries; // max number of send retries for a cmd
+    static const unsigned char _max_num_send_retries = 3; // max number of send retries for a cmd
     unsigned long _start_listen; // start to listen to DL for response
-    unsigned long _max_listen_time; // max listen time
+    static const unsigned long _max_listen_time = 20; // max listen time
 
-    bool _dl_is_ready = false;
     unsigned char _init_dl_state = DLINIT_WAIT_BOOT;
-    unsigned long _wait_dl_boot_ms = 3050;; //give the DL app a chance to load from bootloader; needs 3 seconds
+    static const unsigned long _wait_dl_boot_ms = 3050; //give the DL app a chance to load from bootloader; needs 3 seconds
     unsigned long _init_dl_start;
-    unsigned long _init_dl_process_ms = 300;
+    static const unsigned long _init_dl_process_ms = 300;
 
-    bool _do_poll_diag = false; // whether _poll_diag should run or not
     unsigned long _last_diag_request_ms; // when was the last time that diag check was called
     unsigned long _last_diag_update_ms; // when was the last time that diag was updated
-    unsigned long _diag_check_rest_ms; // the rest time between two
+    static const unsigned long _diag_check_rest_ms = 500; // the rest time between two
 
-    bool _do_poll_buttons = false; // whether _poll_buttons should run or not
     unsigned long _last_btn_poll_ms; // last time buttons states were polled
-    unsigned long _diag_btn_poll_rest_ms; // rest betwen button polls
+    static const unsigned long _diag_btn_poll_rest_ms = 50; // rest betwen button polls
 
-    bool _do_poll_indlight = false; // whether _poll_indlight should run or not
     unsigned long _last_indlight_poll_ms; // last time indicator light was updated
-    unsigned long _diag_indlight_rest_ms; // rest between indlight polls
+    static const unsigned long _diag_indlight_rest_ms = 1000; // rest between indlight polls
 
-    int	_dome_open_int =	-1; // -1=dunno 0=closed 1=open
-    bool _dome_open = false; // is the dome off of the Hub?
+    signed char _dome_open_int = -1; // -1=dunno 0=closed 1=open
 
     unsigned char _foodmachine_state; // state of food machine
-    bool _previous_foodtreat_taken = false; // was the previously presented foodtreat removed from food dish while presented
-
-    bool _hub_out_of_food = false; //keep track of whether the DL thinks there is food or not.
-    bool _platter_error = false; //keep track of platter errors.
-    bool _singulator_error = false; //keep track of singulator errors.
-
-    bool _need_foodtreat_reset = false; // do we need to reset foodmachine state?
 
     unsigned char _pact_foodtreat_state = PACT_BEFORE_PRESENT; // state machine variable for present and check foodtreat
     unsigned long _foodtreat_presented_time = 0; // keep track of when the foodtreat was dispensed to keep track of eaten state
     unsigned long _foodtreat_retracted_time = 0; // keep track of when tray was retracted
     unsigned long _pact_platter_return_time = 0; // keep track of when platter back
-    bool _indefinite_tray_presentation = false; // keep track of whether tray has been presented with T(0) - will leave tray out indefinitely
 
     unsigned long _platter_error_start_ms = 0; // keep track of how long platter in error
-    unsigned long _platter_error_reset_wait = 10000; // attempt reset of platter after some time
-
-    bool _want_tray_closed = false;
+    static const unsigned long _platter_error_reset_wait = 10000; // attempt reset of platter after some time
 
     //timezone settings
+    Timezone _timezone; // not started for a simulated hub
     unsigned long _last_timezone_request = 0; // last time a timezone request was send
-    unsigned long _timezone_request_interval = 300000; // if no valid timezone send a request every 5 mins
+    static const unsigned long _timezone_request_interval = 300000; // if no valid timezone send a request every 5 mins
 
     //audio settings
-    bool _audio_enabled = true; //enable/disable audio output
-    bool _button_audio_mute = false; // override button audio sounds
-    unsigned char _audio_amplitude_max = 99; //max audio amplitude 0-99
-
-    unsigned char _ars_state = ARS_BEFORE_REPLAY; //start out not replaying
-    unsigned long _audio_replay_window_start = 0;
-    unsigned long _audio_replay_window = 280;
+    AmplitudeTable _audio_levels; // volume 0-99 to max audio amplitude
+
+    static const unsigned long _audio_replay_window = 280; // a rejected sample is not played again later than this after PlayAudio
+    unsigned char _audio_replay_sample = 0; // its request, see dlimsg_t
+    unsigned char _audio_replay_volume = 0;
+    unsigned char _audio_replay_count = 0;
+    unsigned long _audio_replay_requested_ms = 0;
+    unsigned long _audio_replay_rejected_ms = 0;
+    unsigned long _audio_replay_backoff_ms = 0;
+    unsigned char _audio_replay_flags = 0;
+    uint32_t _audio_replays = 0;
+    uint32_t _audio_samples_dropped = 0;
+    AudioSequencer _audio_sequencer; // plays the sequence of PlayAudioSequence
+    static const unsigned char SEQUENCE_SAMPLE_NONE = 0;
+    static const unsigned char SEQUENCE_SAMPLE_QUEUED = 1; // sent or to be sent, maybe again after a rejection
+    static const unsigned char SEQUENCE_SAMPLE_STARTED = 2; // the device layer accepted it
+    static const unsigned char SEQUENCE_SAMPLE_DROPPED = 3; // given up, it will not play
+    unsigned char _sequence_sample = SEQUENCE_SAMPLE_NONE; // the latest sample of the audio sequencer
+    uint32_t _audio_samples_started = 0;
 
     //lighting settings
-    bool _light_enabled = true; //enable/disable light output
-    unsigned char _light_amplitude_max = 99; //max light amplitude 0-99
+    LightAnimator _light_animator; // plays the animation of PlayLightAnimation
+    AmplitudeTable _light_levels; // colors 0-99 to max light amplitude, with the light curve
+    LightShadow _light_shadow; // what the lights were last told to show
 
     //keep track of button state
-    unsigned long _button_liftoff_ms = 100; // button liftoff time
-
-    unsigned short _left_baseline, _midd_baseline, _right_baseline;
-    unsigned short _left_read, _midd_read, _right_read;
+    static const unsigned long _button_liftoff_ms = 100; // button liftoff time
 
-    bool _l_button_state = 1; // assume left button pressed until proven otherwise
-    bool _m_button_state = 1; // assume middle button pressed until proven otherwise
-    bool _r_button_state = 1; // assume right button pressed until proven otherwise
+    // per pad, index 0: left, 1: middle, 2: right
+    unsigned short _pad_baseline[NUM_PADS] = {0}; // capsense baselines from the last 'B' reply
+    unsigned short _pad_read[NUM_PADS] = {0}; // capsense readings from the last 'B' reply
+    unsigned long _pad_liftoff_end[NUM_PADS]; // end of liftoff window per pad
 
-    unsigned long _l_button_timeout = _button_liftoff_ms; //end of liftoff window for left button
-    unsigned long _m_button_timeout = _button_liftoff_ms; //end of liftoff window for middle button
-    unsigned long _r_button_timeout = _button_liftoff_ms; //end of liftoff window for right button
+    unsigned char _pads_pressed = PADS_ALL; // BUTTON_... bits, assume all pressed until proven otherwise
+    TouchGestureRecognizer _gestures; // fed with _pads_pressed after every poll
+    RandomSource _random;
 
-    bool _button_audio_enabled = true; //play audio when buttons are pressed
     unsigned char _button_audio_amplitude = 50; //amplitude for button audio
 
     //capsense fix
-    unsigned char _csf_detect_integration_left = 0;
-    unsigned long _csf_timer_max_left = 0;
-    unsigned char _csf_detect_integration_middle = 0;
-    unsigned long _csf_timer_max_middle = 0;
-    unsigned char _csf_detect_integration_right = 0;
-    unsigned long _csf_timer_max_right = 0;
-
-    unsigned char _csf_integration_thresh = 3;
-    unsigned long _csf_max_on_duration = 10000;
-    float _csf_hysteresis = 0.5;
-    bool _csf_DI_reset_locked = false; // allows tmi to lock it during an interaction
-    bool _csf_needs_DI_reset = false;
-    bool _csf_DI_reset_sent = false;
+    unsigned char _csf_detect_integration[NUM_PADS] = {0}; // polls in a row above threshold, per pad
+    unsigned long _csf_timer_max[NUM_PADS] = {0}; // since when each pad is held above threshold
+    int _pad_threshold[NUM_PADS] = {LEFT_THRESHOLD, MIDDLE_THRESHOLD, RIGHT_THRESHOLD}; // touch thresholds the DL is set to
+    int _pad_release_threshold[NUM_PADS]; // _pad_threshold with _csf_hysteresis applied
+
+    static const unsigned char _csf_integration_thresh = 3;
+    static const unsigned long _csf_max_on_duration = 10000;
+    static constexpr float _csf_hysteresis = 0.5;
     unsigned long _csf_last_DI_reset_millis = 0;
-    unsigned long _csf_DI_reset_interval = 500000;
+    static const unsigned long _csf_DI_reset_interval = 3600000; // reset at least this often even without drift
+    static const unsigned long _csf_min_drift_reset_interval = 60000; // rest between resets because of drift
+    BaselineDriftTracker _drift[NUM_PADS]; // per pad, fed from the 'B' replies
 
     int FOODTREAT_DETECT_THRESHOLD = 60                          ; // 60 (default), 40 (addresses empty dish issues)
 
+    // flags, one bit each, initialized in the constructor
+    bool _reaction_cue_shown : 1; // DL acknowledged the cue
+    bool _reaction_pressed : 1; // a touch was seen after the cue
+    bool _get_config_done : 1; // get values complete during init
+    bool _platter_stuck : 1; // max retries of platter error exceeded. red light.
+    bool _dl_is_ready : 1;
+    bool _do_poll_diag : 1; // whether _poll_diag should run or not
+    bool _do_poll_buttons : 1; // whether _poll_buttons should run or not
+    bool _do_poll_indlight : 1; // whether _poll_indlight should run or not
+    bool _dome_open : 1; // is the dome off of the Hub?
+    bool _previous_foodtreat_taken : 1; // was the previously presented foodtreat removed from food dish while presented
+    bool _hub_out_of_food : 1; // keep track of whether the DL thinks there is food or not.
+    bool _platter_error : 1; // keep track of platter errors.
+    bool _singulator_error : 1; // keep track of singulator errors.
+    bool _need_foodtreat_reset : 1; // do we need to reset foodmachine state?
+    bool _indefinite_tray_presentation : 1; // keep track of whether tray has been presented with T(0) - will leave tray out indefinitely
+    bool _want_tray_closed : 1;
+    bool _audio_enabled : 1; // enable/disable audio output
+    bool _button_audio_mute : 1; // override button audio sounds
+    bool _audio_replay_pending : 1; // a rejected sample waits for its backoff
+    bool _audio_playing : 1; // sound_playing of the last diagnostics, or a sample started since
+    bool _light_enabled : 1; // enable/disable light output
+    bool _button_audio_enabled : 1; // play audio when buttons are pressed
+    bool _csf_DI_reset_locked : 1; // allows tmi to lock it during an interaction
+    bool _csf_needs_DI_reset : 1;
+    bool _csf_DI_reset_sent : 1;
+
 //PUBLIC STATIC VARIABLES
 public:
     //PresentAndCheckFoodtreat state machine
@@ -584,7 +888,7 @@ public:
     static const unsigned char LIGHT_CUE = 0b00001000;
     static const unsigned char LIGHT_BTNS = 0b00000111;
     static const unsigned char LIGHT_ALL = 0b00001111;
-    char LightsNum2Token[15];
+    static const char LightsNum2Token[16]; // token of every combination of LIGHT_... bits, at whichLights - 1
     //BUTTON CONSTANTS, BITMAP=LMRXXXXX
     static const unsigned char BUTTON_LEFT       = LIGHT_LEFT                        ; //for convenience of blocks
     static const unsigned char BUTTON_MIDDLE     = LIGHT_MIDDLE                      ;
@@ -621,6 +925,10 @@ public:
     static const unsigned short ERROR_CMD_RECEIVED_BAD_NUM_ARGS = 4; // command queue is full
     static const unsigned short ERROR_CMD_RECEIVED_TOO_LONG = 5; // command queue is full
 
+    //REPORT ENCODINGS
+    static const unsigned char REPORT_ENCODING_JSON = 0; // one JSON "hckrpt/report" event per report (default)
+    static const unsigned char REPORT_ENCODING_COMPACT = 1; // batched binary "hckrpt/creport" events
+
     //AUDIO SLOT IDS
     static const unsigned char AUDIO_ENTICE = 1;
     static const unsigned char AUDIO_POSITIVE = 2;
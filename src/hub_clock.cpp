@@ -0,0 +1,70 @@
+#include "hub_clock.h"
+
+HUB_THREAD_LOCAL VirtualClock * HubClock::_clock = nullptr;
+
+unsigned long HubClock::Millis()
+{
+    return _clock ? (unsigned long)(uint32_t)(_clock->now_us / 1000) : millis();
+}
+
+unsigned long HubClock::Micros()
+{
+    return _clock ? (unsigned long)(uint32_t)_clock->now_us : micros();
+}
+
+uint32_t HubClock::Now()
+{
+    return _clock ? _clock->unix_start + (uint32_t)((_clock->now_us - _clock->start_us) / 1000000) : (uint32_t)Time.now();
+}
+
+bool HubClock::TimeValid()
+{
+    return _clock ? true : Time.isValid();
+}
+
+void HubClock::Select(VirtualClock * clock)
+{
+    _clock = clock;
+}
+
+VirtualClock * HubClock::Selected()
+{
+    return _clock;
+}
+
+bool HubClock::IsVirtual()
+{
+    return _clock != nullptr;
+}
+
+void HubClock::AdvanceMicros(unsigned long us)
+{
+    if (_clock) {
+        _clock->now_us += us;
+    }
+}
+
+void HubClock::WakeAt(unsigned long ms)
+{
+    if (!_clock) {
+        return;
+    }
+    // the earliest one counts, compared as a difference so it works across the wrap
+    if (!_clock->wake_set || ((int32_t)(ms - _clock->wake_ms) < 0)) {
+        _clock->wake_ms = ms;
+        _clock->wake_set = true;
+    }
+}
+
+unsigned long HubClock::MillisUntilWake(unsigned long limit)
+{
+    if (!_clock || !_clock->wake_set) {
+        return limit;
+    }
+    int32_t until = (int32_t)(_clock->wake_ms - Millis());
+    if (until <= 0) {
+        _clock->wake_set = false; // due, whoever asked for it runs in this pass
+        return 0;
+    }
+    return ((unsigned long)until < limit) ? until : limit;
+}
@@ -0,0 +1,89 @@
+#ifndef HUB_CLOCK_H
+#define HUB_CLOCK_H
+
+#include "application.h"
+
+#define HUB_CLOCK_PASS_US 50
+// virtual time one pass of HubInterface::Run takes, about what a pass costs on a Photon
+
+#define HUB_CLOCK_PLAYING_STEP_MS 10
+// longest jump while a light animation or audio sequence plays
+
+#define HUB_CLOCK_UNIX_START 1546300800
+// Time.now() when a virtual clock starts, 2019-01-01 00:00:00 UTC
+
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+#define HUB_THREAD_LOCAL thread_local
+// firmware built for the host may run hubs on several threads (see
+// examples/111_Fleet), each with its own selected clock and report buffer
+#else
+#define HUB_THREAD_LOCAL
+#endif
+
+struct VirtualClock {
+    // the time of one simulated hub, see HubClock::Select
+    uint64_t now_us = 0;
+    uint64_t start_us = 0;
+    uint32_t unix_start = HUB_CLOCK_UNIX_START; // Time.now() at start_us
+    bool wake_set = false;
+    unsigned long wake_ms = 0;
+};
+
+/*
+                            <<<     Hub clock               >>>
+                            <<<                             >>>
+
+    The time the library runs on. It is millis(), micros() and Time.now()
+    until a VirtualClock is selected; from then on time only moves when
+    something advances it. HubInterface::Run does that by jumping straight to
+    its next timer (the next poll, a listen timeout, a retry backoff, or a
+    wake up asked for with WakeAt), so a HubSimulation runs hours of hub time
+    in seconds and can start just before millis() wraps around. The wrap
+    behaves like on the hub where unsigned long has 32 bits, as on the
+    Photon or in a -m32 host build.
+
+    Every simulated hub has its own VirtualClock and selects it before it
+    runs, so one thread can take turns between many hubs. On the gcc
+    platform the selection is per thread.
+
+    The library and the yield_... macros read the time from here. A game
+    that should run in virtual time uses HubClock::Millis() too.
+*/
+
+class HubClock
+{
+
+public:
+    static unsigned long Millis();
+    // millis(), or the virtual time
+
+    static unsigned long Micros();
+    // micros(), or the virtual time; wraps around like micros()
+
+    static uint32_t Now();
+    // Time.now(), or the virtual time since the clock's unix_start
+
+    static bool TimeValid();
+    // Time.isValid(), always true for a virtual clock
+
+    static void Select(VirtualClock * clock);
+    // from now on this thread runs on clock, nullptr goes back to real time
+
+    static VirtualClock * Selected();
+
+    static bool IsVirtual();
+
+    static void AdvanceMicros(unsigned long us);
+    // moves virtual time forward, nothing happens if the time is not virtual
+
+    static void WakeAt(unsigned long ms);
+    // something happens at ms (a simulated reply is due), Run does not skip past it
+
+    static unsigned long MillisUntilWake(unsigned long limit);
+    // ms until the earliest WakeAt still ahead, at most limit
+
+private:
+    static HUB_THREAD_LOCAL VirtualClock * _clock;
+};
+
+#endif
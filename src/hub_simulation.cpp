@@ -0,0 +1,134 @@
+#include "hackerpet.h"
+
+static const char * const FOODMACHINE_STATE_NAMES[NUM_SIM_FOODMACHINE_STATES] = {
+    "lid open", "moving home", "check", "dispensing", "idle", "moving present", "wait", "moving remove",
+    "platter error", "singulator error", 0, 0, 0, 0, 0, 0, 0, "out of food"
+};
+
+HubSimulation::HubSimulation(HubInterface & hub, unsigned long startMs)
+    : _hub(hub)
+{
+    _clock.now_us = (uint64_t)(uint32_t)startMs * 1000;
+    _clock.start_us = _clock.now_us;
+    Select();
+    _dl.Begin();
+    _hub.SetDeviceLayerLink(&_dl);
+}
+
+HubSimulation::~HubSimulation()
+{
+    if (HubClock::Selected() == &_clock) {
+        HubClock::Select(nullptr);
+    }
+}
+
+void HubSimulation::Select()
+{
+    HubClock::Select(&_clock);
+}
+
+void HubSimulation::SetUnixTime(uint32_t unixTime)
+{
+    _clock.unix_start = unixTime - (uint32_t)((_clock.now_us - _clock.start_us) / 1000000);
+}
+
+SimulatedDeviceLayer & HubSimulation::DeviceLayer()
+{
+    return _dl;
+}
+
+void HubSimulation::SetPet(SimulatedPet * pet)
+{
+    _pet = pet;
+}
+
+void HubSimulation::Step(unsigned long ms)
+{
+    unsigned long wall_start = millis();
+    Select();
+    unsigned long before = HubClock::Millis();
+    _pet_acts();
+    _hub.Run(ms);
+    _count(before);
+    _wall_ms += millis() - wall_start;
+}
+
+void HubSimulation::RunFor(uint64_t durationMs, void (*loop)())
+{
+    unsigned long wall_start = millis();
+    Select();
+    uint64_t end = _elapsed_ms + durationMs;
+    while (_elapsed_ms < end) {
+        unsigned long before = HubClock::Millis();
+        _pet_acts();
+        loop();
+        if (HubClock::Millis() == before) {
+            HubClock::AdvanceMicros(1000); // the loop did not run the hub
+        }
+        _count(before);
+    }
+    _wall_ms += millis() - wall_start;
+}
+
+uint64_t HubSimulation::Elapsed() const
+{
+    return _elapsed_ms;
+}
+
+unsigned long HubSimulation::Loops() const
+{
+    return _loops;
+}
+
+void HubSimulation::_pet_acts()
+{
+    if (_pet != nullptr) {
+        _pet->Act(_dl, HubClock::Millis());
+    }
+}
+
+void HubSimulation::_count(unsigned long before)
+{
+    _elapsed_ms += (uint32_t)(HubClock::Millis() - before);
+    _loops++;
+}
+
+/*
+                            <<<   HubSimulation::PrintStats >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    print what happened during the simulation, one fact per line
+*/
+void HubSimulation::PrintStats(Print & out)
+{
+    TelemetrySample sample;
+    _hub.GetTelemetry(&sample);
+
+    unsigned long hours = _elapsed_ms / 3600000;
+    out.printlnf("sim: %lu h %lu min of hub time in %lu ms, %lu loops, now at millis() %lu",
+                 hours, (unsigned long)(_elapsed_ms / 60000 % 60), _wall_ms, _loops, HubClock::Millis());
+    out.printlnf("link: %lu commands sent, %lu retries, %lu listen timeouts, %lu dropped, %lu bad replies",
+                 (unsigned long)sample.cmds_sent, (unsigned long)sample.retries, (unsigned long)sample.listen_timeouts,
+                 (unsigned long)sample.cmds_dropped, (unsigned long)sample.bad_replies);
+    out.printlnf("replies: %lu read, %lu lost, latency %lu / %lu / %lu ms (min / mean / max)",
+                 _dl.Replies(), _dl.RepliesLost(), _dl.LatencyMin(), _dl.LatencyMean(), _dl.LatencyMax());
+    out.printlnf("frames: %lu B, %lu Z, %lu lights, %lu P, %lu Q, %lu T, %lu X, %lu K (DI resets), %lu F",
+                 _dl.Frames('B'), _dl.Frames('Z'), _dl.Frames('M') + _dl.Frames('I') + _dl.Frames('L') + _dl.Frames('H'),
+                 _dl.Frames('P'), _dl.Frames('Q'), _dl.Frames('T'), _dl.Frames('X'), _dl.Frames('K'), _dl.Frames('F'));
+    out.printlnf("audio: %lu samples started, %lu rejected, %lu replays, %lu dropped",
+                 (unsigned long)_hub.AudioSamplesStarted(), _dl.SamplesRejected(),
+                 (unsigned long)_hub.AudioReplays(), (unsigned long)_hub.AudioSamplesDropped());
+    out.printlnf("foodtreats: %lu presented, %lu eaten", _dl.FoodtreatsPresented(), _dl.FoodtreatsEaten());
+    for (unsigned char state = 0; state < NUM_SIM_FOODMACHINE_STATES; state++) {
+        uint64_t ms = _dl.MillisInState(state);
+        if ((ms > 0) && (FOODMACHINE_STATE_NAMES[state] != 0)) {
+            out.printlnf("food machine %-16s %3lu.%lu%%", FOODMACHINE_STATE_NAMES[state],
+                         (unsigned long)(ms * 100 / (_elapsed_ms ? _elapsed_ms : 1)),
+                         (unsigned long)(ms * 1000 / (_elapsed_ms ? _elapsed_ms : 1) % 10));
+        }
+    }
+    if (_pet != nullptr) {
+        _pet->PrintStats(out);
+    }
+}
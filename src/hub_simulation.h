@@ -0,0 +1,92 @@
+#ifndef HUB_SIMULATION_H
+#define HUB_SIMULATION_H
+
+#include "application.h"
+#include "simulated_device_layer.h"
+
+class HubInterface;
+class SimulatedPet;
+
+/*
+                            <<<     Hub simulation          >>>
+                            <<<                             >>>
+
+    Runs a HubInterface against a SimulatedDeviceLayer in virtual time
+    (see HubClock), so days of hub time pass in seconds: long uptimes,
+    millis() wrapping around, the hourly DI reset and slow recoveries like
+    a jammed platter become cheap to check.
+
+ * example:
+ *      HubInterface hub;
+ *      HubSimulation sim(hub, 0xFFFFFFFF - 60000); // wraps after a minute
+ *      ChallengeEngine engine(hub, "Pet, Clever");
+ *      void loop() { engine.Run(); hub.Run(20); }
+ *      ...
+ *      hub.Initialize(__FILE__);
+ *      sim.DeviceLayer().SetEatChance(800);
+ *      sim.RunFor(7 * 24 * 3600000UL, loop);
+ *      sim.PrintStats(Serial);
+
+    A loop that does not call hub.Run still gets time moving, 1 ms per
+    call. Game code that keeps its own time has to use HubClock::Millis()
+    instead of millis().
+
+    SetPet puts a SimulatedPet in front of the hub; it acts before every
+    loop and every Step, so a game needs no scripted touches of its own.
+
+    Each simulation has its own VirtualClock. Step and RunFor select it, so
+    several simulations can take turns on one thread; code that runs
+    between the turns of one of them calls its Select first.
+*/
+
+class HubSimulation
+{
+
+public:
+    HubSimulation(HubInterface & hub, unsigned long startMs = 0);
+    // points hub at the simulated device layer and selects a virtual clock
+    // starting at startMs, before hub.Initialize
+
+    ~HubSimulation();
+    // back to real time, if this simulation's clock is still selected
+
+    void Select();
+    // this thread runs on this simulation's clock
+
+    void SetUnixTime(uint32_t unixTime);
+    // what HubClock::Now() says now, default HUB_CLOCK_UNIX_START at the start
+
+    SimulatedDeviceLayer & DeviceLayer();
+
+    void SetPet(SimulatedPet * pet);
+    // plays the hub from now on, nullptr for none; pet is not copied
+
+    void Step(unsigned long ms = 20);
+    // hub.Run(ms) in virtual time
+
+    void RunFor(uint64_t durationMs, void (*loop)());
+    // calls loop until durationMs of hub time passed
+
+    uint64_t Elapsed() const;
+    // hub time since the start, in ms, counted past the millis() wrap
+
+    unsigned long Loops() const;
+
+    void PrintStats(Print & out);
+    // hub time, speed up, link and food machine statistics
+
+private:
+    void _count(unsigned long before);
+    void _pet_acts();
+
+private:
+    HubInterface & _hub;
+    VirtualClock _clock;
+    SimulatedDeviceLayer _dl;
+    SimulatedPet * _pet = nullptr;
+    uint64_t _elapsed_ms = 0;
+    unsigned long _loops = 0;
+    unsigned long _wall_ms = 0; // real time spent in Step and RunFor
+};
+
+#endif
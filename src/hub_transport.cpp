@@ -0,0 +1,320 @@
+#include "hackerpet.h"
+
+HubTransport::HubTransport(HubInterface & hub)
+    : _hub(hub)
+{
+}
+
+HubTransport::~HubTransport()
+{
+    Stop();
+}
+
+void HubTransport::SetPassHook(void (*hook)(void * context), void * context)
+{
+    _pass_hook = hook;
+    _pass_hook_context = context;
+}
+
+bool HubTransport::Start(unsigned long runMs, unsigned long restMs)
+{
+    if (_thread != nullptr) {
+        return false;
+    }
+    _run_ms = runMs;
+    _rest_ms = restMs;
+    _stop.store(false);
+    _last_pass_ms = HubClock::Millis();
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+    _thread = new std::thread(&HubTransport::_transport_thread, this);
+#else
+    _thread = new Thread("hubtransport", &HubTransport::_transport_thread, this);
+#endif
+    return true;
+}
+
+void HubTransport::Stop()
+{
+    if (_thread == nullptr) {
+        return;
+    }
+    _stop.store(true);
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+    _thread->join();
+#endif
+    delete _thread; // a Particle Thread joins when it is disposed
+    _thread = nullptr;
+}
+
+bool HubTransport::Running() const
+{
+    return _thread != nullptr;
+}
+
+bool HubTransport::SetLights(unsigned char whichLights, unsigned char yellow, unsigned char blue, unsigned char slew)
+{
+    return _submit(HUB_COMMAND_SET_LIGHTS, whichLights, yellow, blue, slew);
+}
+
+bool HubTransport::SetLights(unsigned char whichLights, unsigned char yellow, unsigned char blue, unsigned char period, unsigned char on)
+{
+    return _submit(HUB_COMMAND_SET_LIGHTS_FLASHING, whichLights, yellow, blue, period, on);
+}
+
+bool HubTransport::SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char slew)
+{
+    return _submit(HUB_COMMAND_SET_LIGHTS_RGB, whichLights, red, green, blue, slew);
+}
+
+bool HubTransport::SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char period, unsigned char on)
+{
+    return _submit(HUB_COMMAND_SET_LIGHTS_RGB_FLASHING, whichLights, red, green, blue, period, on);
+}
+
+bool HubTransport::PlayAudio(unsigned char whichAudio, unsigned char volume)
+{
+    return _submit(HUB_COMMAND_PLAY_AUDIO, whichAudio, volume);
+}
+
+bool HubTransport::PlayTone(unsigned int frequency, unsigned char volume, unsigned char slew)
+{
+    return _submit(HUB_COMMAND_PLAY_TONE, volume, slew, 0, 0, 0, 0, frequency);
+}
+
+bool HubTransport::PresentFoodtreat(unsigned char duration_decisec)
+{
+    return _submit(HUB_COMMAND_PRESENT_FOODTREAT, duration_decisec);
+}
+
+bool HubTransport::RetractTray()
+{
+    return _submit(HUB_COMMAND_RETRACT_TRAY);
+}
+
+bool HubTransport::ResetFoodMachine()
+{
+    return _submit(HUB_COMMAND_RESET_FOOD_MACHINE);
+}
+
+bool HubTransport::SetDIResetLock(bool lock)
+{
+    return _submit(HUB_COMMAND_SET_DI_RESET_LOCK, lock);
+}
+
+/*
+                            <<<   PresentAndCheckFoodtreat  >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    the hub's PresentAndCheckFoodtreat seen from the game thread: the
+    first call queues the request, the transport thread runs the hub's
+    state machine on every pass and the state comes back in the snapshot
+
+    <<<PARAMS>>>
+    duration_ms: as on the hub, only the first call's counts
+*/
+unsigned char HubTransport::PresentAndCheckFoodtreat(unsigned long duration_ms)
+{
+    if (_pact_submitted == 0) {
+        if (_submit(HUB_COMMAND_PRESENT_AND_CHECK_FOODTREAT, 0, 0, 0, 0, 0, 0, duration_ms)) {
+            _pact_submitted = ++_pacts;
+        }
+        return HubInterface::PACT_BEFORE_PRESENT;
+    }
+    const HubSnapshot & state = State();
+    if (state.pact_id != _pact_submitted) {
+        return HubInterface::PACT_BEFORE_PRESENT; // not taken yet
+    }
+    if ((state.pact_state == HubInterface::PACT_RESPONSE_FOODTREAT_TAKEN)
+            || (state.pact_state == HubInterface::PACT_RESPONSE_FOODTREAT_NOT_TAKEN)) {
+        _pact_submitted = 0;
+    }
+    return state.pact_state;
+}
+
+const HubSnapshot & HubTransport::State()
+{
+    return _state.Read();
+}
+
+bool HubTransport::CommandsDone()
+{
+    return State().commands_done == _submitted;
+}
+
+unsigned char HubTransport::AnyButtonSupraThresholdInWindow(unsigned long since)
+{
+    // as the hub does it, with the time of the snapshot for now
+    const HubSnapshot & state = State();
+    unsigned char pressed = 0;
+    unsigned long window_start = state.ms > since ? state.ms - since : 0;
+    if (window_start > 0) {
+        for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+            if (window_start <= state.pad_pressed_ms[pad]) {
+                pressed |= (1 << pad);
+            }
+        }
+    }
+    return pressed;
+}
+
+bool HubTransport::WasButtonSupraThresholdInWindow(unsigned char whichButton, unsigned long since)
+{
+    return (AnyButtonSupraThresholdInWindow(since) & whichButton) != 0;
+}
+
+bool HubTransport::NextGesture(TouchGesture * gesture)
+{
+    return _gestures.Pop(gesture);
+}
+
+void HubTransport::ClearGestures()
+{
+    TouchGesture gesture;
+    while (_gestures.Pop(&gesture)) {
+    }
+    _submit(HUB_COMMAND_CLEAR_GESTURES);
+}
+
+uint32_t HubTransport::CommandsDropped() const
+{
+    return _commands.Dropped();
+}
+
+uint32_t HubTransport::GesturesDropped() const
+{
+    return _gestures.Dropped();
+}
+
+bool HubTransport::_submit(unsigned char kind, unsigned char a0, unsigned char a1, unsigned char a2,
+                           unsigned char a3, unsigned char a4, unsigned char a5, unsigned long value)
+{
+    HubCommand cmd = {kind, {a0, a1, a2, a3, a4, a5}, value};
+    if (!_commands.Push(cmd)) {
+        return false;
+    }
+    _submitted++;
+    return true;
+}
+
+void HubTransport::_transport_thread(void * transport)
+{
+    ((HubTransport *)transport)->_transport();
+}
+
+/*
+                            <<<   HubTransport::_transport  >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    the transport thread: until Stop, hand the queued commands to the hub,
+    step PresentAndCheckFoodtreat, run the hub, pass on gestures and
+    publish a snapshot, then rest a little
+*/
+void HubTransport::_transport()
+{
+    while (!_stop.load()) {
+        unsigned long start = HubClock::Millis();
+
+        if (_pass_hook != nullptr) {
+            _pass_hook(_pass_hook_context);
+        }
+
+        HubCommand cmd;
+        while (_commands.Pop(&cmd)) {
+            _execute(cmd);
+            _snapshot.commands_done++;
+        }
+
+        if (_pact_running) {
+            _snapshot.pact_state = _hub.PresentAndCheckFoodtreat(_pact_ms);
+            _pact_running = (_snapshot.pact_state != HubInterface::PACT_RESPONSE_FOODTREAT_TAKEN)
+                            && (_snapshot.pact_state != HubInterface::PACT_RESPONSE_FOODTREAT_NOT_TAKEN);
+        }
+
+        _hub.Run(_run_ms);
+
+        TouchGesture gesture;
+        while (_hub.NextGesture(&gesture)) {
+            _gestures.Push(gesture); // dropped and counted if the game does not keep up
+        }
+
+        _publish(start);
+        if (_rest_ms > 0) {
+            delay(_rest_ms);
+        }
+    }
+}
+
+void HubTransport::_execute(const HubCommand & cmd)
+{
+    const unsigned char * a = cmd.args;
+    switch (cmd.kind) {
+    case HUB_COMMAND_SET_LIGHTS:
+        _hub.SetLights(a[0], a[1], a[2], a[3]);
+        break;
+    case HUB_COMMAND_SET_LIGHTS_FLASHING:
+        _hub.SetLights(a[0], a[1], a[2], a[3], a[4]);
+        break;
+    case HUB_COMMAND_SET_LIGHTS_RGB:
+        _hub.SetLightsRGB(a[0], a[1], a[2], a[3], a[4]);
+        break;
+    case HUB_COMMAND_SET_LIGHTS_RGB_FLASHING:
+        _hub.SetLightsRGB(a[0], a[1], a[2], a[3], a[4], a[5]);
+        break;
+    case HUB_COMMAND_PLAY_AUDIO:
+        _hub.PlayAudio(a[0], a[1]);
+        break;
+    case HUB_COMMAND_PLAY_TONE:
+        _hub.PlayTone((unsigned int)cmd.value, a[0], a[1]);
+        break;
+    case HUB_COMMAND_PRESENT_FOODTREAT:
+        _hub.PresentFoodtreat(a[0]);
+        break;
+    case HUB_COMMAND_PRESENT_AND_CHECK_FOODTREAT:
+        // a new request replaces one still running, the hub's state machine carries on
+        _pact_running = true;
+        _pact_ms = cmd.value;
+        _snapshot.pact_id = ++_pact_ids;
+        _snapshot.pact_state = HubInterface::PACT_BEFORE_PRESENT;
+        break;
+    case HUB_COMMAND_RETRACT_TRAY:
+        _hub.RetractTray();
+        break;
+    case HUB_COMMAND_RESET_FOOD_MACHINE:
+        _hub.ResetFoodMachine();
+        break;
+    case HUB_COMMAND_SET_DI_RESET_LOCK:
+        _hub.SetDIResetLock(a[0] != 0);
+        break;
+    case HUB_COMMAND_CLEAR_GESTURES:
+        _hub.ClearGestures();
+        break;
+    }
+}
+
+void HubTransport::_publish(unsigned long passStartMs)
+{
+    HubSnapshot & s = _snapshot;
+    s.ms = HubClock::Millis();
+    s.passes++;
+    s.max_pass_gap_ms = max(s.max_pass_gap_ms, passStartMs - _last_pass_ms);
+    _last_pass_ms = passStartMs;
+
+    s.ready = _hub.IsReady();
+    s.pads_pressed = _hub.AnyButtonPressed();
+    for (unsigned char pad = 0; pad < NUM_PADS; pad++) {
+        s.pad_pressed_ms[pad] = _hub._time_pad_pressed[pad];
+        s.button_val[pad] = _hub.GetButtonVal(1 << pad);
+    }
+    s.foodmachine_state = _hub.FoodmachineState();
+    s.dome_open = _hub.GetDomeOpen();
+    s.dome_removed = _hub._dome_open; // IsDomeRemoved logs every call
+    s.out_of_food = _hub.IsHubOutOfFood();
+    s.singulator_error = _hub.IsSingulatorError();
+    s.platter_error = _hub.IsPlatterError();
+    s.platter_stuck = _hub.IsPlatterStuck();
+    s.audio_playing = _hub.AudioPlaying();
+
+    _state.Publish(s);
+}
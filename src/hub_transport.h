@@ -0,0 +1,208 @@
+#ifndef HUB_TRANSPORT_H
+#define HUB_TRANSPORT_H
+
+#include "application.h"
+#include "spsc_queue.h"
+#include "touch_gestures.h"
+
+#if defined(PLATFORM_GCC) && (PLATFORM_ID == PLATFORM_GCC)
+#include <thread>
+typedef std::thread HubTransportThread;
+#else
+typedef Thread HubTransportThread;
+#endif
+
+class HubInterface;
+
+#define HUB_TRANSPORT_RUN_MS 10
+// hub.Run time of one pass of the transport thread
+
+#define HUB_TRANSPORT_REST_MS 1
+// the transport thread sleeps this long after every pass, so the game thread gets the CPU
+
+#define HUB_TRANSPORT_COMMANDS 32
+// commands that can wait for the transport thread, a power of two
+
+#define HUB_TRANSPORT_GESTURES 16
+// recognized gestures that can wait for the game thread, a power of two
+
+// commands of the game thread, see HubCommand
+#define HUB_COMMAND_SET_LIGHTS 1
+#define HUB_COMMAND_SET_LIGHTS_FLASHING 2
+#define HUB_COMMAND_SET_LIGHTS_RGB 3
+#define HUB_COMMAND_SET_LIGHTS_RGB_FLASHING 4
+#define HUB_COMMAND_PLAY_AUDIO 5
+#define HUB_COMMAND_PLAY_TONE 6
+#define HUB_COMMAND_PRESENT_FOODTREAT 7
+#define HUB_COMMAND_PRESENT_AND_CHECK_FOODTREAT 8
+#define HUB_COMMAND_RETRACT_TRAY 9
+#define HUB_COMMAND_RESET_FOOD_MACHINE 10
+#define HUB_COMMAND_SET_DI_RESET_LOCK 11
+#define HUB_COMMAND_CLEAR_GESTURES 12
+
+struct HubCommand {
+    // one call of the game thread, carried to the transport thread
+    unsigned char kind;     // HUB_COMMAND_...
+    unsigned char args[6];  // the small arguments of the call, in order
+    unsigned long value;    // duration_ms of PresentAndCheckFoodtreat, frequency of PlayTone
+};
+
+struct HubSnapshot {
+    // the state of the hub after one pass of the transport thread
+    unsigned long ms = 0;               // HubClock::Millis() at the end of the pass
+    uint32_t passes = 0;                // passes so far
+    uint32_t commands_done = 0;         // commands handed to the hub so far
+    unsigned long max_pass_gap_ms = 0;  // longest time between the starts of two passes
+    bool ready = false;                 // IsReady()
+    unsigned char pads_pressed = 0;     // AnyButtonPressed()
+    unsigned long pad_pressed_ms[3] = {0}; // HubClock::Millis() a pad was last seen pressed, left, middle, right
+    int button_val[3] = {0};            // GetButtonVal(), left, middle, right
+    unsigned char foodmachine_state = 0;
+    int dome_open = 0;
+    bool dome_removed = false;
+    bool out_of_food = false;
+    bool singulator_error = false;
+    bool platter_error = false;
+    bool platter_stuck = false;
+    bool audio_playing = false;
+    uint32_t pact_id = 0;               // the PresentAndCheckFoodtreat of the game the state is of, 0 for none yet
+    unsigned char pact_state = 0;       // what the hub's PresentAndCheckFoodtreat returned last for it
+};
+
+/*
+                            <<<     Hub transport thread    >>>
+                            <<<                             >>>
+
+    Runs a hub on a thread of its own: serial traffic with the device
+    layer, button, diagnostics and capsense polling go on while the game
+    computes or waits for a slow Particle.publish. The game thread never
+    touches the hub's link state:
+
+    - commands (lights, audio, foodtreats) go into a lock-free SpscQueue;
+      the transport thread hands them to the hub before every pass.
+    - after every pass the transport thread publishes a HubSnapshot in a
+      SnapshotBuffer; State() returns the latest one, consistent as a
+      whole, without waiting.
+    - recognized touch gestures come back through a second SpscQueue.
+
+    HubInterface is not thread-safe: once Start returned, only Report,
+    FlushReports (with the default JSON encoding, the compact batch is
+    flushed by Run) and the calls of this class may be made from the game
+    thread. Settings, light animations and audio sequences go before Start
+    or after Stop. A command the queue has no room for is dropped and
+    counted; CommandsDone tells when the hub got everything submitted.
+
+    PresentAndCheckFoodtreat works as on the hub, in a loop until a final
+    state, but the transport thread drives the state machine in between,
+    so the game only has to look now and then.
+
+    Off by default: a game that calls hub.Run in its loop works as before.
+    On the gcc platform the thread is a std::thread, so a host build runs
+    the same code against a SimulatedDeviceLayer (see examples/113_TransportThread).
+
+ * example:
+ *      HubInterface hub;
+ *      HubTransport transport(hub);
+ *      void setup() { hub.Initialize(__FILE__); transport.Start(); }
+ *      void loop() {
+ *          if (transport.State().pads_pressed) transport.SetLights(hub.LIGHT_BTNS, 0, 0, 0);
+ *          delay(20);
+ *      }
+*/
+
+class HubTransport
+{
+
+public:
+    HubTransport(HubInterface & hub);
+
+    ~HubTransport();
+    // stops the thread
+
+    void SetPassHook(void (*hook)(void * context), void * context);
+    // called on the transport thread before every pass, e.g. a simulated
+    // pet acting on a SimulatedDeviceLayer; set it before Start
+
+    bool Start(unsigned long runMs = HUB_TRANSPORT_RUN_MS, unsigned long restMs = HUB_TRANSPORT_REST_MS);
+    // starts the thread, after hub.Initialize; false if it already runs
+    // runMs: hub.Run time of one pass
+    // restMs: sleep after every pass
+
+    void Stop();
+    // waits for the thread to finish its pass, the hub is the caller's again
+
+    bool Running() const;
+
+    // game thread: like the hub's calls of the same names, true if the command was queued
+    bool SetLights(unsigned char whichLights, unsigned char yellow, unsigned char blue, unsigned char slew);
+    bool SetLights(unsigned char whichLights, unsigned char yellow, unsigned char blue, unsigned char period, unsigned char on);
+    bool SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char slew);
+    bool SetLightsRGB(unsigned char whichLights, unsigned char red, unsigned char green, unsigned char blue, unsigned char period, unsigned char on);
+    bool PlayAudio(unsigned char whichAudio, unsigned char volume);
+    bool PlayTone(unsigned int frequency, unsigned char volume, unsigned char slew);
+    bool PresentFoodtreat(unsigned char duration_decisec);
+    bool RetractTray();
+    bool ResetFoodMachine();
+    bool SetDIResetLock(bool lock);
+
+    unsigned char PresentAndCheckFoodtreat(unsigned long duration_ms);
+    // returns a HubInterface::PACT_... state, call it until it is a final one
+    // the first call submits the request, PACT_BEFORE_PRESENT until the hub took it
+
+    const HubSnapshot & State();
+    // game thread: the hub after the latest pass, valid until the next State call
+
+    bool CommandsDone();
+    // game thread: State() shows the hub after every command submitted so far
+
+    unsigned char AnyButtonSupraThresholdInWindow(unsigned long since);
+    bool WasButtonSupraThresholdInWindow(unsigned char whichButton, unsigned long since);
+    // game thread: the hub's calls, on State()
+
+    bool NextGesture(TouchGesture * gesture);
+    // game thread: the oldest gesture the hub recognized, false if there is none
+
+    void ClearGestures();
+    // game thread: forgets waiting gestures, here and on the hub
+
+    uint32_t CommandsDropped() const;
+    // commands lost because the queue was full
+
+    uint32_t GesturesDropped() const;
+    // gestures lost because the game did not take them
+
+private:
+    bool _submit(unsigned char kind, unsigned char a0 = 0, unsigned char a1 = 0, unsigned char a2 = 0,
+                 unsigned char a3 = 0, unsigned char a4 = 0, unsigned char a5 = 0, unsigned long value = 0);
+    static void _transport_thread(void * transport);
+    void _transport();
+    void _execute(const HubCommand & cmd);
+    void _publish(unsigned long passStartMs);
+
+private:
+    HubInterface & _hub;
+    HubTransportThread * _thread = nullptr;
+    std::atomic<bool> _stop{false};
+    unsigned long _run_ms = HUB_TRANSPORT_RUN_MS;
+    unsigned long _rest_ms = HUB_TRANSPORT_REST_MS;
+    void (*_pass_hook)(void * context) = nullptr;
+    void * _pass_hook_context = nullptr;
+
+    SpscQueue<HubCommand, HUB_TRANSPORT_COMMANDS> _commands; // game thread to transport thread
+    SpscQueue<TouchGesture, HUB_TRANSPORT_GESTURES> _gestures; // transport thread to game thread
+    SnapshotBuffer<HubSnapshot> _state;
+
+    // game thread only
+    uint32_t _submitted = 0;
+    uint32_t _pacts = 0; // PresentAndCheckFoodtreat requests submitted
+    uint32_t _pact_submitted = 0; // id of the game's PresentAndCheckFoodtreat, 0 for none running
+
+    // transport thread only
+    HubSnapshot _snapshot;
+    uint32_t _pact_ids = 0; // PresentAndCheckFoodtreat requests taken
+    bool _pact_running = false;
+    unsigned long _pact_ms = 0;
+    unsigned long _last_pass_ms = 0;
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "json_writer.h"
+
+JsonWriter::JsonWriter(char * buffer, size_t size)
+{
+    _buffer = buffer;
+    _size = size;
+    Reset();
+}
+
+void JsonWriter::Reset()
+{
+    _len = 0;
+    _overflow = (_size == 0); // no room for even the terminating 0
+    _needs_separator = false;
+    if (_size > 0) {
+        _buffer[0] = 0;
+    }
+}
+
+bool JsonWriter::BeginObject()
+{
+    _needs_separator = false;
+    return _put('{');
+}
+
+bool JsonWriter::EndObject()
+{
+    _needs_separator = true;
+    return _put('}');
+}
+
+bool JsonWriter::StringField(const char * key, const char * value)
+{
+    return _key(key) && _put('"') && _put_escaped(value) && _put('"');
+}
+
+bool JsonWriter::NumberAsStringField(const char * key, uint32_t value)
+{
+    return _key(key) && _put('"') && _put_uint(value) && _put('"');
+}
+
+bool JsonWriter::NumberField(const char * key, uint32_t value)
+{
+    return _key(key) && _put_uint(value);
+}
+
+bool JsonWriter::RawField(const char * key, const char * json)
+{
+    if (!_key(key)) {
+        return false;
+    }
+    while (*json) {
+        if (!_put(*json++)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonWriter::Overflowed() const
+{
+    return _overflow;
+}
+
+size_t JsonWriter::Length() const
+{
+    return _len;
+}
+
+const char * JsonWriter::c_str() const
+{
+    return _buffer;
+}
+
+bool JsonWriter::_key(const char * key)
+{
+    if (_needs_separator && !_put(',')) {
+        return false;
+    }
+    _needs_separator = true;
+    return _put('"') && _put_escaped(key) && _put('"') && _put(':');
+}
+
+bool JsonWriter::_put(char c)
+{
+    if (_overflow) {
+        return false;
+    }
+    if (_len + 1 >= _size) { // always keep room for the terminating 0
+        _overflow = true;
+        return false;
+    }
+    _buffer[_len++] = c;
+    _buffer[_len] = 0;
+    return true;
+}
+
+bool JsonWriter::_put_escaped(const char * str)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    for (; *str; str++) {
+        unsigned char c = (unsigned char)*str;
+        bool ok;
+        switch (c) {
+        case '"':
+            ok = _put('\\') && _put('"');
+            break;
+        case '\\':
+            ok = _put('\\') && _put('\\');
+            break;
+        case '\n':
+            ok = _put('\\') && _put('n');
+            break;
+        case '\r':
+            ok = _put('\\') && _put('r');
+            break;
+        case '\t':
+            ok = _put('\\') && _put('t');
+            break;
+        default:
+            if (c < 0x20) { // remaining control characters
+                ok = _put('\\') && _put('u') && _put('0') && _put('0')
+                     && _put(hex[c >> 4]) && _put(hex[c & 0x0f]);
+            }
+            else {
+                ok = _put(c);
+            }
+            break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonWriter::_put_uint(uint32_t value)
+{
+    char digits[10]; // 4294967295
+    unsigned char n = 0;
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0) {
+        if (!_put(digits[--n])) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include "application.h"
+
+/*
+                            <<<     Streaming JSON writer   >>>
+                            <<<                             >>>
+
+    Writes a flat JSON object field by field straight into a caller owned
+    buffer. Nothing is allocated and nothing is copied into temporaries:
+    strings are escaped on the fly and numbers are converted without printf.
+
+    Once the buffer is full the writer stops writing and Overflowed() stays
+    true until Reset(), so a truncated report can never be sent by accident.
+
+ * example:
+ *      char buf[64];
+ *      JsonWriter json(buf, sizeof(buf));
+ *      json.BeginObject();
+ *      json.StringField("player", "Pet, Clever");
+ *      json.NumberAsStringField("level", 3);
+ *      json.EndObject();
+ *      if (!json.Overflowed()) Particle.publish("x", json.c_str());
+*/
+
+class JsonWriter
+{
+
+public:
+    JsonWriter(char * buffer, size_t size);
+
+    void Reset();
+    // empty the buffer and clear the overflow flag
+
+    bool BeginObject();
+    // write '{'
+
+    bool EndObject();
+    // write '}'
+
+    bool StringField(const char * key, const char * value);
+    // write "key":"value", escaping value
+
+    bool NumberAsStringField(const char * key, uint32_t value);
+    // write "key":"123" (the report schema keeps every number as a string)
+
+    bool NumberField(const char * key, uint32_t value);
+    // write "key":123
+
+    bool RawField(const char * key, const char * json);
+    // write "key":json, json is copied verbatim and must already be valid JSON
+
+    bool Overflowed() const;
+    // true if anything did not fit since the last Reset()
+
+    size_t Length() const;
+    // number of characters written, not counting the terminating 0
+
+    const char * c_str() const;
+    // the 0 terminated output
+
+private:
+    bool _key(const char * key);
+    // write the separator and "key":
+
+    bool _put(char c);
+    // append one character, sets overflow if there is no room left
+
+    bool _put_escaped(const char * str);
+    // append str with JSON escaping, no quotes
+
+    bool _put_uint(uint32_t value);
+    // append the decimal digits of value
+
+private:
+    char * _buffer;
+    size_t _size;
+    size_t _len;
+    bool _overflow;
+    bool _needs_separator;
+};
+
+#endif
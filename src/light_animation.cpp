@@ -0,0 +1,153 @@
+#include "hackerpet.h"
+
+LightAnimator::LightAnimator()
+{
+    memset(_wanted, 0, sizeof(_wanted));
+    memset(_shown, 0, sizeof(_shown));
+}
+
+void LightAnimator::Play(const LightKeyframe * keyframes, unsigned char numKeyframes, unsigned long loopAfterMs)
+{
+    _keyframes = keyframes;
+    _num_keyframes = numKeyframes;
+    _next_keyframe = 0;
+    _loop_after_ms = loopAfterMs;
+    _start_ms = HubClock::Millis();
+    _wanted_valid = 0;
+    _playing = (numKeyframes > 0);
+    _ended = false;
+    // _shown is kept, lights that already show the first colors are not sent again
+}
+
+void LightAnimator::Stop()
+{
+    _playing = false;
+    _ended = false;
+}
+
+bool LightAnimator::Playing() const
+{
+    return _playing;
+}
+
+void LightAnimator::Forget(unsigned char lights)
+{
+    _shown_valid &= ~lights;
+    _wanted_valid &= ~lights; // until a keyframe sets them again
+}
+
+void LightAnimator::Resend()
+{
+    _shown_valid = 0;
+    if (_ended && _wanted_valid) {
+        _playing = true; // a play-once animation that ended shows its last state again, then ends
+    }
+}
+
+/*
+                            <<<     LightAnimator::Run       >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    take over the keyframes that are due, then send the lights whose wanted
+    state differs from what they show, one command per distinct state
+
+    <<<PARAMS>>>
+    hub: to send the commands with
+    queuedCmds: commands waiting for the device layer, nothing is sent
+                while there are more than MAX_ANIMATION_QUEUED_CMDS, the
+                wanted states are kept and sent when there is room
+*/
+void LightAnimator::Run(HubInterface & hub, size_t queuedCmds)
+{
+    if (!_playing) {
+        return;
+    }
+
+    unsigned long elapsed = HubClock::Millis() - _start_ms;
+    for (;;) {
+        while ((_next_keyframe < _num_keyframes)
+                && (_keyframes[_next_keyframe].at_ms <= elapsed)
+                && ((_loop_after_ms == 0) || (_keyframes[_next_keyframe].at_ms < _loop_after_ms))) {
+            const LightKeyframe & keyframe = _keyframes[_next_keyframe];
+            for (unsigned char i = 0; i < NUM_ANIMATED_LIGHTS; i++) {
+                if (keyframe.lights & (1 << i)) {
+                    _wanted[i].mode = keyframe.mode;
+                    memcpy(_wanted[i].color, keyframe.color, sizeof(keyframe.color));
+                    _wanted[i].slew = keyframe.slew;
+                    _wanted[i].period = keyframe.period;
+                    _wanted[i].on = keyframe.on;
+                    _wanted_valid |= (1 << i);
+                }
+            }
+            _next_keyframe++;
+        }
+        if ((_loop_after_ms == 0) || (elapsed < _loop_after_ms)) {
+            break;
+        }
+        // start over, skipping whole loops if Run was not called for a long time
+        _start_ms += _loop_after_ms * (elapsed / _loop_after_ms);
+        elapsed = HubClock::Millis() - _start_ms;
+        _next_keyframe = 0;
+    }
+
+    if (queuedCmds > MAX_ANIMATION_QUEUED_CMDS) {
+        return;
+    }
+
+    unsigned char pending = 0;
+    for (unsigned char i = 0; i < NUM_ANIMATED_LIGHTS; i++) {
+        if ((_wanted_valid & (1 << i)) && (!(_shown_valid & (1 << i)) || !_same(_wanted[i], _shown[i]))) {
+            pending |= (1 << i);
+        }
+    }
+    for (unsigned char i = 0; (i < NUM_ANIMATED_LIGHTS) && pending; i++) {
+        if (!(pending & (1 << i))) {
+            continue;
+        }
+        // all pending lights that want the same state share one command
+        unsigned char lights = 0;
+        for (unsigned char j = i; j < NUM_ANIMATED_LIGHTS; j++) {
+            if ((pending & (1 << j)) && _same(_wanted[i], _wanted[j])) {
+                lights |= (1 << j);
+            }
+        }
+        pending &= ~lights;
+        // SetLights... only refuses while lights are disabled (SetLightEnabled), then there is
+        // nothing to show and nothing to wait for; counting it as shown lets a play-once animation end
+        _send(hub, lights, _wanted[i]);
+        for (unsigned char j = i; j < NUM_ANIMATED_LIGHTS; j++) {
+            if (lights & (1 << j)) {
+                _shown[j] = _wanted[i];
+            }
+        }
+        _shown_valid |= lights;
+        _wanted_valid |= lights; // SetLights... made us Forget them
+    }
+
+    if ((_loop_after_ms == 0) && (_next_keyframe >= _num_keyframes) && ((_shown_valid & _wanted_valid) == _wanted_valid)) {
+        _playing = false; // played once, everything is shown
+        _ended = true;
+    }
+}
+
+bool LightAnimator::_same(const _light_state_t & a, const _light_state_t & b)
+{
+    return (a.mode == b.mode) && (memcmp(a.color, b.color, sizeof(a.color)) == 0)
+           && (a.period == b.period) && (a.on == b.on)
+           && ((a.period != 0) || (a.slew == b.slew)); // slew does not matter when flashing
+}
+
+bool LightAnimator::_send(HubInterface & hub, unsigned char lights, const _light_state_t & state)
+{
+    if (state.mode == LIGHT_KEYFRAME_RGB) {
+        if (state.period == 0) {
+            return hub.SetLightsRGB(lights, state.color[0], state.color[1], state.color[2], state.slew);
+        }
+        return hub.SetLightsRGB(lights, state.color[0], state.color[1], state.color[2], state.period, state.on);
+    }
+    if (state.period == 0) {
+        return hub.SetLights(lights, state.color[0], state.color[1], state.slew);
+    }
+    return hub.SetLights(lights, state.color[0], state.color[1], state.period, state.on);
+}
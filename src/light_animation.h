@@ -0,0 +1,92 @@
+#ifndef LIGHT_ANIMATION_H
+#define LIGHT_ANIMATION_H
+
+#include "application.h"
+
+class HubInterface;
+
+#define NUM_ANIMATED_LIGHTS 4
+// left, middle, right and cue light
+
+#define MAX_ANIMATION_QUEUED_CMDS 4
+// the animation waits while more commands than this are queued for the device layer
+
+struct LightKeyframe {
+    // from at_ms on, the lights in lights show this color, until a later keyframe sets them again
+    unsigned long at_ms;    // time from the start of the animation, keyframes must be sorted by it
+    unsigned char lights;   // LIGHT_... bits
+    unsigned char mode;     // LIGHT_KEYFRAME_YB (color = yellow, blue) or LIGHT_KEYFRAME_RGB (color = red, green, blue)
+    unsigned char color[3]; // [0, 99] each
+    unsigned char slew;     // [0, 99], the device layer fades to the color by itself, ignored when flashing
+    unsigned char period;   // flash period in 10 ms increments, 0 = no flashing
+    unsigned char on;       // flash on time in 10 ms increments, must be < period
+};
+
+#define LIGHT_KEYFRAME_YB 0
+#define LIGHT_KEYFRAME_RGB 1
+
+/*
+                            <<<     Light animator          >>>
+                            <<<                             >>>
+
+    Plays a timeline of LightKeyframes from HubInterface::Run, so a game
+    hands over an animation once instead of calling SetLights from its own
+    loop. Only changes are sent to the device layer: keyframes that are due
+    at the same time are merged per light, a light that already shows a
+    color is not sent it again (also not when the animation loops), and
+    lights that change to the same color share one command. Fades and
+    flashing are left to the device layer (slew, period and on).
+*/
+
+class LightAnimator
+{
+
+public:
+    LightAnimator();
+
+    void Play(const LightKeyframe * keyframes, unsigned char numKeyframes, unsigned long loopAfterMs);
+    // start playing keyframes, the array is not copied and must stay valid while playing
+    // loopAfterMs: start over this many ms after the start, 0 = play once
+
+    void Stop();
+
+    bool Playing() const;
+
+    void Forget(unsigned char lights);
+    // the lights were set outside of the animation, send their color again at the next keyframe
+
+    void Resend();
+    // the lights lost what they showed, send every light the animation set again at the next Run
+
+    void Run(HubInterface & hub, size_t queuedCmds);
+    // emits the commands that are due, queuedCmds is the length of the device layer command queue
+
+private:
+    struct _light_state_t {
+        unsigned char mode;
+        unsigned char color[3];
+        unsigned char slew;
+        unsigned char period;
+        unsigned char on;
+    };
+
+    static bool _same(const _light_state_t & a, const _light_state_t & b);
+
+    bool _send(HubInterface & hub, unsigned char lights, const _light_state_t & state);
+
+private:
+    const LightKeyframe * _keyframes = nullptr;
+    unsigned char _num_keyframes = 0;
+    unsigned char _next_keyframe = 0;
+    unsigned long _loop_after_ms = 0;
+    unsigned long _start_ms = 0;
+    bool _playing = false;
+    bool _ended = false; // played once to the end, not stopped
+
+    _light_state_t _wanted[NUM_ANIMATED_LIGHTS]; // latest due state per light
+    _light_state_t _shown[NUM_ANIMATED_LIGHTS]; // last state sent per light
+    unsigned char _wanted_valid = 0; // bit per light, whether a keyframe set it yet
+    unsigned char _shown_valid = 0; // bit per light, whether _shown is known
+};
+
+#endif
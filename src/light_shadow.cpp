@@ -0,0 +1,56 @@
+#include "light_shadow.h"
+
+LightShadow::LightShadow()
+{
+    memset(_lights, 0, sizeof(_lights));
+}
+
+bool LightShadow::Changes(unsigned char lights, const LightShadowState & state, unsigned int frameBytes)
+{
+    bool changes = false;
+    for (unsigned char i = 0; i < NUM_SHADOWED_LIGHTS; i++) {
+        if ((lights & (1 << i)) && (!(_known & (1 << i)) || !_same(_lights[i], state))) {
+            changes = true;
+            break;
+        }
+    }
+    if (!changes) {
+        _suppressed++;
+        _bytes_saved += frameBytes;
+        return false;
+    }
+    for (unsigned char i = 0; i < NUM_SHADOWED_LIGHTS; i++) {
+        if (lights & (1 << i)) {
+            _lights[i] = state;
+        }
+    }
+    _known |= lights;
+    _sent++;
+    return true;
+}
+
+void LightShadow::Forget(unsigned char lights)
+{
+    _known &= ~lights;
+}
+
+uint32_t LightShadow::Sent() const
+{
+    return _sent;
+}
+
+uint32_t LightShadow::Suppressed() const
+{
+    return _suppressed;
+}
+
+uint32_t LightShadow::BytesSaved() const
+{
+    return _bytes_saved;
+}
+
+bool LightShadow::_same(const LightShadowState & a, const LightShadowState & b)
+{
+    return (a.mode == b.mode) && (memcmp(a.color, b.color, sizeof(a.color)) == 0)
+           && (a.period == b.period) && (a.on == b.on);
+}
@@ -0,0 +1,65 @@
+#ifndef LIGHT_SHADOW_H
+#define LIGHT_SHADOW_H
+
+#include "application.h"
+#include "light_animation.h"
+
+#define NUM_SHADOWED_LIGHTS 4
+// left, middle, right and cue light
+
+struct LightShadowState {
+    // what one light was last told to show, amplitudes as sent to the device layer
+    unsigned char mode;     // LIGHT_KEYFRAME_YB or LIGHT_KEYFRAME_RGB
+    unsigned char color[3]; // yellow, blue, 0 or red, green, blue
+    unsigned char period;   // flash period, 0 = not flashing
+    unsigned char on;       // flash on time
+};
+
+/*
+                            <<<     Light shadow            >>>
+                            <<<                             >>>
+
+    Remembers the last light command per light, so HubInterface can drop
+    SetLights... calls that would not change anything (like turning off
+    touchpads that are already off) instead of sending them over the
+    serial link. Slew is not compared: fading to the color a light already
+    shows does nothing. A light is unknown, and its next command always
+    sent, at the start, after ForceLights, when a command for it was lost
+    or failed and when the device layer starts over (DLINIT, DI reboot).
+*/
+
+class LightShadow
+{
+
+public:
+    LightShadow();
+
+    bool Changes(unsigned char lights, const LightShadowState & state, unsigned int frameBytes);
+    // true if the command has to be sent, any of lights is unknown or
+    // shows something else, and then remembers state for lights
+    // false counts the command and its frameBytes as suppressed
+
+    void Forget(unsigned char lights);
+    // LIGHT_... bits
+
+    uint32_t Sent() const;
+    // light commands that went out
+
+    uint32_t Suppressed() const;
+    // light commands that were dropped
+
+    uint32_t BytesSaved() const;
+    // serial bytes the suppressed commands would have taken
+
+private:
+    static bool _same(const LightShadowState & a, const LightShadowState & b);
+
+private:
+    LightShadowState _lights[NUM_SHADOWED_LIGHTS];
+    unsigned char _known = 0; // bit per light, whether _lights is what it shows
+    uint32_t _sent = 0;
+    uint32_t _suppressed = 0;
+    uint32_t _bytes_saved = 0;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "log_ring.h"
+#include <string.h>
+
+static size_t _power_of_two_below(size_t n)
+{
+    size_t p = 16;
+    while (p * 2 <= n) {
+        p *= 2;
+    }
+    return p;
+}
+
+LogRing::LogRing(size_t capacity)
+    : _capacity(_power_of_two_below(capacity)), _head(0), _tail(0), _dropped(0)
+{
+    // the free running indices wrap around in step with the buffer only for powers of two
+    _buffer = new char[_capacity];
+}
+
+LogRing::~LogRing()
+{
+    delete[] _buffer;
+}
+
+bool LogRing::Push(const char * data, size_t len)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    if ((len > 0xFFFF) || (head - tail + sizeof(uint16_t) + len > _capacity)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    uint16_t record_len = len;
+    _copy_in(head, &record_len, sizeof(record_len));
+    _copy_in(head + sizeof(record_len), data, len);
+    _head.store(head + sizeof(record_len) + len, std::memory_order_release);
+    return true;
+}
+
+size_t LogRing::Pop(char * out, size_t maxLen)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+    while (head != tail) {
+        uint16_t record_len;
+        _copy_out(tail, &record_len, sizeof(record_len));
+        size_t next = tail + sizeof(record_len) + record_len;
+        if (record_len <= maxLen) {
+            _copy_out(tail + sizeof(record_len), out, record_len);
+            _tail.store(next, std::memory_order_release);
+            return record_len;
+        }
+        // does not fit the caller, skip it
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        tail = next;
+        _tail.store(tail, std::memory_order_release);
+    }
+    return 0;
+}
+
+uint32_t LogRing::Dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+size_t LogRing::Used() const
+{
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+size_t LogRing::Capacity() const
+{
+    return _capacity;
+}
+
+void LogRing::_copy_in(size_t at, const void * data, size_t len)
+{
+    size_t start = at & (_capacity - 1);
+    size_t first = (len < _capacity - start) ? len : _capacity - start;
+    memcpy(_buffer + start, data, first);
+    memcpy(_buffer, (const char *)data + first, len - first);
+}
+
+void LogRing::_copy_out(size_t at, void * out, size_t len) const
+{
+    size_t start = at & (_capacity - 1);
+    size_t first = (len < _capacity - start) ? len : _capacity - start;
+    memcpy(out, _buffer + start, first);
+    memcpy((char *)out + first, _buffer, len - first);
+}
@@ -0,0 +1,60 @@
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+                            <<<     Log ring buffer         >>>
+                            <<<                             >>>
+
+    A fixed size ring of variable length records for exactly one producer
+    and one consumer, which may run on different threads. Neither side
+    takes a lock or allocates: the producer only moves the head, the
+    consumer only moves the tail, each publishes its index with release
+    ordering after the bytes are in place.
+
+    A record that does not fit is dropped whole (and counted), records are
+    never overwritten or truncated. Records are stored as a u16 length
+    followed by the bytes and may wrap around the end of the buffer.
+
+    Only standard C++ is used, so the ring builds and runs on Linux too.
+*/
+
+class LogRing
+{
+
+public:
+    LogRing(size_t capacity);
+    // capacity in bytes, rounded down to a power of two (at least 16)
+    ~LogRing();
+
+    bool Push(const char * data, size_t len);
+    // producer only: append one record, false if it was dropped
+
+    size_t Pop(char * out, size_t maxLen);
+    // consumer only: take the oldest record, returns its length, 0 if the ring is empty
+    // a record longer than maxLen is dropped (and counted)
+
+    uint32_t Dropped() const;
+    // records dropped so far because they did not fit
+
+    size_t Used() const;
+    // bytes in use, a snapshot
+
+    size_t Capacity() const;
+
+private:
+    void _copy_in(size_t at, const void * data, size_t len);
+    void _copy_out(size_t at, void * out, size_t len) const;
+
+private:
+    char * _buffer;
+    size_t _capacity;
+    std::atomic<size_t> _head; // free running write index, producer only
+    std::atomic<size_t> _tail; // free running read index, consumer only
+    std::atomic<uint32_t> _dropped;
+};
+
+#endif
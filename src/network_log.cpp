@@ -0,0 +1,162 @@
+#include "network_log.h"
+
+NetworkLogHandler::NetworkLogHandler(const char * host, uint16_t port, unsigned char protocol, LogLevel level, LogCategoryFilters filters)
+    : LogHandler(level, filters), _host(host), _port(port), _protocol(protocol), _ring(NETWORK_LOG_RING_SIZE)
+{
+    LogManager::instance()->addHandler(this);
+}
+
+NetworkLogHandler::~NetworkLogHandler()
+{
+    LogManager::instance()->removeHandler(this);
+}
+
+bool NetworkLogHandler::Initialize()
+{
+    if (_thread == nullptr) {
+        _thread = new Thread("netlog", &NetworkLogHandler::_drain_thread, this);
+    }
+    return _thread != nullptr;
+}
+
+uint32_t NetworkLogHandler::Dropped() const
+{
+    return _ring.Dropped();
+}
+
+uint32_t NetworkLogHandler::Sent() const
+{
+    return _sent;
+}
+
+uint32_t NetworkLogHandler::SendFailures() const
+{
+    return _send_failures;
+}
+
+/*
+                            <<<   NetworkLogHandler::logMessage >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    format one log line into the ring, runs in the thread that logs and
+    never waits for the network
+
+    <<<PARAMS>>>
+    see LogHandler
+*/
+void NetworkLogHandler::logMessage(const char * msg, LogLevel level, const char * category, const LogAttributes & attr)
+{
+    int len = snprintf(_line, sizeof(_line), "%lu %lu %c [%s] %s\r\n", (unsigned long)_sequence++, millis(),
+                       _level_letter(level), category ? category : "", msg);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len >= sizeof(_line)) {
+        // cut, but keep the line ending
+        len = sizeof(_line) - 1;
+        _line[len - 2] = '\r';
+        _line[len - 1] = '\n';
+    }
+    _ring.Push(_line, len);
+}
+
+void NetworkLogHandler::write(const char * data, size_t size)
+{
+    // raw output (Log.print...), sent as it is
+    while (size > 0) {
+        size_t len = (size < sizeof(_line)) ? size : sizeof(_line);
+        _ring.Push(data, len);
+        data += len;
+        size -= len;
+    }
+}
+
+void NetworkLogHandler::_drain_thread(void * handler)
+{
+    ((NetworkLogHandler *)handler)->_drain();
+}
+
+void NetworkLogHandler::_drain()
+{
+    for (;;) {
+        if (!_connect()) {
+            delay(_idle_ms);
+            continue;
+        }
+        uint32_t dropped = _ring.Dropped();
+        if (dropped != _reported_dropped) {
+            int len = snprintf(_out, sizeof(_out), "netlog dropped %lu lines\r\n", (unsigned long)(dropped - _reported_dropped));
+            if (_send(_out, len)) {
+                _reported_dropped = dropped;
+            }
+        }
+        size_t len = _ring.Pop(_out, sizeof(_out));
+        if (len == 0) {
+            delay(_idle_ms);
+            continue;
+        }
+        if (_send(_out, len)) {
+            _sent++;
+        }
+        else {
+            _send_failures++;
+        }
+    }
+}
+
+bool NetworkLogHandler::_connect()
+{
+    if ((_protocol == NETWORK_LOG_TCP) ? _tcp.connected() : _udp_started) {
+        return true;
+    }
+    if (!WiFi.ready() || (_last_connect_ms != 0 && millis() - _last_connect_ms < _connect_retry_ms)) {
+        return false;
+    }
+    _last_connect_ms = millis();
+
+    if (!_address) {
+        unsigned char ip[4];
+        if (sscanf(_host, "%hhu.%hhu.%hhu.%hhu", &ip[0], &ip[1], &ip[2], &ip[3]) == 4) {
+            _address = IPAddress(ip[0], ip[1], ip[2], ip[3]);
+        }
+        else {
+            _address = WiFi.resolve(_host);
+        }
+        if (!_address) {
+            return false;
+        }
+    }
+
+    if (_protocol == NETWORK_LOG_TCP) {
+        return _tcp.connect(_address, _port);
+    }
+    _udp_started = (_udp.begin(_port) != 0);
+    return _udp_started;
+}
+
+bool NetworkLogHandler::_send(const char * line, size_t len)
+{
+    if (_protocol == NETWORK_LOG_UDP) {
+        return _udp.sendPacket((const uint8_t *)line, len, _address, _port) == (int)len;
+    }
+    if (_tcp.write((const uint8_t *)line, len) != len) {
+        _tcp.stop(); // reconnect at the next line
+        return false;
+    }
+    return true;
+}
+
+char NetworkLogHandler::_level_letter(LogLevel level)
+{
+    if (level >= LOG_LEVEL_ERROR) {
+        return 'E';
+    }
+    if (level >= LOG_LEVEL_WARN) {
+        return 'W';
+    }
+    if (level >= LOG_LEVEL_INFO) {
+        return 'I';
+    }
+    return 'T';
+}
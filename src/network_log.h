@@ -0,0 +1,100 @@
+#ifndef NETWORK_LOG_H
+#define NETWORK_LOG_H
+
+#include "application.h"
+#include "log_ring.h"
+
+#define NETWORK_LOG_TCP 0
+#define NETWORK_LOG_UDP 1
+
+#define MAX_LEN_NETWORK_LOG_LINE 256
+// longer log lines are cut, also the size of one UDP datagram
+
+#define NETWORK_LOG_RING_SIZE 2048
+// bytes of log lines that can wait to be sent
+
+/*
+                            <<<     Network log handler     >>>
+                            <<<                             >>>
+
+    A log handler that sends the log over TCP or UDP without ever waiting
+    for the network in the thread that logs. logMessage only formats the
+    line into a LogRing and returns; a thread of its own connects, drains
+    the ring and sends, so a full TCP window or a lost WiFi connection
+    stalls that thread only, never hub.Run() or the game. Lines that arrive
+    while the ring is full are dropped and counted.
+
+    Every line starts with a sequence number, so a receiver sees where lines
+    are missing, and a "netlog dropped" line is sent whenever the number of
+    dropped lines went up. Any listener that prints lines works, e.g.
+    nc -lk 4888 (TCP) or nc -lku 4888 (UDP) on Linux, and
+    tools/netlog_listen.py also counts the gaps.
+
+    Particle calls log handlers one at a time, so the ring has exactly one
+    producer. The drain thread must not log itself.
+
+ * example:
+ *      NetworkLogHandler netLog("192.168.1.191", 4888, NETWORK_LOG_UDP, LOG_LEVEL_INFO);
+ *      void setup() { netLog.Initialize(); }
+*/
+
+class NetworkLogHandler : public LogHandler
+{
+
+public:
+    NetworkLogHandler(const char * host, uint16_t port, unsigned char protocol = NETWORK_LOG_TCP,
+                      LogLevel level = LOG_LEVEL_INFO, LogCategoryFilters filters = {});
+    // host: IP address or name of the receiver
+    // protocol: NETWORK_LOG_TCP or NETWORK_LOG_UDP
+    // registers itself with the log manager, lines are buffered from here on
+
+    ~NetworkLogHandler();
+
+    bool Initialize();
+    // starts the thread that sends the buffered lines, call it from setup()
+
+    uint32_t Dropped() const;
+    // lines dropped because the ring was full
+
+    uint32_t Sent() const;
+    // lines sent
+
+    uint32_t SendFailures() const;
+    // lines lost because sending failed (TCP is reconnected then)
+
+protected:
+    void logMessage(const char * msg, LogLevel level, const char * category, const LogAttributes & attr) override;
+    void write(const char * data, size_t size) override;
+
+private:
+    static void _drain_thread(void * handler);
+    void _drain();
+    bool _connect();
+    bool _send(const char * line, size_t len);
+    static char _level_letter(LogLevel level);
+
+private:
+    const char * _host;
+    uint16_t _port;
+    unsigned char _protocol;
+    IPAddress _address;
+
+    LogRing _ring;
+    uint32_t _sequence = 0; // producer only
+    uint32_t _reported_dropped = 0; // drain thread only
+    volatile uint32_t _sent = 0;
+    volatile uint32_t _send_failures = 0;
+
+    TCPClient _tcp;
+    UDP _udp;
+    bool _udp_started = false;
+    unsigned long _last_connect_ms = 0;
+    unsigned long _connect_retry_ms = 5000; // rest between connection attempts
+    unsigned long _idle_ms = 10; // rest when there is nothing to send
+
+    Thread * _thread = nullptr;
+    char _line[MAX_LEN_NETWORK_LOG_LINE]; // producer only
+    char _out[MAX_LEN_NETWORK_LOG_LINE]; // drain thread only
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include "performance_stats.h"
+#include "hub_clock.h"
+#include <stddef.h> // offsetof
+
+#define PERFORMANCE_STATS_MAGIC 0x48505331 // "HPS1", change when _state_t changes
+
+ReactionTimeHistogram::ReactionTimeHistogram()
+{
+    Reset();
+}
+
+void ReactionTimeHistogram::Add(unsigned long ms)
+{
+    unsigned char bucket = _bucket_for(ms);
+    if (_counts[bucket] == 0xffff) {
+        // halve everything instead of overflowing, keeps the shape of the distribution
+        _total = 0;
+        for (unsigned char i = 0; i < NUM_REACTION_TIME_BUCKETS; i++) {
+            _counts[i] /= 2;
+            _total += _counts[i];
+        }
+    }
+    _counts[bucket]++;
+    _total++;
+}
+
+void ReactionTimeHistogram::Reset()
+{
+    memset(_counts, 0, sizeof(_counts));
+    _total = 0;
+}
+
+unsigned long ReactionTimeHistogram::Count() const
+{
+    return _total;
+}
+
+unsigned long ReactionTimeHistogram::Percentile(unsigned char percentile) const
+{
+    if (_total == 0) {
+        return 0;
+    }
+    if (percentile > 100) {
+        percentile = 100;
+    }
+
+    // rank of the wanted value, then interpolate linearly inside its bucket
+    unsigned long rank = (_total * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+    unsigned long seen = 0;
+    for (unsigned char i = 0; i < NUM_REACTION_TIME_BUCKETS; i++) {
+        if (seen + _counts[i] >= rank) {
+            unsigned long lower = BucketLowerBound(i);
+            unsigned long upper = (i + 1 < NUM_REACTION_TIME_BUCKETS) ? BucketLowerBound(i + 1) : lower * 5 / 4;
+            return lower + (upper - lower) * (rank - seen) / _counts[i];
+        }
+        seen += _counts[i];
+    }
+    return BucketLowerBound(NUM_REACTION_TIME_BUCKETS - 1);
+}
+
+unsigned short ReactionTimeHistogram::BucketCount(unsigned char bucket) const
+{
+    return (bucket < NUM_REACTION_TIME_BUCKETS) ? _counts[bucket] : 0;
+}
+
+unsigned long ReactionTimeHistogram::BucketLowerBound(unsigned char bucket)
+{
+    if (bucket == 0) {
+        return 0; // the first bucket also holds everything below 16 ms
+    }
+    unsigned char octave = bucket / 4;
+    unsigned char quarter = bucket % 4;
+    return (unsigned long)(4 + quarter) << (octave + 2);
+}
+
+unsigned char ReactionTimeHistogram::_bucket_for(unsigned long ms)
+{
+    if (ms < 16) {
+        return 0;
+    }
+    // position of the highest set bit, ms >= 16 so msb >= 4
+    unsigned char msb = 31 - __builtin_clz((uint32_t)ms);
+    unsigned char quarter = (ms >> (msb - 2)) & 3; // the two bits below the highest one
+    unsigned int bucket = (msb - 4) * 4 + quarter;
+    return (bucket < NUM_REACTION_TIME_BUCKETS) ? bucket : NUM_REACTION_TIME_BUCKETS - 1;
+}
+
+PerformanceStats::PerformanceStats(unsigned char historyLength)
+{
+    if (historyLength < 1) {
+        historyLength = 1;
+    }
+    if (historyLength > MAX_PERFORMANCE_HISTORY) {
+        historyLength = MAX_PERFORMANCE_HISTORY;
+    }
+    _state.history_length = historyLength;
+    Reset();
+}
+
+void PerformanceStats::AddResult(bool success)
+{
+    if (_state.depth == _state.history_length) {
+        // window is full, the oldest result drops out
+        if (_history_bit(_state.history_length - 1)) {
+            _state.successes--;
+        }
+    }
+    else {
+        _state.depth++;
+    }
+    // shift the whole window one place back, the top bit of a word carries into the next one
+    for (unsigned char i = PERFORMANCE_HISTORY_WORDS - 1; i > 0; i--) {
+        _state.history[i] = (_state.history[i] << 1) | (_state.history[i - 1] >> 31);
+    }
+    _state.history[0] = (_state.history[0] << 1) | (success ? 1 : 0);
+    _trim_history();
+
+    if (success) {
+        _state.successes++;
+        _state.success_streak++;
+        _state.miss_streak = 0;
+        if (_state.success_streak > _state.best_success_streak) {
+            _state.best_success_streak = _state.success_streak;
+        }
+    }
+    else {
+        _state.miss_streak++;
+        _state.success_streak = 0;
+    }
+}
+
+void PerformanceStats::ResetHistory()
+{
+    memset(_state.history, 0, sizeof(_state.history));
+    _state.depth = 0;
+    _state.successes = 0;
+}
+
+unsigned char PerformanceStats::CountSuccesses() const
+{
+    return _state.successes;
+}
+
+unsigned char PerformanceStats::CountMisses() const
+{
+    return _state.depth - _state.successes;
+}
+
+unsigned char PerformanceStats::Depth() const
+{
+    return _state.depth;
+}
+
+float PerformanceStats::SuccessRate() const
+{
+    if (_state.depth == 0) {
+        return 0;
+    }
+    return (float)_state.successes / _state.depth;
+}
+
+bool PerformanceStats::GetResult(unsigned char age) const
+{
+    if (age >= _state.depth) {
+        return false;
+    }
+    return _history_bit(age);
+}
+
+unsigned int PerformanceStats::SuccessStreak() const
+{
+    return _state.success_streak;
+}
+
+unsigned int PerformanceStats::MissStreak() const
+{
+    return _state.miss_streak;
+}
+
+unsigned int PerformanceStats::BestSuccessStreak() const
+{
+    return _state.best_success_streak;
+}
+
+void PerformanceStats::AddReactionTime(unsigned long ms)
+{
+    _state.reaction_times.Add(ms);
+}
+
+unsigned long PerformanceStats::ReactionTimePercentile(unsigned char percentile) const
+{
+    return _state.reaction_times.Percentile(percentile);
+}
+
+const ReactionTimeHistogram & PerformanceStats::ReactionTimes() const
+{
+    return _state.reaction_times;
+}
+
+void PerformanceStats::AddPadResult(unsigned char pads, bool correct)
+{
+    for (unsigned char i = 0; i < 3; i++) {
+        if (pads & (1 << i)) {
+            if (_state.pad_touches[i] == 0xffff) { // keep the ratio, drop the oldest weight
+                _state.pad_touches[i] /= 2;
+                _state.pad_correct[i] /= 2;
+            }
+            _state.pad_touches[i]++;
+            if (correct) {
+                _state.pad_correct[i]++;
+            }
+        }
+    }
+}
+
+float PerformanceStats::PadAccuracy(unsigned char pad) const
+{
+    unsigned char i = _pad_index(pad);
+    if ((i >= 3) || (_state.pad_touches[i] == 0)) {
+        return 0;
+    }
+    return (float)_state.pad_correct[i] / _state.pad_touches[i];
+}
+
+void PerformanceStats::SetLevel(int level)
+{
+    _state.level = level;
+}
+
+int PerformanceStats::GetLevel() const
+{
+    return _state.level;
+}
+
+void PerformanceStats::Reset()
+{
+    unsigned char history_length = _state.history_length;
+    memset((void *)&_state, 0, sizeof(_state));
+    _state.history_length = history_length;
+    _state.reaction_times.Reset();
+}
+
+bool PerformanceStats::Save(int address, const char * challengeName) const
+{
+    if ((address < 0) || (address + SaveSize() > EEPROM.length())) {
+        return false;
+    }
+    _saved_t saved;
+    memset((void *)&saved, 0, sizeof(saved)); // padding is part of the checksum
+    saved.magic = PERFORMANCE_STATS_MAGIC;
+    saved.name_hash = _hash(challengeName, strlen(challengeName), 2166136261UL);
+    saved.state = _state;
+    saved.checksum = _hash(&saved, offsetof(_saved_t, checksum), 2166136261UL);
+    EEPROM.put(address, saved);
+    return true;
+}
+
+bool PerformanceStats::SaveIfDue(int address, const char * challengeName, unsigned long intervalMs)
+{
+    unsigned long now = HubClock::Millis();
+    if (_saved && (_state.level == _saved_level) && (now - _saved_ms < intervalMs)) {
+        return false;
+    }
+    if (!Save(address, challengeName)) {
+        return false;
+    }
+    _saved = true;
+    _saved_level = _state.level;
+    _saved_ms = now;
+    return true;
+}
+
+bool PerformanceStats::Load(int address, const char * challengeName)
+{
+    if ((address < 0) || (address + SaveSize() > EEPROM.length())) {
+        return false;
+    }
+    _saved_t saved;
+    EEPROM.get(address, saved);
+    if ((saved.magic != PERFORMANCE_STATS_MAGIC)
+            || (saved.name_hash != _hash(challengeName, strlen(challengeName), 2166136261UL))
+            || (saved.checksum != _hash(&saved, offsetof(_saved_t, checksum), 2166136261UL))) {
+        return false;
+    }
+    if (saved.state.history_length != _state.history_length) {
+        // the challenge looks at a different number of interactions now, only keep what still fits
+        unsigned char history_length = _state.history_length;
+        _state = saved.state;
+        _state.history_length = history_length;
+        while (_state.depth > history_length) {
+            _state.depth--;
+            if (_history_bit(_state.depth)) {
+                _state.successes--;
+            }
+        }
+        _trim_history();
+    }
+    else {
+        _state = saved.state;
+    }
+    // what is in EEPROM now, for SaveIfDue
+    _saved = true;
+    _saved_level = _state.level;
+    _saved_ms = HubClock::Millis();
+    return true;
+}
+
+bool PerformanceStats::_history_bit(unsigned char age) const
+{
+    return (_state.history[age / 32] >> (age % 32)) & 1;
+}
+
+void PerformanceStats::_trim_history()
+{
+    for (unsigned char i = 0; i < PERFORMANCE_HISTORY_WORDS; i++) {
+        unsigned int first = 32 * i; // age of bit 0 of this word
+        if (_state.history_length <= first) {
+            _state.history[i] = 0;
+        }
+        else if (_state.history_length < first + 32) {
+            _state.history[i] &= (1UL << (_state.history_length - first)) - 1;
+        }
+    }
+}
+
+size_t PerformanceStats::SaveSize()
+{
+    return sizeof(_saved_t);
+}
+
+uint32_t PerformanceStats::_hash(const void * data, size_t len, uint32_t hash)
+{
+    // FNV-1a
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+unsigned char PerformanceStats::_pad_index(unsigned char pad)
+{
+    switch (pad) {
+    case 0b001:
+        return 0;
+    case 0b010:
+        return 1;
+    case 0b100:
+        return 2;
+    default:
+        return 3;
+    }
+}
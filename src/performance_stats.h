@@ -0,0 +1,206 @@
+#ifndef PERFORMANCE_STATS_H
+#define PERFORMANCE_STATS_H
+
+#include "application.h"
+
+#define MAX_PERFORMANCE_HISTORY 128
+// the maximum number of interactions a PerformanceStats window can look back,
+// a multiple of 32; the examples look back up to 100
+
+#define PERFORMANCE_HISTORY_WORDS (MAX_PERFORMANCE_HISTORY / 32)
+
+#define PERFORMANCE_SAVE_INTERVAL_MS 1800000
+// SaveIfDue saves the history at most this often while the level stays the same
+
+#define NUM_REACTION_TIME_BUCKETS 48
+// quarter octave buckets from 16 ms to 65 s
+
+/*
+                            <<<     Reaction time histogram >>>
+                            <<<                             >>>
+
+    Log scale histogram of reaction times: adding a value is O(1), a
+    percentile costs one pass over NUM_REACTION_TIME_BUCKETS counters and is
+    accurate to a quarter octave (~19%). When a counter would overflow all
+    counters are halved, so old values slowly lose weight.
+*/
+
+class ReactionTimeHistogram
+{
+
+public:
+    ReactionTimeHistogram();
+
+    void Add(unsigned long ms);
+    // count one reaction time
+
+    void Reset();
+    // forget all reaction times
+
+    unsigned long Count() const;
+    // number of reaction times counted (after halving, if that happened)
+
+    unsigned long Percentile(unsigned char percentile) const;
+    // reaction time in ms below which percentile [0, 100] of the counted times fall, 0 if empty
+
+    unsigned short BucketCount(unsigned char bucket) const;
+    // raw counter of a bucket
+
+    static unsigned long BucketLowerBound(unsigned char bucket);
+    // smallest reaction time in ms that falls in bucket
+
+private:
+    static unsigned char _bucket_for(unsigned long ms);
+
+private:
+    unsigned short _counts[NUM_REACTION_TIME_BUCKETS];
+    unsigned long _total;
+};
+
+/*
+                            <<<     Performance statistics  >>>
+                            <<<                             >>>
+
+    Keeps track of how well a player is doing in a challenge, replacing the
+    performance[] array, countSuccesses() and countMisses() the examples
+    used to carry around. All updates are O(1):
+
+ * - success/miss counts over the last historyLength interactions
+ * - success and miss streaks
+ * - reaction time percentiles (see ReactionTimeHistogram)
+ * - accuracy per touchpad
+ * - the current level of the challenge
+
+    The whole state can be saved to and loaded from EEPROM, so a challenge
+    continues at the same level with the same history after a power loss.
+    EEPROM is flash on the Photon: SaveIfDue writes when the level changed
+    and otherwise every PERFORMANCE_SAVE_INTERVAL_MS, not after every
+    interaction.
+
+ * example:
+ *      PerformanceStats performance(15);
+ *      // setup()
+ *      if (performance.Load(0, "LearningLongerSequences"))
+ *          sequenceLength = performance.GetLevel();
+ *      // after each interaction
+ *      performance.AddResult(accurate);
+ *      if (performance.CountSuccesses() >= ENOUGH_SUCCESSES) { ... }
+ *      performance.SetLevel(sequenceLength);
+ *      performance.SaveIfDue(0, "LearningLongerSequences");
+*/
+
+class PerformanceStats
+{
+
+public:
+    PerformanceStats(unsigned char historyLength);
+    // historyLength: number of interactions to look back, [1, MAX_PERFORMANCE_HISTORY]
+
+    void AddResult(bool success);
+    // add the result of an interaction to the history
+
+    void ResetHistory();
+    // forget the history window (e.g. after a level change), streaks and other statistics are kept
+
+    unsigned char CountSuccesses() const;
+    // number of successes in the history window
+
+    unsigned char CountMisses() const;
+    // number of misses in the history window
+
+    unsigned char Depth() const;
+    // number of interactions in the history window, at most historyLength
+
+    float SuccessRate() const;
+    // fraction of successes in the history window, 0 if empty
+
+    bool GetResult(unsigned char age) const;
+    // result of an interaction in the window, age 0 is the most recent
+
+    unsigned int SuccessStreak() const;
+    // number of successes in a row up to the last interaction
+
+    unsigned int MissStreak() const;
+    // number of misses in a row up to the last interaction
+
+    unsigned int BestSuccessStreak() const;
+    // longest success streak seen
+
+    void AddReactionTime(unsigned long ms);
+    // add a reaction time to the reaction time histogram
+
+    unsigned long ReactionTimePercentile(unsigned char percentile) const;
+    // see ReactionTimeHistogram::Percentile
+
+    const ReactionTimeHistogram & ReactionTimes() const;
+    // the reaction time histogram itself
+
+    void AddPadResult(unsigned char pads, bool correct);
+    // count a touch of one or more pads (BUTTON_... bits), correct or not
+
+    float PadAccuracy(unsigned char pad) const;
+    // fraction of correct touches of a single pad (BUTTON_...), 0 if never touched
+
+    void SetLevel(int level);
+    // remember the current level, so it is saved with the rest
+
+    int GetLevel() const;
+    // the level set with SetLevel or loaded with Load
+
+    void Reset();
+    // forget everything except the history length
+
+    bool Save(int address, const char * challengeName) const;
+    // write the statistics to EEPROM at address, tagged with challengeName
+
+    bool SaveIfDue(int address, const char * challengeName, unsigned long intervalMs = PERFORMANCE_SAVE_INTERVAL_MS);
+    // Save if the level changed since the last save or load, or intervalMs passed since then
+    // returns true if it saved
+
+    bool Load(int address, const char * challengeName);
+    // read the statistics from EEPROM at address
+    // returns false (and changes nothing) if nothing valid was saved there for challengeName
+
+    static size_t SaveSize();
+    // number of EEPROM bytes Save uses
+
+private:
+    struct _state_t {
+        uint32_t history[PERFORMANCE_HISTORY_WORDS]; // bit i % 32 of word i / 32 is the result of the
+                                                     // interaction i places back, bit 0 of word 0 the most recent
+        unsigned char history_length;
+        unsigned char depth;
+        unsigned char successes;
+        unsigned int success_streak;
+        unsigned int miss_streak;
+        unsigned int best_success_streak;
+        unsigned short pad_touches[3];
+        unsigned short pad_correct[3];
+        int level;
+        ReactionTimeHistogram reaction_times;
+    };
+
+    struct _saved_t {
+        uint32_t magic;
+        uint32_t name_hash;
+        _state_t state;
+        uint32_t checksum;
+    };
+
+    static uint32_t _hash(const void * data, size_t len, uint32_t hash);
+
+    static unsigned char _pad_index(unsigned char pad);
+
+    bool _history_bit(unsigned char age) const;
+
+    void _trim_history();
+    // clears the bits past history_length
+
+private:
+    _state_t _state;
+    bool _saved = false; // _saved_level and _saved_ms are of a save or load
+    int _saved_level = 0;
+    unsigned long _saved_ms = 0;
+};
+
+#endif
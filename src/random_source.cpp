@@ -0,0 +1,134 @@
+#include "random_source.h"
+
+RandomSource::RandomSource(uint32_t seed, uint32_t stream)
+{
+    Seed(seed, stream);
+}
+
+void RandomSource::Seed(uint32_t seed, uint32_t stream)
+{
+    // PCG32 initialization, see pcg-random.org
+    _state = 0;
+    _increment = ((uint64_t)stream << 1) | 1;
+    Next();
+    _state += seed;
+    Next();
+}
+
+void RandomSource::SeedFromHardware()
+{
+    Seed(HAL_RNG_GetRandomNumber(), HAL_RNG_GetRandomNumber());
+}
+
+uint32_t RandomSource::Next()
+{
+    uint64_t old = _state;
+    _state = old * 6364136223846793005ULL + _increment;
+    uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rotation = (uint32_t)(old >> 59);
+    return (shifted >> rotation) | (shifted << ((32 - rotation) & 31));
+}
+
+uint32_t RandomSource::Below(uint32_t bound)
+{
+    if (bound == 0) {
+        return 0;
+    }
+    // reject the few numbers that would make small results more likely
+    uint32_t threshold = (0 - bound) % bound;
+    for (;;) {
+        uint32_t value = Next();
+        if (value >= threshold) {
+            return value % bound;
+        }
+    }
+}
+
+long RandomSource::Between(long min, long max)
+{
+    if (max <= min) {
+        return min;
+    }
+    return min + (long)Below((uint32_t)(max - min));
+}
+
+bool RandomSource::Chance(uint16_t perMille)
+{
+    return Below(1000) < perMille;
+}
+
+unsigned int RandomSource::WeightedChoice(const unsigned int * weights, unsigned int count)
+{
+    uint32_t total = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        total += weights[i];
+    }
+    if (total == 0) {
+        return count;
+    }
+    uint32_t pick = Below(total);
+    for (unsigned int i = 0; i < count; i++) {
+        if (pick < weights[i]) {
+            return i;
+        }
+        pick -= weights[i];
+    }
+    return count - 1; // not reached
+}
+
+unsigned char RandomSource::Bits(unsigned char mask, unsigned char count)
+{
+    unsigned char chosen = 0;
+    unsigned char available = 0;
+    for (unsigned char rest = mask; rest; rest &= rest - 1) {
+        available++;
+    }
+    // pick each bit with the probability (bits still needed) / (bits left)
+    for (unsigned char bit = 1; bit && (count > 0); bit <<= 1) {
+        if (!(mask & bit)) {
+            continue;
+        }
+        if (Below(available) < count) {
+            chosen |= bit;
+            count--;
+        }
+        available--;
+    }
+    return chosen;
+}
+
+RandomDeck::RandomDeck(RandomSource & random, unsigned char size)
+    : _random(random), _size(size), _next(0)
+{
+    if (_size < 1) {
+        _size = 1;
+    }
+    if (_size > MAX_RANDOM_DECK) {
+        _size = MAX_RANDOM_DECK;
+    }
+    for (unsigned char i = 0; i < _size; i++) {
+        _cards[i] = i;
+    }
+    Reset();
+}
+
+unsigned char RandomDeck::Deal()
+{
+    if (_next == _size) {
+        unsigned char last = _cards[_size - 1];
+        Reset();
+        if ((_size > 1) && (_cards[0] == last)) {
+            // swap it with any other card
+            unsigned char other = 1 + _random.Below(_size - 1);
+            _cards[0] = _cards[other];
+            _cards[other] = last;
+        }
+    }
+    return _cards[_next++];
+}
+
+void RandomDeck::Reset()
+{
+    _random.Shuffle(_cards, _size);
+    _next = 0;
+}
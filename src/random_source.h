@@ -0,0 +1,104 @@
+#ifndef RANDOM_SOURCE_H
+#define RANDOM_SOURCE_H
+
+#include "application.h"
+
+#define MAX_RANDOM_DECK 16
+// most items a RandomDeck can deal
+
+/*
+                            <<<     Random source           >>>
+                            <<<                             >>>
+
+    A small seeded random number generator (PCG32: 8 bytes of state plus
+    the stream, a multiply and a few shifts per number) with the picks the
+    games need: shuffles, weighted choices and random sets of touchpads.
+    Nothing is allocated, so it can be used in every interaction without
+    growing the heap.
+
+    HubInterface::Initialize seeds the hub's source (hub.Random()) from the
+    hardware random number generator; HubInterface::SeedRandom gives it a
+    fixed seed instead, so a simulated run picks the same touchpads and
+    colors every time.
+*/
+
+class RandomSource
+{
+
+public:
+    RandomSource(uint32_t seed = 1, uint32_t stream = 0);
+
+    void Seed(uint32_t seed, uint32_t stream = 0);
+    // same seed and stream, same numbers
+
+    void SeedFromHardware();
+    // seed from the hardware random number generator
+
+    uint32_t Next();
+    // 32 random bits
+
+    uint32_t Below(uint32_t bound);
+    // uniform in [0, bound), 0 if bound is 0
+
+    long Between(long min, long max);
+    // uniform in [min, max) like random(min, max), min if max <= min
+
+    bool Chance(uint16_t perMille);
+    // true with a probability of perMille / 1000
+
+    unsigned int WeightedChoice(const unsigned int * weights, unsigned int count);
+    // index i chosen with probability weights[i] / sum of all weights,
+    // count if all weights are 0
+
+    unsigned char Bits(unsigned char mask, unsigned char count);
+    // count randomly chosen bits of mask, e.g. Bits(LIGHT_BTNS, 2) for two
+    // of the three touchpads; all bits of mask if it has fewer
+
+    template <typename T> void Shuffle(T * items, unsigned int count)
+    // puts items in random order (Fisher-Yates), replaces random_shuffle
+    {
+        for (unsigned int i = count; i > 1; i--) {
+            unsigned int j = Below(i);
+            T item = items[i - 1];
+            items[i - 1] = items[j];
+            items[j] = item;
+        }
+    }
+
+private:
+    uint64_t _state;
+    uint64_t _increment;
+};
+
+/*
+                            <<<     Random deck             >>>
+                            <<<                             >>>
+
+    Deals the numbers 0 .. size-1 in random order without repeating one
+    until all have been dealt, then shuffles again; the first number of a
+    new round is never the last one of the previous round. Good for
+    picking targets or probes that should all come up equally often but
+    not predictably.
+*/
+
+class RandomDeck
+{
+
+public:
+    RandomDeck(RandomSource & random, unsigned char size);
+    // size: 1 .. MAX_RANDOM_DECK
+
+    unsigned char Deal();
+    // the next number
+
+    void Reset();
+    // shuffle and start a new round
+
+private:
+    RandomSource & _random;
+    unsigned char _size;
+    unsigned char _next;
+    unsigned char _cards[MAX_RANDOM_DECK];
+};
+
+#endif
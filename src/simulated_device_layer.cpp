@@ -0,0 +1,403 @@
+#include "hackerpet.h"
+
+SimulatedDeviceLayer::SimulatedDeviceLayer()
+    : _fm_state(HubInterface::FOODMACHINE_IDLE)
+{
+    memset(_lights, 0, sizeof(_lights));
+    memset(_config, 0, sizeof(_config));
+    memset(_frames, 0, sizeof(_frames));
+    memset(_state_ms, 0, sizeof(_state_ms));
+}
+
+void SimulatedDeviceLayer::Begin()
+{
+    _fm_state_start_ms = HubClock::Millis();
+    _fm_accounted_ms = _fm_state_start_ms;
+}
+
+int SimulatedDeviceLayer::available()
+{
+    if ((_out_at >= _out_len) || ((int32_t)(HubClock::Millis() - _out_due_ms) < 0)) {
+        return 0;
+    }
+    return _out_len - _out_at;
+}
+
+int SimulatedDeviceLayer::read()
+{
+    if (available() == 0) {
+        return -1;
+    }
+    char c = _out[_out_at++];
+    if (_out_at == _out_len) {
+        unsigned long latency = HubClock::Millis() - _out_due_ms;
+        if ((_replies == 0) || (latency < _latency_min)) {
+            _latency_min = latency;
+        }
+        if (latency > _latency_max) {
+            _latency_max = latency;
+        }
+        _latency_sum += latency;
+        _replies++;
+    }
+    return c;
+}
+
+int SimulatedDeviceLayer::peek()
+{
+    return (available() > 0) ? _out[_out_at] : -1;
+}
+
+size_t SimulatedDeviceLayer::write(uint8_t c)
+{
+    if (c == '$') {
+        _in_len = 0; // a new frame, whatever came before
+    }
+    if (_in_len >= sizeof(_in) - 1) {
+        return 1; // not a frame, wait for the next '$'
+    }
+    _in[_in_len++] = c;
+    if ((c == '.') && (_in[0] == '$') && (_in_len >= 8)) {
+        _in[_in_len] = 0;
+        _handle_frame();
+        _in_len = 0;
+    }
+    return 1;
+}
+
+void SimulatedDeviceLayer::flush()
+{
+}
+
+void SimulatedDeviceLayer::Touch(unsigned char pads, unsigned long durationMs)
+{
+    _touch_pads = pads;
+    _touch_until_ms = HubClock::Millis() + durationMs;
+}
+
+void SimulatedDeviceLayer::EatFoodtreat()
+{
+    if ((_fm_state == HubInterface::FOODMACHINE_MOVING_PRESENT) || (_fm_state == HubInterface::FOODMACHINE_WAIT)) {
+        _foodtreat_eaten = _foodtreat_on_tray;
+    }
+}
+
+void SimulatedDeviceLayer::SetEatChance(uint16_t perMille)
+{
+    _eat_chance = perMille;
+}
+
+void SimulatedDeviceLayer::SetOutOfFood(bool outOfFood)
+{
+    _out_of_food = outOfFood;
+}
+
+void SimulatedDeviceLayer::JamPlatter(unsigned long durationMs)
+{
+    unsigned long now = HubClock::Millis();
+    _update_foodmachine(now);
+    _jam_until_ms = now + durationMs;
+    _enter(HubInterface::FOODMACHINE_PLATTER_ERROR_CODE, now, 0);
+}
+
+void SimulatedDeviceLayer::SetReplyLatency(unsigned long ms)
+{
+    _reply_latency_ms = ms;
+}
+
+void SimulatedDeviceLayer::SetReplyLoss(uint16_t perMille)
+{
+    _reply_loss = perMille;
+}
+
+void SimulatedDeviceLayer::Seed(uint32_t seed)
+{
+    _random.Seed(seed);
+}
+
+unsigned long SimulatedDeviceLayer::Frames(char token) const
+{
+    return ((token >= 'A') && (token <= 'Z')) ? _frames[token - 'A'] : 0;
+}
+
+unsigned long SimulatedDeviceLayer::Replies() const
+{
+    return _replies;
+}
+
+unsigned long SimulatedDeviceLayer::RepliesLost() const
+{
+    return _replies_lost;
+}
+
+unsigned long SimulatedDeviceLayer::SamplesRejected() const
+{
+    return _samples_rejected;
+}
+
+unsigned long SimulatedDeviceLayer::FoodtreatsPresented() const
+{
+    return _presented;
+}
+
+unsigned long SimulatedDeviceLayer::FoodtreatsEaten() const
+{
+    return _eaten;
+}
+
+unsigned long SimulatedDeviceLayer::LatencyMin() const
+{
+    return _latency_min;
+}
+
+unsigned long SimulatedDeviceLayer::LatencyMax() const
+{
+    return _latency_max;
+}
+
+unsigned long SimulatedDeviceLayer::LatencyMean() const
+{
+    return (_replies == 0) ? 0 : (unsigned long)(_latency_sum / _replies);
+}
+
+uint64_t SimulatedDeviceLayer::MillisInState(unsigned char foodmachineState) const
+{
+    return (foodmachineState < NUM_SIM_FOODMACHINE_STATES) ? _state_ms[foodmachineState] : 0;
+}
+
+unsigned char SimulatedDeviceLayer::FoodmachineState() const
+{
+    return _fm_state;
+}
+
+unsigned char SimulatedDeviceLayer::Light(unsigned char light) const
+{
+    for (unsigned char i = 0; i < 4; i++) {
+        if (light == (1 << i)) {
+            return _lights[i];
+        }
+    }
+    return 0;
+}
+
+unsigned char SimulatedDeviceLayer::LitPads() const
+{
+    return (_lights[0] ? 1 : 0) | (_lights[1] ? 2 : 0) | (_lights[2] ? 4 : 0);
+}
+
+/*
+                            <<<   SimulatedDeviceLayer::_handle_frame >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    answer the command frame in _in like the device layer would
+*/
+void SimulatedDeviceLayer::_handle_frame()
+{
+    unsigned long now = HubClock::Millis();
+    char token = _in[5];
+    const char * payload = &_in[7];
+    char reply[MAX_SIM_DL_FRAME];
+    char status = '1';
+    reply[0] = 0;
+
+    _update_foodmachine(now);
+    if ((token >= 'A') && (token <= 'Z')) {
+        _frames[token - 'A']++;
+    }
+
+    unsigned char touched = _touched(now);
+    switch (token) {
+    case 'B':
+        snprintf(reply, sizeof(reply), "%c%c%c%03u%03u%03u%03u%03u%03u",
+                 '0' + (touched & 1), '0' + ((touched >> 1) & 1), '0' + ((touched >> 2) & 1),
+                 _baseline, _baseline, _baseline,
+                 _baseline - ((touched & 1) ? SIM_DL_TOUCH_DELTA : 0),
+                 _baseline - ((touched & 2) ? SIM_DL_TOUCH_DELTA : 0),
+                 _baseline - ((touched & 4) ? SIM_DL_TOUCH_DELTA : 0));
+        break;
+    case 'G':
+        snprintf(reply, sizeof(reply), "%c%c%c", '0' + (touched & 1), '0' + ((touched >> 1) & 1), '0' + ((touched >> 2) & 1));
+        break;
+    case 'Z':
+        snprintf(reply, sizeof(reply), "%c%c%c%c%c0%c0%c%c0",
+                 (_fm_state == HubInterface::FOODMACHINE_DISPENSING) ? '1' : '0',
+                 ((_fm_state == HubInterface::FOODMACHINE_MOVING_PRESENT) || (_fm_state == HubInterface::FOODMACHINE_MOVING_HOME)) ? '1' : '0',
+                 '0' + (touched & 1), '0' + ((touched >> 1) & 1), '0' + ((touched >> 2) & 1),
+                 ((int32_t)(now - _sample_until_ms) < 0) ? '1' : '0',
+                 _foodtreat_left ? '1' : '0',
+                 '0' + _fm_state);
+        break;
+    case 'P':
+        if ((int32_t)(now - _sample_until_ms) < 0) {
+            status = '0'; // still playing the last one
+            _samples_rejected++;
+        }
+        else {
+            _sample_until_ms = now + SIM_DL_SAMPLE_MS;
+        }
+        break;
+    case 'T':
+        if (_fm_state == HubInterface::FOODMACHINE_IDLE) {
+            _present_ms = 100UL * (10 * (payload[0] - '0') + (payload[1] - '0'));
+            _foodtreat_eaten = false;
+            _presented++;
+            _enter(HubInterface::FOODMACHINE_MOVING_PRESENT, now, SIM_DL_MOVE_MS);
+        }
+        else {
+            status = '0';
+        }
+        break;
+    case 'X':
+        if ((_fm_state == HubInterface::FOODMACHINE_MOVING_PRESENT) || (_fm_state == HubInterface::FOODMACHINE_WAIT)) {
+            _enter(HubInterface::FOODMACHINE_MOVING_HOME, now, SIM_DL_MOVE_MS);
+        }
+        break;
+    case 'F':
+        if ((_fm_state == HubInterface::FOODMACHINE_PLATTER_ERROR_CODE) && ((int32_t)(now - _jam_until_ms) < 0)) {
+            break; // still jammed
+        }
+        _enter(HubInterface::FOODMACHINE_MOVING_HOME, now, SIM_DL_MOVE_MS);
+        break;
+    case 'M':
+    case 'L':
+        _set_lights(payload, 2); // yellow, blue
+        break;
+    case 'I':
+    case 'H':
+        _set_lights(payload, 3); // red, green, blue
+        break;
+    case 'U':
+    {
+        unsigned int id = 10 * (payload[0] - '0') + (payload[1] - '0');
+        snprintf(reply, sizeof(reply), "%02u%05u", id, (id < NUM_SIM_DL_CONFIG) ? _config[id] : 0);
+        break;
+    }
+    case 'N':
+    {
+        unsigned int id = 0;
+        unsigned int value = 0;
+        if ((sscanf(payload, "%2u%5u", &id, &value) == 2) && (id < NUM_SIM_DL_CONFIG)) {
+            _config[id] = value;
+        }
+        break;
+    }
+    default:
+        break; // tones and resets only need the answer
+    }
+    _reply(token, status, reply);
+}
+
+void SimulatedDeviceLayer::_reply(char token, char status, const char * payload)
+{
+    if ((_reply_loss > 0) && _random.Chance(_reply_loss)) {
+        _replies_lost++;
+        _out_len = 0;
+        _out_at = 0;
+        return;
+    }
+    int len = snprintf(_out, sizeof(_out), "$%03u%c%c%c%s.", (unsigned int)strlen(payload), _in[4], token, status, payload);
+    _out_len = (len > 0) ? len : 0;
+    _out_at = 0;
+    _out_due_ms = HubClock::Millis() + _reply_latency_ms;
+    HubClock::WakeAt(_out_due_ms);
+}
+
+/*
+                            <<<   SimulatedDeviceLayer::_update_foodmachine >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    move the food machine through every state that ended by now
+
+    <<<PARAMS>>>
+    now: HubClock::Millis()
+*/
+void SimulatedDeviceLayer::_update_foodmachine(unsigned long now)
+{
+    // 32 bit differences, across the millis() wrap also where unsigned long is wider
+    while ((_fm_state_ms != 0) && ((uint32_t)(now - _fm_state_start_ms) >= _fm_state_ms)) {
+        unsigned long end = (uint32_t)(_fm_state_start_ms + _fm_state_ms);
+        switch (_fm_state) {
+        case HubInterface::FOODMACHINE_MOVING_PRESENT:
+            if (!_foodtreat_eaten && _foodtreat_on_tray && (_eat_chance > 0) && _random.Chance(_eat_chance)) {
+                _foodtreat_eaten = true;
+            }
+            _enter(HubInterface::FOODMACHINE_WAIT, end, _present_ms);
+            break;
+        case HubInterface::FOODMACHINE_WAIT:
+            _enter(HubInterface::FOODMACHINE_MOVING_HOME, end, SIM_DL_MOVE_MS);
+            break;
+        case HubInterface::FOODMACHINE_MOVING_HOME:
+            _enter(HubInterface::FOODMACHINE_CHECK, end, SIM_DL_CHECK_MS);
+            break;
+        case HubInterface::FOODMACHINE_CHECK:
+            if (_foodtreat_eaten) {
+                _eaten++;
+                _foodtreat_on_tray = false;
+                _foodtreat_eaten = false;
+            }
+            _foodtreat_left = _foodtreat_on_tray;
+            if (_foodtreat_on_tray) {
+                _enter(HubInterface::FOODMACHINE_IDLE, end, 0);
+            }
+            else {
+                _enter(HubInterface::FOODMACHINE_DISPENSING, end, SIM_DL_DISPENSE_MS);
+            }
+            break;
+        case HubInterface::FOODMACHINE_DISPENSING:
+            if (_out_of_food) {
+                _enter(HubInterface::FOODMACHINE_FOODTREAT_ERROR_CODE, end, SIM_DL_DISPENSE_MS);
+            }
+            else {
+                _foodtreat_on_tray = true;
+                _enter(HubInterface::FOODMACHINE_IDLE, end, 0);
+            }
+            break;
+        case HubInterface::FOODMACHINE_FOODTREAT_ERROR_CODE:
+            // tries again until there is food
+            _enter(HubInterface::FOODMACHINE_DISPENSING, end, SIM_DL_DISPENSE_MS);
+            break;
+        default:
+            _fm_state_ms = 0;
+            break;
+        }
+    }
+    _state_ms[_fm_state] += (uint32_t)(now - _fm_accounted_ms);
+    _fm_accounted_ms = now;
+}
+
+void SimulatedDeviceLayer::_enter(unsigned char state, unsigned long now, unsigned long forMs)
+{
+    _state_ms[_fm_state] += (uint32_t)(now - _fm_accounted_ms);
+    _fm_accounted_ms = now;
+    _fm_state = state;
+    _fm_state_start_ms = now;
+    _fm_state_ms = forMs; // the hub only sees the change at its next poll, no need to wake it
+}
+
+unsigned char SimulatedDeviceLayer::_touched(unsigned long now) const
+{
+    return ((int32_t)(now - _touch_until_ms) < 0) ? _touch_pads : 0;
+}
+
+// payload of a light frame: the LightsNum2Token letter, then two digits per color
+void SimulatedDeviceLayer::_set_lights(const char * payload, unsigned char colors)
+{
+    unsigned char whichLights = payload[0] - 'A' + 1;
+    if ((payload[0] < 'A') || (whichLights > 15)) {
+        return;
+    }
+    unsigned char brightest = 0;
+    for (unsigned char i = 0; i < colors; i++) {
+        unsigned char level = 10 * (payload[1 + 2 * i] - '0') + (payload[2 + 2 * i] - '0');
+        if (level > brightest) {
+            brightest = level;
+        }
+    }
+    for (unsigned char i = 0; i < 4; i++) {
+        if (whichLights & (1 << i)) {
+            _lights[i] = brightest;
+        }
+    }
+}
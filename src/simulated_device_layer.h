@@ -0,0 +1,175 @@
+#ifndef SIMULATED_DEVICE_LAYER_H
+#define SIMULATED_DEVICE_LAYER_H
+
+#include "application.h"
+#include "random_source.h"
+
+#define MAX_SIM_DL_FRAME 40
+// longest frame the simulated device layer reads or writes
+
+#define NUM_SIM_DL_CONFIG 32
+// config ids the simulated device layer stores ('U' / 'N')
+
+#define NUM_SIM_FOODMACHINE_STATES 18
+// FOODMACHINE_... values up to FOODMACHINE_FOODTREAT_ERROR_CODE
+
+#define SIM_DL_MOVE_MS 1500
+// the platter moving out to present or back home
+
+#define SIM_DL_CHECK_MS 300
+// looking for a foodtreat in the bowl
+
+#define SIM_DL_DISPENSE_MS 1000
+
+#define SIM_DL_SAMPLE_MS 800
+// how long a sample plays
+
+#define SIM_DL_TOUCH_DELTA 60
+// baseline minus reading of a touched pad, above every touch threshold
+
+/*
+                            <<<     Simulated device layer  >>>
+                            <<<                             >>>
+
+    Stands in for the hub's device layer on the other end of Serial1:
+    HubInterface::SetDeviceLayerLink points the hub at it, it reads the
+    command frames the hub writes and answers each one after a reply
+    latency, on HubClock time. It models what the replies report:
+
+    - touchpads, touched with Touch() (readings below the baseline)
+    - the food machine: presenting, waiting, moving home, checking and
+      dispensing, with an eaten or uneaten foodtreat, running out of food
+      and platter jams
+    - samples playing for a while ('P' is rejected while one plays)
+    - how bright each light was last set, for a SimulatedPet to look at
+    - config values ('U' and 'N')
+    - lost replies, with a chance per reply
+
+    It also counts frames per token, reply latencies (reply due until the
+    hub read it) and the time spent in each food machine state, for
+    HubSimulation to report.
+*/
+
+class SimulatedDeviceLayer : public Stream
+{
+
+public:
+    SimulatedDeviceLayer();
+
+    void Begin();
+    // the food machine is idle from now, on the selected HubClock
+
+    // Stream, used by HubInterface
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    using Stream::write;
+    void flush() override;
+
+    void Touch(unsigned char pads, unsigned long durationMs);
+    // BUTTON_... bits touched from now for durationMs
+
+    void EatFoodtreat();
+    // the foodtreat on the presented tray is taken
+
+    void SetEatChance(uint16_t perMille);
+    // chance a presented foodtreat gets eaten without EatFoodtreat, default 0
+
+    void SetOutOfFood(bool outOfFood);
+
+    void JamPlatter(unsigned long durationMs);
+    // the platter reports FOODMACHINE_PLATTER_ERROR_CODE until then and until a reset
+
+    void SetReplyLatency(unsigned long ms);
+    // default 3
+
+    void SetReplyLoss(uint16_t perMille);
+    // chance a reply never comes, default 0
+
+    void Seed(uint32_t seed);
+    // for the eat chance and reply loss
+
+    unsigned long Frames(char token) const;
+    // frames received with that token
+
+    unsigned long Replies() const;
+
+    unsigned long RepliesLost() const;
+
+    unsigned long SamplesRejected() const;
+
+    unsigned long FoodtreatsPresented() const;
+
+    unsigned long FoodtreatsEaten() const;
+
+    unsigned long LatencyMin() const;
+    unsigned long LatencyMax() const;
+    unsigned long LatencyMean() const;
+    // ms from a reply being due until the hub read all of it
+
+    uint64_t MillisInState(unsigned char foodmachineState) const;
+
+    unsigned char FoodmachineState() const;
+
+    unsigned char Light(unsigned char light) const;
+    // 0 to 99, the brightest color one LIGHT_... light was last set to, blinking or not
+
+    unsigned char LitPads() const;
+    // LIGHT_LEFT, LIGHT_MIDDLE and LIGHT_RIGHT bits of the touchpad lights that are on
+
+private:
+    void _handle_frame();
+    void _reply(char token, char status, const char * payload);
+    void _update_foodmachine(unsigned long now);
+    void _enter(unsigned char state, unsigned long now, unsigned long forMs);
+    unsigned char _touched(unsigned long now) const;
+    void _set_lights(const char * payload, unsigned char colors);
+
+private:
+    char _in[MAX_SIM_DL_FRAME]; // the frame being received
+    unsigned char _in_len = 0;
+    char _out[MAX_SIM_DL_FRAME]; // the reply being read by the hub
+    unsigned char _out_len = 0;
+    unsigned char _out_at = 0;
+    unsigned long _out_due_ms = 0;
+
+    unsigned long _reply_latency_ms = 3;
+    uint16_t _reply_loss = 0;
+    RandomSource _random;
+
+    unsigned char _touch_pads = 0;
+    unsigned long _touch_until_ms = 0;
+    unsigned short _baseline = 500;
+
+    unsigned char _fm_state; // FOODMACHINE_...
+    unsigned long _fm_state_start_ms = 0;
+    unsigned long _fm_state_ms = 0; // how long the state lasts, 0 until something changes it
+    unsigned long _fm_accounted_ms = 0;
+    unsigned long _present_ms = 0; // of the last 'T', 0 until 'X'
+    bool _foodtreat_on_tray = true;
+    bool _foodtreat_eaten = false;
+    bool _foodtreat_left = false; // the last check found the foodtreat still in the bowl
+    bool _out_of_food = false;
+    unsigned long _jam_until_ms = 0;
+    uint16_t _eat_chance = 0;
+
+    unsigned long _sample_until_ms = 0;
+
+    unsigned char _lights[4]; // per LIGHT_... bit, left, middle, right, cue
+
+    unsigned int _config[NUM_SIM_DL_CONFIG];
+
+    unsigned long _frames[26]; // per token 'A'...'Z'
+    unsigned long _replies = 0;
+    unsigned long _replies_lost = 0;
+    unsigned long _samples_rejected = 0;
+    unsigned long _presented = 0;
+    unsigned long _eaten = 0;
+    unsigned long _latency_min = 0;
+    unsigned long _latency_max = 0;
+    uint64_t _latency_sum = 0;
+    uint64_t _state_ms[NUM_SIM_FOODMACHINE_STATES];
+};
+
+#endif
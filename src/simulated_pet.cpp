@@ -0,0 +1,244 @@
+#include "hackerpet.h"
+#include <math.h>
+
+void SimulatedPet::PrintStats(Print & out)
+{
+}
+
+LearningPet::LearningPet(uint32_t seed)
+    : _random(seed)
+{
+    SetTraits(_traits);
+}
+
+void LearningPet::SetTraits(const PetTraits & traits)
+{
+    _traits = traits;
+    _accuracy = traits.accuracy;
+    _satiety = 0;
+    _boredom = 0;
+    _started = false;
+    _seen = 0;
+    _playing = false;
+    _touch_planned = false;
+    _waiting_for_reward = false;
+    _eat_planned = false;
+    _touches = 0;
+    _rewards = 0;
+    _foodtreats = 0;
+    _ignored = 0;
+}
+
+const PetTraits & LearningPet::Traits() const
+{
+    return _traits;
+}
+
+void LearningPet::Seed(uint32_t seed)
+{
+    _random.Seed(seed);
+}
+
+/*
+                            <<<   LearningPet::Act          >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    one look at the hub: go for a foodtreat that came out, decide whether
+    to play the lights, touch when a planned touch is due
+
+    <<<PARAMS>>>
+    dl: the device layer of the simulation
+    now: HubClock::Millis()
+*/
+void LearningPet::Act(SimulatedDeviceLayer & dl, unsigned long now)
+{
+    if (!_started) {
+        _started = true;
+        _worn_off_ms = now;
+        _touch_end_ms = now;
+        _presented_seen = dl.FoodtreatsPresented();
+        _next_explore_ms = now + _traits.explore_ms;
+    }
+
+    if (dl.FoodtreatsPresented() != _presented_seen) {
+        // a foodtreat came out, for the last touch if it was not long ago
+        _presented_seen = dl.FoodtreatsPresented();
+        if (_waiting_for_reward && (now - _last_touch_ms <= SIM_PET_REWARD_MS)) {
+            _reward(now);
+        }
+        _waiting_for_reward = false;
+        _wear_off(now);
+        _eat_planned = _random.Chance((uint16_t)(1000 * (1 - _satiety)));
+        if (_eat_planned) {
+            _eat_at_ms = now + _reaction();
+            HubClock::WakeAt(_eat_at_ms);
+        }
+    }
+    else if (_waiting_for_reward && (now - _last_touch_ms > SIM_PET_REWARD_MS)) {
+        // nothing came of the last touches
+        _waiting_for_reward = false;
+        _wear_off(now);
+        _boredom = min(1.0f, _boredom + _traits.boredom_per_miss / 1000.0f);
+    }
+    if (_eat_planned && ((int32_t)(now - _eat_at_ms) >= 0)) {
+        unsigned char state = dl.FoodmachineState();
+        if (state == HubInterface::FOODMACHINE_WAIT) {
+            dl.EatFoodtreat();
+            _eat_planned = false;
+            _foodtreats++;
+            _wear_off(now);
+            _satiety = min(1.0f, _satiety + _traits.satiety_per_foodtreat / 1000.0f);
+        }
+        else if (state != HubInterface::FOODMACHINE_MOVING_PRESENT) {
+            _eat_planned = false; // the tray went home before the pet got there
+        }
+    }
+
+    uint32_t lights = dl.Light(HubInterface::LIGHT_LEFT) | (dl.Light(HubInterface::LIGHT_MIDDLE) << 8)
+                      | ((uint32_t)dl.Light(HubInterface::LIGHT_RIGHT) << 16);
+    if (lights != _seen) {
+        // a new stimulus
+        _seen = lights;
+        _touch_planned = false;
+        _next_explore_ms = now + _traits.explore_ms;
+        _playing = (lights != 0) && _feels_like_playing(now);
+    }
+    else if ((lights != 0) && !_playing && !_touch_planned
+             && ((int32_t)(now - _look_again_ms) >= 0) && ((int32_t)(now - _touch_end_ms) >= 0)) {
+        _playing = _feels_like_playing(now);
+    }
+
+    if (_touch_planned) {
+        if ((int32_t)(now - _touch_at_ms) >= 0) {
+            _touch(dl, now);
+        }
+    }
+    else if (_playing && ((int32_t)(now - _touch_end_ms) >= 0)) {
+        _touch_planned = true;
+        _touch_at_ms = now + _reaction();
+        HubClock::WakeAt(_touch_at_ms);
+    }
+    else if ((lights == 0) && (_traits.explore_ms > 0) && (dl.FoodmachineState() == HubInterface::FOODMACHINE_IDLE)
+             && ((int32_t)(now - _next_explore_ms) >= 0)) {
+        _wear_off(now);
+        if (_random.Chance((uint16_t)(1000 * (1 - _satiety) * (1 - _boredom)))) {
+            _touch(dl, now);
+        }
+        _next_explore_ms = now + _random.Between(_traits.explore_ms / 2, _traits.explore_ms * 3 / 2 + 1);
+        HubClock::WakeAt(_next_explore_ms);
+    }
+}
+
+void LearningPet::PrintStats(Print & out)
+{
+    unsigned long now = HubClock::Millis();
+    out.printlnf("pet: %lu touches, %lu rewarded, %lu foodtreats taken, %lu times not in the mood",
+                 _touches, _rewards, _foodtreats, _ignored);
+    out.printlnf("pet: accuracy %u, satiety %u, boredom %u (per mille)", Accuracy(), Satiety(now), Boredom(now));
+}
+
+uint16_t LearningPet::Accuracy() const
+{
+    return (uint16_t)_accuracy;
+}
+
+uint16_t LearningPet::Satiety(unsigned long now)
+{
+    _wear_off(now);
+    return (uint16_t)(1000 * _satiety);
+}
+
+uint16_t LearningPet::Boredom(unsigned long now)
+{
+    _wear_off(now);
+    return (uint16_t)(1000 * _boredom);
+}
+
+unsigned long LearningPet::Touches() const
+{
+    return _touches;
+}
+
+unsigned long LearningPet::Rewards() const
+{
+    return _rewards;
+}
+
+unsigned long LearningPet::Foodtreats() const
+{
+    return _foodtreats;
+}
+
+unsigned long LearningPet::StimuliIgnored() const
+{
+    return _ignored;
+}
+
+void LearningPet::_wear_off(unsigned long now)
+{
+    unsigned long ms = now - _worn_off_ms;
+    if (ms == 0) {
+        return;
+    }
+    _worn_off_ms = now;
+    _satiety = (_traits.satiety_half_life_min > 0) ? _satiety * powf(0.5f, ms / (60000.0f * _traits.satiety_half_life_min)) : 0;
+    _boredom = (_traits.boredom_half_life_min > 0) ? _boredom * powf(0.5f, ms / (60000.0f * _traits.boredom_half_life_min)) : 0;
+}
+
+unsigned long LearningPet::_reaction()
+{
+    long spread = min(_traits.reaction_spread_ms, _traits.reaction_ms);
+    return _traits.reaction_ms + _random.Between(-spread, spread + 1);
+}
+
+// touches the brightest lit pad if the pet aims well this time, a random pad otherwise
+void LearningPet::_touch(SimulatedDeviceLayer & dl, unsigned long now)
+{
+    unsigned char brightest = 0;
+    unsigned char pads = 0;
+    for (unsigned char pad = HubInterface::LIGHT_LEFT; pad <= HubInterface::LIGHT_RIGHT; pad <<= 1) {
+        unsigned char level = dl.Light(pad);
+        if ((level > 0) && (level >= brightest)) {
+            pads = (level > brightest) ? pad : (pads | pad);
+            brightest = level;
+        }
+    }
+    unsigned char touch;
+    if ((pads != 0) && _random.Chance((uint16_t)_accuracy)) {
+        touch = _random.Bits(pads, 1);
+    }
+    else {
+        touch = 1 << _random.Below(3);
+    }
+    dl.Touch(touch, _traits.touch_ms);
+
+    _waiting_for_reward = true;
+    _last_touch_ms = now;
+    _touch_end_ms = now + _traits.touch_ms;
+    _next_explore_ms = now + _traits.explore_ms;
+    _touch_planned = false;
+    _playing = false; // the next touch is a new decision
+    _touches++;
+}
+
+void LearningPet::_reward(unsigned long now)
+{
+    _rewards++;
+    _accuracy += (_traits.max_accuracy - _accuracy) * _traits.learning_rate / 1000.0f;
+    _wear_off(now);
+    _boredom = max(0.0f, _boredom - _traits.boredom_per_miss / 1000.0f);
+}
+
+// plays the stimulus with a chance of (1 - satiety) * (1 - boredom), looks again after rest_ms if not
+bool LearningPet::_feels_like_playing(unsigned long now)
+{
+    _wear_off(now);
+    if (_random.Chance((uint16_t)(1000 * (1 - _satiety) * (1 - _boredom)))) {
+        return true;
+    }
+    _ignored++;
+    _look_again_ms = now + _traits.rest_ms;
+    HubClock::WakeAt(_look_again_ms);
+    return false;
+}
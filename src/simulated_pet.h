@@ -0,0 +1,161 @@
+#ifndef SIMULATED_PET_H
+#define SIMULATED_PET_H
+
+#include "application.h"
+#include "random_source.h"
+
+class SimulatedDeviceLayer;
+
+#define SIM_PET_REWARD_MS 15000
+// a foodtreat presented this long after a touch rewards that touch
+
+/*
+                            <<<     Simulated pet           >>>
+                            <<<                             >>>
+
+    Plays the hub of a HubSimulation (see HubSimulation::SetPet): before
+    every loop of the game it looks at what the SimulatedDeviceLayer shows,
+    the touchpad lights and the food machine, and touches pads and eats
+    foodtreats through it. Any challenge then runs against it in virtual
+    time, e.g. to see how many hours a kind of pet needs to get through
+    the levels.
+
+    SimulatedPet is the plug: a model of a pet derives from it and
+    implements Act. LearningPet is the model the library comes with.
+*/
+
+class SimulatedPet
+{
+
+public:
+    virtual ~SimulatedPet() {}
+
+    virtual void Act(SimulatedDeviceLayer & dl, unsigned long now) = 0;
+    // look, touch and eat; now is HubClock::Millis(). A pet that wants to
+    // act at a later time asks for it with HubClock::WakeAt
+
+    virtual void PrintStats(Print & out);
+    // what the pet did, for HubSimulation::PrintStats; nothing by default
+};
+
+struct PetTraits {
+    // what a LearningPet is like; chances and amounts are per mille
+    unsigned long reaction_ms = 1500;        // mean time from seeing a stimulus or a foodtreat to acting on it
+    unsigned long reaction_spread_ms = 1000; // reactions are uniform within reaction_ms +- this
+    uint16_t accuracy = 400;                 // chance to touch the brightest lit pad instead of a random one, at first
+    uint16_t max_accuracy = 950;             // the accuracy learning gets close to
+    uint16_t learning_rate = 30;             // of the way to max_accuracy made with every reward
+    uint16_t satiety_per_foodtreat = 10;     // added by every foodtreat eaten, of full
+    unsigned long satiety_half_life_min = 180;
+    uint16_t boredom_per_miss = 10;          // added by touches no foodtreat follows, taken off by a reward
+    unsigned long boredom_half_life_min = 30;
+    unsigned long rest_ms = 60000;           // a stimulus the pet did not feel like playing gets another look after this
+    unsigned long explore_ms = 20000;        // mean quiet time before a touch while no touchpad is lit, 0 for none
+    unsigned long touch_ms = 300;
+};
+
+/*
+                            <<<     Learning pet            >>>
+                            <<<                             >>>
+
+    A pet with a reaction time, an accuracy that grows with every reward,
+    a satiety and a boredom:
+
+    - a stimulus is a change of the touchpad lights. The pet plays it with
+      a chance of (1 - satiety) * (1 - boredom), and then touches after its
+      reaction time: the brightest lit pad with a chance of its accuracy,
+      a random pad otherwise, again after every touch while the lights
+      stay the same. Knowing only brightness, it does not understand
+      colors or sequences, its accuracy stands for that.
+    - after explore_ms without lights or touches it now and then touches
+      a random pad.
+    - a presented foodtreat gets eaten after the reaction time with a
+      chance of 1 - satiety.
+    - a foodtreat presented up to SIM_PET_REWARD_MS after a touch rewards
+      it: the accuracy moves learning_rate of the way to max_accuracy and
+      the boredom goes down. Touches no foodtreat follows make the pet
+      more bored, once SIM_PET_REWARD_MS passed since the last of them.
+    - satiety and boredom wear off with their half-lives.
+
+ * example:
+ *      HubSimulation sim(hub);
+ *      LearningPet pet;
+ *      PetTraits traits;
+ *      traits.reaction_ms = 2500; // a slow one
+ *      pet.SetTraits(traits);
+ *      sim.SetPet(&pet);
+*/
+
+class LearningPet : public SimulatedPet
+{
+
+public:
+    LearningPet(uint32_t seed = 1);
+
+    void SetTraits(const PetTraits & traits);
+    // starts the pet over with these traits
+
+    const PetTraits & Traits() const;
+
+    void Seed(uint32_t seed);
+
+    void Act(SimulatedDeviceLayer & dl, unsigned long now) override;
+
+    void PrintStats(Print & out) override;
+
+    uint16_t Accuracy() const;
+    // per mille, now
+
+    uint16_t Satiety(unsigned long now);
+    // per mille, worn off until now
+
+    uint16_t Boredom(unsigned long now);
+
+    unsigned long Touches() const;
+
+    unsigned long Rewards() const;
+    // touches a foodtreat followed
+
+    unsigned long Foodtreats() const;
+    // foodtreats the pet went for
+
+    unsigned long StimuliIgnored() const;
+
+private:
+    void _wear_off(unsigned long now);
+    unsigned long _reaction();
+    void _touch(SimulatedDeviceLayer & dl, unsigned long now);
+    void _reward(unsigned long now);
+    bool _feels_like_playing(unsigned long now);
+
+private:
+    PetTraits _traits;
+    RandomSource _random;
+
+    float _accuracy; // per mille
+    float _satiety = 0; // 0 to 1
+    float _boredom = 0;
+    unsigned long _worn_off_ms = 0; // satiety and boredom are up to date until then
+    bool _started = false;
+
+    uint32_t _seen = 0; // brightness of the three touchpad lights last looked at
+    bool _playing = false; // plays the stimulus in _seen
+    unsigned long _look_again_ms = 0; // when an ignored stimulus gets another look
+    bool _touch_planned = false;
+    unsigned long _touch_at_ms = 0;
+    unsigned long _touch_end_ms = 0;
+    unsigned long _next_explore_ms = 0;
+    bool _waiting_for_reward = false; // the last touch has not been rewarded yet
+    unsigned long _last_touch_ms = 0;
+
+    unsigned long _presented_seen = 0; // FoodtreatsPresented() of the device layer
+    bool _eat_planned = false;
+    unsigned long _eat_at_ms = 0;
+
+    unsigned long _touches = 0;
+    unsigned long _rewards = 0;
+    unsigned long _foodtreats = 0;
+    unsigned long _ignored = 0;
+};
+
+#endif
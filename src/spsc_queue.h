@@ -0,0 +1,148 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+                            <<<     SPSC queue              >>>
+                            <<<                             >>>
+
+    A fixed size ring of N items of type T for exactly one producer and one
+    consumer, which may run on different threads, the typed sibling of
+    LogRing. Neither side takes a lock or allocates: the producer only
+    moves the head, the consumer only moves the tail, each publishes its
+    index with release ordering after the item is in place. A push to a
+    full queue fails (and is counted), items are never overwritten.
+
+    N must be a power of two. T is copied in and out, keep it small and
+    plain (no pointers into memory the other side might free).
+
+ * example:
+ *      SpscQueue<TouchGesture, 16> gestures;
+ *      gestures.Push(gesture);             // producer thread
+ *      while (gestures.Pop(&gesture)) {}   // consumer thread
+*/
+
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert((N >= 2) && ((N & (N - 1)) == 0), "SpscQueue size must be a power of two");
+
+public:
+    bool Push(const T & item);
+    // producer only: false if the queue is full
+
+    bool Pop(T * item);
+    // consumer only: takes the oldest item, false if the queue is empty
+
+    size_t Size() const;
+    // items waiting, a snapshot
+
+    uint32_t Dropped() const;
+    // pushes that failed because the queue was full
+
+private:
+    T _items[N];
+    std::atomic<size_t> _head{0}; // free running write index, producer only
+    std::atomic<size_t> _tail{0}; // free running read index, consumer only
+    std::atomic<uint32_t> _dropped{0};
+};
+
+template <typename T, size_t N>
+bool SpscQueue<T, N>::Push(const T & item)
+{
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= N) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T, size_t N>
+bool SpscQueue<T, N>::Pop(T * item)
+{
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    *item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T, size_t N>
+size_t SpscQueue<T, N>::Size() const
+{
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+template <typename T, size_t N>
+uint32_t SpscQueue<T, N>::Dropped() const
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+/*
+                            <<<     Snapshot buffer         >>>
+                            <<<                             >>>
+
+    Hands the latest value of a T from one writer thread to one reader
+    thread, whole: the reader never sees half of one update and half of
+    the next, and neither side waits for the other. Three slots (a triple
+    buffer): the writer fills its own slot, then swaps it for the middle
+    one; the reader swaps its own slot for the middle one when that holds
+    something newer. A value the reader did not get to before the next
+    Publish is skipped, the reader always gets the latest.
+
+ * example:
+ *      SnapshotBuffer<HubSnapshot> state;
+ *      state.Publish(snapshot);        // writer thread
+ *      HubSnapshot now = state.Read(); // reader thread
+*/
+
+template <typename T>
+class SnapshotBuffer
+{
+
+public:
+    void Publish(const T & value);
+    // writer only
+
+    const T & Read();
+    // reader only: the value of the latest Publish, a default T before the first
+    // the reference stays valid and unchanged until the next Read
+
+private:
+    static const unsigned char SLOT = 0x03;
+    static const unsigned char FRESH = 0x04; // the middle slot has not been read yet
+
+    T _slots[3];
+    std::atomic<unsigned char> _middle{1}; // slot in the middle, and FRESH
+    unsigned char _back = 0;  // slot the writer fills, writer only
+    unsigned char _front = 2; // slot the reader reads, reader only
+};
+
+template <typename T>
+void SnapshotBuffer<T>::Publish(const T & value)
+{
+    _slots[_back] = value;
+    unsigned char old = _middle.exchange((unsigned char)(_back | FRESH), std::memory_order_acq_rel);
+    _back = old & SLOT;
+}
+
+template <typename T>
+const T & SnapshotBuffer<T>::Read()
+{
+    if (_middle.load(std::memory_order_relaxed) & FRESH) {
+        unsigned char old = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = old & SLOT;
+    }
+    return _slots[_front];
+}
+
+#endif
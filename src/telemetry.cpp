@@ -0,0 +1,130 @@
+#include "hackerpet.h"
+
+TelemetrySender::TelemetrySender(const char * host, uint16_t port, unsigned long intervalMs)
+    : _host(host), _port(port), _interval_ms(intervalMs)
+{
+    memset(_device_id, 0, sizeof(_device_id));
+}
+
+/*
+                            <<<     TelemetrySender::Run     >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    once per interval, take a sample of the hub and send it as one datagram
+
+    <<<PARAMS>>>
+    hub: the hub to sample
+*/
+bool TelemetrySender::Run(HubInterface & hub)
+{
+    if ((_last_sent_ms != 0) && (millis() - _last_sent_ms < _interval_ms)) {
+        return false;
+    }
+    if (!_start()) {
+        return false;
+    }
+    _last_sent_ms = millis();
+
+    TelemetrySample sample;
+    hub.GetTelemetry(&sample);
+    size_t len = Encode(sample, _device_id, _sequence++, _datagram, sizeof(_datagram));
+    if (_udp.sendPacket(_datagram, len, _address, _port) != (int)len) {
+        _send_failures++;
+        return false;
+    }
+    _sent++;
+    return true;
+}
+
+uint32_t TelemetrySender::Sent() const
+{
+    return _sent;
+}
+
+uint32_t TelemetrySender::SendFailures() const
+{
+    return _send_failures;
+}
+
+size_t TelemetrySender::Encode(const TelemetrySample & sample, const uint8_t * deviceId, uint16_t sequence, uint8_t * out, size_t size)
+{
+    if (size < LEN_TELEMETRY_DATAGRAM) {
+        return 0;
+    }
+    uint8_t * at = out;
+    *at++ = 'H';
+    *at++ = 'T';
+    *at++ = TELEMETRY_VERSION;
+    *at++ = sample.flags;
+    at = _put_u16(at, sequence);
+    memcpy(at, deviceId, 12);
+    at += 12;
+    at = _put_u32(at, sample.uptime_ms);
+    for (int i = 0; i < 3; i++) {
+        at = _put_u16(at, sample.read[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        at = _put_u16(at, sample.baseline[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        *at++ = sample.integration[i];
+    }
+    *at++ = sample.buttons;
+    *at++ = sample.foodmachine_state;
+    *at++ = 0;
+    at = _put_u16(at, sample.cmd_queue);
+    at = _put_u16(at, sample.reply_queue);
+    at = _put_u16(at, sample.last_error);
+    at = _put_u32(at, sample.cmds_sent);
+    at = _put_u32(at, sample.retries);
+    at = _put_u32(at, sample.listen_timeouts);
+    at = _put_u32(at, sample.cmds_dropped);
+    at = _put_u32(at, sample.bad_replies);
+    return at - out;
+}
+
+bool TelemetrySender::_start()
+{
+    if (_started) {
+        return true;
+    }
+    if (!WiFi.ready() || ((_last_start_ms != 0) && (millis() - _last_start_ms < _start_retry_ms))) {
+        return false;
+    }
+    _last_start_ms = millis();
+
+    unsigned char ip[4];
+    if (sscanf(_host, "%hhu.%hhu.%hhu.%hhu", &ip[0], &ip[1], &ip[2], &ip[3]) == 4) {
+        _address = IPAddress(ip[0], ip[1], ip[2], ip[3]);
+    }
+    else {
+        _address = WiFi.resolve(_host);
+    }
+    if (!_address || (_udp.begin(_port) == 0)) {
+        return false;
+    }
+
+    // the 24 hex digits of the device id as 12 bytes
+    String id = System.deviceID();
+    for (unsigned int i = 0; (i < sizeof(_device_id)) && (2 * i + 1 < id.length()); i++) {
+        unsigned int value = 0;
+        sscanf(id.c_str() + 2 * i, "%2x", &value);
+        _device_id[i] = value;
+    }
+    _started = true;
+    return true;
+}
+
+uint8_t * TelemetrySender::_put_u16(uint8_t * at, uint16_t value)
+{
+    *at++ = value & 0xFF;
+    *at++ = value >> 8;
+    return at;
+}
+
+uint8_t * TelemetrySender::_put_u32(uint8_t * at, uint32_t value)
+{
+    at = _put_u16(at, value & 0xFFFF);
+    return _put_u16(at, value >> 16);
+}
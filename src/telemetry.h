@@ -0,0 +1,115 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "application.h"
+
+class HubInterface;
+
+#define TELEMETRY_VERSION 1
+
+#define LEN_TELEMETRY_DATAGRAM 66
+// every telemetry datagram has exactly this length
+
+struct TelemetrySample {
+    // one snapshot of the hub, filled in by HubInterface::GetTelemetry
+    uint32_t uptime_ms;
+    uint16_t read[3];           // touchpad readings, left, middle, right
+    uint16_t baseline[3];       // touchpad baselines, left, middle, right
+    uint8_t integration[3];     // capsense stuck-touch integrators, left, middle, right
+    uint8_t buttons;            // BUTTON_... bits of the pressed touchpads
+    uint8_t foodmachine_state;  // FOODMACHINE_... constant
+    uint8_t flags;              // TELEMETRY_FLAG_... bits
+    uint16_t cmd_queue;         // commands waiting for the device layer
+    uint16_t reply_queue;       // replies waiting to be processed
+    uint16_t last_error;        // last error code of the device layer link
+    uint32_t cmds_sent;         // commands transmitted to the device layer
+    uint32_t retries;           // commands transmitted again
+    uint32_t listen_timeouts;   // replies that did not arrive in time
+    uint32_t cmds_dropped;      // commands given up after too many retries
+    uint32_t bad_replies;       // replies with a failure status or that did not parse
+};
+
+#define TELEMETRY_FLAG_DL_READY          0b00000001
+#define TELEMETRY_FLAG_DI_RESET_NEEDED   0b00000010
+#define TELEMETRY_FLAG_DI_RESET_LOCKED   0b00000100
+#define TELEMETRY_FLAG_DOME_OPEN         0b00001000
+#define TELEMETRY_FLAG_OUT_OF_FOOD       0b00010000
+#define TELEMETRY_FLAG_PLATTER_ERROR     0b00100000
+#define TELEMETRY_FLAG_SINGULATOR_ERROR  0b01000000
+#define TELEMETRY_FLAG_PLATTER_STUCK     0b10000000
+
+/*
+                            <<<     Telemetry sender        >>>
+                            <<<                             >>>
+
+    Sends a TelemetrySample as one fixed layout UDP datagram every
+    interval, 66 bytes instead of a few hundred bytes of log text per
+    reading. tools/telemetry_collector.py receives the datagrams of many
+    hubs, decodes them and shows sensor drift and link health live.
+
+    Datagram layout, integers are little endian:
+        u8      'H'
+        u8      'T'
+        u8      version (TELEMETRY_VERSION)
+        u8      flags (TELEMETRY_FLAG_...)
+        u16     sequence number, a gap means lost datagrams
+        u8[12]  device id
+        u32     uptime in ms
+        u16[3]  touchpad readings
+        u16[3]  touchpad baselines
+        u8[3]   capsense integrators
+        u8      pressed touchpads
+        u8      food machine state
+        u8      0, reserved
+        u16     command queue depth
+        u16     reply queue depth
+        u16     last error code
+        u32     commands sent
+        u32     retries
+        u32     listen timeouts
+        u32     commands dropped
+        u32     bad replies
+*/
+
+class TelemetrySender
+{
+
+public:
+    TelemetrySender(const char * host, uint16_t port, unsigned long intervalMs);
+    // host: IP address or name of the collector, not copied
+
+    bool Run(HubInterface & hub);
+    // sends a sample if the interval passed, returns true if one was sent
+
+    uint32_t Sent() const;
+
+    uint32_t SendFailures() const;
+
+    static size_t Encode(const TelemetrySample & sample, const uint8_t * deviceId, uint16_t sequence, uint8_t * out, size_t size);
+    // writes the datagram to out, returns LEN_TELEMETRY_DATAGRAM or 0 if it does not fit
+    // deviceId: 12 bytes
+
+private:
+    bool _start();
+
+    static uint8_t * _put_u16(uint8_t * at, uint16_t value);
+    static uint8_t * _put_u32(uint8_t * at, uint32_t value);
+
+private:
+    const char * _host;
+    uint16_t _port;
+    unsigned long _interval_ms;
+    unsigned long _last_sent_ms = 0;
+    unsigned long _last_start_ms = 0;
+    unsigned long _start_retry_ms = 5000; // rest between attempts to resolve the host
+    bool _started = false;
+    IPAddress _address;
+    UDP _udp;
+    uint8_t _device_id[12];
+    uint16_t _sequence = 0;
+    uint32_t _sent = 0;
+    uint32_t _send_failures = 0;
+    uint8_t _datagram[LEN_TELEMETRY_DATAGRAM];
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "touch_gestures.h"
+
+TouchGestureRecognizer::TouchGestureRecognizer()
+{
+}
+
+void TouchGestureRecognizer::SetTimings(unsigned long holdMs, unsigned long doubleTapMs, unsigned long chordMs, unsigned long slideMs)
+{
+    _hold_ms = holdMs;
+    _double_tap_ms = doubleTapMs;
+    _chord_ms = chordMs;
+    _slide_ms = slideMs;
+}
+
+/*
+                            <<<  TouchGestureRecognizer::Update >>>
+                            <<<                             >>>
+
+    <<<GOAL>>>
+    advance the recognizer by one touchpad reading, queueing every gesture
+    that is complete now
+
+    <<<PARAMS>>>
+    pressed: BUTTON_... bits of the touched pads
+    now: millis()
+*/
+void TouchGestureRecognizer::Update(unsigned char pressed, unsigned long now)
+{
+    unsigned char touched = pressed & ~_pressed;
+
+    // no second tap came in time
+    if (_tap_pending && (pressed == 0) && (_pressed == 0) && (now - _tap_end_ms > _double_tap_ms)) {
+        _emit_pending_tap();
+    }
+
+    if (touched) {
+        unsigned char pad = _lowest_pad(touched);
+        if (_pressed == 0) {
+            // a new touch, maybe continuing the previous one on another pad
+            if ((_last_pad != 0) && (touched == pad) && (pad != _last_pad) && (now - _last_release_ms <= _slide_ms)) {
+                _tap_pending = false; // the previous touch was the start of the slide
+                _emit(GESTURE_SLIDE, _last_pad | pad, _last_pad, pad, now, now - _touch_start_ms);
+                _slid = true;
+            }
+            else {
+                if (_tap_pending && (pad != _tap_pad)) {
+                    _emit_pending_tap(); // keep the order of the touches
+                }
+                _slid = false;
+            }
+            _touch_pads = touched;
+            _touch_start_ms = now;
+            _chord = (touched != pad);
+            _chord_sent = false;
+            _hold_sent = false;
+        }
+        else if (now - _touch_start_ms <= _chord_ms) {
+            _touch_pads |= touched;
+            _chord = true;
+        }
+        else if (!_chord) {
+            // touched while another pad is still held
+            _emit_pending_tap();
+            _emit(GESTURE_SLIDE, _last_pad | pad, _last_pad, pad, now, now - _touch_start_ms);
+            _touch_pads |= touched;
+            _slid = true;
+        }
+        _last_pad = pad;
+    }
+
+    if (_chord && !_chord_sent && ((pressed == 0) || (now - _touch_start_ms > _chord_ms))) {
+        _emit_pending_tap();
+        _emit(GESTURE_CHORD, _touch_pads, _touch_pads, _touch_pads, now, now - _touch_start_ms);
+        _chord_sent = true;
+    }
+
+    if ((pressed != 0) && !_chord && !_slid && !_hold_sent && (now - _touch_start_ms >= _hold_ms)) {
+        _emit_pending_tap();
+        _emit(GESTURE_HOLD, _touch_pads, _touch_pads, _touch_pads, now, now - _touch_start_ms);
+        _hold_sent = true;
+    }
+
+    if ((pressed == 0) && (_pressed != 0)) {
+        // the touch ended
+        _last_release_ms = now;
+        if (!_chord && !_slid && !_hold_sent) {
+            if (_tap_pending && (_tap_pad == _touch_pads) && (_touch_start_ms - _tap_end_ms <= _double_tap_ms)) {
+                _tap_pending = false;
+                _emit(GESTURE_DOUBLE_TAP, _touch_pads, _touch_pads, _touch_pads, now, now - _tap_start_ms);
+            }
+            else {
+                _emit_pending_tap();
+                _tap_pending = true;
+                _tap_pad = _touch_pads;
+                _tap_start_ms = _touch_start_ms;
+                _tap_end_ms = now;
+                if (_double_tap_ms == 0) {
+                    _emit_pending_tap();
+                }
+            }
+        }
+    }
+
+    _pressed = pressed;
+}
+
+bool TouchGestureRecognizer::Next(TouchGesture * gesture)
+{
+    if (_queue_count == 0) {
+        return false;
+    }
+    *gesture = _queue[_queue_start];
+    _queue_start = (_queue_start + 1) % MAX_QUEUED_GESTURES;
+    _queue_count--;
+    return true;
+}
+
+void TouchGestureRecognizer::Clear()
+{
+    _queue_count = 0;
+    _tap_pending = false;
+    _last_pad = 0;
+    // a touch in progress is ignored until it ends
+    _chord = false;
+    _chord_sent = false;
+    _slid = true;
+    _hold_sent = true;
+}
+
+void TouchGestureRecognizer::_emit(unsigned char type, unsigned char pads, unsigned char from, unsigned char to, unsigned long at, unsigned long duration)
+{
+    if (_queue_count == MAX_QUEUED_GESTURES) {
+        // drop the oldest
+        _queue_start = (_queue_start + 1) % MAX_QUEUED_GESTURES;
+        _queue_count--;
+    }
+    TouchGesture & gesture = _queue[(_queue_start + _queue_count) % MAX_QUEUED_GESTURES];
+    gesture.type = type;
+    gesture.pads = pads;
+    gesture.from = from;
+    gesture.to = to;
+    gesture.at_ms = at;
+    gesture.duration_ms = duration;
+    _queue_count++;
+}
+
+void TouchGestureRecognizer::_emit_pending_tap()
+{
+    if (_tap_pending) {
+        _tap_pending = false;
+        _emit(GESTURE_TAP, _tap_pad, _tap_pad, _tap_pad, _tap_end_ms, _tap_end_ms - _tap_start_ms);
+    }
+}
+
+unsigned char TouchGestureRecognizer::_lowest_pad(unsigned char pads)
+{
+    return pads & (unsigned char)(-pads);
+}
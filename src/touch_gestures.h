@@ -0,0 +1,99 @@
+#ifndef TOUCH_GESTURES_H
+#define TOUCH_GESTURES_H
+
+#include "application.h"
+
+#define MAX_QUEUED_GESTURES 8
+// recognized gestures waiting for the game, the oldest is dropped when full
+
+#define GESTURE_TAP 1        // one pad touched shortly
+#define GESTURE_DOUBLE_TAP 2 // the same pad tapped twice quickly
+#define GESTURE_HOLD 3       // one pad touched for hold_ms, sent while still touched
+#define GESTURE_CHORD 4      // several pads touched at the same time
+#define GESTURE_SLIDE 5      // a touch moved from one pad to another
+
+struct TouchGesture {
+    unsigned char type;         // GESTURE_...
+    unsigned char pads;         // BUTTON_... bits of all pads involved
+    unsigned char from;         // slide: BUTTON_... bit of the pad it started on, otherwise = pads
+    unsigned char to;           // slide: BUTTON_... bit of the pad it moved to, otherwise = pads
+    unsigned long at_ms;        // millis() when it was recognized
+    unsigned long duration_ms;  // how long the pads were touched (for a double tap: both taps)
+};
+
+/*
+                            <<<     Touch gesture recognizer >>>
+                            <<<                             >>>
+
+    Turns the touchpad state into gestures. It is fed the pressed BUTTON_...
+    bits after every button poll (HubInterface does that by itself) and
+    keeps only the state of the current and the previous touch, so every
+    update takes the same few steps no matter how long the game has been
+    running, and the game reads finished gestures with Next() instead of
+    comparing bitmasks in its yield loops.
+
+    A touch starts when the first pad is touched and ends when no pad is
+    touched any more:
+    - more pads touched within chord_ms of the start make it a chord, sent
+      when chord_ms passed (or at the end, if it ended sooner)
+    - a pad touched later while another is held, or within slide_ms after
+      the previous touch ended on another pad, is a slide from that pad
+    - a single pad touched for hold_ms is a hold
+    - anything else is a tap; a tap on the same pad starting within
+      double_tap_ms after the previous tap ended makes both a double tap.
+      To tell them apart a tap is only sent after double_tap_ms, set it to
+      0 to get taps right away (and no double taps).
+*/
+
+class TouchGestureRecognizer
+{
+
+public:
+    TouchGestureRecognizer();
+
+    void SetTimings(unsigned long holdMs, unsigned long doubleTapMs, unsigned long chordMs, unsigned long slideMs);
+    // defaults: hold 1000 ms, double tap 300 ms, chord 150 ms, slide 250 ms
+
+    void Update(unsigned char pressed, unsigned long now);
+    // pressed: BUTTON_... bits of the touched pads, call regularly also when nothing changed
+
+    bool Next(TouchGesture * gesture);
+    // takes the oldest recognized gesture, false if there is none
+
+    void Clear();
+    // forget queued gestures and the touch in progress, e.g. at the start of an interaction
+
+private:
+    void _emit(unsigned char type, unsigned char pads, unsigned char from, unsigned char to, unsigned long at, unsigned long duration);
+    void _emit_pending_tap();
+    static unsigned char _lowest_pad(unsigned char pads);
+
+private:
+    unsigned long _hold_ms = 1000;
+    unsigned long _double_tap_ms = 300;
+    unsigned long _chord_ms = 150;
+    unsigned long _slide_ms = 250;
+
+    // current touch
+    unsigned char _pressed = 0; // pads touched at the last update
+    unsigned char _touch_pads = 0; // all pads of the current touch
+    unsigned long _touch_start_ms = 0;
+    unsigned char _last_pad = 0; // pad touched most recently, in this or the previous touch
+    bool _chord = false;
+    bool _chord_sent = false;
+    bool _slid = false;
+    bool _hold_sent = false;
+    unsigned long _last_release_ms = 0; // end of the previous touch
+
+    // tap waiting to see whether it becomes a double tap
+    bool _tap_pending = false;
+    unsigned char _tap_pad = 0;
+    unsigned long _tap_start_ms = 0;
+    unsigned long _tap_end_ms = 0;
+
+    TouchGesture _queue[MAX_QUEUED_GESTURES];
+    unsigned char _queue_start = 0;
+    unsigned char _queue_count = 0;
+};
+
+#endif
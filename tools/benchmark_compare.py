@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""
+Compare hackerpet benchmark runs
+================================
+
+Reads the JSON lines examples/109_Benchmark prints (see src/benchmark.h)
+from a captured serial log, other lines are skipped, and prints one row per
+case. With --baseline the row shows the change against the baseline run,
+and the exit status is 1 if a case got slower by more than --tolerance
+percent or allocates more than before.
+
+usage:
+    benchmark_compare.py RUN [--baseline FILE] [--tolerance PERCENT]
+
+RUN and FILE are captured logs ("-" for stdin). If a log holds several runs
+the last one counts.
+"""
+
+import argparse
+import json
+import sys
+
+
+def read_run(path):
+    """returns {case: result} of the last run in the log"""
+    results = {}
+    source = sys.stdin if path == "-" else open(path)
+    with source:
+        for line in source:
+            line = line.strip()
+            if not line.startswith('{"bench"'):
+                continue
+            try:
+                result = json.loads(line)
+            except ValueError:
+                continue  # cut off line
+            results[result["bench"]] = result
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("run", help="captured log of the run to check")
+    parser.add_argument("--baseline", metavar="FILE", help="captured log of the run to compare with")
+    parser.add_argument("--tolerance", type=float, default=10.0,
+                        help="percent a case may get slower before it counts as a regression")
+    args = parser.parse_args()
+
+    run = read_run(args.run)
+    if not run:
+        print("no benchmark lines in %s" % args.run, file=sys.stderr)
+        return 2
+    baseline = read_run(args.baseline) if args.baseline else {}
+
+    regressions = 0
+    print("%-20s %10s %12s %10s %12s" % ("case", "ns/op", "change", "allocs/op", "change"))
+    for name in sorted(run):
+        now = run[name]
+        allocs = now["allocs_per_1000_ops"] / 1000.0
+        if name not in baseline:
+            print("%-20s %10d %12s %10.3f %12s" % (name, now["ns_per_op"], "new", allocs, ""))
+            continue
+        then = baseline[name]
+        slower = 100.0 * (now["ns_per_op"] - then["ns_per_op"]) / max(then["ns_per_op"], 1)
+        more_allocs = (now["allocs_per_1000_ops"] - then["allocs_per_1000_ops"]) / 1000.0
+        flag = ""
+        if slower > args.tolerance or more_allocs > 0:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-20s %10d %+11.1f%% %10.3f %+12.3f%s" % (name, now["ns_per_op"], slower, allocs, more_allocs, flag))
+    for name in sorted(set(baseline) - set(run)):
+        print("%-20s missing from the run" % name)
+
+    if regressions:
+        print("%d regressions" % regressions, file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
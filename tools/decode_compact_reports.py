@@ -0,0 +1,235 @@
+#!/usr/bin/env python3
+"""
+Decode compact hackerpet reports
+================================
+
+Turns the "hckrpt/dict" and "hckrpt/creport" events that a hub sends with
+HubInterface::SetReportEncoding(REPORT_ENCODING_COMPACT) back into regular
+"hckrpt/report" events, with exactly the JSON that HubInterface::Report()
+would have published.
+
+Input and output are JSON lines in the format of the body the webhook in
+docs/particle_webhook.json posts:
+
+    {"event": "...", "data": "...", "coreid": "...", "published_at": "..."}
+
+Events other than hckrpt/dict and hckrpt/creport are passed through
+unchanged. Dictionaries are remembered in --dict-store so batches can be
+decoded in a later run than the one that saw their dictionary.
+
+usage:
+    decode_compact_reports.py [--dict-store FILE] [--forward URL] [events.jsonl]
+
+--forward POSTs every output event to URL (e.g. the hackerpet webhook),
+instead of only printing it.
+"""
+
+import argparse
+import base64
+import datetime
+import json
+import os
+import sys
+import urllib.request
+
+COMPACT_REPORT_VERSION = 1
+
+# record flags, see compact_report.h
+FLAG_FOODTREAT_PRESENTED = 0b00000001
+FLAG_FOODTREAT_EATEN = 0b00000010
+FLAG_START_PACKED = 0b00000100
+FLAG_START_UTC_Z = 0b00001000
+FLAG_RESULT_PACKED = 0b00010000
+FLAG_RESULT_VALUE = 0b00100000
+FLAG_HAS_EXTRA = 0b01000000
+
+
+class DecodeError(Exception):
+    pass
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        if self.pos >= len(self.data):
+            raise DecodeError("batch truncated")
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def u32(self):
+        value = 0
+        for shift in (0, 8, 16, 24):
+            value |= self.byte() << shift
+        return value
+
+    def varint(self):
+        value = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            value |= (b & 0x7F) << shift
+            if not b & 0x80:
+                return value
+            shift += 7
+
+    def text(self):
+        length = self.varint()
+        if self.pos + length > len(self.data):
+            raise DecodeError("batch truncated")
+        value = self.data[self.pos:self.pos + length]
+        self.pos += length
+        return value
+
+
+def json_escape(raw):
+    """Escape bytes the way JsonWriter::_put_escaped does."""
+    out = bytearray()
+    for c in raw:
+        if c == 0x22:
+            out += b'\\"'
+        elif c == 0x5C:
+            out += b"\\\\"
+        elif c == 0x0A:
+            out += b"\\n"
+        elif c == 0x0D:
+            out += b"\\r"
+        elif c == 0x09:
+            out += b"\\t"
+        elif c < 0x20:
+            out += b"\\u00%02x" % c
+        else:
+            out.append(c)
+    return bytes(out)
+
+
+def format_start_time(timestamp, delta, zigzag, is_z):
+    offset = -((zigzag + 1) // 2) if zigzag & 1 else zigzag // 2
+    local = datetime.datetime(1970, 1, 1) + datetime.timedelta(seconds=timestamp - delta + offset * 60)
+    text = local.strftime("%Y-%m-%dT%H:%M:%S")
+    if is_z:
+        return (text + "Z").encode()
+    sign = "-" if offset < 0 else "+"
+    return (text + "%s%02d:%02d" % (sign, abs(offset) // 60, abs(offset) % 60)).encode()
+
+
+def decode_batch(data, dictionaries):
+    """Returns the report JSON strings of one base64 batch."""
+    reader = Reader(base64.b64decode(data))
+    version = reader.byte()
+    if version != COMPACT_REPORT_VERSION:
+        raise DecodeError("unknown batch version %d" % version)
+    dict_id = str(reader.u32())
+    base_timestamp = reader.u32()
+    count = reader.byte()
+    if dict_id not in dictionaries:
+        raise DecodeError("unknown dictionary %s" % dict_id)
+    challenge_id = dictionaries[dict_id]["challenge_id"].encode()
+    player = dictionaries[dict_id]["player"].encode()
+
+    reports = []
+    for _ in range(count):
+        timestamp = base_timestamp + reader.varint()
+        flags = reader.byte()
+        level = reader.varint()
+        duration = reader.varint()
+        if flags & FLAG_START_PACKED:
+            delta = reader.varint()
+            zigzag = reader.varint()
+            start = format_start_time(timestamp, delta, zigzag, flags & FLAG_START_UTC_Z)
+        else:
+            start = reader.text()
+        if flags & FLAG_RESULT_PACKED:
+            result = b"1" if flags & FLAG_RESULT_VALUE else b"0"
+        else:
+            result = reader.text()
+        extra = reader.text() if flags & FLAG_HAS_EXTRA else None
+
+        # same field order and formatting as HubInterface::_report
+        report = b"{"
+        report += b'"challenge_id":"' + json_escape(challenge_id) + b'",'
+        report += b'"play_start_time":"' + json_escape(start) + b'",'
+        report += b'"player":"' + json_escape(player) + b'",'
+        report += b'"timestamp":"%d",' % timestamp
+        report += b'"result":"' + json_escape(result) + b'",'
+        report += b'"level":"%d",' % level
+        report += b'"duration":"%d",' % duration
+        report += b'"foodtreat_presented":"%d",' % (1 if flags & FLAG_FOODTREAT_PRESENTED else 0)
+        report += b'"foodtreat_eaten":"%d"' % (1 if flags & FLAG_FOODTREAT_EATEN else 0)
+        if extra is not None:
+            report += b',"extra":' + extra
+        report += b"}"
+        reports.append(report.decode("utf-8", errors="replace"))
+    return reports
+
+
+def load_dictionaries(path):
+    if path and os.path.exists(path):
+        with open(path) as f:
+            return json.load(f)
+    return {}
+
+
+def save_dictionaries(path, dictionaries):
+    if path:
+        tmp = path + ".tmp"
+        with open(tmp, "w") as f:
+            json.dump(dictionaries, f, indent=1)
+        os.replace(tmp, path)
+
+
+def forward(url, event):
+    request = urllib.request.Request(url, data=json.dumps(event).encode(),
+                                     headers={"Content-Type": "application/json"})
+    urllib.request.urlopen(request).read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("events", nargs="?", help="JSON lines of webhook events (default: stdin)")
+    parser.add_argument("--dict-store", default="compact_report_dicts.json",
+                        help="file remembering dictionaries between runs")
+    parser.add_argument("--forward", metavar="URL", help="POST decoded events to URL")
+    args = parser.parse_args()
+
+    dictionaries = load_dictionaries(args.dict_store)
+    source = open(args.events) if args.events else sys.stdin
+    errors = 0
+
+    for line in source:
+        line = line.strip()
+        if not line:
+            continue
+        event = json.loads(line)
+        name = event.get("event", "")
+        outputs = []
+        try:
+            if name == "hckrpt/dict":
+                entry = json.loads(event["data"])
+                dictionaries[entry["dict_id"]] = {"challenge_id": entry["challenge_id"], "player": entry["player"]}
+                save_dictionaries(args.dict_store, dictionaries)
+            elif name == "hckrpt/creport":
+                for report in decode_batch(event["data"], dictionaries):
+                    decoded = dict(event)
+                    decoded["event"] = "hckrpt/report"
+                    decoded["data"] = report
+                    outputs.append(decoded)
+            else:
+                outputs.append(event)
+        except (DecodeError, ValueError, KeyError) as e:
+            errors += 1
+            print("skipping %s event from %s: %s" % (name, event.get("coreid"), e), file=sys.stderr)
+
+        for output in outputs:
+            print(json.dumps(output))
+            if args.forward:
+                forward(args.forward, output)
+
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,280 @@
+#!/usr/bin/env python3
+"""
+hackerpet learning curves
+=========================
+
+Crunches report history into how fast players move through the levels of
+each challenge, to tune the level tables (enough successes, too many
+misses, timeouts) of the challenges.
+
+Input is either JSON lines of reports (webhook bodies like the ones
+webhook_standin.py --log writes, or bare Report() JSON), or the data
+directory of report_server.py. Compact batches have to be decoded with
+decode_compact_reports.py first.
+
+Every player (device and player name) is followed through each challenge
+in timestamp order; a run of reports at one level is a visit. Per
+challenge and level it prints:
+
+    players     players that played the level
+    ups         visits that ended on a higher level
+    downs       visits that ended on a lower level
+    open        visits the history ends in
+    hours       median time from the first report of a visit to the first
+                report on the next level, with a 95% interval
+    plays       median interactions of the visits that leveled up
+    success     success rate over all interactions, with a 95% Wilson interval
+
+--curves FILE writes the success curves: the success rate by interaction
+number within a visit, in bins of --bin interactions, with Wilson intervals.
+
+Lines of JSON are not decoded: every worker maps its part of the file and
+picks the few fields it needs out of the bytes with one regular
+expression, so millions of reports take seconds. Files and report_server
+partitions are spread over --jobs processes.
+
+usage:
+    learning_curves.py [--jobs N] [--bin N] [--curves FILE] [--csv] INPUT...
+"""
+
+import argparse
+import array
+import csv
+import math
+import mmap
+import os
+import re
+import sys
+from collections import defaultdict
+from multiprocessing import Pool
+from urllib.parse import unquote
+
+from report_server import SUCCESS_RESULTS, Partition, challenge_name
+
+# the fields of HubInterface::_write_report_json in their order, quotes escaped once inside a webhook body;
+# names with quotes or backslashes in them are skipped
+REPORT = re.compile(
+    rb'challenge_id\\?"\s*:\s*\\?"([^"\\]*)\\?".*?'
+    rb'player\\?"\s*:\s*\\?"([^"\\]*)\\?"\s*,\s*'
+    rb'\\?"timestamp\\?"\s*:\s*\\?"(\d+)\\?"\s*,\s*'
+    rb'\\?"result\\?"\s*:\s*\\?"([^"\\]*)\\?"\s*,\s*'
+    rb'\\?"level\\?"\s*:\s*\\?"(\d+)')
+DEVICE = re.compile(rb'"coreid"\s*:\s*"([^"]*)"')
+
+SUCCESS = tuple(result.encode() for result in SUCCESS_RESULTS)
+
+CHUNK_BYTES = 16 << 20  # a file is split into parts of about this size for the workers
+
+Z_95 = 1.959964
+
+
+def new_history():
+    # timestamp, level, success of every report, in file order
+    return (array.array("I"), array.array("I"), array.array("B"))
+
+
+def scan_lines(path, start, end):
+    """the reports of the lines that start in [start, end) of a JSON lines file"""
+    histories = defaultdict(new_history)
+    skipped = 0
+    with open(path, "rb") as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as data:
+        if start > 0:
+            # the line that runs into this part belongs to the part before
+            start = data.find(b"\n", start - 1) + 1 or end
+        position = start
+        while position < end:
+            line_end = data.find(b"\n", position)
+            if line_end < 0:
+                line_end = len(data)
+            match = REPORT.search(data, position, line_end)
+            if match is None:
+                if line_end > position + 1:
+                    skipped += 1
+            else:
+                device = DEVICE.search(data, position, line_end)
+                challenge = challenge_name(match.group(1).decode("utf-8", "replace"))
+                key = (device.group(1).decode() if device else "", match.group(2).decode("utf-8", "replace"), challenge)
+                timestamps, levels, successes = histories[key]
+                timestamps.append(int(match.group(3)))
+                levels.append(int(match.group(5)))
+                successes.append(match.group(4).lower() in SUCCESS)
+            position = line_end + 1
+    return dict(histories), skipped
+
+
+def scan_partition(path, device, challenge_id):
+    """the reports of one report_server.py partition"""
+    partition = Partition(path, writable=False)
+    rows = partition.rows
+    players = partition.dictionaries["player"].texts
+    won = [text.lower() in SUCCESS_RESULTS for text in partition.dictionaries["result"].texts]
+    columns = [partition.read_column(name, rows) for name in ("timestamp", "level", "result", "player")]
+    histories = defaultdict(new_history)
+    challenge = challenge_name(challenge_id)
+    for timestamp, level, result, player in zip(*columns):
+        timestamps, levels, successes = histories[(device, players[player], challenge)]
+        timestamps.append(int(timestamp))
+        levels.append(int(level))
+        successes.append(won[result])
+    return dict(histories), 0
+
+
+def scan(task):
+    kind, arguments = task
+    return scan_lines(*arguments) if kind == "lines" else scan_partition(*arguments)
+
+
+def tasks_for(path):
+    """splits an input into work for the pool"""
+    if os.path.isdir(path):
+        for device_dir in sorted(os.listdir(path)):
+            device_path = os.path.join(path, device_dir)
+            if not os.path.isdir(device_path):
+                continue
+            for challenge_dir in sorted(os.listdir(device_path)):
+                yield ("partition", (os.path.join(device_path, challenge_dir), unquote(device_dir), unquote(challenge_dir)))
+    else:
+        size = os.path.getsize(path)
+        for start in range(0, size, CHUNK_BYTES):
+            yield ("lines", (path, start, min(size, start + CHUNK_BYTES)))
+
+
+def wilson(successes, total, z=Z_95):
+    """95% Wilson score interval of a success rate"""
+    if total == 0:
+        return 0.0, 1.0
+    rate = successes / total
+    denominator = 1 + z * z / total
+    center = (rate + z * z / (2 * total)) / denominator
+    half = z * math.sqrt(rate * (1 - rate) / total + z * z / (4 * total * total)) / denominator
+    return max(0.0, center - half), min(1.0, center + half)
+
+
+def median_interval(values, z=Z_95):
+    """median and a distribution-free 95% interval for it, from the order statistics"""
+    values = sorted(values)
+    n = len(values)
+    if n == 0:
+        return None, None, None
+    median = values[n // 2] if n % 2 else (values[n // 2 - 1] + values[n // 2]) / 2
+    half = z * math.sqrt(n) / 2
+    low = max(0, int(math.floor(n / 2 - half)))
+    high = min(n - 1, int(math.ceil(n / 2 + half)) - 1)
+    return median, values[low], values[max(low, high)]
+
+
+class LevelStats:
+    def __init__(self):
+        self.players = set()
+        self.ups = 0
+        self.downs = 0
+        self.open = 0
+        self.hours = []
+        self.plays = []
+        self.successes = 0
+        self.total = 0
+        self.curve = defaultdict(lambda: [0, 0])  # bin -> [successes, total]
+
+
+def analyze(histories, bin_size):
+    """per (challenge, level) statistics of the player histories"""
+    stats = defaultdict(LevelStats)
+    for (device, player, challenge), (timestamps, levels, successes) in histories.items():
+        order = sorted(range(len(timestamps)), key=timestamps.__getitem__)
+        visit_start = 0
+        while visit_start < len(order):
+            level = levels[order[visit_start]]
+            visit_end = visit_start
+            while (visit_end < len(order)) and (levels[order[visit_end]] == level):
+                visit_end += 1
+            s = stats[(challenge, level)]
+            s.players.add((device, player))
+            for number, index in enumerate(order[visit_start:visit_end]):
+                cell = s.curve[number // bin_size]
+                cell[0] += successes[index]
+                cell[1] += 1
+                s.successes += successes[index]
+            s.total += visit_end - visit_start
+
+            if visit_end == len(order):
+                s.open += 1
+            elif levels[order[visit_end]] > level:
+                s.ups += 1
+                s.hours.append((timestamps[order[visit_end]] - timestamps[order[visit_start]]) / 3600.0)
+                s.plays.append(visit_end - visit_start)
+            else:
+                s.downs += 1
+            visit_start = visit_end
+    return stats
+
+
+def merge(into, histories):
+    for key, (timestamps, levels, successes) in histories.items():
+        mine = into[key]
+        mine[0].extend(timestamps)
+        mine[1].extend(levels)
+        mine[2].extend(successes)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("inputs", nargs="+", metavar="INPUT", help="JSON lines file or report_server.py data directory")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="worker processes")
+    parser.add_argument("--bin", type=int, default=10, help="interactions per point of the success curves")
+    parser.add_argument("--curves", metavar="FILE", help="write the success curves as CSV")
+    parser.add_argument("--csv", action="store_true", help="print the summary as CSV")
+    args = parser.parse_args()
+
+    tasks = [task for path in args.inputs for task in tasks_for(path)]
+    histories = defaultdict(new_history)
+    skipped = 0
+    with Pool(max(1, args.jobs)) as pool:
+        for part, part_skipped in pool.imap(scan, tasks):
+            merge(histories, part)
+            skipped += part_skipped
+    if skipped:
+        print("skipped %d lines without a report" % skipped, file=sys.stderr)
+
+    stats = analyze(histories, max(1, args.bin))
+
+    columns = ["challenge", "level", "players", "ups", "downs", "open", "hours", "hours_low", "hours_high",
+               "plays", "success", "success_low", "success_high"]
+    rows = []
+    for (challenge, level) in sorted(stats):
+        s = stats[(challenge, level)]
+        hours, hours_low, hours_high = median_interval(s.hours)
+        plays = median_interval(s.plays)[0]
+        low, high = wilson(s.successes, s.total)
+        rows.append([challenge, level, len(s.players), s.ups, s.downs, s.open, hours, hours_low, hours_high,
+                     plays, s.successes / s.total, low, high])
+
+    if args.csv:
+        writer = csv.writer(sys.stdout)
+        writer.writerow(columns)
+        writer.writerows(rows)
+    else:
+        print("%-28s %5s %7s %5s %5s %5s  %-22s %6s  %s" % (
+            "challenge", "level", "players", "ups", "downs", "open", "hours (95%)", "plays", "success (95%)"))
+        for row in rows:
+            hours = "-" if row[6] is None else "%.1f (%.1f-%.1f)" % (row[6], row[7], row[8])
+            plays = "-" if row[9] is None else "%g" % row[9]
+            print("%-28s %5d %7d %5d %5d %5d  %-22s %6s  %4.1f%% (%.1f-%.1f)" % (
+                row[0][:28], row[1], row[2], row[3], row[4], row[5], hours, plays,
+                100 * row[10], 100 * row[11], 100 * row[12]))
+
+    if args.curves:
+        with open(args.curves, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["challenge", "level", "from", "to", "interactions", "success", "success_low", "success_high"])
+            for (challenge, level) in sorted(stats):
+                curve = stats[(challenge, level)].curve
+                for point in sorted(curve):
+                    won, total = curve[point]
+                    low, high = wilson(won, total)
+                    writer.writerow([challenge, level, point * args.bin + 1, (point + 1) * args.bin, total,
+                                     "%.4f" % (won / total), "%.4f" % low, "%.4f" % high])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
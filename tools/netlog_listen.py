@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Listen to hackerpet network logs
+================================
+
+Prints the log lines a hub sends with NetworkLogHandler (src/network_log.h),
+like nc -lk PORT would, and keeps track of lines that never arrived: every
+line starts with a sequence number, so a jump in it is a gap. "netlog
+dropped" lines (lines the hub could not buffer) are counted too. Any number
+of hubs can send to one listener, lines are prefixed with the sender.
+
+usage:
+    netlog_listen.py [--udp] [--port PORT] [--quiet]
+
+A summary per sender is printed on Ctrl-C.
+"""
+
+import argparse
+import re
+import socket
+import sys
+import threading
+
+LINE = re.compile(r"^(\d+) (\d+) ([TIWE]) ")
+DROPPED = re.compile(r"^netlog dropped (\d+) lines")
+
+
+class Sender:
+    def __init__(self, name):
+        self.name = name
+        self.next_sequence = None
+        self.lines = 0
+        self.missing = 0
+        self.dropped = 0
+        self.lock = threading.Lock()
+
+    def line(self, text, quiet):
+        with self.lock:
+            match = LINE.match(text)
+            if match:
+                sequence = int(match.group(1))
+                if self.next_sequence is not None and sequence > self.next_sequence:
+                    self.missing += sequence - self.next_sequence
+                    print("%s: -- %d lines missing --" % (self.name, sequence - self.next_sequence), file=sys.stderr)
+                self.next_sequence = sequence + 1
+                self.lines += 1
+            else:
+                match = DROPPED.match(text)
+                if match:
+                    self.dropped += int(match.group(1))
+            if not quiet:
+                print("%s: %s" % (self.name, text), flush=True)
+
+    def summary(self):
+        return "%s: %d lines, %d missing in transit, %d dropped on the hub" % (
+            self.name, self.lines, self.missing, self.dropped)
+
+
+def sender_for(senders, address):
+    name = "%s:%d" % address[:2]
+    if name not in senders:
+        senders[name] = Sender(name)
+    return senders[name]
+
+
+def serve_tcp_client(connection, sender, quiet):
+    buffered = b""
+    with connection:
+        while True:
+            data = connection.recv(4096)
+            if not data:
+                break
+            buffered += data
+            while b"\n" in buffered:
+                line, buffered = buffered.split(b"\n", 1)
+                sender.line(line.decode("utf-8", "replace").rstrip("\r"), quiet)
+
+
+def listen_tcp(port, senders, quiet):
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("", port))
+    server.listen()
+    while True:
+        connection, address = server.accept()
+        # a reconnecting hub keeps its counters, by address only
+        sender = sender_for(senders, (address[0], 0))
+        threading.Thread(target=serve_tcp_client, args=(connection, sender, quiet), daemon=True).start()
+
+
+def listen_udp(port, senders, quiet):
+    server = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server.bind(("", port))
+    while True:
+        data, address = server.recvfrom(65535)
+        sender = sender_for(senders, address)
+        for line in data.decode("utf-8", "replace").splitlines():
+            sender.line(line, quiet)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--udp", action="store_true", help="listen for UDP datagrams instead of TCP connections")
+    parser.add_argument("--port", type=int, default=4888)
+    parser.add_argument("--quiet", action="store_true", help="only count, do not print the lines")
+    args = parser.parse_args()
+
+    senders = {}
+    try:
+        if args.udp:
+            listen_udp(args.port, senders, args.quiet)
+        else:
+            listen_tcp(args.port, senders, args.quiet)
+    except KeyboardInterrupt:
+        pass
+    for sender in senders.values():
+        print(sender.summary(), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
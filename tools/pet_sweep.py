@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+"""
+hackerpet pet sweep
+===================
+
+Runs examples/112_PetSimulation, a challenge played by a simulated pet in
+virtual time, for every combination of pet traits given with --set and
+every seed, --jobs at a time, and sums up how the pets got on:
+
+    runs        runs of the setting (one per seed)
+    top         highest level reached, median over the runs
+    hours to    median hours of hub time until a level was first reported,
+                for every level more than half of the runs reached
+    food/h      foodtreats eaten per hour of hub time, mean over the runs
+    success     success rate over all reported interactions, with a 95%
+                Wilson interval
+
+Every BINARY is a host build of 112_PetSimulation for one challenge (see
+PET_CHALLENGE in it); a trait is a field of PetTraits (src/simulated_pet.h),
+e.g.
+
+    pet_sweep.py --hours 336 --seeds 5 --set reaction_ms=800,1500,3000 \\
+                 --set learning_rate=10,30 build/009_pet build/007_pet
+
+--curves FILE writes the level progression: per setting and hour of hub
+time the median level reached by then, and the mean foodtreats eaten,
+accuracy, satiety and boredom (per mille) of that hour.
+
+usage:
+    pet_sweep.py [--hours H] [--seeds N] [--jobs N] [--set TRAIT=V1,V2...]...
+                 [--curves FILE] [--csv] BINARY...
+"""
+
+import argparse
+import csv
+import itertools
+import os
+import statistics
+import subprocess
+import sys
+from concurrent.futures import ThreadPoolExecutor
+
+from learning_curves import wilson
+from report_server import SUCCESS_RESULTS
+
+# fields of PetTraits, 112_PetSimulation reads them from PET_<FIELD>
+TRAITS = ("reaction_ms", "reaction_spread_ms", "accuracy", "max_accuracy", "learning_rate",
+          "satiety_per_foodtreat", "satiety_half_life_min", "boredom_per_miss", "boredom_half_life_min",
+          "rest_ms", "explore_ms", "touch_ms")
+
+
+class Run:
+    def __init__(self):
+        self.reports = []  # (hub hours, level, success)
+        self.hours = []  # (presented, eaten, accuracy, satiety, boredom) per hour
+        self.error = None
+
+    def first_hours(self):
+        """hub hours of the first report on every level"""
+        first = {}
+        for hours, level, _ in self.reports:
+            first.setdefault(level, hours)
+        return first
+
+    def level_by_hour(self, hours):
+        """the highest level reported by the end of every hour, None before the first report"""
+        levels = []
+        top = None
+        reports = iter(self.reports)
+        report = next(reports, None)
+        for hour in range(1, hours + 1):
+            while (report is not None) and (report[0] <= hour):
+                top = report[1] if top is None else max(top, report[1])
+                report = next(reports, None)
+            levels.append(top)
+        return levels
+
+
+def run(binary, traits, seed, hours):
+    environment = dict(os.environ, PET_HOURS=str(hours), PET_SEED=str(seed))
+    environment.update(("PET_" + name.upper(), str(value)) for name, value in traits)
+    result = Run()
+    try:
+        process = subprocess.run([binary], env=environment, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    except OSError as error:
+        result.error = str(error)
+        return result
+    for line in process.stdout.decode("utf-8", "replace").splitlines():
+        fields = line.split()
+        if fields[:2] == ["pet", "report"] and len(fields) >= 5:
+            result.reports.append((float(fields[2]), int(fields[3]), fields[4].lower() in SUCCESS_RESULTS))
+        elif fields[:2] == ["pet", "hour"] and len(fields) == 8:
+            result.hours.append(tuple(int(value) for value in fields[3:]))
+    if process.returncode != 0:
+        result.error = "exit status %d" % process.returncode
+    return result
+
+
+def parse_set(text):
+    name, _, values = text.partition("=")
+    if name not in TRAITS or not values:
+        raise argparse.ArgumentTypeError("expected TRAIT=V1,V2,... with TRAIT one of " + ", ".join(TRAITS))
+    return name, [int(value) for value in values.split(",")]
+
+
+def describe(binary, traits):
+    return os.path.basename(binary), " ".join("%s=%d" % trait for trait in traits) or "defaults"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("binaries", nargs="+", metavar="BINARY", help="host build of 112_PetSimulation")
+    parser.add_argument("--hours", type=int, default=168, help="hub time of every run")
+    parser.add_argument("--seeds", type=int, default=3, help="runs per setting, seeds 1 to N")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="runs at a time")
+    parser.add_argument("--set", type=parse_set, action="append", default=[], metavar="TRAIT=V1,V2...",
+                        help="values of a trait to sweep")
+    parser.add_argument("--curves", metavar="FILE", help="write the level progression per hour as CSV")
+    parser.add_argument("--csv", action="store_true", help="print the summary as CSV")
+    args = parser.parse_args()
+
+    names = [name for name, _ in args.set]
+    settings = [(binary, tuple(zip(names, values)))
+                for binary in args.binaries for values in itertools.product(*(values for _, values in args.set))]
+    seeds = range(1, max(1, args.seeds) + 1)
+    print("%d runs of %d h each, %d at a time" % (len(settings) * len(seeds), args.hours, args.jobs), file=sys.stderr)
+
+    with ThreadPoolExecutor(max(1, args.jobs)) as pool:
+        futures = {(setting, seed): pool.submit(run, setting[0], setting[1], seed, args.hours)
+                   for setting in settings for seed in seeds}
+        runs = {key: future.result() for key, future in futures.items()}
+
+    for (setting, seed), result in sorted(runs.items()):
+        if result.error:
+            print("%s %s seed %d: %s" % (describe(*setting) + (seed, result.error)), file=sys.stderr)
+
+    columns = ["challenge", "traits", "runs", "top", "hours_to", "food_per_hour", "success", "success_low", "success_high"]
+    rows = []
+    curves = []
+    for setting in settings:
+        results = [runs[(setting, seed)] for seed in seeds]
+        firsts = [result.first_hours() for result in results]
+        levels = sorted(set(level for first in firsts for level in first))
+        hours_to = []
+        for level in levels:
+            reached = [first[level] for first in firsts if level in first]
+            if 2 * len(reached) > len(results):
+                hours_to.append("%d:%.1f" % (level, statistics.median(reached)))
+        tops = [max(first) for first in firsts if first]
+        food = [sum(hour[1] for hour in result.hours) / len(result.hours) for result in results if result.hours]
+        won = sum(success for result in results for _, _, success in result.reports)
+        total = sum(len(result.reports) for result in results)
+        low, high = wilson(won, total)
+        rows.append(list(describe(*setting)) + [len(results), statistics.median(tops) if tops else None,
+                                                 " ".join(hours_to), statistics.mean(food) if food else 0.0,
+                                                 won / total if total else 0.0, low, high])
+
+        by_hour = [result.level_by_hour(args.hours) for result in results]
+        for hour in range(args.hours):
+            reached = [levels[hour] for levels in by_hour if levels[hour] is not None]
+            of_hour = [result.hours[hour] for result in results if hour < len(result.hours)]
+            if not of_hour:
+                continue
+            curves.append(list(describe(*setting)) + [hour + 1, statistics.median(reached) if reached else ""]
+                          + ["%.1f" % statistics.mean(values[i] for values in of_hour) for i in range(1, 5)])
+
+    if args.csv:
+        writer = csv.writer(sys.stdout)
+        writer.writerow(columns)
+        writer.writerows(rows)
+    else:
+        print("%-24s %-32s %4s %4s %7s %14s  %s" % ("challenge", "traits", "runs", "top", "food/h", "success (95%)", "hours to"))
+        for row in rows:
+            print("%-24s %-32s %4d %4s %7.2f %4.1f%% (%.1f-%.1f)  %s" % (
+                row[0][:24], row[1][:32], row[2], "-" if row[3] is None else "%g" % row[3], row[5],
+                100 * row[6], 100 * row[7], 100 * row[8], row[4]))
+
+    if args.curves:
+        with open(args.curves, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["challenge", "traits", "hour", "level", "eaten", "accuracy", "satiety", "boredom"])
+            writer.writerows(curves)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,463 @@
+#!/usr/bin/env python3
+"""
+hackerpet report server
+=======================
+
+Self-hosted replacement for the sheet behind docs/particle_webhook.json:
+takes "hckrpt" events, stores the reports in append-only column files and
+answers aggregate queries by scanning only the columns they need.
+
+    serve         accept events over HTTP (point the webhook, or
+                  webhook_standin.py --forward, at http://HOST:PORT/)
+    ingest        load JSON lines of webhook bodies, e.g. a
+                  webhook_standin.py --log file
+    success-rate  interactions, successes and success rate per day,
+                  challenge and level
+
+A POST body is either what the webhook sends,
+
+    {"event": "hckrpt/report", "data": "<report JSON>", "coreid": "...",
+     "published_at": "..."}
+
+or the report JSON HubInterface::Report() publishes, with the device in
+?coreid=. Compact batches ("hckrpt/dict", "hckrpt/creport") are decoded
+with decode_compact_reports.py.
+
+Storage: DATA/<device>/<challenge_id>/ holds one file per column and a
+"rows" file with the number of complete rows. Rows are appended, never
+rewritten; a crash can only leave a partial row after "rows", which is cut
+off when the partition is opened again. Numbers are little endian uint32
+(flags uint8), text columns hold ids into a .dict file of JSON lines, and
+extra is a blob with an offsets column. success-rate reads timestamp,
+level and result only, with numpy if it is installed.
+
+usage:
+    report_server.py serve --data DIR [--port PORT] [--flush-every SECONDS]
+    report_server.py ingest --data DIR [events.jsonl]
+    report_server.py success-rate --data DIR [--device ID] [--challenge NAME]
+                     [--since YYYY-MM-DD] [--until YYYY-MM-DD] [--csv]
+"""
+
+import argparse
+import array
+import datetime
+import json
+import os
+import sys
+import threading
+import time
+import urllib.parse
+from collections import Counter
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from decode_compact_reports import DecodeError, decode_batch, load_dictionaries, save_dictionaries
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+# column name -> array typecode; text columns are ids into <name>.dict
+NUMBER_COLUMNS = {"timestamp": "I", "play_start": "I", "level": "I", "duration": "I", "flags": "B"}
+TEXT_COLUMNS = {"player": "I", "result": "I"}
+COLUMNS = dict(NUMBER_COLUMNS, **TEXT_COLUMNS, extra_end="Q")
+
+FLAG_FOODTREAT_PRESENTED = 0b01
+FLAG_FOODTREAT_EATEN = 0b10
+
+SUCCESS_RESULTS = ("1", "true", "success")
+
+if (array.array("I").itemsize != 4) or (array.array("Q").itemsize != 8) or (sys.byteorder != "little"):
+    sys.exit("report_server.py writes the columns with the array module, it needs 32 bit ints, little endian")
+
+
+def number(value):
+    try:
+        return int(value)
+    except (TypeError, ValueError):
+        return 0
+
+
+def unix_time(iso):
+    """seconds of an ISO 8601 time like play_start_time, 0 if it is not one"""
+    try:
+        return int(datetime.datetime.fromisoformat(iso.replace("Z", "+00:00")).timestamp())
+    except (AttributeError, ValueError, OverflowError):
+        return 0
+
+
+def partition_name(text):
+    return urllib.parse.quote(text or "unknown", safe="")
+
+
+class TextDictionary:
+    """append-only list of texts, a column stores their index"""
+
+    def __init__(self, path):
+        self.path = path
+        self.texts = []
+        self.ids = {}
+        if os.path.exists(path):
+            with open(path) as f:
+                for line in f:
+                    text = json.loads(line)
+                    self.ids[text] = len(self.texts)
+                    self.texts.append(text)
+
+    def id(self, text, pending):
+        if text not in self.ids:
+            self.ids[text] = len(self.texts)
+            self.texts.append(text)
+            pending.append(text)
+        return self.ids[text]
+
+
+class Partition:
+    """the reports of one device and challenge_id"""
+
+    def __init__(self, path, writable=True):
+        # only the writer cuts off partial rows, a reader could cut off rows being written
+        self.path = path
+        if writable:
+            os.makedirs(path, exist_ok=True)
+        self.rows = self._read_rows()
+        if writable:
+            self._cut_partial_rows()
+        self.dictionaries = {name: TextDictionary(self._file(name + ".dict")) for name in TEXT_COLUMNS}
+        self.pending = {name: array.array(typecode) for name, typecode in COLUMNS.items()}
+        self.pending_texts = {name: [] for name in TEXT_COLUMNS}
+        self.pending_extra = bytearray()
+        self.extra_size = os.path.getsize(self._file("extra.bin")) if os.path.exists(self._file("extra.bin")) else 0
+
+    def _file(self, name):
+        return os.path.join(self.path, name)
+
+    def _read_rows(self):
+        try:
+            with open(self._file("rows")) as f:
+                return int(f.read())
+        except (OSError, ValueError):
+            return 0
+
+    def _cut_partial_rows(self):
+        for name, typecode in COLUMNS.items():
+            path = self._file(name)
+            size = self.rows * array.array(typecode).itemsize
+            if os.path.exists(path) and os.path.getsize(path) > size:
+                os.truncate(path, size)
+        extra_end = self.read_column("extra_end")
+        path = self._file("extra.bin")
+        if os.path.exists(path) and os.path.getsize(path) > (extra_end[-1] if len(extra_end) else 0):
+            os.truncate(path, extra_end[-1] if len(extra_end) else 0)
+
+    def append(self, report, timestamp=None):
+        p = self.pending
+        p["timestamp"].append(number(report.get("timestamp")) or number(timestamp))
+        p["play_start"].append(unix_time(report.get("play_start_time")))
+        p["level"].append(number(report.get("level")))
+        p["duration"].append(number(report.get("duration")))
+        p["flags"].append((FLAG_FOODTREAT_PRESENTED if number(report.get("foodtreat_presented")) else 0)
+                          | (FLAG_FOODTREAT_EATEN if number(report.get("foodtreat_eaten")) else 0))
+        for name in TEXT_COLUMNS:
+            p[name].append(self.dictionaries[name].id(str(report.get(name, "")), self.pending_texts[name]))
+        extra = report.get("extra")
+        if extra is not None:
+            self.pending_extra += json.dumps(extra, separators=(",", ":")).encode()
+        p["extra_end"].append(self.extra_size + len(self.pending_extra))
+
+    def flush(self):
+        """writes the pending rows, then commits them in "rows" """
+        count = len(self.pending["timestamp"])
+        if count == 0:
+            return 0
+        for name in TEXT_COLUMNS:
+            if self.pending_texts[name]:
+                with open(self._file(name + ".dict"), "a") as f:
+                    f.writelines(json.dumps(text) + "\n" for text in self.pending_texts[name])
+                self.pending_texts[name] = []
+        for name, column in self.pending.items():
+            with open(self._file(name), "ab") as f:
+                column.tofile(f)
+            self.pending[name] = array.array(column.typecode)
+        with open(self._file("extra.bin"), "ab") as f:
+            f.write(self.pending_extra)
+        self.extra_size += len(self.pending_extra)
+        self.pending_extra = bytearray()
+
+        self.rows += count
+        with open(self._file("rows.new"), "w") as f:
+            f.write(str(self.rows))
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(self._file("rows.new"), self._file("rows"))
+        return count
+
+    def read_column(self, name, rows=None):
+        """the committed values of a column, a numpy array if numpy is there"""
+        rows = self.rows if rows is None else rows
+        typecode = COLUMNS[name]
+        path = self._file(name)
+        if numpy is not None:
+            dtype = numpy.dtype({"B": "<u1", "I": "<u4", "Q": "<u8"}[typecode])
+            if not os.path.exists(path):
+                return numpy.zeros(0, dtype)
+            return numpy.fromfile(path, dtype, count=rows)
+        values = array.array(typecode)
+        if os.path.exists(path):
+            with open(path, "rb") as f:
+                values.fromfile(f, min(rows, os.path.getsize(path) // values.itemsize))
+        return values
+
+
+class Store:
+    """all partitions under one data directory"""
+
+    def __init__(self, path):
+        self.path = path
+        self.lock = threading.Lock()
+        self.partitions = {}
+        self.dictionaries = load_dictionaries(os.path.join(path, "compact_dicts.json"))
+        os.makedirs(path, exist_ok=True)
+
+    def partition(self, device, challenge_id):
+        key = (partition_name(device), partition_name(challenge_id))
+        if key not in self.partitions:
+            self.partitions[key] = Partition(os.path.join(self.path, *key))
+        return self.partitions[key]
+
+    def add_event(self, event):
+        """stores the reports of one webhook body, returns how many"""
+        name = event.get("event", "")
+        device = event.get("coreid", "unknown")
+        received = unix_time(event.get("published_at"))
+        with self.lock:
+            if name == "hckrpt/report":
+                data = event["data"]
+                reports = [json.loads(data) if isinstance(data, str) else data]
+            elif name == "hckrpt/dict":
+                entry = json.loads(event["data"])
+                self.dictionaries[entry["dict_id"]] = {"challenge_id": entry["challenge_id"], "player": entry["player"]}
+                save_dictionaries(os.path.join(self.path, "compact_dicts.json"), self.dictionaries)
+                return 0
+            elif name == "hckrpt/creport":
+                reports = [json.loads(report) for report in decode_batch(event["data"], self.dictionaries)]
+            else:
+                return 0
+            for report in reports:
+                self.partition(device, report.get("challenge_id")).append(report, received)
+            return len(reports)
+
+    def flush(self):
+        with self.lock:
+            return sum(partition.flush() for partition in self.partitions.values())
+
+    def scan(self, device=None, challenge=None):
+        """yields (device, challenge_id, Partition) of the stored partitions that match"""
+        if not os.path.isdir(self.path):
+            return
+        for device_dir in sorted(os.listdir(self.path)):
+            device_path = os.path.join(self.path, device_dir)
+            if not os.path.isdir(device_path):
+                continue
+            device_id = urllib.parse.unquote(device_dir)
+            if device and device_id != device:
+                continue
+            for challenge_dir in sorted(os.listdir(device_path)):
+                challenge_id = urllib.parse.unquote(challenge_dir)
+                if challenge and challenge_name(challenge_id) != challenge:
+                    continue
+                key = (device_dir, challenge_dir)
+                partition = self.partitions.get(key) or Partition(os.path.join(device_path, challenge_dir), writable=False)
+                yield device_id, challenge_id, partition
+
+
+def challenge_name(challenge_id):
+    """challenge_id without the build date and time SetChallengeId adds"""
+    return challenge_id.split("#")[0]
+
+
+def success_rate(store, device=None, challenge=None, since=None, until=None):
+    """rows of (day, challenge, level, interactions, successes), days as YYYY-MM-DD in UTC"""
+    counts = Counter()
+    successes = Counter()
+    first_day = since and datetime.date.fromisoformat(since).toordinal() - 719163  # days since 1970-01-01
+    last_day = until and datetime.date.fromisoformat(until).toordinal() - 719163
+
+    for _, challenge_id, partition in store.scan(device, challenge):
+        rows = partition.rows  # read every column up to the same committed row
+        if rows == 0:
+            continue
+        name = challenge_name(challenge_id)
+        results = partition.dictionaries["result"].texts
+        is_success = [text.lower() in SUCCESS_RESULTS for text in results]
+        days = partition.read_column("timestamp", rows)
+        levels = partition.read_column("level", rows)
+        result_ids = partition.read_column("result", rows)
+
+        if numpy is not None:
+            days = days // 86400
+            keep = numpy.ones(rows, bool)
+            if first_day:
+                keep &= days >= first_day
+            if last_day:
+                keep &= days <= last_day
+            won = numpy.asarray(is_success, bool)[result_ids] if is_success else numpy.zeros(rows, bool)
+            # one key per (day, level), counted in one pass
+            keys = days[keep].astype(numpy.uint64) << numpy.uint64(32) | levels[keep]
+            unique, total = numpy.unique(keys, return_counts=True)
+            unique_won, total_won = numpy.unique(keys[won[keep]], return_counts=True)
+            for key, n in zip(unique.tolist(), total.tolist()):
+                counts[(key >> 32, name, key & 0xFFFFFFFF)] += n
+            for key, n in zip(unique_won.tolist(), total_won.tolist()):
+                successes[(key >> 32, name, key & 0xFFFFFFFF)] += n
+        else:
+            for timestamp, level, result in zip(days, levels, result_ids):
+                day = timestamp // 86400
+                if (first_day and day < first_day) or (last_day and day > last_day):
+                    continue
+                counts[(day, name, level)] += 1
+                if is_success[result]:
+                    successes[(day, name, level)] += 1
+
+    for key in sorted(counts):
+        day, name, level = key
+        date = datetime.date.fromordinal(day + 719163).isoformat()
+        yield date, name, level, counts[key], successes[key]
+
+
+def make_handler(store):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_POST(self):
+            url = urllib.parse.urlparse(self.path)
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            try:
+                event = json.loads(body)
+                if "event" not in event:
+                    # the report itself, as HubInterface::Report() publishes it
+                    device = urllib.parse.parse_qs(url.query).get("coreid", ["unknown"])[0]
+                    event = {"event": "hckrpt/report", "data": event, "coreid": device}
+                store.add_event(event)
+            except (DecodeError, ValueError, KeyError, TypeError, AttributeError) as e:
+                self.answer(400, {"error": str(e)})
+                return
+            self.answer(200, {})
+
+        def do_GET(self):
+            url = urllib.parse.urlparse(self.path)
+            query = {key: values[0] for key, values in urllib.parse.parse_qs(url.query).items()}
+            if url.path != "/success-rate":
+                self.answer(404, {"error": "GET /success-rate?device=&challenge=&since=&until="})
+                return
+            store.flush()
+            try:
+                rows = [dict(zip(("day", "challenge", "level", "interactions", "successes"), row))
+                        for row in success_rate(store, query.get("device"), query.get("challenge"),
+                                                query.get("since"), query.get("until"))]
+            except ValueError as e:
+                self.answer(400, {"error": str(e)})
+                return
+            for row in rows:
+                row["rate"] = row["successes"] / row["interactions"]
+            self.answer(200, rows)
+
+        def answer(self, status, content):
+            body = json.dumps(content).encode()
+            self.send_response(status)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, format, *values):
+            pass
+
+    return Handler
+
+
+def serve(args):
+    store = Store(args.data)
+    server = ThreadingHTTPServer(("", args.port), make_handler(store))
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print("listening on port %d, storing in %s" % (args.port, args.data))
+    stored = 0
+    try:
+        while True:
+            time.sleep(args.flush_every)
+            written = store.flush()
+            stored += written
+            if written:
+                print("%d reports stored, %d since start" % (written, stored))
+                sys.stdout.flush()
+    except KeyboardInterrupt:
+        server.shutdown()
+        store.flush()
+    return 0
+
+
+def ingest(args):
+    store = Store(args.data)
+    source = open(args.events) if args.events else sys.stdin
+    stored = errors = 0
+    for number_of_line, line in enumerate(source, 1):
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            stored += store.add_event(json.loads(line))
+        except (DecodeError, ValueError, KeyError, TypeError) as e:
+            errors += 1
+            print("skipping line %d: %s" % (number_of_line, e), file=sys.stderr)
+        if number_of_line % 10000 == 0:
+            store.flush()
+    store.flush()
+    print("%d reports stored, %d lines skipped" % (stored, errors), file=sys.stderr)
+    return 1 if errors else 0
+
+
+def print_success_rate(args):
+    store = Store(args.data)
+    rows = success_rate(store, args.device, args.challenge, args.since, args.until)
+    if args.csv:
+        print("day,challenge,level,interactions,successes,rate")
+        for day, name, level, total, won in rows:
+            print("%s,%s,%d,%d,%d,%.4f" % (day, name, level, total, won, won / total))
+    else:
+        print("%-10s  %-32s %5s %12s %9s %6s" % ("day", "challenge", "level", "interactions", "successes", "rate"))
+        for day, name, level, total, won in rows:
+            print("%-10s  %-32s %5d %12d %9d %5.1f%%" % (day, name[:32], level, total, won, 100.0 * won / total))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("serve", help="accept webhook events over HTTP")
+    command.add_argument("--data", required=True, help="directory of the column files")
+    command.add_argument("--port", type=int, default=8091)
+    command.add_argument("--flush-every", type=float, default=1.0, help="seconds between writes to disk")
+    command.set_defaults(run=serve)
+
+    command = commands.add_parser("ingest", help="store JSON lines of webhook bodies")
+    command.add_argument("--data", required=True, help="directory of the column files")
+    command.add_argument("events", nargs="?", help="JSON lines (default: stdin)")
+    command.set_defaults(run=ingest)
+
+    command = commands.add_parser("success-rate", help="success rate per day, challenge and level")
+    command.add_argument("--data", required=True, help="directory of the column files")
+    command.add_argument("--device")
+    command.add_argument("--challenge", help="challenge name, without the build date")
+    command.add_argument("--since", metavar="YYYY-MM-DD")
+    command.add_argument("--until", metavar="YYYY-MM-DD")
+    command.add_argument("--csv", action="store_true")
+    command.set_defaults(run=print_success_rate)
+
+    args = parser.parse_args()
+    return args.run(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+Report the size of the hackerpet library
+========================================
+
+Reads a firmware .elf built with the library (any example, e.g.
+108_SizeReport, built locally with debug information) and prints:
+
+    flash      bytes of code and constant data of the library
+    ram        bytes of static variables of the library (data + bss)
+    sizeof     sizeof(HubInterface) and sizeof(dlimsg_t), the RAM every hub
+               and every queued device layer message takes
+    firmware   text, data and bss of the whole firmware
+
+Library symbols are the ones of the classes and structs declared in src/,
+found with arm-none-eabi-nm. The sizeof values come from the debug
+information with arm-none-eabi-gdb, they are left out without it.
+
+--history FILE --release NAME appends the numbers to a CSV file, one row
+per release, and shows how they changed since the previous row.
+
+usage:
+    size_report.py FIRMWARE.elf [--history FILE --release NAME] [--tools PREFIX]
+"""
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+
+COLUMNS = ["release", "flash", "ram", "sizeof_HubInterface", "sizeof_dlimsg_t", "text", "data", "bss"]
+
+
+def library_names():
+    """class and struct names declared in the library headers"""
+    names = set()
+    for name in os.listdir(SRC):
+        if name.endswith(".h"):
+            with open(os.path.join(SRC, name), encoding="utf-8", errors="replace") as header:
+                names.update(re.findall(r"^\s*(?:class|struct)\s+(\w+)\s*(?::[^;{]*)?$", header.read(), re.M))
+    return names
+
+
+def run(command):
+    return subprocess.run(command, check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+
+def library_sizes(elf, prefix, names):
+    """(flash, ram) of the symbols that belong to the library"""
+    flash = ram = 0
+    owner = re.compile(r"^(?:\w+::)*(%s)\b" % "|".join(sorted(names)))
+    for line in run([prefix + "nm", "--print-size", "--size-sort", "-C", elf]).splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4 or not owner.match(parts[3]):
+            continue
+        size, kind = int(parts[1], 16), parts[2].lower()
+        if kind in "tr":
+            flash += size
+        elif kind in "bd":
+            ram += size
+            if kind == "d":
+                flash += size  # initial values are stored in flash too
+    return flash, ram
+
+
+def firmware_sizes(elf, prefix):
+    """text, data and bss of the whole firmware"""
+    lines = run([prefix + "size", elf]).splitlines()
+    return [int(value) for value in lines[1].split()[:3]]
+
+
+def sizeof(elf, prefix, type_name):
+    try:
+        output = run([prefix + "gdb", "-batch", "-ex", "print sizeof(%s)" % type_name, elf])
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+    match = re.search(r"= (\d+)", output)
+    return int(match.group(1)) if match else ""
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf")
+    parser.add_argument("--history", metavar="FILE", help="CSV file with the numbers of earlier releases")
+    parser.add_argument("--release", help="name of this release in the history")
+    parser.add_argument("--tools", default="arm-none-eabi-", metavar="PREFIX", help="prefix of nm, size and gdb")
+    args = parser.parse_args()
+    if args.history and not args.release:
+        parser.error("--history needs --release")
+
+    flash, ram = library_sizes(args.elf, args.tools, library_names())
+    text, data, bss = firmware_sizes(args.elf, args.tools)
+    row = {"release": args.release or "", "flash": flash, "ram": ram,
+           "sizeof_HubInterface": sizeof(args.elf, args.tools, "HubInterface"),
+           "sizeof_dlimsg_t": sizeof(args.elf, args.tools, "dlimsg_t"),
+           "text": text, "data": data, "bss": bss}
+
+    previous = None
+    if args.history and os.path.exists(args.history):
+        with open(args.history, newline="") as history:
+            rows = list(csv.DictReader(history))
+        previous = rows[-1] if rows else None
+
+    for column in COLUMNS[1:]:
+        line = "%-20s %8s" % (column, row[column])
+        if previous and previous.get(column) and row[column] != "":
+            line += "  %+d since %s" % (row[column] - int(previous[column]), previous["release"])
+        print(line)
+
+    if args.history:
+        new = not os.path.exists(args.history)
+        with open(args.history, "a", newline="") as history:
+            writer = csv.DictWriter(history, fieldnames=COLUMNS)
+            if new:
+                writer.writeheader()
+            writer.writerow(row)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
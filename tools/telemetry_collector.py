@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""
+Collect hackerpet telemetry
+===========================
+
+Receives the binary telemetry datagrams that hubs send after
+HubInterface::EnableTelemetry(host, port), from any number of hubs, and
+every few seconds prints one line per hub:
+
+    device       the hub's device id
+    loss         datagrams lost in transit, from the sequence numbers
+    pads L/M/R   baseline - reading of each touchpad (how strongly touched)
+    drift        how far each baseline moved since the hub was first seen
+    integ        capsense stuck-touch integrators
+    fm           food machine state
+    q            command / reply queue depth
+    link         commands sent, retries, timeouts, dropped, bad replies
+                 since the previous line
+    flags        see TELEMETRY_FLAG_... in src/telemetry.h
+
+--csv writes every decoded datagram as one CSV row, for plotting later.
+
+usage:
+    telemetry_collector.py [--port PORT] [--every SECONDS] [--csv FILE]
+"""
+
+import argparse
+import csv
+import select
+import socket
+import struct
+import sys
+import time
+
+TELEMETRY_VERSION = 1
+
+# see the datagram layout in src/telemetry.h
+DATAGRAM = struct.Struct("<2sBBH12sI3H3H3BBBBHHHIIIII")
+
+FIELDS = ["device", "sequence", "flags", "uptime_ms",
+          "read_left", "read_middle", "read_right",
+          "baseline_left", "baseline_middle", "baseline_right",
+          "integration_left", "integration_middle", "integration_right",
+          "buttons", "foodmachine_state", "cmd_queue", "reply_queue", "last_error",
+          "cmds_sent", "retries", "listen_timeouts", "cmds_dropped", "bad_replies"]
+
+FLAGS = ["ready", "di-reset", "di-lock", "dome", "no-food", "platter", "singulator", "stuck"]
+
+LINK = ["cmds_sent", "retries", "listen_timeouts", "cmds_dropped", "bad_replies"]
+
+
+def decode(datagram):
+    """returns the sample as a dict, or None if it is not a telemetry datagram"""
+    if len(datagram) != DATAGRAM.size:
+        return None
+    values = DATAGRAM.unpack(datagram)
+    magic, version = values[0], values[1]
+    if magic != b"HT" or version != TELEMETRY_VERSION:
+        return None
+    rest = values[2:]
+    sample = {"flags": rest[0], "sequence": rest[1], "device": rest[2].hex()}
+    names = FIELDS[3:]
+    # skip the reserved byte after foodmachine_state
+    numbers = list(rest[3:15]) + list(rest[16:])
+    sample.update(zip(names, numbers))
+    return sample
+
+
+class Hub:
+    def __init__(self, first):
+        self.first = first
+        self.latest = first
+        self.reported = first
+        self.received = 1
+        self.lost = 0
+
+    def add(self, sample):
+        expected = (self.latest["sequence"] + 1) & 0xFFFF
+        if sample["sequence"] != expected:
+            gap = (sample["sequence"] - expected) & 0xFFFF
+            if gap < 0x8000:
+                self.lost += gap
+        if sample["uptime_ms"] < self.latest["uptime_ms"]:
+            # the hub restarted, counters start over
+            self.reported = sample
+        self.latest = sample
+        self.received += 1
+
+    def line(self):
+        s = self.latest
+        pads = "/".join("%4d" % (s["baseline_" + p] - s["read_" + p]) for p in ("left", "middle", "right"))
+        drift = "/".join("%+4d" % (s["baseline_" + p] - self.first["baseline_" + p]) for p in ("left", "middle", "right"))
+        integ = "/".join(str(s["integration_" + p]) for p in ("left", "middle", "right"))
+        link = "/".join(str(s[k] - self.reported[k]) for k in LINK)
+        flags = ",".join(name for bit, name in enumerate(FLAGS) if s["flags"] & (1 << bit))
+        self.reported = s
+        return "%s loss %3.0f%%  pads %s  drift %s  integ %s  fm %2d  q %d/%d  link %s  %s" % (
+            s["device"], 100.0 * self.lost / (self.received + self.lost), pads, drift, integ,
+            s["foodmachine_state"], s["cmd_queue"], s["reply_queue"], link, flags)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=4889)
+    parser.add_argument("--every", type=float, default=5.0, help="seconds between summaries")
+    parser.add_argument("--csv", metavar="FILE", help="append every sample to FILE")
+    args = parser.parse_args()
+
+    server = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server.bind(("", args.port))
+
+    writer = None
+    if args.csv:
+        out = open(args.csv, "a", newline="")
+        writer = csv.DictWriter(out, fieldnames=["received"] + FIELDS)
+        if out.tell() == 0:
+            writer.writeheader()
+
+    hubs = {}
+    ignored = 0
+    next_summary = time.time() + args.every
+    try:
+        while True:
+            ready, _, _ = select.select([server], [], [], max(0.0, next_summary - time.time()))
+            if ready:
+                datagram, _ = server.recvfrom(2048)
+                sample = decode(datagram)
+                if sample is None:
+                    ignored += 1
+                    continue
+                if sample["device"] in hubs:
+                    hubs[sample["device"]].add(sample)
+                else:
+                    hubs[sample["device"]] = Hub(sample)
+                if writer:
+                    writer.writerow(dict(sample, received="%.3f" % time.time()))
+            if time.time() >= next_summary:
+                for device in sorted(hubs):
+                    print(hubs[device].line())
+                if ignored:
+                    print("ignored %d datagrams that are not telemetry" % ignored, file=sys.stderr)
+                    ignored = 0
+                sys.stdout.flush()
+                next_summary += args.every
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,145 @@
+#!/usr/bin/env python3
+"""
+Stand-in for the report webhook
+===============================
+
+Accepts the POSTs the webhook in docs/particle_webhook.json makes for every
+"hckrpt" event:
+
+    {"event": "hckrpt/report", "data": "<the report JSON>",
+     "coreid": "<device id>", "published_at": "<ISO 8601 time>"}
+
+locally, e.g. from examples/111_Fleet, and every few seconds prints the
+requests per second, the events by name, the devices seen and the requests
+it could not use. --delay and --fail make it behave like a slow or failing
+backend, --forward passes every request on to the real service (or the
+ingestion server) and answers with its status.
+
+usage:
+    webhook_standin.py [--port PORT] [--every SECONDS] [--delay MS]
+                       [--fail PERCENT] [--forward URL] [--log FILE]
+"""
+
+import argparse
+import json
+import random
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+from collections import Counter
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.bad = 0
+        self.failed = 0
+        self.events = Counter()
+        self.devices = set()
+
+    def take(self):
+        """returns the counts since the last call and starts over"""
+        with self.lock:
+            taken = (self.requests, self.bad, self.failed, dict(self.events), len(self.devices))
+            self.requests = self.bad = self.failed = 0
+            self.events.clear()
+            return taken
+
+
+def make_handler(args, stats, log):
+    class Handler(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            try:
+                hook = json.loads(body)
+                event = hook["event"]
+                device = hook["coreid"]
+                if event == "hckrpt/report":
+                    json.loads(hook["data"])  # the report itself is JSON too
+            except (ValueError, KeyError, TypeError):
+                with stats.lock:
+                    stats.bad += 1
+                self.answer(400)
+                return
+
+            if args.delay:
+                time.sleep(args.delay / 1000.0)
+            status = 200
+            if args.fail and random.uniform(0, 100) < args.fail:
+                status = 503
+            elif args.forward:
+                status = forward(args.forward, body)
+
+            with stats.lock:
+                stats.requests += 1
+                stats.events[event] += 1
+                stats.devices.add(device)
+                if status != 200:
+                    stats.failed += 1
+                if log:
+                    log.write(body.decode("utf-8", "replace") + "\n")
+            self.answer(status)
+
+        def answer(self, status):
+            self.send_response(status)
+            self.send_header("Content-Length", "0")
+            self.end_headers()
+
+        def log_message(self, format, *values):
+            pass  # one line per request would hide the summaries
+
+    return Handler
+
+
+def forward(url, body):
+    request = urllib.request.Request(url, data=body, headers={"Content-Type": "application/json"})
+    try:
+        with urllib.request.urlopen(request, timeout=10) as response:
+            return response.status
+    except urllib.error.HTTPError as error:
+        return error.code
+    except OSError:
+        return 502
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8090)
+    parser.add_argument("--every", type=float, default=5.0, help="seconds between summaries")
+    parser.add_argument("--delay", type=float, default=0, help="ms to wait before answering")
+    parser.add_argument("--fail", type=float, default=0, help="percent of requests answered with 503")
+    parser.add_argument("--forward", metavar="URL", help="pass requests on to URL")
+    parser.add_argument("--log", metavar="FILE", help="append every request body to FILE, one per line")
+    args = parser.parse_args()
+
+    stats = Stats()
+    log = open(args.log, "a") if args.log else None
+    server = ThreadingHTTPServer(("", args.port), make_handler(args, stats, log))
+    server.daemon_threads = True
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    print("listening on port %d" % args.port)
+
+    total = 0
+    try:
+        while True:
+            time.sleep(args.every)
+            requests, bad, failed, events, devices = stats.take()
+            total += requests
+            events = ", ".join("%s %d" % (name, count) for name, count in sorted(events.items()))
+            print("%7.1f requests/s  %d total  %d devices  %d failed  %d bad  %s" % (
+                requests / args.every, total, devices, failed, bad, events))
+            if log:
+                log.flush()
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        server.shutdown()
+
+
+if __name__ == "__main__":
+    main()